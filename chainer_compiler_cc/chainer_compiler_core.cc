@@ -28,6 +28,7 @@
 #include <runtime/chxvm.pb.h>
 #include <runtime/chxvm_state.h>
 #include <runtime/chxvm_var.h>
+#include <runtime/gradient_accumulator.h>
 #include <runtime/meminfo.h>
 #include <tools/util.h>
 
@@ -365,6 +366,25 @@ void InitChxVMVar(py::module& m) {
     c.def("__str__", [](const VarPtr& v) { return "var(" + v->DebugString() + ")"; });
 }
 
+void InitGradientAccumulator(py::module& m) {
+    py::class_<runtime::GradientAccumulator, std::shared_ptr<runtime::GradientAccumulator>> c{m, "GradientAccumulator"};
+    c.def(py::init<int64_t>(), "num_micro_batches"_a);
+    c.def("add",
+          &runtime::GradientAccumulator::Add,
+          "Accumulate gradients in outputs of a micro-batch. Returns true for the last micro-batch",
+          "outputs"_a);
+    c.def("grads", &runtime::GradientAccumulator::grads, "Mean gradients of the last batch");
+    c.def_property_readonly("num_micro_batches", &runtime::GradientAccumulator::num_micro_batches);
+}
+
+std::vector<ArrayBodyPtr> SplitBatch(const ArrayBodyPtr& a, int64_t num_micro_batches) {
+    std::vector<ArrayBodyPtr> out;
+    for (const chainerx::Array& x : runtime::SplitBatch(chainerx::Array(a), num_micro_batches)) {
+        out.push_back(chainerx::internal::GetArrayBody(x));
+    }
+    return out;
+}
+
 VarPtr CreateValueFromArray(const ArrayBodyPtr& a) {
     return std::make_shared<runtime::ChxVMVar>(chainerx::Array(a));
 }
@@ -396,12 +416,15 @@ PYBIND11_MODULE(_chainer_compiler_core, m) {  // NOLINT
 
     InitChxVMState(m);
 
+    InitGradientAccumulator(m);
+
     m.def("load", &LoadGraph, "Load an ONNX model");
     m.def("configure", &Configure, "Configure global variables in chainer compiler",
 #include "chainer_compiler_cc/pybind_args.inc"
     );
     m.def("value", &CreateValueFromArray, "Create an ChxVMVar from a ChainerX Array");
     m.def("value", &CreateValueFromSequence, "Create an ChxVMVar from a sequence of ChxVMVars");
+    m.def("split_batch", &SplitBatch, "Split a batch into micro-batches", "batch"_a, "num_micro_batches"_a);
 
     m.def("initialize_memory_monitoring", &InitializeMemoryMonitoring, "Initialize function hooks to monitor memory usage");
     m.def("get_peak_memory", &runtime::GetPeakMemory, "Output peak memory usage observed by function hooks");
@@ -0,0 +1,240 @@
+#include "compiler/calibration.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+#include <chainerx/native/native_backend.h>
+#include <chainerx/routines/creation.h>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/value.h>
+#include <runtime/chainerx_util.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+// The number of quantized bins for a half of the range.
+constexpr int kNumQuantizedBins = 128;
+
+double KLDivergence(const std::vector<double>& p, const std::vector<double>& q) {
+    double p_sum = 0, q_sum = 0;
+    for (size_t i = 0; i < p.size(); ++i) {
+        p_sum += p[i];
+        q_sum += q[i];
+    }
+    double kl = 0;
+    for (size_t i = 0; i < p.size(); ++i) {
+        if (p[i] == 0) continue;
+        const double pi = p[i] / p_sum;
+        const double qi = std::max(q[i] / q_sum, 1e-12);
+        kl += pi * std::log(pi / qi);
+    }
+    return kl;
+}
+
+}  // namespace
+
+bool ParseCalibrationMethod(const std::string& name, CalibrationMethod* method) {
+    if (name == "minmax") {
+        *method = CalibrationMethod::kMinMax;
+    } else if (name == "percentile") {
+        *method = CalibrationMethod::kPercentile;
+    } else if (name == "entropy") {
+        *method = CalibrationMethod::kEntropy;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void TensorStatistics::Add(const chainerx::Array& a) {
+    const chainerx::Array x = chainerx::AsContiguous(a.ToDevice(chainerx::GetNativeBackend().GetDevice(0)).AsType(chainerx::Dtype::kFloat32));
+    const float* p = static_cast<const float*>(runtime::RawStartPtr(x));
+    const int64_t size = x.GetTotalSize();
+    if (size == 0) {
+        return;
+    }
+
+    float lo = p[0], hi = p[0];
+    for (int64_t i = 0; i < size; ++i) {
+        lo = std::min(lo, p[i]);
+        hi = std::max(hi, p[i]);
+    }
+    if (empty_) {
+        hist_.assign(kNumBins, 0);
+        min_ = lo;
+        max_ = hi;
+        empty_ = false;
+    } else {
+        min_ = std::min(min_, lo);
+        max_ = std::max(max_, hi);
+    }
+    Widen(std::max(std::abs(lo), std::abs(hi)));
+
+    if (abs_max_ == 0) {
+        hist_[0] += size;
+        return;
+    }
+    const float bin_width = abs_max_ / kNumBins;
+    for (int64_t i = 0; i < size; ++i) {
+        const int bin = std::min<int>(kNumBins - 1, std::abs(p[i]) / bin_width);
+        hist_[bin] += 1;
+    }
+}
+
+void TensorStatistics::Widen(float abs_max) {
+    if (abs_max <= abs_max_) {
+        return;
+    }
+    if (abs_max_ > 0) {
+        // Move each old bin into the new bin which contains its center.
+        std::vector<double> hist(kNumBins, 0);
+        const float old_width = abs_max_ / kNumBins;
+        const float new_width = abs_max / kNumBins;
+        for (int i = 0; i < kNumBins; ++i) {
+            const int bin = std::min<int>(kNumBins - 1, (i + 0.5f) * old_width / new_width);
+            hist[bin] += hist_[i];
+        }
+        hist_.swap(hist);
+    }
+    abs_max_ = abs_max;
+}
+
+float TensorStatistics::GetThreshold(CalibrationMethod method, float percentile) const {
+    switch (method) {
+        case CalibrationMethod::kMinMax:
+            return abs_max_;
+        case CalibrationMethod::kPercentile:
+            return GetPercentileThreshold(percentile);
+        case CalibrationMethod::kEntropy:
+            return GetEntropyThreshold();
+    }
+    CHECK(false);
+}
+
+float TensorStatistics::GetPercentileThreshold(float percentile) const {
+    CHECK_LT(0, percentile);
+    CHECK_GE(100, percentile);
+    if (empty_) {
+        return 0;
+    }
+    double total = 0;
+    for (double c : hist_) total += c;
+    const double target = total * percentile / 100;
+    double sum = 0;
+    for (int i = 0; i < kNumBins; ++i) {
+        sum += hist_[i];
+        if (sum >= target) {
+            return abs_max_ * (i + 1) / kNumBins;
+        }
+    }
+    return abs_max_;
+}
+
+float TensorStatistics::GetEntropyThreshold() const {
+    if (abs_max_ == 0) {
+        return 0;
+    }
+    double best_kl = std::numeric_limits<double>::max();
+    int best_i = kNumBins;
+    for (int i = kNumQuantizedBins; i <= kNumBins; ++i) {
+        // The reference distribution with outliers clipped into the last bin.
+        std::vector<double> p(hist_.begin(), hist_.begin() + i);
+        for (int j = i; j < kNumBins; ++j) {
+            p[i - 1] += hist_[j];
+        }
+
+        // Quantize the first `i` bins into `kNumQuantizedBins` and
+        // expand them back, spreading counts over non-empty bins.
+        std::vector<double> q(i, 0);
+        for (int j = 0; j < kNumQuantizedBins; ++j) {
+            const int start = static_cast<int64_t>(j) * i / kNumQuantizedBins;
+            const int end = static_cast<int64_t>(j + 1) * i / kNumQuantizedBins;
+            double sum = 0;
+            int nonzeros = 0;
+            for (int k = start; k < end; ++k) {
+                sum += hist_[k];
+                nonzeros += hist_[k] != 0;
+            }
+            if (nonzeros == 0) continue;
+            for (int k = start; k < end; ++k) {
+                if (hist_[k] != 0) q[k] = sum / nonzeros;
+            }
+        }
+
+        const double kl = KLDivergence(p, q);
+        if (kl < best_kl) {
+            best_kl = kl;
+            best_i = i;
+        }
+    }
+    return abs_max_ * best_i / kNumBins;
+}
+
+QuantizationParams ComputeQuantizationParams(const TensorStatistics& stats, CalibrationMethod method, float percentile) {
+    const float threshold = stats.GetThreshold(method, percentile);
+    const float rmin = std::max(std::min(stats.min(), 0.f), -threshold);
+    const float rmax = std::min(std::max(stats.max(), 0.f), threshold);
+    const float scale = rmax > rmin ? (rmax - rmin) / 255 : 1.f;
+    const float zero_point = std::min(255.f, std::max(0.f, std::round(-rmin / scale)));
+    return {Dtype::kUInt8, zero_point, scale};
+}
+
+bool CalibrationCollector::Add(const std::string& name, const chainerx::Array& a) {
+    if (!HasPrefix(name, kCalibrationOutputPrefix)) {
+        return false;
+    }
+    stats_[name.substr(std::strlen(kCalibrationOutputPrefix))].Add(a);
+    return true;
+}
+
+std::map<std::string, QuantizationParams> CalibrationCollector::ComputeQuantizationParams(
+        CalibrationMethod method, float percentile) const {
+    std::map<std::string, QuantizationParams> params;
+    for (const auto& p : stats_) {
+        params.emplace(p.first, chainer_compiler::ComputeQuantizationParams(p.second, method, percentile));
+    }
+    return params;
+}
+
+void AddCalibrationOutputs(Graph* graph) {
+    for (Value* value : GetValuesToCalibrate(*graph)) {
+        Value* output = graph->AddOutputValue(StrCat(kCalibrationOutputPrefix, value->name()), value->type());
+        GraphBuilder gb(graph, "Calibration", value);
+        gb.Op(Node::kIdentity, {value}, output);
+    }
+}
+
+void WriteCalibrationTable(const std::string& filename, const std::map<std::string, QuantizationParams>& params) {
+    std::ofstream ofs(filename);
+    CHECK(ofs) << "Failed to open calibration table: " << filename;
+    ofs << std::setprecision(std::numeric_limits<float>::max_digits10);
+    for (const auto& p : params) {
+        CHECK_EQ(Dtype::kUInt8, p.second.zero_point_dtype);
+        ofs << p.first << '\t' << p.second.scale << '\t' << p.second.zero_point << '\n';
+    }
+}
+
+void ReadCalibrationTable(const std::string& filename, QuantizationOptions* opts) {
+    std::ifstream ifs(filename);
+    CHECK(ifs) << "Failed to open calibration table: " << filename;
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (line.empty()) continue;
+        std::vector<std::string> toks = SplitString(line, "\t");
+        CHECK_EQ(3, toks.size()) << "Broken calibration table: " << line;
+        QuantizationParams params{Dtype::kUInt8, std::stof(toks[2]), std::stof(toks[1])};
+        opts->input_quantization_params[toks[0]] = params;
+        opts->output_quantization_params[toks[0]] = params;
+    }
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <chainerx/array.h>
+
+#include <compiler/quantize.h>
+
+namespace chainer_compiler {
+
+class Graph;
+
+// Outputs added by `AddCalibrationOutputs` are named by this prefix
+// followed by the name of the original value.
+constexpr char kCalibrationOutputPrefix[] = "calibration@";
+
+enum class CalibrationMethod {
+    // The observed minimum and maximum.
+    kMinMax,
+    // Clips outliers beyond a percentile of absolute values.
+    kPercentile,
+    // Chooses the clipping threshold which minimizes the KL divergence
+    // between the original and quantized distributions (TensorRT's
+    // entropy calibration).
+    kEntropy,
+};
+
+bool ParseCalibrationMethod(const std::string& name, CalibrationMethod* method);
+
+// Statistics of a tensor accumulated over a calibration dataset. In
+// addition to the range, a histogram of absolute values is kept. The
+// histogram is re-binned when a later batch has a wider range.
+class TensorStatistics {
+public:
+    static constexpr int kNumBins = 2048;
+
+    void Add(const chainerx::Array& a);
+
+    float min() const {
+        return min_;
+    }
+    float max() const {
+        return max_;
+    }
+
+    // Returns the threshold T to clip values into [-T, T].
+    float GetThreshold(CalibrationMethod method, float percentile) const;
+
+private:
+    float GetPercentileThreshold(float percentile) const;
+    float GetEntropyThreshold() const;
+    void Widen(float abs_max);
+
+    bool empty_{true};
+    float min_{0};
+    float max_{0};
+    float abs_max_{0};
+    std::vector<double> hist_;
+};
+
+// Computes uint8 quantization parameters from `stats`.
+QuantizationParams ComputeQuantizationParams(const TensorStatistics& stats, CalibrationMethod method, float percentile);
+
+// Collects statistics of outputs added by `AddCalibrationOutputs`.
+class CalibrationCollector {
+public:
+    // Ignores values without `kCalibrationOutputPrefix`. Returns true if
+    // `name` was a calibration output.
+    bool Add(const std::string& name, const chainerx::Array& a);
+
+    std::map<std::string, QuantizationParams> ComputeQuantizationParams(CalibrationMethod method, float percentile) const;
+
+private:
+    std::map<std::string, TensorStatistics> stats_;
+};
+
+// Adds graph outputs for the values returned by `GetValuesToCalibrate`.
+void AddCalibrationOutputs(Graph* graph);
+
+// A calibration table is a text file with a line of a value name,
+// its scale, and its zero point for each activation.
+void WriteCalibrationTable(const std::string& filename, const std::map<std::string, QuantizationParams>& params);
+
+// Fills `input_quantization_params` and `output_quantization_params`.
+void ReadCalibrationTable(const std::string& filename, QuantizationOptions* opts);
+
+}  // namespace chainer_compiler
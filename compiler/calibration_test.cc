@@ -0,0 +1,109 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <chainerx/testing/context_session.h>
+
+#include <compiler/calibration.h>
+#include <runtime/chainerx_util.h>
+
+namespace chainer_compiler {
+namespace {
+
+chainerx::Array MakeFloatArray(const std::vector<float>& data) {
+    return runtime::MakeArray(chainerx::Dtype::kFloat32, {static_cast<int64_t>(data.size())}, data.data());
+}
+
+// Exponentially distributed values with a single outlier.
+std::vector<float> MakeLongTailData() {
+    const int n = 10000;
+    std::vector<float> data;
+    for (int i = 0; i < n; ++i) {
+        data.push_back(-std::log(1 - (i + 0.5) / n));
+    }
+    data.push_back(100);
+    return data;
+}
+
+TEST(CalibrationTest, MinMax) {
+    chainerx::testing::ContextSession sess;
+
+    TensorStatistics stats;
+    stats.Add(MakeFloatArray({-1, 0, 1}));
+    stats.Add(MakeFloatArray({2, 3}));
+    EXPECT_EQ(-1, stats.min());
+    EXPECT_EQ(3, stats.max());
+
+    QuantizationParams params = ComputeQuantizationParams(stats, CalibrationMethod::kMinMax, 100);
+    EXPECT_EQ(Dtype::kUInt8, params.zero_point_dtype);
+    EXPECT_FLOAT_EQ(4.0 / 255, params.scale);
+    EXPECT_EQ(64, params.zero_point);
+}
+
+TEST(CalibrationTest, Constant) {
+    chainerx::testing::ContextSession sess;
+
+    TensorStatistics stats;
+    stats.Add(MakeFloatArray({0, 0, 0}));
+    QuantizationParams params = ComputeQuantizationParams(stats, CalibrationMethod::kEntropy, 100);
+    EXPECT_EQ(1, params.scale);
+    EXPECT_EQ(0, params.zero_point);
+}
+
+TEST(CalibrationTest, Percentile) {
+    chainerx::testing::ContextSession sess;
+
+    TensorStatistics stats;
+    stats.Add(MakeFloatArray(MakeLongTailData()));
+    QuantizationParams params = ComputeQuantizationParams(stats, CalibrationMethod::kPercentile, 99.9);
+    EXPECT_EQ(0, params.zero_point);
+    EXPECT_LT(6.0 / 255, params.scale);
+    EXPECT_GT(8.0 / 255, params.scale);
+}
+
+TEST(CalibrationTest, Entropy) {
+    chainerx::testing::ContextSession sess;
+
+    TensorStatistics stats;
+    stats.Add(MakeFloatArray(MakeLongTailData()));
+    QuantizationParams params = ComputeQuantizationParams(stats, CalibrationMethod::kEntropy, 100);
+    EXPECT_EQ(0, params.zero_point);
+    EXPECT_LT(5.0 / 255, params.scale);
+    EXPECT_GT(20.0 / 255, params.scale);
+}
+
+TEST(CalibrationTest, Collector) {
+    chainerx::testing::ContextSession sess;
+
+    CalibrationCollector collector;
+    EXPECT_FALSE(collector.Add("x", MakeFloatArray({1})));
+    EXPECT_TRUE(collector.Add(std::string(kCalibrationOutputPrefix) + "y", MakeFloatArray({0, 255})));
+    std::map<std::string, QuantizationParams> params = collector.ComputeQuantizationParams(CalibrationMethod::kMinMax, 100);
+    ASSERT_EQ(1, params.size());
+    EXPECT_FLOAT_EQ(1, params["y"].scale);
+}
+
+TEST(CalibrationTest, Table) {
+    const std::string filename = "/tmp/chainer_compiler_test_calibration_table.txt";
+    std::map<std::string, QuantizationParams> params;
+    params["x"] = {Dtype::kUInt8, 3, 0.1f};
+    params["y"] = {Dtype::kUInt8, 128, 1.0f / 3};
+    WriteCalibrationTable(filename, params);
+
+    QuantizationOptions opts;
+    ReadCalibrationTable(filename, &opts);
+    std::remove(filename.c_str());
+    ASSERT_EQ(2, opts.input_quantization_params.size());
+    ASSERT_EQ(2, opts.output_quantization_params.size());
+    for (const auto& p : params) {
+        const QuantizationParams& actual = opts.input_quantization_params[p.first];
+        EXPECT_EQ(p.second.zero_point_dtype, actual.zero_point_dtype);
+        EXPECT_EQ(p.second.zero_point, actual.zero_point);
+        EXPECT_EQ(p.second.scale, actual.scale);
+    }
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -20,6 +20,7 @@
 #include <compiler/nvrtc_builder.h>
 #include <compiler/onnx.h>
 #include <compiler/passes.h>
+#include <compiler/thread_pool.h>
 #include <compiler/tvm/compiler.h>
 #include <compiler/value.h>
 #include <runtime/chxvm.pb.h>
@@ -49,13 +50,69 @@ void FillOpInfo(const Node& node, const std::string& debug_info, ChxVMProgramPro
     inst->set_flops(CalculateFlops(node));
 }
 
+std::string SerializeFusionGroupBody(const Graph& body) {
+    std::string serialized;
+    onnx::ModelProto xmodel;
+    body.ToONNX(xmodel.mutable_graph());
+    xmodel.SerializeToString(&serialized);
+    return serialized;
+}
+
+// Returns true if the loop state is passed to the next iteration as is.
+bool IsForwardedLoopState(const Value* body_in, const Value* body_out) {
+    const Node* node = body_out->producer();
+    return node && node->op_type() == Node::kIdentity && node->input(0) == body_in;
+}
+
+bool HasSideEffects(const Graph& graph) {
+    for (const Node* node : graph.nodes()) {
+        switch (node->op_type()) {
+            case Node::kChainerPrint:
+            case Node::kChainerDoSomething:
+            case Node::kChainerSGDUpdate:
+            case Node::kChainerAdamUpdate:
+                return true;
+            default:
+                break;
+        }
+        for (const Graph* subgraph : node->GetSubGraphs()) {
+            if (HasSideEffects(*subgraph)) return true;
+        }
+    }
+    return false;
+}
+
+// Returns true if iterations of `loop` are independent, i.e., its body
+// only computes scan outputs and forwards the condition and loop
+// states as they are.
+bool IsParallelizableLoop(const Node& loop) {
+    const Graph& body = *loop.body();
+    const int num_states = loop.inputs().size() - 2;
+    const int num_scans = body.output_values().size() - 1 - num_states;
+    if (loop.input(0)->IsNull() || num_scans == 0) return false;
+    if (!loop.input(1)->IsNull() && !IsForwardedLoopState(body.input_values()[1], body.output_values()[0])) return false;
+    for (int i = 0; i < num_states; ++i) {
+        // The separately compiled body expects all its inputs.
+        if (loop.input(i + 2)->IsNull()) return false;
+        if (!IsForwardedLoopState(body.input_values()[i + 2], body.output_values()[i + 1])) return false;
+    }
+    return !HasSideEffects(body);
+}
+
 class ChxVMEmitter {
 public:
     ChxVMEmitter() {
     }
 
+    // Loops in the body of a ParallelLoop are emitted as sequential
+    // loops, as each worker of the ParallelLoop would otherwise start
+    // its own threads.
+    explicit ChxVMEmitter(bool in_parallel_loop) : in_parallel_loop_(in_parallel_loop) {
+    }
+
     void EmitModel(const Graph& graph, ChxVMProgramProto* program, bool dump_value_names) {
         EmitInputTypes(graph, program);
+        BuildFusionGroups(graph);
         AssignValueIds(graph);
         EmitGraph(graph, program, false /* in_loop */, graph.output_values());
         EmitOutputs(graph.output_values(), program);
@@ -268,8 +325,18 @@ private:
             EmitNode(&graph, *node, prog);
 
             for (const Value* output : node->outputs()) {
-                // Do not free output values.
-                if (todo_outputs.erase(output)) continue;
+                if (todo_outputs.erase(output)) {
+                    // Outputs no node reads are output right away so
+                    // ChxVMOptions::output_callback sees them early.
+                    if (!in_loop && output->users().empty()) {
+                        AddOutOp(prog, output->name(), GetValueId(output));
+                        prog->mutable_instructions(prog->instructions_size() - 1)->set_debug_info(output->name());
+                        FREE(GetValueId(output));
+                        early_outputs_.insert(output);
+                    }
+                    // Do not free output values.
+                    continue;
+                }
                 if (output->IsTemp() && !output->IsNull() && output->users().empty()) {
                     FREE(GetValueId(output));
                 }
@@ -317,14 +384,14 @@ private:
             outputs.emplace_back(GetValueId(value), value);
         }
 
-        std::string ngraph_device = g_ngraph_device;
+        std::string ngraph_device = g_ngraph_device();
         if (ngraph_device.empty()) {
             ngraph_device = "CPU";
         }
         EMIT(NGraph, outputs, inputs, serialized_onnx, ngraph_device);
     }
 
-    std::string DumpONNXToTmpFile(const Node& node, const std::string& serialized) {
+    std::string DumpONNXToTmpFile(const Node& node, const std::string& serialized) const {
         const std::string& onnx_path = StrCat("/tmp/chainer_compiler_", node.fusion_type(), "_tmp_", node.chainer_fusion_group(), ".onnx");
 
         std::ofstream ofs(onnx_path);
@@ -334,25 +401,43 @@ private:
         return onnx_path;
     }
 
-    std::string CacheBasePath(const Node& node) {
+    std::string CacheBasePath(const Node& node) const {
         return StrCat("/tmp/chainer_compiler_", node.fusion_type(), "_tmp_", node.chainer_fusion_group());
     }
 
-    void EmitFusionGroupDldt(const Node& node, const std::string& serialized_onnx, ChxVMProgramProto* prog) {
-        const Graph& body = *node.subgraph();
+    // Runs external converters of fusion groups in `graph` in parallel
+    // before they are emitted one by one.
+    void BuildFusionGroups(const Graph& graph) {
+        std::vector<const Node*> nodes;
+        for (const Node* node : graph.nodes()) {
+            if (node->op_type() != Node::kChainerFusionGroup) continue;
+            if ((g_use_dldt() && node->fusion_type() == "dldt") || (g_use_snpe() && node->fusion_type() == "snpe")) {
+                nodes.push_back(node);
+            }
+        }
 
-#if 0
-        for (Node* node : body.nodes()) {
-            node->set_chainer_order(-1);
-            node->set_chainer_fusion_group(0);
+        std::vector<std::string> filenames(nodes.size());
+        ParallelFor(nodes.size(), [this, &nodes, &filenames](int64_t i) {
+            const Node& node = *nodes[i];
+            const std::string& serialized_onnx = SerializeFusionGroupBody(*node.subgraph());
+            if (node.fusion_type() == "dldt") {
+                filenames[i] = BuildDldtModel(node, serialized_onnx);
+            } else {
+                filenames[i] = BuildSNPEModel(node, serialized_onnx);
+            }
+        });
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            built_models_.emplace(nodes[i], filenames[i]);
         }
-#endif
+    }
 
-        const std::string& extra_args = g_use_dldt_fp16 ? " --data_type=FP16" : "";
+    // Returns the filename of the model converted by the model optimizer.
+    std::string BuildDldtModel(const Node& node, const std::string& serialized_onnx) const {
+        const std::string& extra_args = g_use_dldt_fp16() ? " --data_type=FP16" : "";
 
         FileCache cache(CacheBasePath(node), ".xml", {serialized_onnx, extra_args});
 
-        if (!cache.IsReady() || !g_use_cached_model) {
+        if (!cache.IsReady() || !g_use_cached_model()) {
             const std::string onnx_path = DumpONNXToTmpFile(node, serialized_onnx);
 
             const char* dldt_dir_env = getenv("CHAINER_COMPILER_DLDT_DIR");
@@ -367,7 +452,7 @@ private:
                            " --model_name ",
                            cache.GetTmpFilename(),
                            extra_args);
-            if (g_compiler_log) {
+            if (g_compiler_log()) {
                 CLOG() << "Run command: " << cmdline << std::endl;
             }
             int ret = system(cmdline.c_str());
@@ -375,6 +460,21 @@ private:
 
             cache.Commit();
         }
+        return cache.GetFilename();
+    }
+
+    void EmitFusionGroupDldt(const Node& node, const std::string& serialized_onnx, ChxVMProgramProto* prog) {
+        const Graph& body = *node.subgraph();
+
+#if 0
+        for (Node* node : body.nodes()) {
+            node->set_chainer_order(-1);
+            node->set_chainer_fusion_group(0);
+        }
+#endif
+
+        auto found = built_models_.find(&node);
+        const std::string& model_path = found != built_models_.end() ? found->second : BuildDldtModel(node, serialized_onnx);
 
         std::vector<int> inputs;
         std::vector<ChxVMValue> outputs;
@@ -385,7 +485,7 @@ private:
             outputs.emplace_back(GetValueId(value), value);
         }
 
-        std::string dldt_device = g_dldt_device;
+        std::string dldt_device = g_dldt_device();
         if (dldt_device.empty()) {
             dldt_device = "CPU";
         }
@@ -397,15 +497,14 @@ private:
             output_names.push_back(output->producer()->name());
         }
 
-        EMIT(Dldt, outputs, inputs, cache.GetFilename(), dldt_device, output_names);
+        EMIT(Dldt, outputs, inputs, model_path, dldt_device, output_names);
     }
 
-    void EmitFusionGroupSNPE(const Node& node, const std::string& serialized_onnx, ChxVMProgramProto* prog) {
-        const Graph& body = *node.subgraph();
-
+    // Returns the filename of the DLC converted from the fusion group.
+    std::string BuildSNPEModel(const Node& node, const std::string& serialized_onnx) const {
         FileCache cache(CacheBasePath(node), ".dlc", {serialized_onnx});
 
-        if (!cache.IsReady() || !g_use_cached_model) {
+        if (!cache.IsReady() || !g_use_cached_model()) {
             const std::string onnx_path = DumpONNXToTmpFile(node, serialized_onnx);
 
             // TODO(take-cheeze): Embed SNPE_ROOT
@@ -424,7 +523,7 @@ private:
                            onnx_path,
                            " --output_path ",
                            cache.GetTmpFilename());
-            if (g_compiler_log) {
+            if (g_compiler_log()) {
                 CLOG() << "Run command: " << cmdline << std::endl;
             }
             int ret = system(cmdline.c_str());
@@ -432,7 +531,7 @@ private:
 
             cache.Commit();
 
-            if (g_dump_snpe_dlc_info) {
+            if (g_dump_snpe_dlc_info()) {
                 std::string cmdline =
                         StrCat("PYTHONPATH=",
                                snpe_dir,
@@ -442,16 +541,23 @@ private:
                                "/bin/x86_64-linux-clang/snpe-dlc-info"
                                " --input_dlc ",
                                cache.GetFilename());
-                if (!g_snpe_dlc_info_out_prefix.empty()) {
-                    cmdline += StrCat(" -s ", g_snpe_dlc_info_out_prefix, node.chainer_fusion_group(), ".txt");
+                if (!g_snpe_dlc_info_out_prefix().empty()) {
+                    cmdline += StrCat(" -s ", g_snpe_dlc_info_out_prefix(), node.chainer_fusion_group(), ".txt");
                 }
-                if (g_compiler_log) {
+                if (g_compiler_log()) {
                     CLOG() << "Dumping snpe-dlc-info of: " << cache.GetFilename() << " with: " << cmdline << std::endl;
                 }
                 int ret = system(cmdline.c_str());
                 CHECK_EQ(0, ret) << "Command failed: " << cmdline;
             }
         }
+        return cache.GetFilename();
+    }
+
+    void EmitFusionGroupSNPE(const Node& node, const std::string& serialized_onnx, ChxVMProgramProto* prog) {
+        const Graph& body = *node.subgraph();
+        auto found = built_models_.find(&node);
+        const std::string& dlc_path = found != built_models_.end() ? found->second : BuildSNPEModel(node, serialized_onnx);
 
         std::vector<int> inputs;
         std::vector<ChxVMValue> outputs;
@@ -475,7 +581,7 @@ private:
             output_names.push_back(output->producer()->name());
         }
 
-        std::ifstream ifs(cache.GetFilename());
+        std::ifstream ifs(dlc_path);
         std::stringstream ss;
         ss << ifs.rdbuf();
 
@@ -488,10 +594,10 @@ private:
         FileCache cache(CacheBasePath(node), ".dso", {serialized_onnx, std::to_string(node.chainer_fusion_group())});
 
         const std::string func_name = StrCat("tvm_op_", node.chainer_fusion_group());
-        if (!cache.IsReady() || !g_use_cached_model) {
+        if (!cache.IsReady() || !g_use_cached_model()) {
             BuildTVMProgram(body.nodes(), body.input_values(), body.output_values(), cache.GetTmpFilename(), func_name);
             cache.Commit();
-            if (g_compiler_log) {
+            if (g_compiler_log()) {
                 CLOG() << "TVM output: " << cache.GetFilename() << std::endl;
             }
         }
@@ -563,14 +669,14 @@ private:
             encode_shape(ct->output(0)->type().dims(), 2);
         }
 
-        EMIT(TensorRT, outputs, inputs, serialized_onnx, batch_size, g_use_tensorrt_fp16, deconv_output_shapes);
+        EMIT(TensorRT, outputs, inputs, serialized_onnx, batch_size, g_use_tensorrt_fp16(), deconv_output_shapes);
     }
 
     void EmitFusionGroupNVRTC(const Node& node, ChxVMProgramProto* prog) {
         const Graph& body = *node.subgraph();
         std::string nvrtc;
         BuildNvrtcProgram(body.nodes(), node.chainer_fusion_group(), body.input_values(), body.output_values(), &nvrtc);
-        if (g_compiler_log) {
+        if (g_compiler_log()) {
             CLOG() << "NVRTC program: " << nvrtc;
         }
 
@@ -594,46 +700,36 @@ private:
         CHECK_EQ(node.inputs().size(), num_input_values);
         CHECK_EQ(node.outputs().size(), body.output_values().size());
 
-        if (g_compiler_log) {
+        if (g_compiler_log()) {
             CLOG() << "Fusion group (" << node.fusion_type() << ") " << GetFusionGroupSummary(node) << std::endl;
         }
 
-        auto run_onnx_serialize = [](const Graph& body) {
-            std::string serialized;
-            {
-                onnx::ModelProto xmodel;
-                body.ToONNX(xmodel.mutable_graph());
-                xmodel.SerializeToString(&serialized);
-            }
-            return serialized;
-        };
-
-        if (g_use_ngraph && node.fusion_type() == "ngraph") {
-            EmitFusionGroupNGraph(node, run_onnx_serialize(body), prog);
+        if (g_use_ngraph() && node.fusion_type() == "ngraph") {
+            EmitFusionGroupNGraph(node, SerializeFusionGroupBody(body), prog);
             return;
         }
 
-        if (g_use_dldt && node.fusion_type() == "dldt") {
-            EmitFusionGroupDldt(node, run_onnx_serialize(body), prog);
+        if (g_use_dldt() && node.fusion_type() == "dldt") {
+            EmitFusionGroupDldt(node, SerializeFusionGroupBody(body), prog);
             return;
         }
 
-        if (g_use_snpe && node.fusion_type() == "snpe") {
-            EmitFusionGroupSNPE(node, run_onnx_serialize(body), prog);
+        if (g_use_snpe() && node.fusion_type() == "snpe") {
+            EmitFusionGroupSNPE(node, SerializeFusionGroupBody(body), prog);
             return;
         }
 
-        if (g_use_tvm && node.fusion_type() == "tvm") {
-            EmitFusionGroupTVM(node, run_onnx_serialize(body), prog);
+        if (g_use_tvm() && node.fusion_type() == "tvm") {
+            EmitFusionGroupTVM(node, SerializeFusionGroupBody(body), prog);
             return;
         }
 
-        if (g_use_tensorrt && node.fusion_type() == "tensorrt") {
-            EmitFusionGroupTensorRT(node, run_onnx_serialize(body), prog);
+        if (g_use_tensorrt() && node.fusion_type() == "tensorrt") {
+            EmitFusionGroupTensorRT(node, SerializeFusionGroupBody(body), prog);
             return;
         }
 
-        if (g_use_nvrtc && node.fusion_type() == "nvrtc") {
+        if (g_use_nvrtc() && node.fusion_type() == "nvrtc") {
             EmitFusionGroupNVRTC(node, prog);
             return;
         }
@@ -820,53 +916,35 @@ private:
         int loop_begin = prog->instructions_size();
 
         EmitGraph(*body, prog, true /* in_loop */, body_output_values);
-        int one_id = value_ids_.AssignNextId();
-        EMIT(IntScalarConstant, ChxVMValue(one_id), 1, Dtype::kInt64, true);
-        int tmp_id = value_ids_.AssignNextId();
-        EMIT(Add, ChxVMValue(tmp_id), iter_id, one_id);
-        FREE(one_id);
-        for (const Value* value : body_input_values) {
-            FREE(GetValueId(value));
-        }
-        MOVE(ChxVMValue(iter_id), tmp_id);
-        MOVE(ChxVMValue(cond_id), GetValueId(body_output_values[0]));
 
-        // Propagate the loop state.
+        // Advance the loop by a single instruction, which renames loop
+        // states instead of copying them.
+        std::vector<int> states_in;
+        std::vector<int> states_out;
         for (int i = 0; i < num_states; ++i) {
             CHECK_LT(i + 2, body_input_values.size());
             CHECK_LT(i + 1, body_output_values.size());
-            const Value* body_in = body_input_values[i + 2];
             const Value* body_out = body_output_values[i + 1];
-            if (body_out->IsNull()) {
-                // TODO(hamaji): Consider removing this value.
-                EMIT(NullConstant, ChxVMValue(GetValueId(body_in)));
-            } else {
-                MOVE(ChxVMValue(GetValueId(body_in)), GetValueId(body_out));
-            }
+            states_in.push_back(GetValueId(body_input_values[i + 2]));
+            // TODO(hamaji): Consider removing null states.
+            states_out.push_back(body_out->IsNull() ? -1 : GetValueId(body_out));
         }
-
-        // Push scan outputs.
+        std::vector<int> scan_values;
         for (int i = 0; i < num_scans; ++i) {
             CHECK_LT(i + num_states + 1, body_output_values.size());
-            const Value* body_out = body_output_values[i + num_states + 1];
-            EMIT(SequenceAppend, scan_out_ids[i], GetValueId(body_out));
-            FREE(GetValueId(body_out));
-        }
-
-        // Check if the loop finishes.
-        if (terminal_condition->IsNull()) {
-            CHECK(!max_trip_count->IsNull());
-            FREE(cond_id);
-            EMIT(Greater, ChxVMValue(cond_id), GetValueId(loop.input(0)), iter_id);
-        } else if (!max_trip_count->IsNull()) {
-            EMIT(Greater, ChxVMValue(tmp_id), GetValueId(loop.input(0)), iter_id);
-            int tmp2_id = value_ids_.AssignNextId();
-            EMIT(Mul, ChxVMValue(tmp2_id), cond_id, tmp_id);
-            FREE(cond_id);
-            MOVE(ChxVMValue(cond_id), tmp2_id);
-            FREE(tmp_id);
-        }
-        EMIT(JmpTrue, cond_id, loop_begin);
+            scan_values.push_back(GetValueId(body_output_values[i + num_states + 1]));
+        }
+        EMIT(LoopControl,
+             iter_id,
+             cond_id,
+             GetValueId(body_output_values[0]),
+             !terminal_condition->IsNull(),
+             max_trip_count->IsNull() ? -1 : GetValueId(max_trip_count),
+             states_in,
+             states_out,
+             scan_out_ids,
+             scan_values,
+             loop_begin);
 
         if (skip_loop_jmp >= 0) {
             runtime::ChxVMInstructionProto* jmp = prog->mutable_instructions(skip_loop_jmp);
@@ -898,16 +976,82 @@ private:
         FREE(iter_id);
         FREE(cond_id);
 
+#undef EMIT
+    }
+
+    // Emits `loop` as a ParallelLoop instruction, which runs the body
+    // compiled as a separate program on multiple threads.
+    void EmitParallelLoop(const Node& loop, ChxVMProgramProto* prog) {
+        const Graph& body = *loop.body();
+        const int num_states = loop.inputs().size() - 2;
+        const int num_scans = body.output_values().size() - 1 - num_states;
+        const std::string& debug_info = loop.ToString();
+
+#define EMIT(op, ...)                                                                                                  \
+    do {                                                                                                               \
+        Add##op##Op(prog, __VA_ARGS__);                                                                                \
+        prog->mutable_instructions(prog->instructions_size() - 1)->set_debug_info(StrCat(debug_info, " @", __LINE__)); \
+    } while (0)
+
+        ChxVMProgramProto body_prog;
+        ChxVMEmitter(true /* in_parallel_loop */).EmitModel(body, &body_prog, false /* dump_value_names */);
+        std::string serialized;
+        body_prog.SerializeToString(&serialized);
+
+        std::vector<int> inputs;
+        std::vector<std::string> input_names;
+        for (int i = 0; i < num_states; ++i) {
+            CHECK(!loop.input(i + 2)->IsNull()) << debug_info;
+            inputs.push_back(GetValueId(loop.input(i + 2)));
+            input_names.push_back(body.input_values()[i + 2]->name());
+        }
+        std::vector<ChxVMValue> scan_seqs;
+        std::vector<std::string> scan_names;
+        for (int i = 0; i < num_scans; ++i) {
+            scan_seqs.emplace_back(value_ids_.AssignNextId());
+            scan_names.push_back(body.output_values()[i + num_states + 1]->name());
+        }
+
+        EMIT(ParallelLoop,
+             scan_seqs,
+             GetValueId(loop.input(0)),
+             loop.input(1)->IsNull() ? -1 : GetValueId(loop.input(1)),
+             inputs,
+             input_names,
+             body.input_values()[0]->name(),
+             body.input_values()[1]->name(),
+             scan_names,
+             serialized,
+             g_parallel_loop_threads());
+
+        // Loop states are unchanged.
+        for (int i = 0; i < num_states; ++i) {
+            const Value* loop_out = loop.output(i);
+            if (loop_out->IsNull()) continue;
+            EMIT(Identity, ChxVMValue(GetValueId(loop_out)), GetValueId(loop.input(i + 2)));
+        }
+
+        for (int i = 0; i < num_scans; ++i) {
+            const Value* loop_out = loop.output(i + num_states);
+            EMIT(SequenceStack, ChxVMValue(GetValueId(loop_out)), scan_seqs[i].id(), loop.chainer_stack_axis());
+            FREE(scan_seqs[i].id());
+        }
+
 #undef EMIT
     }
 
     void EmitLoop(const Node& loop, ChxVMProgramProto* prog) {
+        if (!in_parallel_loop_ && g_parallel_loop_threads() > 1 && IsParallelizableLoop(loop)) {
+            EmitParallelLoop(loop, prog);
+            return;
+        }
         AssignValueIds(*loop.body());
         EmitLoopImpl(loop, loop.body().get(), loop.body()->input_values(), loop.body()->output_values(), prog);
     }
 
     void EmitOutputs(const std::vector<Value*>& output_values, ChxVMProgramProto* prog) {
         for (const Value* value : output_values) {
+            if (early_outputs_.count(value)) continue;
             AddOutOp(prog, value->name(), GetValueId(value));
             prog->mutable_instructions(prog->instructions_size() - 1)->set_debug_info(value->name());
             FREE(GetValueId(value));
@@ -915,7 +1059,7 @@ private:
     }
 
     void EmitInputTypes(const Graph& graph, ChxVMProgramProto* program) {
-        const std::set<Value*>& necessary_values = graph.GetNecessaryValues();
+        const IdSet<Value> necessary_values = graph.GetNecessaryValues();
         for (Value* value : graph.input_values()) {
             if (!necessary_values.count(value)) {
                 continue;
@@ -933,6 +1077,10 @@ private:
 
     ValueIdManager value_ids_;
     std::set<const Node*> emitted_;
+    std::set<const Value*> early_outputs_;
+    // Models of fusion groups built by `BuildFusionGroups`.
+    std::map<const Node*, std::string> built_models_;
+    bool in_parallel_loop_{false};
 };
 
 }  // namespace
@@ -8,8 +8,13 @@
 #include <common/log.h>
 #include <common/protoutil.h>
 #include <compiler/chxvm/emitter.h>
+#include <compiler/flags.h>
+#include <compiler/graph.h>
 #include <compiler/model.h>
+#include <compiler/node.h>
 #include <compiler/passes.h>
+#include <compiler/scheduler.h>
+#include <compiler/tensor.h>
 #include <runtime/chxvm.pb.h>
 
 namespace chainer_compiler {
@@ -35,11 +40,173 @@ TEST(ChxVMTest, Compile) {
     ASSERT_EQ(runtime::ChxVMInstructionProto::In, program.instructions(0).op());
     ASSERT_EQ(runtime::ChxVMInstructionProto::In, program.instructions(1).op());
     ASSERT_EQ(runtime::ChxVMInstructionProto::Add, program.instructions(2).op());
-    ASSERT_EQ(runtime::ChxVMInstructionProto::Free, program.instructions(3).op());
+    // The output is output right after it is computed.
+    ASSERT_EQ(runtime::ChxVMInstructionProto::Out, program.instructions(3).op());
     ASSERT_EQ(runtime::ChxVMInstructionProto::Free, program.instructions(4).op());
-    ASSERT_EQ(runtime::ChxVMInstructionProto::Out, program.instructions(5).op());
+    ASSERT_EQ(runtime::ChxVMInstructionProto::Free, program.instructions(5).op());
     ASSERT_EQ(runtime::ChxVMInstructionProto::Free, program.instructions(6).op());
 }
 
+// Adds a loop which applies Relu to each row of `xs` to `graph`. `ys`
+// is the stacked result.
+Node* AddMapLoop(Graph* graph, Value* max_trip_count, Value* xs, Value* ys) {
+    const Type& type = xs->type();
+    Type row_type(type.dtype(), std::vector<int64_t>(type.dims().begin() + 1, type.dims().end()));
+
+    Graph* body = new Graph("body");
+    Value* iter = body->AddInputValue("iter", Type(Dtype::kInt64, {}));
+    Value* cond = body->AddInputValue("cond", Type(Dtype::kBool, {}));
+    Value* xs_in = body->AddInputValue("xs_in", type);
+    Value* cond_out = body->AddOutputValue("cond_out", Type(Dtype::kBool, {}));
+    Value* xs_out = body->AddOutputValue("xs_out", type);
+    Value* y = body->AddOutputValue("y", row_type);
+    Value* x = body->AddValue("x", row_type);
+    body->AddNode(Node::kIdentity, {cond}, {cond_out});
+    body->AddNode(Node::kIdentity, {xs_in}, {xs_out});
+    body->AddNode(Node::kGather, {xs_in, iter}, {x});
+    body->AddNode(Node::kRelu, {x}, {y});
+
+    Node* loop = graph->AddNode(Node::kLoop, {max_trip_count, graph->AddNullValue(), xs}, {graph->AddValue("xs_final"), ys});
+    loop->set_body(body);
+    return loop;
+}
+
+// Builds a loop which applies Relu to each row of `xs`.
+void BuildMapLoop(Graph* graph) {
+    Value* max_trip_count = graph->AddInputValue("max_trip_count", Type(Dtype::kInt64, {}));
+    Value* xs = graph->AddInputValue("xs", Type(Dtype::kFloat32, {3, 2}));
+    Value* ys = graph->AddOutputValue("ys", Type(Dtype::kFloat32, {3, 2}));
+    Node* loop = AddMapLoop(graph, max_trip_count, xs, ys);
+    ScheduleComputation(*loop->body(), ScheduleComputation(*graph, 0));
+}
+
+// Builds a loop whose body runs the loop of `BuildMapLoop` for each
+// matrix in `xs`.
+void BuildNestedMapLoop(Graph* graph) {
+    Type type(Dtype::kFloat32, {4, 3, 2});
+    Type row_type(Dtype::kFloat32, {3, 2});
+    Value* max_trip_count = graph->AddInputValue("max_trip_count", Type(Dtype::kInt64, {}));
+    Value* xs = graph->AddInputValue("xs", type);
+    Value* ys = graph->AddOutputValue("ys", type);
+
+    Graph* body = new Graph("outer_body");
+    Value* iter = body->AddInputValue("iter", Type(Dtype::kInt64, {}));
+    Value* cond = body->AddInputValue("cond", Type(Dtype::kBool, {}));
+    Value* xs_in = body->AddInputValue("xs_in", type);
+    Value* cond_out = body->AddOutputValue("cond_out", Type(Dtype::kBool, {}));
+    Value* xs_out = body->AddOutputValue("xs_out", type);
+    Value* y = body->AddOutputValue("y", row_type);
+    Value* x = body->AddValue("x", row_type);
+    Value* shape = body->AddValue("shape", Type(Dtype::kInt64, {2}));
+    Value* zero = body->AddValue("zero", Type(Dtype::kInt64, {}));
+    Value* num_rows = body->AddValue("num_rows", Type(Dtype::kInt64, {}));
+    body->AddNode(Node::kIdentity, {cond}, {cond_out});
+    body->AddNode(Node::kIdentity, {xs_in}, {xs_out});
+    body->AddNode(Node::kGather, {xs_in, iter}, {x});
+    body->AddNode(Node::kShape, {x}, {shape});
+    body->AddNode(Node::kConstant, {}, {zero})->set_tensor_value(new Tensor("zero", Dtype::kInt64, {}, std::vector<int64_t>{0}));
+    body->AddNode(Node::kGather, {shape, zero}, {num_rows});
+    Node* inner = AddMapLoop(body, num_rows, x, y);
+
+    Node* loop = graph->AddNode(Node::kLoop, {max_trip_count, graph->AddNullValue(), xs}, {graph->AddValue("xs_final"), ys});
+    loop->set_body(body);
+    ScheduleComputation(*inner->body(), ScheduleComputation(*body, ScheduleComputation(*graph, 0)));
+}
+
+bool HasInstruction(const runtime::ChxVMProgramProto& program, runtime::ChxVMInstructionProto::Op op) {
+    for (const runtime::ChxVMInstructionProto& inst : program.instructions()) {
+        if (inst.op() == op) return true;
+    }
+    return false;
+}
+
+TEST(ChxVMTest, ParallelLoop) {
+    {
+        Graph graph("test");
+        BuildMapLoop(&graph);
+        runtime::ChxVMProgramProto program;
+        chxvm::Emit(graph, &program);
+        EXPECT_TRUE(HasInstruction(program, runtime::ChxVMInstructionProto::LoopControl));
+        EXPECT_FALSE(HasInstruction(program, runtime::ChxVMInstructionProto::ParallelLoop));
+    }
+
+    {
+        CompilerContext context;
+        context.parallel_loop_threads = 4;
+        CompilerContextScope scope(&context);
+        Graph graph("test");
+        BuildMapLoop(&graph);
+        runtime::ChxVMProgramProto program;
+        chxvm::Emit(graph, &program);
+        EXPECT_FALSE(HasInstruction(program, runtime::ChxVMInstructionProto::LoopControl));
+        EXPECT_TRUE(HasInstruction(program, runtime::ChxVMInstructionProto::ParallelLoop));
+    }
+
+    {
+        CompilerContext context;
+        context.parallel_loop_threads = 4;
+        CompilerContextScope scope(&context);
+        Graph graph("test");
+        BuildMapLoop(&graph);
+        // The body of ParallelLoop cannot take a null state.
+        Node* loop = graph.output_values()[0]->producer();
+        loop->ReplaceInput(loop->input(2), graph.AddNullValue());
+        runtime::ChxVMProgramProto program;
+        chxvm::Emit(graph, &program);
+        EXPECT_TRUE(HasInstruction(program, runtime::ChxVMInstructionProto::LoopControl));
+        EXPECT_FALSE(HasInstruction(program, runtime::ChxVMInstructionProto::ParallelLoop));
+    }
+}
+
+TEST(ChxVMTest, NoParallelLoopInParallelLoop) {
+    CompilerContext context;
+    context.parallel_loop_threads = 4;
+    CompilerContextScope scope(&context);
+    Graph graph("test");
+    BuildNestedMapLoop(&graph);
+    runtime::ChxVMProgramProto program;
+    chxvm::Emit(graph, &program);
+
+    const runtime::ChxVMInstructionProto* outer = nullptr;
+    for (const runtime::ChxVMInstructionProto& inst : program.instructions()) {
+        if (inst.op() == runtime::ChxVMInstructionProto::ParallelLoop) outer = &inst;
+    }
+    ASSERT_TRUE(outer);
+    // The inner loop runs sequentially in each worker of the outer one.
+    runtime::ChxVMProgramProto body_program;
+    ASSERT_TRUE(body_program.ParseFromString(outer->inputs(7).s()));
+    EXPECT_TRUE(HasInstruction(body_program, runtime::ChxVMInstructionProto::LoopControl));
+    EXPECT_FALSE(HasInstruction(body_program, runtime::ChxVMInstructionProto::ParallelLoop));
+}
+
+// Emits `ys.append(x)` after or before `len(ys)`.
+runtime::ChxVMProgramProto EmitSizeAndAppend(bool size_first) {
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {2}));
+    Value* size = graph.AddOutputValue("size", Type(Dtype::kInt64, {}));
+    Value* ys_out = graph.AddOutputValue("ys_out", Type(Type::Kind::kSequence));
+    Value* ys = graph.AddValue("ys", Type(Type::Kind::kSequence));
+    Node* create = graph.AddNode(Node::kChainerSequenceCreate, {}, {ys});
+    Node* len = graph.AddNode(Node::kChainerSequenceSize, {ys}, {size});
+    Node* append = graph.AddNode(Node::kChainerSequenceAppend, {ys, x}, {ys_out});
+    create->set_chainer_order(1);
+    len->set_chainer_order(size_first ? 2 : 3);
+    append->set_chainer_order(size_first ? 3 : 2);
+    runtime::ChxVMProgramProto program;
+    chxvm::Emit(graph, &program);
+    return program;
+}
+
+TEST(ChxVMTest, SequenceUpdateAfterLastUse) {
+    // The sequence is updated in place as `len` is already computed.
+    runtime::ChxVMProgramProto program = EmitSizeAndAppend(true /* size_first */);
+    EXPECT_TRUE(HasInstruction(program, runtime::ChxVMInstructionProto::SequenceMove));
+    EXPECT_FALSE(HasInstruction(program, runtime::ChxVMInstructionProto::SequenceCopy));
+
+    program = EmitSizeAndAppend(false /* size_first */);
+    EXPECT_FALSE(HasInstruction(program, runtime::ChxVMInstructionProto::SequenceMove));
+    EXPECT_TRUE(HasInstruction(program, runtime::ChxVMInstructionProto::SequenceCopy));
+}
+
 }  // namespace
 }  // namespace chainer_compiler
@@ -98,6 +98,12 @@ void EmitSimpleNode(const Node& node, const ValueIdManager& id_manager, ChxVMPro
         return node.auto_pad();
     };
 
+    // Constant weights can be packed only once by the runtime.
+    auto prepack = [&node](int i) {
+        if (i >= static_cast<int>(node.inputs().size())) return 0;
+        return node.input(i)->GetConstTensor() ? 1 : 0;
+    };
+
     auto direction = [&node]() {
         const std::string& dir = node.direction();
         if (dir == "" || dir == "forward")
@@ -204,7 +210,7 @@ void EmitSimpleNode(const Node& node, const ValueIdManager& id_manager, ChxVMPro
         CHECK_LE(1UL, node.outputs().size());
         EMIT(Elu, out(0), in(0), node.alpha());
     } else if (node.op_type() == Node::kChainerLinear) {
-        EMIT(Linear, out(0), in(0), in(1), oin(2), node.n_batch_axes());
+        EMIT(Linear, out(0), in(0), in(1), oin(2), node.n_batch_axes(), prepack(1));
     } else if (node.op_type() == Node::kChainerLinearGradWeight) {
         EMIT(LinearGradWeight, out(0), in(0), in(1));
     } else if (node.op_type() == Node::kConv) {
@@ -213,7 +219,7 @@ void EmitSimpleNode(const Node& node, const ValueIdManager& id_manager, ChxVMPro
         CHECK_EQ(1UL, node.outputs().size());
         // TODO(ChainerX): Support dilation.
         for (int d : node.dilations()) CHECK_EQ(d, 1) << "Dilation is not supported yet";
-        EMIT(Conv, out(0), in(0), in(1), oin(2), strides(), pads(), node.group(), auto_pad());
+        EMIT(Conv, out(0), in(0), in(1), oin(2), strides(), pads(), node.group(), auto_pad(), prepack(1));
     } else if (node.op_type() == Node::kConvTranspose) {
         CHECK_LE(2UL, node.inputs().size());
         CHECK_GE(3UL, node.inputs().size());
@@ -302,11 +308,11 @@ void EmitSimpleNode(const Node& node, const ValueIdManager& id_manager, ChxVMPro
     } else if (node.op_type() == Node::kMatMul) {
         CHECK_EQ(2UL, node.inputs().size());
         CHECK_EQ(1UL, node.outputs().size());
-        EMIT(MatMul, out(0), in(0), in(1));
+        EMIT(MatMul, out(0), in(0), in(1), prepack(1));
     } else if (node.op_type() == Node::kGemm) {
         CHECK_EQ(3UL, node.inputs().size());
         CHECK_EQ(1UL, node.outputs().size());
-        EMIT(Gemm, out(0), in(0), in(1), in(2), node.alpha(), node.beta(), node.trans_a(), node.trans_b());
+        EMIT(Gemm, out(0), in(0), in(1), in(2), node.alpha(), node.beta(), node.trans_a(), node.trans_b(), prepack(1));
     } else if (node.op_type() == Node::kLRN) {
         EMIT(LRN, out(0), oout(1), in(0), node.alpha(), node.beta(), node.bias(), node.size());
     } else if (node.op_type() == Node::kChainerLRNGrad) {
@@ -335,7 +341,16 @@ void EmitSimpleNode(const Node& node, const ValueIdManager& id_manager, ChxVMPro
             CHECK_EQ(3UL, node.outputs().size());
             CHECK(node.output(1)->IsNull());
         }
-        EMIT(MaxPool, out(0), oout(2), in(0), node.kernel_shape(), strides(), pads(), node.ceil_mode(), auto_pad());
+        EMIT(MaxPool,
+             out(0),
+             oout(2),
+             in(0),
+             node.kernel_shape(),
+             strides(),
+             pads(),
+             node.ceil_mode(),
+             auto_pad(),
+             node.chainer_compress_indices());
     } else if (node.op_type() == Node::kChainerMaxPoolGrad) {
         CHECK_EQ("NOTSET", node.auto_pad()) << "auto_pad is not supported for MaxPool";
         EMIT(MaxPoolGrad, out(0), in(0), in(1), node.kernel_shape(), node.ceil_mode());
@@ -520,6 +535,49 @@ void EmitSimpleNode(const Node& node, const ValueIdManager& id_manager, ChxVMPro
         for (size_t i = 0; i < node.inputs().size(); ++i) ins.push_back(in(i));
         for (size_t i = 0; i < node.outputs().size(); ++i) outs.push_back(out(i));
         EMIT(DoSomething, outs, ins, node.function_name());
+    } else if (node.op_type() == Node::kChainerSGDUpdate || node.op_type() == Node::kChainerAdamUpdate) {
+        const bool is_adam = node.op_type() == Node::kChainerAdamUpdate;
+        const bool accumulates = node.num_micro_batches() > 1;
+        // `lr`, `step` for Adam, and `micro_batch`.
+        const size_t num_scalars = 1 + is_adam + accumulates;
+        // Parameters, gradients, optimizer states, and accumulators.
+        const size_t num_lists = 2 + (is_adam ? 2 : node.momentum() != 0) + accumulates;
+        CHECK_EQ(0UL, (node.inputs().size() - num_scalars) % num_lists) << node.DebugString();
+        const size_t num_params = (node.inputs().size() - num_scalars) / num_lists;
+        std::vector<int> lists[5], none;
+        for (size_t i = num_scalars; i < node.inputs().size(); ++i) lists[(i - num_scalars) / num_params].push_back(in(i));
+        const std::vector<int>& accs = accumulates ? lists[num_lists - 1] : none;
+        const int micro_batch = accumulates ? in(num_scalars - 1) : -1;
+        if (is_adam) {
+            EMIT(AdamUpdate,
+                 in(0),
+                 in(1),
+                 micro_batch,
+                 lists[0],
+                 lists[1],
+                 lists[2],
+                 lists[3],
+                 accs,
+                 node.beta1(),
+                 node.beta2(),
+                 node.epsilon(),
+                 node.weight_decay(),
+                 node.decoupled_weight_decay(),
+                 node.num_micro_batches());
+        } else {
+            const std::vector<int>& moms = node.momentum() != 0 ? lists[2] : none;
+            EMIT(SGDUpdate,
+                 in(0),
+                 micro_batch,
+                 lists[0],
+                 lists[1],
+                 moms,
+                 accs,
+                 node.momentum(),
+                 node.weight_decay(),
+                 node.nesterov(),
+                 node.num_micro_batches());
+        }
     } else if (node.op_type() == Node::kChainerPrint) {
         std::vector<int> ins;
         for (size_t i = 0; i < node.inputs().size(); ++i) ins.push_back(in(i));
@@ -534,36 +592,56 @@ void EmitSimpleNode(const Node& node, const ValueIdManager& id_manager, ChxVMPro
         EMIT(SequenceSize, out(0), in(0));
     } else if (node.op_type() == Node::kChainerSequenceLengths) {
         EMIT(SequenceLengths, out(0), in(0));
-    } else if (node.op_type() == Node::kChainerSequenceAppend || node.op_type() == Node::kSequenceInsert) {
+    } else if (
+            node.op_type() == Node::kChainerSequenceAppend || node.op_type() == Node::kSequenceInsert ||
+            node.op_type() == Node::kChainerSequenceExtend || node.op_type() == Node::kSequenceErase ||
+            node.op_type() == Node::kChainerSequenceUpdate || node.op_type() == Node::kChainerSequencePop) {
+        // Sequences are updated in place. The input sequence is taken
+        // when this is its last use, i.e., all other users are
+        // scheduled earlier, to avoid O(N^2) copies. Otherwise, it is
+        // copied on the update.
         ChxVMValue o(out(0));
-        if (node.inputs().size() == 3) {
-            EMIT(SequenceInsert, o, in(0), in(1), in(2));
-        } else if (node.input(0)->users().size() == 1) {
-            // Avoid O(N^2) copies for the simple case.
+        const Value* seq = node.input(0);
+        bool last_use = !seq->IsOutput();
+        for (size_t i = 1; i < node.inputs().size(); ++i) {
+            if (node.input(i) == seq) last_use = false;
+        }
+        for (const Node* user : seq->users()) {
+            if (user != &node && user->chainer_order() >= node.chainer_order()) last_use = false;
+        }
+        if (last_use) {
             EMIT(SequenceMove, o, in(0));
-            EMIT(SequenceAppend, o.id(), in(1));
         } else {
             EMIT(SequenceCopy, o, in(0));
-            EMIT(SequenceAppend, o.id(), in(1));
         }
-    } else if (node.op_type() == Node::kChainerSequenceExtend) {
-        EMIT(SequenceExtend, out(0), in(0), in(1));
-    } else if (node.op_type() == Node::kSequenceErase) {
-        EMIT(SequenceErase, out(0), in(0), in(1));
-    } else if (node.op_type() == Node::kChainerSequencePop) {
-        ChxVMValue o0(out(0));
-        if (node.input(0)->users().size() == 1) {
-            // Avoid O(N^2) copies for the simple case.
-            EMIT(SequenceMove, o0, in(0));
-            EMIT(SequencePop, out(1), o0.id());
-        } else {
-            EMIT(SequenceCopy, o0, in(0));
-            EMIT(SequencePop, out(1), o0.id());
+        switch (node.op_type()) {
+            case Node::kChainerSequenceAppend:
+                EMIT(SequenceAppend, o.id(), in(1));
+                break;
+            case Node::kSequenceInsert:
+                if (node.inputs().size() == 3) {
+                    EMIT(SequenceInsert, o.id(), in(1), in(2));
+                } else {
+                    EMIT(SequenceAppend, o.id(), in(1));
+                }
+                break;
+            case Node::kChainerSequenceExtend:
+                EMIT(SequenceExtend, o.id(), in(1));
+                break;
+            case Node::kSequenceErase:
+                EMIT(SequenceErase, o.id(), in(1));
+                break;
+            case Node::kChainerSequenceUpdate:
+                EMIT(SequenceUpdate, o.id(), in(1), in(2));
+                break;
+            case Node::kChainerSequencePop:
+                EMIT(SequencePop, out(1), o.id());
+                break;
+            default:
+                CHECK(false) << node.DebugString();
         }
     } else if (node.op_type() == Node::kChainerSequenceLookup || node.op_type() == Node::kSequenceAt) {
         EMIT(SequenceLookup, out(0), in(0), in(1));
-    } else if (node.op_type() == Node::kChainerSequenceUpdate) {
-        EMIT(SequenceUpdate, out(0), in(0), in(1), in(2));
     } else if (node.op_type() == Node::kChainerSequenceGetSlice) {
         EMIT(SequenceGetSlice, out(0), in(0), oin(1), oin(2), oin(3));
     } else if (node.op_type() == Node::kChainerSequenceLookupGrad) {
@@ -642,17 +720,30 @@ void EmitSimpleNode(const Node& node, const ValueIdManager& id_manager, ChxVMPro
              strides(),
              pads(),
              node.group(),
-             auto_pad());
+             auto_pad(),
+             prepack(3));
     } else if (node.op_type() == Node::kMatMulInteger) {
         CHECK_LE(2UL, node.inputs().size());
         CHECK_GE(4UL, node.inputs().size());
         CHECK_EQ(1UL, node.outputs().size());
-        EMIT(MatMulInteger, out(0), in(0), in(1), oin(2), oin(3));
+        EMIT(MatMulInteger, out(0), in(0), in(1), oin(2), oin(3), prepack(1));
     } else if (node.op_type() == Node::kConvInteger) {
         CHECK_LE(2UL, node.inputs().size());
         CHECK_GE(4UL, node.inputs().size());
         CHECK_EQ(1UL, node.outputs().size());
-        EMIT(ConvInteger, out(0), in(0), in(1), oin(2), oin(3), strides(), pads(), node.group(), auto_pad());
+        EMIT(ConvInteger, out(0), in(0), in(1), oin(2), oin(3), strides(), pads(), node.group(), auto_pad(), prepack(1));
+    } else if (node.op_type() == Node::kChainerWeightOnlyMatMul) {
+        EMIT(WeightOnlyMatMul, out(0), in(0), in(1), in(2), node.bits());
+    } else if (node.op_type() == Node::kChainerWeightOnlyGather) {
+        EMIT(WeightOnlyGather, out(0), in(0), in(1), in(2), node.bits());
+    } else if (node.op_type() == Node::kChainerPackBits) {
+        EMIT(PackBits, out(0), in(0));
+    } else if (node.op_type() == Node::kChainerMaskByBits) {
+        EMIT(MaskByBits, out(0), in(0), in(1));
+    } else if (node.op_type() == Node::kChainerFloatToBFloat16) {
+        EMIT(FloatToBFloat16, out(0), in(0));
+    } else if (node.op_type() == Node::kChainerBFloat16ToFloat) {
+        EMIT(BFloat16ToFloat, out(0), in(0));
     } else if (node.op_type() == Node::kBitShift) {
         CHECK_EQ(2UL, node.inputs().size());
         CHECK_EQ(1UL, node.outputs().size());
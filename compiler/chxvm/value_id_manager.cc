@@ -1,5 +1,7 @@
 #include "compiler/chxvm/value_id_manager.h"
 
+#include <map>
+
 #include <common/log.h>
 #include <compiler/graph.h>
 #include <compiler/value.h>
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <map>
+#include <unordered_map>
 #include <vector>
 
 namespace chainer_compiler {
@@ -20,7 +20,7 @@ public:
 
 private:
     int next_value_id_{1};
-    std::map<const Value*, int> value_ids_;
+    std::unordered_map<const Value*, int> value_ids_;
 };
 
 }  // namespace chxvm
@@ -0,0 +1,255 @@
+// A recomputation policy which minimizes the extra flops under an
+// explicit memory budget. The nodes are split into blocks at
+// articulation points and a DP over the blocks decides which runs of
+// blocks are forgotten after forward and recomputed in backward.
+//
+// For a run of recomputed blocks, only values used after the run are
+// kept after forward, and all values produced in the run are alive
+// again while it is recomputed. The estimated peak is the sum of
+// inputs, kept values, and the largest recomputed run. The DP is
+// solved for each candidate size of the largest run.
+#include "compiler/computation_order/policy_budget.h"
+
+#include "compiler/computation_order/policy_chen.h"
+#include "compiler/computation_order/simple_graph.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/log.h>
+#include <compiler/node.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+constexpr int64_t kInf = std::numeric_limits<int64_t>::max() / 4;
+// Limits the size of the DP, which takes O(blocks^2 * flops_units) for
+// each candidate of the transient size.
+constexpr size_t kMaxBlocks = 128;
+constexpr size_t kMaxTransientCandidates = 16;
+constexpr int64_t kFlopsUnitsPerBlock = 4;
+
+// Nodes in [begin, end) of the topologically sorted nodes.
+struct Segment {
+    size_t begin;
+    size_t end;
+    bool recompute;
+};
+
+struct Plan {
+    int64_t flops{kInf};
+    int64_t peak{kInf};
+    std::vector<Segment> segments;
+};
+
+}  // namespace
+
+std::vector<Order> BudgetPolicy(const Graph& graph, int64_t budget) {
+    const SimpleGraph sg = GetSimpleFormGraph(graph);
+    const std::vector<Node*> sorted = graph.GetTopologicallySortedNodes();
+    const size_t n = sorted.size();
+    std::map<Node*, size_t> node_pos;
+    for (size_t i = 0; i < n; ++i) {
+        node_pos.emplace(sorted[i], i);
+    }
+
+    // The last position where each value is used. Values which are
+    // never freed have `n`.
+    std::map<Value*, size_t> last_uses;
+    std::vector<int64_t> node_memories(n), node_flopses(n);
+    for (size_t id = 0; id < sg.n; ++id) {
+        Value* value = sg.value_list[id];
+        auto found = node_pos.find(value->producer());
+        if (found == node_pos.end()) continue;
+        const size_t pos = found->second;
+        size_t last_use = value->IsOutput() || value->users().empty() ? n : pos;
+        for (Node* user : value->users()) {
+            auto user_found = node_pos.find(user);
+            if (user_found != node_pos.end()) last_use = std::max(last_use, user_found->second);
+        }
+        last_uses.emplace(value, last_use);
+        node_memories[pos] += std::max<int64_t>(0, sg.memories[id]);
+        node_flopses[pos] = std::max<int64_t>(node_flopses[pos], sg.flopses[id]);
+    }
+
+    int64_t fixed_memory = 0;
+    for (Value* value : graph.input_values()) {
+        fixed_memory += std::max<int64_t>(0, value->GetNBytes());
+    }
+
+    // Split the nodes into blocks at articulation points.
+    const std::set<Node*> split_candidates = FindArticulationPoints(graph);
+    std::vector<size_t> ends;
+    for (size_t i = 0; i + 1 < n; ++i) {
+        if (split_candidates.count(sorted[i])) ends.push_back(i + 1);
+    }
+    ends.push_back(n);
+    if (ends.size() > kMaxBlocks) {
+        std::vector<size_t> thinned;
+        for (size_t k = 0; k < kMaxBlocks; ++k) {
+            thinned.push_back(ends[(k + 1) * ends.size() / kMaxBlocks - 1]);
+        }
+        ends.swap(thinned);
+    }
+    const size_t m = ends.size();
+    std::vector<size_t> begins(m);
+    std::vector<size_t> block_of(n);
+    for (size_t k = 0; k < m; ++k) {
+        begins[k] = k ? ends[k - 1] : 0;
+        for (size_t i = begins[k]; i < ends[k]; ++i) block_of[i] = k;
+    }
+
+    std::vector<int64_t> memory_prefix(m + 1), flops_prefix(m + 1);
+    for (size_t k = 0; k < m; ++k) {
+        int64_t memory = 0, flops = 0;
+        for (size_t i = begins[k]; i < ends[k]; ++i) {
+            memory += node_memories[i];
+            flops += node_flopses[i];
+        }
+        memory_prefix[k + 1] = memory_prefix[k] + memory;
+        flops_prefix[k + 1] = flops_prefix[k] + flops;
+    }
+    auto run_memory = [&memory_prefix](size_t a, size_t b) { return memory_prefix[b + 1] - memory_prefix[a]; };
+
+    // Discretize flops so the total is about `kFlopsUnitsPerBlock * m`.
+    const int64_t unit = std::max<int64_t>(1, (flops_prefix[m] + kFlopsUnitsPerBlock * m - 1) / (kFlopsUnitsPerBlock * m));
+    auto run_flops = [&flops_prefix, unit](size_t a, size_t b) { return (flops_prefix[b + 1] - flops_prefix[a] + unit - 1) / unit; };
+    const int64_t max_flops = run_flops(0, m - 1) + m;
+
+    // kept[a][b] := bytes of values produced in blocks [a, b] and used
+    // after the block b.
+    std::vector<std::vector<int64_t>> kept(m, std::vector<int64_t>(m));
+    for (size_t b = 0; b < m; ++b) {
+        std::vector<int64_t> by_block(b + 1);
+        for (const auto& p : last_uses) {
+            const size_t pos = node_pos[p.first->producer()];
+            if (pos < ends[b] && p.second >= ends[b]) {
+                by_block[block_of[pos]] += std::max<int64_t>(0, p.first->GetNBytes());
+            }
+        }
+        int64_t total = 0;
+        for (size_t a = b + 1; a-- > 0;) {
+            total += by_block[a];
+            kept[a][b] = total;
+        }
+    }
+
+    std::vector<int64_t> transients = {0};
+    for (size_t a = 0; a < m; ++a) {
+        for (size_t b = a; b < m; ++b) transients.push_back(run_memory(a, b));
+    }
+    std::sort(transients.begin(), transients.end());
+    transients.erase(std::unique(transients.begin(), transients.end()), transients.end());
+    if (transients.size() > kMaxTransientCandidates) {
+        std::vector<int64_t> thinned;
+        for (size_t k = 0; k < kMaxTransientCandidates; ++k) {
+            thinned.push_back(transients[k * (transients.size() - 1) / (kMaxTransientCandidates - 1)]);
+        }
+        transients.swap(thinned);
+    }
+
+    Plan best;
+    int64_t min_peak = kInf;
+    for (int64_t transient : transients) {
+        // dp[k][f] := the minimum bytes kept for blocks [0, k) with `f`
+        // units of extra flops.
+        std::vector<std::vector<int64_t>> dp(m + 1, std::vector<int64_t>(max_flops + 1, kInf));
+        // The first block of the last segment and whether it is recomputed.
+        std::vector<std::vector<std::pair<size_t, bool>>> prev(m + 1, std::vector<std::pair<size_t, bool>>(max_flops + 1));
+        auto relax = [&dp, &prev](size_t k, int64_t f, int64_t memory, size_t from, bool recompute) {
+            if (memory < dp[k][f]) {
+                dp[k][f] = memory;
+                prev[k][f] = {from, recompute};
+            }
+        };
+        dp[0][0] = 0;
+        for (size_t a = 0; a < m; ++a) {
+            for (int64_t f = 0; f <= max_flops; ++f) {
+                if (dp[a][f] == kInf) continue;
+                relax(a + 1, f, dp[a][f] + run_memory(a, a), a, false);
+                for (size_t b = a; b < m && run_memory(a, b) <= transient; ++b) {
+                    const int64_t f_next = f + run_flops(a, b);
+                    if (f_next > max_flops) break;
+                    relax(b + 1, f_next, dp[a][f] + kept[a][b], a, true);
+                }
+            }
+        }
+
+        for (int64_t f = 0; f <= max_flops; ++f) {
+            if (dp[m][f] == kInf) continue;
+            const int64_t peak = fixed_memory + dp[m][f] + transient;
+            min_peak = std::min(min_peak, peak);
+            if (peak > budget) continue;
+            if (f < best.flops || (f == best.flops && peak < best.peak)) {
+                best.flops = f;
+                best.peak = peak;
+                best.segments.clear();
+                int64_t g = f;
+                for (size_t k = m; k > 0;) {
+                    const std::pair<size_t, bool> p = prev[k][g];
+                    best.segments.push_back(Segment{begins[p.first], ends[k - 1], p.second});
+                    if (p.second) g -= run_flops(p.first, k - 1);
+                    k = p.first;
+                }
+                std::reverse(best.segments.begin(), best.segments.end());
+            }
+            // Larger `f` never reduces the flops.
+            break;
+        }
+    }
+    CHECK(!best.segments.empty()) << "No recomputation plan fits in the budget of " << budget << " bytes (" << min_peak
+                                  << " bytes at least)";
+
+    size_t num_recomputed = 0;
+    for (const Segment& segment : best.segments) {
+        if (segment.recompute) num_recomputed += segment.end - segment.begin;
+    }
+    CLOG() << "Budget policy: budget=" << budget << " estimated_peak=" << best.peak << " recomputed_nodes=" << num_recomputed << "/" << n
+           << " extra_flops=" << best.flops * unit << std::endl;
+
+    std::vector<Order> orders;
+    std::set<Value*> forgotten;
+    for (const Segment& segment : best.segments) {
+        for (size_t i = segment.begin; i < segment.end; ++i) {
+            orders.emplace_back(Order::kComputeForward, sorted[i], nullptr);
+        }
+        if (!segment.recompute) continue;
+        for (size_t i = segment.begin; i < segment.end; ++i) {
+            for (Value* value : sorted[i]->outputs()) {
+                auto found = last_uses.find(value);
+                if (found == last_uses.end() || found->second >= segment.end) continue;
+                orders.emplace_back(Order::kForgetForward, nullptr, value);
+                forgotten.insert(value);
+            }
+        }
+    }
+
+    for (auto it = best.segments.rbegin(); it != best.segments.rend(); ++it) {
+        const Segment& segment = *it;
+        for (size_t i = segment.begin; i < segment.end; ++i) {
+            const std::vector<Value*>& outputs = sorted[i]->outputs();
+            if (std::any_of(outputs.begin(), outputs.end(), [&forgotten](Value* value) { return forgotten.count(value); })) {
+                orders.emplace_back(Order::kComputeForward, sorted[i], nullptr);
+            }
+        }
+        for (size_t i = segment.end; i-- > segment.begin;) {
+            orders.emplace_back(Order::kComputeBackward, sorted[i], nullptr);
+        }
+    }
+
+    return orders;
+}
+
+std::vector<Order> BudgetPolicy(const Graph& graph) {
+    CHECK_LT(0, g_recompute_budget()) << "--recompute_budget must be specified for the budget policy";
+    return BudgetPolicy(graph, g_recompute_budget() * 1000000LL);
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "compiler/computation_order/core.h"
+
+#include <vector>
+
+namespace chainer_compiler {
+
+// Chooses segments between articulation points to be recomputed in
+// backward so the estimated peak memory fits in `budget` bytes with
+// the minimum extra flops. The budget includes inputs and parameters.
+std::vector<Order> BudgetPolicy(const Graph& graph, int64_t budget);
+
+std::vector<Order> BudgetPolicy(const Graph& graph);
+
+}  // namespace chainer_compiler
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include <compiler/computation_order/policy_budget.h>
+#include <compiler/computation_order/policy_chen.h>
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/type.h>
+
+namespace chainer_compiler {
+namespace {
+
+TEST(ComputationOrderTest, FindArticulationPoints) {
+    Graph graph("test");
+    Value* in = graph.AddValue("in", Value::Kind::kInput);
+    Value* a = graph.AddValue("a");
+    Value* b = graph.AddValue("b");
+    Value* c = graph.AddValue("c");
+    Value* d = graph.AddValue("d");
+    Value* out = graph.AddValue("out", Value::Kind::kOutput);
+    // A diamond followed by a node.
+    Node* na = graph.AddNode(Node::kIdentity, {in}, {a});
+    graph.AddNode(Node::kIdentity, {a}, {b});
+    graph.AddNode(Node::kIdentity, {a}, {c});
+    Node* nd = graph.AddNode(Node::kAdd, {b, c}, {d});
+    graph.AddNode(Node::kIdentity, {d}, {out});
+
+    std::set<Node*> articulation_points = FindArticulationPoints(graph);
+    EXPECT_EQ(1UL, articulation_points.size());
+    EXPECT_EQ(1UL, articulation_points.count(nd));
+    EXPECT_EQ(0UL, articulation_points.count(na));
+}
+
+// A chain of eight Relu, each of which outputs 4000 bytes.
+void BuildChain(Graph* graph) {
+    const Type type(Dtype::kFloat32, {1000});
+    Value* x = graph->AddInputValue("x", type);
+    for (int i = 0; i < 8; ++i) {
+        Value* y = i == 7 ? graph->AddOutputValue("y", type) : graph->AddValue("y" + std::to_string(i), type);
+        graph->AddNode(Node::kRelu, {x}, {y});
+        x = y;
+    }
+}
+
+size_t CountOrders(const std::vector<Order>& orders, Order::Kind kind) {
+    return std::count_if(orders.begin(), orders.end(), [kind](const Order& order) { return order.kind == kind; });
+}
+
+TEST(ComputationOrderTest, BudgetPolicyWithoutRecomputation) {
+    Graph graph("test");
+    BuildChain(&graph);
+
+    const std::vector<Order> orders = BudgetPolicy(graph, 1000 * 1000);
+    EXPECT_EQ(8UL, CountOrders(orders, Order::kComputeForward));
+    EXPECT_EQ(8UL, CountOrders(orders, Order::kComputeBackward));
+    EXPECT_EQ(0UL, CountOrders(orders, Order::kForgetForward));
+}
+
+TEST(ComputationOrderTest, BudgetPolicyWithRecomputation) {
+    Graph graph("test");
+    BuildChain(&graph);
+
+    // 36000 bytes are necessary without recomputation.
+    const std::vector<Order> orders = BudgetPolicy(graph, 30000);
+    const size_t num_forgotten = CountOrders(orders, Order::kForgetForward);
+    EXPECT_LT(0UL, num_forgotten);
+    EXPECT_EQ(8UL + num_forgotten, CountOrders(orders, Order::kComputeForward));
+    EXPECT_EQ(8UL, CountOrders(orders, Order::kComputeBackward));
+
+    // Values are forgotten in forward.
+    const auto first_backward = std::find_if(orders.begin(), orders.end(), [](const Order& o) { return o.kind == Order::kComputeBackward; });
+    EXPECT_EQ(num_forgotten, CountOrders(std::vector<Order>(orders.begin(), first_backward), Order::kForgetForward));
+}
+
+}  // namespace
+}  // namespace chainer_compiler
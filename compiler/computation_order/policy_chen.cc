@@ -6,7 +6,6 @@
 #include <iostream>
 #include <map>
 #include <numeric>
-#include <queue>
 #include <set>
 #include <vector>
 
@@ -31,41 +30,58 @@ std::set<Node*> FindArticulationPoints(const Graph& graph) {
         for (Value* output : node->outputs()) {
             for (Node* user : output->users()) {
                 // There is an edge (node, user)
-                size_t i = node_ids[node], j = node_ids[user];
+                const size_t i = node_ids[node], j = node_ids[user];
                 adj[i].push_back(j);
                 adj[j].push_back(i);
             }
         }
     }
 
+    // Tarjan's algorithm with an explicit stack, which runs in O(N+E).
     std::set<Node*> articulation_points;
-    // In this implementation, we try naive approach to enumerate articulation points
-    for (size_t i = 0; i < n; ++i) {
-        // Check connectivity after the removal of node i
-        std::vector<size_t> visited(n);
-        std::queue<size_t> q;
-        q.push((i + 1) % n);
-        while (!q.empty()) {
-            size_t j = q.front();
-            q.pop();
-            if (visited[j]) continue;
-            visited[j] = 1;
-
-            for (size_t k : adj[j]) {
-                if (k == i || visited[k]) continue;
-                q.push(k);
+    std::vector<int64_t> order(n, -1);
+    std::vector<int64_t> low(n, -1);
+    std::vector<size_t> parent(n, n);
+    int64_t num_visited = 0;
+    for (size_t root = 0; root < n; ++root) {
+        if (order[root] >= 0) continue;
+        order[root] = low[root] = num_visited++;
+        size_t num_root_children = 0;
+        // Pairs of a vertex and the index of its next edge to visit.
+        std::vector<std::pair<size_t, size_t>> stack = {{root, 0}};
+        while (!stack.empty()) {
+            const size_t v = stack.back().first;
+            if (stack.back().second < adj[v].size()) {
+                const size_t w = adj[v][stack.back().second++];
+                if (order[w] < 0) {
+                    parent[w] = v;
+                    order[w] = low[w] = num_visited++;
+                    if (v == root) ++num_root_children;
+                    stack.emplace_back(w, 0);
+                } else if (w != parent[v]) {
+                    low[v] = std::min(low[v], order[w]);
+                }
+                continue;
+            }
+
+            stack.pop_back();
+            if (stack.empty()) break;
+            const size_t u = stack.back().first;
+            low[u] = std::min(low[u], low[v]);
+            if (u != root && low[v] >= order[u]) {
+                articulation_points.insert(nodes[u]);
             }
         }
-        if (std::accumulate(visited.begin(), visited.end(), 0) < n - 1) {
-            articulation_points.insert(nodes[i]);
+        if (num_root_children > 1) {
+            articulation_points.insert(nodes[root]);
         }
     }
     return articulation_points;
 }
 
 std::vector<Order> ChenPolicy(const Graph& graph) {
-    int64_t budget = g_chen_budget * 1000000LL;
-    if (g_chen_budget == 0) {
+    int64_t budget = g_chen_budget() * 1000000LL;
+    if (g_chen_budget() == 0) {
         // default budget = sqrt of total memory
         for (Node* node : graph.nodes()) {
             for (Value* value : node->outputs()) {
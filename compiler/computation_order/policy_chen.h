@@ -2,10 +2,15 @@
 
 #include "compiler/computation_order/core.h"
 
+#include <set>
 #include <vector>
 
 namespace chainer_compiler {
 
+// Returns nodes whose removal disconnects the undirected form of
+// `graph`.
+std::set<Node*> FindArticulationPoints(const Graph& graph);
+
 std::vector<Order> ChenPolicy(const Graph& graph);
 
 }  // namespace chainer_compiler
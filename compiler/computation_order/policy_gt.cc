@@ -2,11 +2,12 @@
 // https://arxiv.org/abs/1905.11722
 #include "compiler/computation_order/policy_gt.h"
 
+#include "compiler/computation_order/simple_graph.h"
+
 #include <numeric>
 #include <queue>
 
 #include <compiler/flags.h>
-#include <compiler/flops.h>
 #include <compiler/log.h>
 #include <runtime/meminfo.h>
 
@@ -14,31 +15,6 @@ typedef std::vector<char> NodeSet;
 
 namespace chainer_compiler {
 
-struct SimpleGraph {
-    // Simple representation of computational graph
-    size_t n;
-    std::vector<Value*> value_list;
-    std::map<Value*, size_t> value_ids;
-    std::vector<std::vector<size_t>> adj;  // adj[i] is a list of vertices adjacent from the vertex i
-    std::vector<int64_t> memories;
-    std::vector<int64_t> flopses;
-
-    std::string ToString() const {
-        std::string s;
-        for (size_t i = 0; i < n; ++i) {
-            s += "[" + std::to_string(i) + "] => " + value_list[i]->ToString() + "\n";
-            s += "      MEM=" + std::to_string(memories[i]) + " FLOPS=" + std::to_string(flopses[i]) + "\n";
-        }
-        s += "Edges:\n";
-        for (size_t i = 0; i < n; ++i) {
-            for (const int j : adj[i]) {
-                s += " " + std::to_string(i) + " -> " + std::to_string(j) + "\n";
-            }
-        }
-        return s;
-    }
-};
-
 std::string ToDot(const SimpleGraph& sg, const std::vector<NodeSet>& seq) {
     // For debugging
     std::vector<size_t> block_number(sg.n);
@@ -133,54 +109,6 @@ void CheckDisjoint(const char* test_name, const NodeSet& set1, const NodeSet& se
     }
 }
 
-SimpleGraph GetSimpleFormGraph(const Graph& graph) {
-    // Extract only temporary&output values
-    SimpleGraph sg;
-
-    std::vector<Value*> intermediate_values(graph.temp_values());
-    for (Value* output : graph.output_values()) {
-        intermediate_values.push_back(output);
-    }
-
-    for (Value* value : intermediate_values) {
-        const size_t id = sg.value_ids.size();
-        sg.value_ids[value] = id;
-        sg.value_list.push_back(value);
-    }
-    sg.n = sg.value_ids.size();
-
-    sg.adj.assign(sg.n, std::vector<size_t>());
-
-    for (Node* node : graph.nodes()) {
-        for (Value* input : node->inputs()) {
-            for (Value* output : node->outputs()) {
-                const auto in_it = sg.value_ids.find(input);
-                const auto out_it = sg.value_ids.find(output);
-                if (in_it != sg.value_ids.end() && out_it != sg.value_ids.end()) {
-                    sg.adj[in_it->second].push_back(out_it->second);
-                }
-            }
-        }
-    }
-
-    sg.memories.assign(sg.n, -1);
-    for (Value* value : intermediate_values) {
-        const size_t id = sg.value_ids[value];
-        sg.memories[id] = value->GetNBytes();
-    }
-
-    sg.flopses.assign(sg.n, 0);
-    for (Node* node : graph.nodes()) {
-        for (Value* output : node->outputs()) {
-            const size_t out_id = sg.value_ids[output];
-            const int64_t f = CalculateFlops(*node);
-            sg.flopses[out_id] = f;
-        }
-    }
-
-    return sg;
-}
-
 std::vector<NodeSet> EnumerateLowerSets(const SimpleGraph& sg) {
     std::vector<NodeSet> lower_sets;
     lower_sets.push_back(NodeSet(sg.n, 0));  // Empty node set
@@ -427,7 +355,7 @@ int64_t AutomaticBudgetDetection() {
 }
 
 std::vector<Order> GTPolicyTimeCentric(const Graph& graph) {
-    const int64_t budget = (g_gt_budget ? (g_gt_budget * 1000000LL) : AutomaticBudgetDetection());
+    const int64_t budget = (g_gt_budget() ? (g_gt_budget() * 1000000LL) : AutomaticBudgetDetection());
     CLOG() << "GT budget (time centric)=" << budget << " bytes" << std::endl;
     SimpleGraph sg = GetSimpleFormGraph(graph);
 
@@ -445,8 +373,8 @@ std::vector<Order> GTPolicyMemoryCentric(const Graph& graph) {
     DiscretizeFlops(&sg);
     const std::vector<NodeSet> lower_sets = EnumerateLowerSets(sg);
 
-    if (g_gt_budget) {
-        const int64_t budget = g_gt_budget * 1000000LL;
+    if (g_gt_budget()) {
+        const int64_t budget = g_gt_budget() * 1000000LL;
         CLOG() << "GT budget (memory centric) =" << budget << " bytes" << std::endl;
         const std::vector<NodeSet> seq = ComputeDP(sg, lower_sets, budget, true);
         DumpDebugDotFile(sg, seq);
@@ -0,0 +1,71 @@
+#include "compiler/computation_order/simple_graph.h"
+
+#include <compiler/flops.h>
+#include <compiler/node.h>
+
+namespace chainer_compiler {
+
+std::string SimpleGraph::ToString() const {
+    std::string s;
+    for (size_t i = 0; i < n; ++i) {
+        s += "[" + std::to_string(i) + "] => " + value_list[i]->ToString() + "\n";
+        s += "      MEM=" + std::to_string(memories[i]) + " FLOPS=" + std::to_string(flopses[i]) + "\n";
+    }
+    s += "Edges:\n";
+    for (size_t i = 0; i < n; ++i) {
+        for (const int j : adj[i]) {
+            s += " " + std::to_string(i) + " -> " + std::to_string(j) + "\n";
+        }
+    }
+    return s;
+}
+
+SimpleGraph GetSimpleFormGraph(const Graph& graph) {
+    // Extract only temporary&output values
+    SimpleGraph sg;
+
+    std::vector<Value*> intermediate_values(graph.temp_values());
+    for (Value* output : graph.output_values()) {
+        intermediate_values.push_back(output);
+    }
+
+    for (Value* value : intermediate_values) {
+        const size_t id = sg.value_ids.size();
+        sg.value_ids[value] = id;
+        sg.value_list.push_back(value);
+    }
+    sg.n = sg.value_ids.size();
+
+    sg.adj.assign(sg.n, std::vector<size_t>());
+
+    for (Node* node : graph.nodes()) {
+        for (Value* input : node->inputs()) {
+            for (Value* output : node->outputs()) {
+                const auto in_it = sg.value_ids.find(input);
+                const auto out_it = sg.value_ids.find(output);
+                if (in_it != sg.value_ids.end() && out_it != sg.value_ids.end()) {
+                    sg.adj[in_it->second].push_back(out_it->second);
+                }
+            }
+        }
+    }
+
+    sg.memories.assign(sg.n, -1);
+    for (Value* value : intermediate_values) {
+        const size_t id = sg.value_ids[value];
+        sg.memories[id] = value->GetNBytes();
+    }
+
+    sg.flopses.assign(sg.n, 0);
+    for (Node* node : graph.nodes()) {
+        for (Value* output : node->outputs()) {
+            const size_t out_id = sg.value_ids[output];
+            const int64_t f = CalculateFlops(*node);
+            sg.flopses[out_id] = f;
+        }
+    }
+
+    return sg;
+}
+
+}  // namespace chainer_compiler
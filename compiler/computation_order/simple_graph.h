@@ -0,0 +1,28 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <compiler/graph.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+struct SimpleGraph {
+    // Simple representation of computational graph
+    size_t n;
+    std::vector<Value*> value_list;
+    std::map<Value*, size_t> value_ids;
+    std::vector<std::vector<size_t>> adj;  // adj[i] is a list of vertices adjacent from the vertex i
+    std::vector<int64_t> memories;
+    std::vector<int64_t> flopses;
+
+    std::string ToString() const;
+};
+
+// Extracts temporary and output values of `graph` with their sizes and
+// the flops of their producers.
+SimpleGraph GetSimpleFormGraph(const Graph& graph);
+
+}  // namespace chainer_compiler
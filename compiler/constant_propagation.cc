@@ -1,82 +1,53 @@
 #include "compiler/constant_propagation.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
 #include <vector>
 
+#include <compiler/onnx.h>
+
+#include <common/strutil.h>
 #include <compiler/evaluator.h>
 #include <compiler/graph.h>
 #include <compiler/graph_builder.h>
+#include <compiler/id_map.h>
 #include <compiler/log.h>
 #include <compiler/node.h>
 #include <compiler/tensor.h>
 #include <compiler/value.h>
+#include <configs/backend_config.h>
 
 namespace chainer_compiler {
 
 namespace {
 
+// Folding must not make constants larger than this unless inputs are
+// already larger (e.g., ConstantOfShape with a large shape).
+constexpr int64_t kMaxFoldedBytes = 1000 * 1000;
+
+// Subgraphs with larger constant inputs are not cached to bound the
+// memory kept by the cache and the cost to serialize them.
+constexpr int64_t kMaxCachedInputBytes = 1000 * 1000;
+constexpr size_t kMaxCacheEntries = 4096;
+
 bool IsConstantNode(const Node* node) {
     if (node == nullptr) {
         return false;
     }
-    if (node->op_type() != Node::kConstant && node->op_type() != Node::kChainerSequenceConstants) {
-        return false;
-    }
-    // TODO(hamaji): Support constant propagation for string tensors.
-    if (node->op_type() == Node::kConstant && !node->tensor_value()->IsArray()) {
-        return false;
-    }
-    return true;
-}
-
-bool HasConstantInputsOnly(const Node& node) {
-    if (node.inputs().empty()) return false;
-    for (Value* input : node.inputs()) {
-        if (!IsConstantNode(input->producer())) {
-            return false;
-        }
-    }
-    return true;
-}
-
-void DoConstantPropagation(Graph* graph, Node* node) {
-    CLOG() << "Propagate " << node->ToString() << std::endl;
-    std::vector<Node*> inputs;
-    std::set<Value*> seen_inputs;
-    for (Value* input : node->inputs()) {
-        if (seen_inputs.insert(input).second) {
-            inputs.push_back(input->producer());
-        }
-    }
-
-    std::vector<std::unique_ptr<EvaluatedValue>> next_values;
-    std::vector<Node*> nodes = inputs;
-    nodes.push_back(node);
-    Eval(nodes, node->outputs(), &next_values);
-
-    for (size_t i = 0; i < next_values.size(); ++i) {
-        auto& next_value = next_values[i];
-        GraphBuilder gb(graph, "Const", node->output(i));
-        if (next_value->is_tensor()) {
-            gb.Op(Node::kConstant, {}, node->output(i))->producer()->set_tensor_value(next_value->ReleaseTensor());
-        } else {
-            gb.Op(Node::kChainerSequenceConstants, {}, node->output(i))->producer()->set_tensor_values(next_value->ReleaseSequence());
-        }
-    }
-
-    graph->DetachNode(node);
-    for (Node* input : inputs) {
-        Value* output = input->output(0);
-        // Detach node if the value is not uesd by other ops nor a
-        // graph output.
-        if (output->users().empty() && !output->IsOutput()) {
-            graph->DetachNode(input);
-        }
-    }
+    return node->op_type() == Node::kConstant || node->op_type() == Node::kChainerSequenceConstants;
 }
 
-bool MaybePropagateConstant(Graph* graph, Node* node) {
-    switch (node->op_type()) {
-        // TODO(hamaji): Handle more ops.
+// Returns true if `node` never fails for any inputs. Nodes in subgraphs
+// such as If branches may never run with the constant inputs seen at
+// compile time, and a runtime CHECK failure during folding aborts the
+// compiler.
+bool IsSafeToFoldInSubGraph(const Node& node) {
+    switch (node.op_type()) {
         case Node::kAdd:
         case Node::kCast:
         case Node::kChainerGenericIs:
@@ -96,30 +67,301 @@ bool MaybePropagateConstant(Graph* graph, Node* node) {
         case Node::kSlice:
         case Node::kSub:
         case Node::kTranspose:
-        case Node::kUnsqueeze: {
-            DoConstantPropagation(graph, node);
+        case Node::kUnsqueeze:
             return true;
-        }
+        default:
+            return false;
+    }
+}
 
+// Returns true if `node` can be evaluated by ChxVM at compile time and
+// always produces the same outputs for the same inputs. Nodes of the
+// main graph always run, so any such op is folded there.
+bool IsFoldableOp(const Node& node, bool in_subgraph) {
+    static const std::unique_ptr<BackendConfig> chxvm_config = BackendConfig::FromName("chxvm");
+    switch (node.op_type()) {
+        case Node::kConstant:
+        case Node::kChainerSequenceConstants:
+        case Node::kChainerPrint:
+        case Node::kChainerDoSomething:
+        case Node::kChainerSGDUpdate:
+        case Node::kChainerAdamUpdate:
+        case Node::kDropout:
+            return false;
         default:
-            CLOG() << "Not propagate " << node->ToString() << std::endl;
+            break;
     }
-    return false;
+    if (!node.GetSubGraphs().empty()) return false;
+    if (in_subgraph) return IsSafeToFoldInSubGraph(node);
+    return chxvm_config->HasOp(Node::OpTypeToString(node.op_type()));
 }
 
-}  // namespace
+// A value evaluated at compile time, which is kept by `ConstantCache`.
+struct FoldedValue {
+    std::unique_ptr<Tensor> tensor;
+    std::vector<std::unique_ptr<Tensor>> sequence;
+
+    int64_t GetNBytes() const {
+        int64_t nbytes = 0;
+        if (tensor) {
+            if (tensor->IsArray()) nbytes += tensor->chx().GetNBytes();
+        }
+        for (const auto& t : sequence) {
+            if (t->IsArray()) nbytes += t->chx().GetNBytes();
+        }
+        return nbytes;
+    }
+};
+
+typedef std::vector<FoldedValue> FoldedValues;
+
+// Results of evaluations keyed by serialized subgraphs, which are
+// shared by all graphs and compilations in this process. Subgraphs are
+// serialized without names of values so the same computation in
+// different models hits.
+class ConstantCache {
+public:
+    bool Find(const std::string& key, FoldedValues* values) {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto found = cache_.find(key);
+        if (found == cache_.end()) return false;
+        for (const FoldedValue& value : found->second) {
+            values->emplace_back(Copy(value));
+        }
+        return true;
+    }
+
+    void Add(const std::string& key, const FoldedValues& values) {
+        FoldedValues copied;
+        for (const FoldedValue& value : values) copied.emplace_back(Copy(value));
+        std::lock_guard<std::mutex> lock(mu_);
+        if (cache_.size() >= kMaxCacheEntries) cache_.clear();
+        cache_.emplace(key, std::move(copied));
+    }
+
+private:
+    // Tensors share their data so copies are cheap.
+    static FoldedValue Copy(const FoldedValue& value) {
+        FoldedValue copied;
+        if (value.tensor) copied.tensor.reset(new Tensor(value.tensor->name(), *value.tensor));
+        for (const auto& t : value.sequence) copied.sequence.emplace_back(new Tensor(t->name(), *t));
+        return copied;
+    }
+
+    std::mutex mu_;
+    std::map<std::string, FoldedValues> cache_;
+};
+
+ConstantCache* GetConstantCache() {
+    static ConstantCache* cache = new ConstantCache();
+    return cache;
+}
+
+// A maximal connected subgraph of foldable nodes.
+struct ConstantSubGraph {
+    // Constant nodes which feed `nodes`.
+    std::vector<Node*> inputs;
+    // Nodes to be evaluated in a topological order.
+    std::vector<Node*> nodes;
+    // Values computed by `nodes` which are used outside.
+    std::vector<Value*> outputs;
+};
 
-void PropagateConstants(Graph* graph) {
-    bool replaced = true;
-    while (replaced) {
-        replaced = false;
-        for (Node* node : graph->GetLiveNodes()) {
-            if (!HasConstantInputsOnly(*node)) continue;
-            if (MaybePropagateConstant(graph, node)) {
-                replaced = true;
+std::string SerializeSubGraph(const ConstantSubGraph& sg) {
+    onnx::GraphProto xgraph;
+    std::map<const Value*, std::string> names;
+    auto get_name = [&names](const Value* value) {
+        if (value->IsNull()) return std::string();
+        auto p = names.emplace(value, StrCat("v", names.size()));
+        return p.first->second;
+    };
+    auto add_node = [&xgraph, &get_name](const Node* node) {
+        onnx::NodeProto* xnode = xgraph.add_node();
+        node->ToONNX(xnode);
+        xnode->clear_name();
+        xnode->clear_doc_string();
+        xnode->clear_input();
+        xnode->clear_output();
+        for (const Value* value : node->inputs()) xnode->add_input(get_name(value));
+        for (const Value* value : node->outputs()) xnode->add_output(get_name(value));
+        for (onnx::AttributeProto& xattr : *xnode->mutable_attribute()) {
+            if (xattr.has_t()) xattr.mutable_t()->clear_name();
+            for (onnx::TensorProto& xtensor : *xattr.mutable_tensors()) xtensor.clear_name();
+        }
+    };
+    for (const Node* node : sg.inputs) add_node(node);
+    for (const Node* node : sg.nodes) add_node(node);
+    for (const Value* value : sg.outputs) xgraph.add_output()->set_name(get_name(value));
+    return xgraph.SerializeAsString();
+}
+
+bool EvaluateSubGraph(const ConstantSubGraph& sg, bool use_cache, FoldedValues* values) {
+    const std::string key = use_cache ? SerializeSubGraph(sg) : "";
+    if (use_cache && GetConstantCache()->Find(key, values)) {
+        CLOG() << "Constant cache hit for " << sg.nodes.size() << " nodes" << std::endl;
+        // Name tensors after values as `Eval` does.
+        for (size_t i = 0; i < values->size(); ++i) {
+            FoldedValue& value = (*values)[i];
+            const std::string& name = sg.outputs[i]->name();
+            if (value.tensor) value.tensor.reset(new Tensor(name, *value.tensor));
+            for (size_t j = 0; j < value.sequence.size(); ++j) {
+                value.sequence[j].reset(new Tensor(StrCat(name, '_', j), *value.sequence[j]));
+            }
+        }
+        return true;
+    }
+
+    std::vector<Node*> nodes = sg.inputs;
+    nodes.insert(nodes.end(), sg.nodes.begin(), sg.nodes.end());
+    std::vector<std::unique_ptr<EvaluatedValue>> evaluated;
+    if (!TryEval(nodes, sg.outputs, &evaluated)) return false;
+    for (auto& e : evaluated) {
+        FoldedValue value;
+        if (e->is_tensor()) {
+            value.tensor.reset(e->ReleaseTensor());
+        } else {
+            value.sequence = e->ReleaseSequence();
+        }
+        values->push_back(std::move(value));
+    }
+    if (use_cache) GetConstantCache()->Add(key, *values);
+    return true;
+}
+
+int64_t GetConstantBytes(const Node& node) {
+    int64_t nbytes = 0;
+    if (node.op_type() == Node::kConstant) {
+        if (node.tensor_value()->IsArray()) nbytes += node.tensor_value()->chx().GetNBytes();
+    } else {
+        for (const auto& t : node.tensor_values()) {
+            if (t->IsArray()) nbytes += t->chx().GetNBytes();
+        }
+    }
+    return nbytes;
+}
+
+std::vector<ConstantSubGraph> FindConstantSubGraphs(const Graph& graph, bool in_subgraph) {
+    const std::vector<Node*> sorted = graph.GetTopologicallySortedNodes();
+
+    // A node is foldable when all its actual inputs are computed by
+    // constants or other foldable nodes.
+    IdSet<Node> foldable(graph.num_node_ids());
+    for (Node* node : sorted) {
+        if (node->GetNumActualInputs() == 0 || !IsFoldableOp(*node, in_subgraph)) continue;
+        bool ok = true;
+        for (Value* input : node->inputs()) {
+            if (input->IsNull()) continue;
+            Node* producer = input->producer();
+            if (!IsConstantNode(producer) && !(producer && foldable.count(producer))) {
+                ok = false;
+                break;
+            }
+        }
+        if (ok) foldable.emplace(node);
+    }
+
+    // Union-find over foldable nodes to split them into connected
+    // subgraphs, which are evaluated and cached separately.
+    std::vector<Node*> nodes;
+    for (Node* node : sorted) {
+        if (foldable.count(node)) nodes.push_back(node);
+    }
+    IdMap<Node, int> index(graph.num_node_ids());
+    for (size_t i = 0; i < nodes.size(); ++i) index.emplace(nodes[i], i);
+    std::vector<int> parents(nodes.size());
+    std::iota(parents.begin(), parents.end(), 0);
+    auto find_root = [&parents](int i) {
+        while (parents[i] != i) i = parents[i] = parents[parents[i]];
+        return i;
+    };
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        for (Value* input : nodes[i]->inputs()) {
+            if (input->IsNull() || !input->producer()) continue;
+            if (const int* j = index.find(input->producer())) {
+                parents[find_root(i)] = find_root(*j);
             }
         }
     }
+
+    std::map<int, ConstantSubGraph> subgraphs;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        Node* node = nodes[i];
+        const int root = find_root(i);
+        ConstantSubGraph& sg = subgraphs[root];
+        sg.nodes.push_back(node);
+        for (Value* input : node->inputs()) {
+            Node* producer = input->IsNull() ? nullptr : input->producer();
+            if (IsConstantNode(producer) && std::find(sg.inputs.begin(), sg.inputs.end(), producer) == sg.inputs.end()) {
+                sg.inputs.push_back(producer);
+            }
+        }
+        for (Value* output : node->outputs()) {
+            if (output->IsNull()) continue;
+            bool used_outside = output->IsOutput();
+            for (Node* user : output->users()) {
+                if (!foldable.count(user)) used_outside = true;
+            }
+            if (used_outside) sg.outputs.push_back(output);
+        }
+    }
+
+    std::vector<ConstantSubGraph> results;
+    for (auto& p : subgraphs) {
+        if (!p.second.outputs.empty()) results.push_back(std::move(p.second));
+    }
+    return results;
+}
+
+void ReplaceWithConstants(Graph* graph, const ConstantSubGraph& sg, FoldedValues* values) {
+    CHECK_EQ(sg.outputs.size(), values->size());
+    for (size_t i = 0; i < sg.outputs.size(); ++i) {
+        Value* output = sg.outputs[i];
+        FoldedValue& value = (*values)[i];
+        GraphBuilder gb(graph, "Const", output);
+        if (value.tensor) {
+            gb.Op(Node::kConstant, {}, output)->producer()->set_tensor_value(value.tensor.release());
+        } else {
+            gb.Op(Node::kChainerSequenceConstants, {}, output)->producer()->set_tensor_values(std::move(value.sequence));
+        }
+    }
+
+    for (Node* node : sg.nodes) {
+        CLOG() << "Propagate " << node->ToString() << std::endl;
+        graph->DetachNode(node);
+    }
+    for (Node* input : sg.inputs) {
+        Value* output = input->output(0);
+        // Detach node if the value is not uesd by other ops nor a
+        // graph output.
+        if (output->users().empty() && !output->IsOutput()) {
+            graph->DetachNode(input);
+        }
+    }
+}
+
+}  // namespace
+
+void PropagateConstants(Graph* graph, bool in_subgraph) {
+    for (const ConstantSubGraph& sg : FindConstantSubGraphs(*graph, in_subgraph)) {
+        int64_t input_bytes = 0;
+        for (const Node* node : sg.inputs) input_bytes += GetConstantBytes(*node);
+
+        FoldedValues values;
+        if (!EvaluateSubGraph(sg, input_bytes <= kMaxCachedInputBytes, &values)) {
+            CLOG() << "Not propagate " << sg.nodes.front()->ToString() << std::endl;
+            continue;
+        }
+
+        int64_t output_bytes = 0;
+        for (const FoldedValue& value : values) output_bytes += value.GetNBytes();
+        if (output_bytes > std::max(input_bytes, kMaxFoldedBytes)) {
+            CLOG() << "Not propagate " << sg.nodes.front()->ToString() << " which makes " << output_bytes << " bytes of constants"
+                   << std::endl;
+            continue;
+        }
+
+        ReplaceWithConstants(graph, sg, &values);
+    }
 }
 
 }  // namespace chainer_compiler
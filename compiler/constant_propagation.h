@@ -4,6 +4,9 @@ namespace chainer_compiler {
 
 class Graph;
 
-void PropagateConstants(Graph* graph);
+// Replaces nodes whose inputs are all constants with their results.
+// `in_subgraph` must be true for subgraphs such as Loop bodies and If
+// branches, where only ops which never fail are folded.
+void PropagateConstants(Graph* graph, bool in_subgraph = false);
 
 }  // namespace chainer_compiler
@@ -0,0 +1,100 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <chainerx/testing/context_session.h>
+
+#include <compiler/constant_propagation.h>
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+TEST(ConstantPropagationTest, FoldSubGraph) {
+    chainerx::testing::ContextSession sess;
+
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kInt32, {2}));
+    Value* y = graph.AddOutputValue("y", Type(Dtype::kInt32, {2}));
+    {
+        GraphBuilder gb(&graph, "test", y);
+        Value* a = gb.Const(Type(Dtype::kInt32, {2}), {3, 10});
+        Value* b = gb.Const(Type(Dtype::kInt32, {2}), {7, 32});
+        Value* c = gb.Op(Node::kAdd, {a, b});
+        Value* d = gb.Op(Node::kMul, {c, b});
+        gb.Op(Node::kAdd, {x, d}, y);
+    }
+
+    PropagateConstants(&graph);
+
+    // Add and Mul are folded into a single constant.
+    ASSERT_EQ(2UL, y->producer()->inputs().size());
+    Node* folded = y->producer()->input(1)->producer();
+    ASSERT_EQ(Node::kConstant, folded->op_type());
+    const Tensor& t = *folded->tensor_value();
+    EXPECT_EQ(Dtype::kInt32, t.dtype());
+    EXPECT_EQ(70, t.Get<int>(0));
+    EXPECT_EQ(1344, t.Get<int>(1));
+
+    int num_live_nodes = 0;
+    for (const Node* node : graph.nodes()) {
+        if (!node->detached()) ++num_live_nodes;
+    }
+    EXPECT_EQ(2, num_live_nodes);
+}
+
+TEST(ConstantPropagationTest, FoldStringConstant) {
+    chainerx::testing::ContextSession sess;
+
+    Graph graph("test");
+    Value* y = graph.AddOutputValue("y", Type());
+    {
+        GraphBuilder gb(&graph, "test", y);
+        Value* s = gb.Op(Node::kConstant, {});
+        s->producer()->set_tensor_value(new Tensor(s->name(), std::vector<std::string>{"foo", "bar"}));
+        gb.Op(Node::kIdentity, {s}, y);
+    }
+
+    PropagateConstants(&graph);
+
+    Node* folded = y->producer();
+    ASSERT_EQ(Node::kConstant, folded->op_type());
+    const Tensor& t = *folded->tensor_value();
+    ASSERT_FALSE(t.IsArray());
+    EXPECT_EQ(std::vector<std::string>({"foo", "bar"}), t.str());
+}
+
+TEST(ConstantPropagationTest, FoldOnlySafeOpsInSubGraph) {
+    chainerx::testing::ContextSession sess;
+
+    for (bool in_subgraph : {false, true}) {
+        Graph graph("test");
+        Value* y = graph.AddOutputValue("y", Type(Dtype::kFloat32, {2}));
+        {
+            GraphBuilder gb(&graph, "test", y);
+            Value* a = gb.Const(Type(Dtype::kFloat32, {2}), {-3.0f, 4.0f});
+            gb.Op(Node::kRelu, {a}, y);
+        }
+
+        PropagateConstants(&graph, in_subgraph);
+
+        // Relu may fail for unexpected inputs in a branch which never
+        // runs, so it is folded only in the main graph.
+        if (in_subgraph) {
+            EXPECT_EQ(Node::kRelu, y->producer()->op_type());
+        } else {
+            ASSERT_EQ(Node::kConstant, y->producer()->op_type());
+            const Tensor& t = *y->producer()->tensor_value();
+            EXPECT_EQ(0.0f, t.Get<float>(0));
+            EXPECT_EQ(4.0f, t.Get<float>(1));
+        }
+    }
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -336,6 +336,83 @@ ONNX_CHAINER_OPERATOR_SET_SCHEMA(
 
 namespace {
 
+// The number of columns of a (N, K) weight quantized by weight-only
+// quantization. Returns -1 if unknown.
+int64_t GetWeightOnlyColumns(InferenceContext& ctx, size_t weight_index) {
+    if (!hasInputShape(ctx, weight_index)) {
+        return -1;
+    }
+    const TensorShapeProto& shape = getInputShape(ctx, weight_index);
+    if (shape.dim_size() != 2 || !shape.dim(1).has_dim_value()) {
+        return -1;
+    }
+    const int64_t bits = getAttribute(ctx, "bits", 8);
+    return bits == 4 ? shape.dim(1).dim_value() * 2 : shape.dim(1).dim_value();
+}
+
+void InferWeightOnlyMatMul(InferenceContext& ctx) {
+    ctx.getOutputType(0)->mutable_tensor_type()->set_elem_type(TensorProto::FLOAT);
+    if (!hasNInputShapes(ctx, 2)) {
+        return;
+    }
+    const TensorShapeProto& a_shape = getInputShape(ctx, 0);
+    const TensorShapeProto& w_shape = getInputShape(ctx, 1);
+    if (a_shape.dim_size() < 1 || w_shape.dim_size() != 2) {
+        fail_shape_inference("ChainerWeightOnlyMatMul requires (..., K) and (N, K) inputs");
+    }
+    auto* output_shape = ctx.getOutputType(0)->mutable_tensor_type()->mutable_shape();
+    for (int i = 0; i < a_shape.dim_size() - 1; ++i) {
+        output_shape->add_dim()->CopyFrom(a_shape.dim(i));
+    }
+    output_shape->add_dim()->CopyFrom(w_shape.dim(0));
+}
+
+void InferWeightOnlyGather(InferenceContext& ctx) {
+    ctx.getOutputType(0)->mutable_tensor_type()->set_elem_type(TensorProto::FLOAT);
+    const int64_t columns = GetWeightOnlyColumns(ctx, 0);
+    if (columns < 0 || !hasInputShape(ctx, 2)) {
+        return;
+    }
+    auto* output_shape = ctx.getOutputType(0)->mutable_tensor_type()->mutable_shape();
+    for (const auto& dim : getInputShape(ctx, 2).dim()) {
+        output_shape->add_dim()->CopyFrom(dim);
+    }
+    output_shape->add_dim()->set_dim_value(columns);
+}
+
+}  // namespace
+
+ONNX_CHAINER_OPERATOR_SET_SCHEMA(
+        ChainerWeightOnlyMatMul,
+        9,
+        OpSchema()
+                .SetDoc("Multiplies A by the transpose of a weight quantized per group along K.")
+                .Input(0, "A", "Input tensor of (..., K)", "T")
+                .Input(1, "W", "Quantized weight of (N, K), or (N, K / 2) for int4", "Q")
+                .Input(2, "scales", "Scales of (N, K / group_size)", "T")
+                .Output(0, "Y", "Output tensor of (..., N)", "T")
+                .Attr("bits", "The number of bits of quantized weights (8 or 4).", AttributeProto::INT, static_cast<int64_t>(8))
+                .TypeConstraint("T", {"tensor(float)"}, "Constrain input and output types to float tensors.")
+                .TypeConstraint("Q", {"tensor(int8)", "tensor(uint8)"}, "Constrain quantized weights to 8 bits tensors.")
+                .TypeAndShapeInferenceFunction(InferWeightOnlyMatMul));
+
+ONNX_CHAINER_OPERATOR_SET_SCHEMA(
+        ChainerWeightOnlyGather,
+        9,
+        OpSchema()
+                .SetDoc("Gathers and dequantizes rows of a weight quantized per group along K.")
+                .Input(0, "data", "Quantized weight of (N, K), or (N, K / 2) for int4", "Q")
+                .Input(1, "scales", "Scales of (N, K / group_size)", "T")
+                .Input(2, "indices", "Tensors of int32/int64 indices", "I")
+                .Output(0, "output", "Output tensor", "T")
+                .Attr("bits", "The number of bits of quantized weights (8 or 4).", AttributeProto::INT, static_cast<int64_t>(8))
+                .TypeConstraint("T", {"tensor(float)"}, "Constrain input and output types to float tensors.")
+                .TypeConstraint("Q", {"tensor(int8)", "tensor(uint8)"}, "Constrain quantized weights to 8 bits tensors.")
+                .TypeConstraint("I", {"tensor(int32)", "tensor(int64)"}, "Constrain indices to integer tensors.")
+                .TypeAndShapeInferenceFunction(InferWeightOnlyGather));
+
+namespace {
+
 static const char* Split_ver9_doc =
         R"DOC(Split a tensor into a list of tensors, along the specified
 'axis'. Lengths of the parts can be specified using argument 'split'.
@@ -458,6 +535,8 @@ public:
         fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerResizeImages)>());
         fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerSoftmaxCrossEntropy)>());
         fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerSelectItem)>());
+        fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerWeightOnlyGather)>());
+        fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Chainer, 9, ChainerWeightOnlyMatMul)>());
         fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Onnx, 9, Expand)>());
         fn(GetOpSchema<ONNX_OPERATOR_SET_SCHEMA_CLASS_NAME(Onnx, 9, Split)>());
     }
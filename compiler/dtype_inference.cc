@@ -106,6 +106,34 @@ void InferDtype(Node* node) {
             break;
         }
 
+        case Node::kChainerWeightOnlyMatMul:
+        case Node::kChainerWeightOnlyGather: {
+            // Quantized weights are dequantized into float32.
+            set(0, Dtype::kFloat32);
+            break;
+        }
+
+        case Node::kChainerPackBits: {
+            set(0, Dtype::kUInt8);
+            break;
+        }
+
+        case Node::kChainerMaskByBits: {
+            set(0, in1);
+            break;
+        }
+
+        case Node::kChainerFloatToBFloat16: {
+            // ChainerX has no bfloat16.
+            set(0, Dtype::kInt16);
+            break;
+        }
+
+        case Node::kChainerBFloat16ToFloat: {
+            set(0, Dtype::kFloat32);
+            break;
+        }
+
         case Node::kChainerConvTransposeWithDynamicOutputShape: {
             CHECK(in2 == Dtype::kInt64 || in2 == Dtype::kUnknown) << in1.ToString() << " in " << node->ToString();
             set(0, CoerceDtype(in0, in1));
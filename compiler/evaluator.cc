@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <exception>
 #include <set>
 
 #include <chainerx/array.h>
@@ -40,11 +41,30 @@ std::vector<std::unique_ptr<Tensor>> EvaluatedValue::ReleaseSequence() {
     return ret;
 }
 
-void Eval(
+namespace {
+
+// Converts an evaluated variable to a tensor. Returns nullptr if it
+// cannot be a tensor (e.g., opaque values).
+std::unique_ptr<Tensor> VarToTensor(const std::string& name, const runtime::ChxVMVar& var) {
+    switch (var.kind()) {
+        case runtime::ChxVMVar::Kind::kScalar:
+        case runtime::ChxVMVar::Kind::kShape:
+        case runtime::ChxVMVar::Kind::kArray:
+            return std::make_unique<Tensor>(name, var.GetArray());
+        case runtime::ChxVMVar::Kind::kString:
+            return std::make_unique<Tensor>(name, var.GetString());
+        default:
+            return nullptr;
+    }
+}
+
+// Returns false when `may_fail` is true and the evaluation fails.
+bool EvalImpl(
         const std::vector<Node*>& nodes,
         const std::vector<std::pair<Value*, Tensor*>>& feeds,
         const std::vector<Value*>& fetches,
-        std::vector<std::unique_ptr<EvaluatedValue>>* outputs) {
+        std::vector<std::unique_ptr<EvaluatedValue>>* outputs,
+        bool may_fail) {
     runtime::ChxVMProgramProto program;
     std::vector<int> input_ids;
     std::vector<int> output_ids;
@@ -61,10 +81,11 @@ void Eval(
 
     runtime::ChxVM chxvm(program);
     runtime::ChxVMOptions chxvm_options;
-    chxvm_options.trace_level = g_trace_level;
+    chxvm_options.trace_level = g_trace_level();
+    chxvm_options.catch_exception = !may_fail;
     runtime::ChxVMState state(chxvm_options, chxvm.num_variables(), {});
 
-    if (g_trace_level) {
+    if (g_trace_level()) {
         std::cerr << "Tracing compile time eval for following nodes:" << std::endl;
         for (Node* node : nodes) {
             std::cerr << "  " << node->ToString() << std::endl;
@@ -78,41 +99,67 @@ void Eval(
         state.SetArray(input_id, t->chx());
     }
 
-    chxvm.Run(&state);
+    if (may_fail) {
+        try {
+            chxvm.Run(&state);
+        } catch (const std::exception& e) {
+            CLOG() << "Failed to evaluate: " << e.what() << std::endl;
+            return false;
+        }
+    } else {
+        chxvm.Run(&state);
+    }
 
+    std::vector<std::unique_ptr<EvaluatedValue>> values;
     for (size_t i = 0; i < fetches.size(); ++i) {
         const std::string& name = fetches[i]->name();
         int output_id = output_ids[i];
         runtime::ChxVMVar* var = state.GetVar(output_id);
 
-        switch (var->kind()) {
-            case runtime::ChxVMVar::Kind::kScalar:
-            case runtime::ChxVMVar::Kind::kShape:
-            case runtime::ChxVMVar::Kind::kArray: {
-                outputs->emplace_back(new EvaluatedValue(new Tensor(name, state.GetArray(output_id))));
-                break;
-            }
-
-            case runtime::ChxVMVar::Kind::kSequence: {
-                const runtime::ChxVMSequence& seq = *var->GetSequence();
-                std::vector<std::unique_ptr<Tensor>> tensors;
-                for (size_t j = 0; j < seq.size(); ++j) {
-                    // TODO(hamaji): Support nested sequences.
-                    tensors.emplace_back(new Tensor(StrCat(name, '_', j), seq[j].GetArray()));
+        if (var->kind() == runtime::ChxVMVar::Kind::kSequence) {
+            const runtime::ChxVMSequence& seq = *var->GetSequence();
+            std::vector<std::unique_ptr<Tensor>> tensors;
+            for (size_t j = 0; j < seq.size(); ++j) {
+                // TODO(hamaji): Support nested sequences.
+                std::unique_ptr<Tensor> tensor = VarToTensor(StrCat(name, '_', j), seq[j]);
+                if (!tensor) {
+                    CHECK(may_fail) << "Not supported yet: " << var->DebugString();
+                    return false;
                 }
-                outputs->emplace_back(new EvaluatedValue(std::move(tensors)));
-                break;
+                tensors.push_back(std::move(tensor));
             }
+            values.emplace_back(new EvaluatedValue(std::move(tensors)));
+            continue;
+        }
 
-            default:
-                // TODO(hamaji): Support other types.
-                CHECK(false) << "Not supported yet: " << var->DebugString();
+        std::unique_ptr<Tensor> tensor = VarToTensor(name, *var);
+        if (!tensor) {
+            // TODO(hamaji): Support other types.
+            CHECK(may_fail) << "Not supported yet: " << var->DebugString();
+            return false;
         }
+        values.emplace_back(new EvaluatedValue(tensor.release()));
     }
+    for (auto& value : values) outputs->push_back(std::move(value));
+    return true;
+}
+
+}  // namespace
+
+void Eval(
+        const std::vector<Node*>& nodes,
+        const std::vector<std::pair<Value*, Tensor*>>& feeds,
+        const std::vector<Value*>& fetches,
+        std::vector<std::unique_ptr<EvaluatedValue>>* outputs) {
+    CHECK(EvalImpl(nodes, feeds, fetches, outputs, false /* may_fail */));
 }
 
 void Eval(const std::vector<Node*>& nodes, const std::vector<Value*>& fetches, std::vector<std::unique_ptr<EvaluatedValue>>* outputs) {
     Eval(nodes, {}, fetches, outputs);
 }
 
+bool TryEval(const std::vector<Node*>& nodes, const std::vector<Value*>& fetches, std::vector<std::unique_ptr<EvaluatedValue>>* outputs) {
+    return EvalImpl(nodes, {}, fetches, outputs, true /* may_fail */);
+}
+
 }  // namespace chainer_compiler
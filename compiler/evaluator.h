@@ -35,4 +35,10 @@ void Eval(
 
 void Eval(const std::vector<Node*>& nodes, const std::vector<Value*>& fetches, std::vector<std::unique_ptr<EvaluatedValue>>* outputs);
 
+// Same as `Eval` without feeds, but returns false instead of aborting
+// when ops throw an exception or some of `fetches` cannot be tensors
+// (e.g., opaque values). `outputs` are not modified on failures. Note
+// CHECK failures in ops still abort the process.
+bool TryEval(const std::vector<Node*>& nodes, const std::vector<Value*>& fetches, std::vector<std::unique_ptr<EvaluatedValue>>* outputs);
+
 }  // namespace chainer_compiler
@@ -16,6 +16,7 @@
 #include <compiler/graph.h>
 #include <compiler/graph_builder.h>
 #include <compiler/node.h>
+#include <compiler/thread_pool.h>
 #include <compiler/topology.h>
 #include <compiler/value.h>
 
@@ -23,40 +24,6 @@ namespace chainer_compiler {
 
 namespace {
 
-void RejectCyclicNodes(std::set<Node*>* cands) {
-    std::stack<Node*> q;
-    for (Node* node : *cands) {
-        for (Value* output : node->outputs()) {
-            for (Node* n : output->users()) {
-                if (!cands->count(n)) q.push(n);
-            }
-        }
-    }
-
-    std::set<Node*> rejected;
-    std::set<Node*> seen;
-
-    while (!q.empty()) {
-        Node* node = q.top();
-        q.pop();
-        if (!seen.emplace(node).second) continue;
-        if (cands->count(node)) {
-            rejected.insert(node);
-        }
-
-        // TODO(hamaji): Optimize this algorithm by pre-calculating
-        // the max distance from the input for all nodes.
-
-        for (Value* output : node->outputs()) {
-            for (Node* n : output->users()) {
-                q.push(n);
-            }
-        }
-    }
-
-    for (Node* node : rejected) cands->erase(node);
-}
-
 void RejectUnusedConstants(std::set<Node*>* cands) {
     std::set<Node*> rejected;
     for (Node* node : *cands) {
@@ -87,14 +54,14 @@ std::string MakeValueName(const char* prefix, int index, const std::string& name
 
 }  // namespace
 
-void CreateFusionGroup(
+Node* CreateFusionGroup(
         Graph* graph, const std::set<Node*>& nodes, const std::string& fusion_type, int fusion_group_id, bool can_fuse_initializers) {
     std::vector<Value*> inputs;
     std::vector<Value*> outputs;
     std::vector<Value*> temps;
     ClassifyValues(std::vector<Node*>(nodes.begin(), nodes.end()), &inputs, &outputs, &temps);
     if (inputs.empty() || outputs.empty()) {
-        return;
+        return nullptr;
     }
 
     GraphBuilder gb(graph, StrCat("Fusion", fusion_group_id), outputs.front());
@@ -160,14 +127,16 @@ void CreateFusionGroup(
         }
     }
 #endif
+    return fused;
 }
 
 void FuseAllConnectedNodes(
         const char* name, Graph* graph, int min_fuse_ops, bool can_fuse_initializers, const std::function<bool(const Node&)>& is_fusable) {
     int num_fusion_groups = 0;
+    TopologicalOrder order(*graph);
     const std::vector<Node*> all_nodes(graph->nodes());
     for (Node* base_node : all_nodes) {
-        if (base_node->chainer_fusion_group()) continue;
+        if (base_node->detached() || base_node->chainer_fusion_group()) continue;
         if (!is_fusable(*base_node)) continue;
 
         std::set<Node*> cands;
@@ -195,7 +164,7 @@ void FuseAllConnectedNodes(
             }
         }
 
-        RejectCyclicNodes(&cands);
+        order.RejectCyclicNodes(&cands);
         RejectUnusedConstants(&cands);
 
         int num_calculation = 0;
@@ -209,34 +178,38 @@ void FuseAllConnectedNodes(
             node->set_chainer_fusion_group(num_fusion_groups);
         }
 
-        CreateFusionGroup(graph, cands, name, num_fusion_groups, can_fuse_initializers);
+        if (Node* fused = CreateFusionGroup(graph, cands, name, num_fusion_groups, can_fuse_initializers)) {
+            order.Fuse(cands, fused);
+        }
     }
 }
 
 void FuseOperations(Graph* graph, bool is_subgraph) {
     // Fuse ops in subgraphs first to avoid infinite loop.
+    std::vector<Graph*> subgraphs;
     for (const Node* node : graph->nodes()) {
         for (Graph* subgraph : node->GetSubGraphs()) {
-            FuseOperations(subgraph, true);
+            subgraphs.push_back(subgraph);
         }
     }
+    ParallelFor(subgraphs.size(), [&subgraphs](int64_t i) { FuseOperations(subgraphs[i], true); });
 
-    if (g_use_dldt && !is_subgraph) {
+    if (g_use_dldt() && !is_subgraph) {
         FuseDldtOperations(graph);
     }
-    if (g_use_ngraph && !is_subgraph) {
+    if (g_use_ngraph() && !is_subgraph) {
         FuseNGraphOperations(graph);
     }
-    if (g_use_tvm && !is_subgraph) {
+    if (g_use_tvm() && !is_subgraph) {
         FuseTVMOperations(graph);
     }
-    if (g_use_snpe && !is_subgraph) {
+    if (g_use_snpe() && !is_subgraph) {
         FuseSNPEOperations(graph);
     }
-    if (g_use_tensorrt && !is_subgraph) {
+    if (g_use_tensorrt() && !is_subgraph) {
         FuseTensorRTOperations(graph);
     }
-    if (g_fuse_operations) {
+    if (g_fuse_operations()) {
         FuseElementwiseOperations(graph);
     }
 }
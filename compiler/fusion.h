@@ -11,7 +11,9 @@ class Node;
 
 void FuseOperations(Graph* graph, bool is_subgraph = false);
 
-void CreateFusionGroup(
+// Moves `nodes` into the subgraph of a new ChainerFusionGroup node and
+// returns it, or returns nullptr if `nodes` have no inputs or outputs.
+Node* CreateFusionGroup(
         Graph* graph, const std::set<Node*>& nodes, const std::string& fusion_type, int fusion_group_id, bool can_fuse_initializers);
 
 void FuseAllConnectedNodes(
@@ -79,7 +79,7 @@ void FuseDldtOperations(Graph* graph) {
             Node::kUnsqueeze,
     };
 
-    if (g_dldt_device == "GPU") {
+    if (g_dldt_device() == "GPU") {
         CHECK(fusable_ops.emplace(Node::kResize).second);
         CHECK(fusable_ops.emplace(Node::kUpsample).second);
     }
@@ -10,7 +10,7 @@ namespace {
 
 TEST(FusionTest, Basic) {
     // TODO(hamaji): Introduce something like CompilerContext.
-    g_fuse_operations = true;
+    g_fuse_operations() = true;
     Type type(Dtype::kFloat32, {});
     Graph graph("test");
     Value* input = graph.AddInputValue("input", type);
@@ -26,7 +26,7 @@ TEST(FusionTest, Basic) {
     ASSERT_TRUE(node.subgraph());
     EXPECT_EQ(2, node.subgraph()->nodes().size());
     graph.CheckSanity("fused");
-    g_fuse_operations = false;
+    g_fuse_operations() = false;
 }
 
 }  // namespace
@@ -203,8 +203,9 @@ pool_attrs = attr_sets(auto_pad='NOTSET',
                        storage_order=0,
                        strides=[int],
                        ceil_mode=0)
-# Extension: the third output is for backward context.
-NodeDef('MaxPool', 1, (1, 2, 3), **pool_attrs)
+# Extension: the third output is for backward context, which keeps
+# int8 positions of maxima if `chainer_compress_indices` is set.
+NodeDef('MaxPool', 1, (1, 2, 3), chainer_compress_indices=0, **pool_attrs)
 # Extension: the second output is for backward context.
 NodeDef('AveragePool', 1, (1, 2), count_include_pad=False, **pool_attrs)
 NodeDef('GlobalMaxPool', 1, 1)
@@ -294,6 +295,30 @@ NodeDef('ChainerResizeImages', 1, 1, output_shape=[int])
 
 NodeDef('ChainerPadBatchSize', 1, 1, size=Required(int))
 
+# Weight-only quantized ops. See runtime/native_weight_only.h for the
+# layout of quantized weights and scales.
+NodeDef('ChainerWeightOnlyMatMul', 3, 1, bits=8)
+NodeDef('ChainerWeightOnlyGather', 3, 1, bits=8)
+
+# Compressed forms of activations retained for backward. See
+# runtime/native_compression.h.
+NodeDef('ChainerPackBits', 1, 1)
+NodeDef('ChainerMaskByBits', 2, 1)
+NodeDef('ChainerFloatToBFloat16', 1, 1)
+NodeDef('ChainerBFloat16ToFloat', 1, 1)
+
+# Update parameters in place at the end of a training step. See
+# compiler/optimizer_update.h. If `num_micro_batches` > 1, the index of
+# the micro-batch follows `lr` (and `step`), and buffers to accumulate
+# gradients follow the optimizer states.
+# (lr, params..., grads..., moms...) -> ()
+NodeDef('ChainerSGDUpdate', None, 0,
+        momentum=0.0, weight_decay=0.0, nesterov=0, num_micro_batches=1)
+# (lr, step, params..., grads..., ms..., vs...) -> ()
+NodeDef('ChainerAdamUpdate', None, 0,
+        beta1=0.9, beta2=0.999, epsilon=1e-8, weight_decay=0.0,
+        decoupled_weight_decay=0, num_micro_batches=1)
+
 # For experimental ops.
 NodeDef('ChainerDoSomething', None, None, function_name=Required(str))
 
@@ -597,7 +622,9 @@ class Value;
 
 class NodeBase {
 public:
-    void FillONNXAttributes(onnx::NodeProto* xnode) const;
+    // Tensor attributes have only their types and shapes and graph
+    // attributes are skipped if `shallow` is true.
+    void FillONNXAttributes(onnx::NodeProto* xnode, bool shallow = false) const;
 
     void SetDefaultAttributeValues();
 
@@ -657,7 +684,7 @@ def gen_gen_node_base_cc():
             conds.append('xattr.name() == "%s"' % (attr.onnx_name))
             blines = []
             blines.append(
-                'if (!g_permissive) '
+                'if (!g_permissive()) '
                 'CHECK_EQ(xattr.type(), %s) << xnode.DebugString();' %
                 attr.onnx_type())
             if attr.type == int:
@@ -686,7 +713,7 @@ def gen_gen_node_base_cc():
             blines.append('was_%s_set_ = true;' % (attr.c_name))
             bodies.append(blines)
         bodies.append([
-            'if (!g_permissive) CHECK(false) << "Invalid attribute `"'
+            'if (!g_permissive()) CHECK(false) << "Invalid attribute `"'
             '<< xattr.name() << "\' for " << OpTypeToString(op_type_);',
             'unknown_attributes_.push_back(xattr);'])
 
@@ -715,8 +742,8 @@ def gen_gen_node_base_cc():
     lines.append('}')
     lines.append('}')
 
-    lines.append('void NodeBase::FillONNXAttributes(onnx::NodeProto* xnode) '
-                 'const {')
+    lines.append('void NodeBase::FillONNXAttributes(onnx::NodeProto* xnode, '
+                 'bool shallow) const {')
 
     lines.append(r'''
     auto add_int_attr = [&xnode](const std::string& name, int v) {
@@ -740,24 +767,33 @@ def gen_gen_node_base_cc():
         xattr->set_s(v);
     };
 
-    auto add_tensor_attr = [&xnode](const std::string& name, const std::unique_ptr<Tensor>& v) {
+    auto fill_tensor = [shallow](const Tensor& t, onnx::TensorProto* xtensor) {
+        if (shallow) {
+            xtensor->set_data_type(t.dtype().ToONNX());
+            for (int64_t d : t.dims()) xtensor->add_dims(d);
+        } else {
+            t.ToONNX(xtensor);
+        }
+    };
+
+    auto add_tensor_attr = [&xnode, fill_tensor](const std::string& name, const std::unique_ptr<Tensor>& v) {
         if (!v.get()) return;
         onnx::AttributeProto* xattr = xnode->add_attribute();
         xattr->set_name(name);
         xattr->set_type(onnx::AttributeProto::TENSOR);
-        v->ToONNX(xattr->mutable_t());
+        fill_tensor(*v, xattr->mutable_t());
     };
 
-    auto add_tensors_attr = [&xnode](const std::string& name, const std::vector<std::unique_ptr<Tensor>>& vec) {
+    auto add_tensors_attr = [&xnode, fill_tensor](const std::string& name, const std::vector<std::unique_ptr<Tensor>>& vec) {
         if (vec.empty()) return;
         onnx::AttributeProto* xattr = xnode->add_attribute();
         xattr->set_name(name);
         xattr->set_type(onnx::AttributeProto::TENSORS);
-        for (const std::unique_ptr<Tensor>& t : vec) t->ToONNX(xattr->add_tensors());
+        for (const std::unique_ptr<Tensor>& t : vec) fill_tensor(*t, xattr->add_tensors());
     };
 
-    auto add_graph_attr = [&xnode](const std::string& name, const std::unique_ptr<Graph>& v) {
-        if (!v.get()) return;
+    auto add_graph_attr = [&xnode, shallow](const std::string& name, const std::unique_ptr<Graph>& v) {
+        if (!v.get() || shallow) return;
         onnx::AttributeProto* xattr = xnode->add_attribute();
         xattr->set_name(name);
         xattr->set_type(onnx::AttributeProto::GRAPH);
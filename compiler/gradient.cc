@@ -56,17 +56,17 @@ void ExposeParamGradsAsOutputs(Graph* graph, Graph* dest_graph, const std::set<V
     graph->ResetGradients();
 }
 
-void FilterOutUnnecessaryNode(const std::vector<Value*>& xs, std::map<Node*, int>* node_set) {
+void FilterOutUnnecessaryNode(const Graph& graph, const std::vector<Value*>& xs, IdMap<Node, int>* node_set) {
     std::stack<Node*> q;
     for (Value* x : xs) {
         for (Node* node : x->users()) q.push(node);
     }
 
-    std::set<Node*> seen;
+    IdSet<Node> seen(graph.num_node_ids());
     while (!q.empty()) {
         Node* node = q.top();
         q.pop();
-        if (!seen.insert(node).second) continue;
+        if (!seen.emplace(node)) continue;
         for (Value* output : node->outputs()) {
             for (Node* node : output->users()) {
                 q.push(node);
@@ -75,8 +75,7 @@ void FilterOutUnnecessaryNode(const std::vector<Value*>& xs, std::map<Node*, int
     }
 
     std::vector<Node*> unnecessary_nodes;
-    for (const auto& p : *node_set) {
-        Node* node = p.first;
+    for (Node* node : node_set->keys()) {
         if (!seen.count(node)) unnecessary_nodes.push_back(node);
     }
 
@@ -87,7 +86,7 @@ void FilterOutUnnecessaryNode(const std::vector<Value*>& xs, std::map<Node*, int
 
 std::set<Value*> GetParamValues(Graph* graph) {
     std::set<Value*> xs;
-    for (Value* value : graph->GetNecessaryValues(graph->output_values())) {
+    for (Value* value : graph->GetNecessaryValues(graph->output_values()).keys()) {
         if (!value->IsInput() || !value->initializer()) continue;
         CHECK(xs.emplace(value).second);
     }
@@ -135,7 +134,7 @@ void GenerateGradientNodes(Graph* graph, Graph* dest_graph) {
 void GenerateGradientNodesTo(Graph* graph, Graph* dest_graph, const std::vector<std::string>& param_names) {
     std::set<std::string> param_name_set{param_names.begin(), param_names.end()};
     std::set<Value*> xs;
-    for (Value* value : graph->GetNecessaryValues(graph->output_values())) {
+    for (Value* value : graph->GetNecessaryValues(graph->output_values()).keys()) {
         if (!param_name_set.count(value->name())) continue;
         CHECK(xs.emplace(value).second);
     }
@@ -146,8 +145,8 @@ void GenerateGradientNodesTo(Graph* graph, Graph* dest_graph, const std::vector<
 void GenerateGradientNodes(
         Graph* graph, Graph* dest_graph, const std::vector<Value*>& xs, const std::vector<Value*>& ys, std::map<Value*, Value*>* retained) {
     std::vector<Node*> necessary_nodes;
-    std::map<Node*, int> node_set = graph->GetNecessaryNodesAndInputCounts(ys);
-    FilterOutUnnecessaryNode(xs, &node_set);
+    IdMap<Node, int> node_set = graph->GetNecessaryNodesAndInputCounts(ys);
+    FilterOutUnnecessaryNode(*graph, xs, &node_set);
     for (Node* node : graph->GetTopologicallySortedNodes()) {
         if (node_set.count(node)) necessary_nodes.push_back(node);
     }
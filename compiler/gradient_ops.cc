@@ -8,6 +8,7 @@
 
 #include <common/log.h>
 #include <common/strutil.h>
+#include <compiler/flags.h>
 #include <compiler/gradient.h>
 #include <compiler/graph.h>
 #include <compiler/graph_builder.h>
@@ -105,6 +106,30 @@ public:
         return Retain(y_[i]);
     }
 
+    // Returns `x(i)` which is kept in float16 or bfloat16 between
+    // forward and backward if --compress_activations is set.
+    Value* CompressedX(int i) {
+        CHECK_LE(0, i) << i;
+        CHECK_GT(x_.size(), i) << i;
+        return Compressed(x_[i]);
+    }
+
+    Value* CompressedY(int i) {
+        CHECK_LE(0, i) << i;
+        CHECK_GT(y_.size(), i) << i;
+        return Compressed(y_[i]);
+    }
+
+    // Returns bits of whether elements of a forward value `v` are
+    // non-zero, packed in forward.
+    Value* PackedBits(Value* v) {
+        GraphBuilder gb(src_graph_, StrCat(name_, "PackBits"), v);
+        Value* bits = v->type().HasKnownShape() ? gb.Temp(Type(Dtype::kUInt8, {(v->type().NumElements() + 7) / 8}))
+                                                : gb.Temp(Type(Dtype::kUInt8));
+        gb.Op(Node::kChainerPackBits, {v}, bits);
+        return Retain(bits);
+    }
+
     Value* gy(int i) {
         CHECK_LE(0, i) << i;
         CHECK_GT(y_.size(), i) << i;
@@ -179,6 +204,45 @@ public:
     }
 
 private:
+    Value* Compressed(Value* v) {
+        const std::string& format = g_compress_activations();
+        const Type& type = v->type();
+        if (format.empty() || v->IsInput() || !v->producer() || v->producer()->op_type() == Node::kConstant ||
+            type.dtype() != Dtype::kFloat32) {
+            return Retain(v);
+        }
+        CHECK(format == "fp16" || format == "bf16") << "Unknown format of --compress_activations: " << format;
+        const bool is_bf16 = format == "bf16";
+        const Dtype compressed_dtype = is_bf16 ? Dtype::kInt16 : Dtype::kFloat16;
+
+        // Share the compressed value among gradients.
+        Value* compressed = nullptr;
+        for (Node* user : v->users()) {
+            if (is_bf16 ? user->op_type() == Node::kChainerFloatToBFloat16
+                        : user->op_type() == Node::kCast && user->to() == Dtype::kFloat16) {
+                compressed = user->output(0);
+                break;
+            }
+        }
+        if (!compressed) {
+            GraphBuilder gb(src_graph_, StrCat(name_, "Compress"), v);
+            compressed = type.HasKnownShape() ? gb.Temp(Type(compressed_dtype, type.dims())) : gb.Temp(Type(compressed_dtype));
+            if (is_bf16) {
+                gb.Op(Node::kChainerFloatToBFloat16, {v}, compressed);
+            } else {
+                gb.Op(Node::kCast, {v}, compressed)->producer()->set_to(Dtype::kFloat16);
+            }
+        }
+
+        GraphBuilder gb(graph_, StrCat(name_, "Decompress"), v);
+        if (is_bf16) {
+            return gb.Op(Node::kChainerBFloat16ToFloat, {Retain(compressed)}, gb.Temp(type));
+        }
+        Value* decompressed = gb.Op(Node::kCast, {Retain(compressed)}, gb.Temp(type));
+        decompressed->producer()->set_to(Dtype::kFloat32);
+        return decompressed;
+    }
+
     Graph* src_graph_;
     Graph* graph_;
     Node* node_;
@@ -234,12 +298,17 @@ void SigmoidGradFn(GradientOpContext* gc) {
     GraphBuilder gb{gc->builder(0)};
     Value* gy = gc->gy(0);
     Value* one = gb.Const(Type(GetFloatDtype(gc->NoRetainX(0)), {}), {1.0});
-    Value* t0 = gb.Op(Node::kMul, {gy, gc->y(0)});
-    Value* t1 = gb.Op(Node::kSub, {one, gc->y(0)});
+    Value* y = gc->CompressedY(0);
+    Value* t0 = gb.Op(Node::kMul, {gy, y});
+    Value* t1 = gb.Op(Node::kSub, {one, y});
     gc->GradOp(Node::kMul, 0, {t0, t1});
 }
 
 void ReluGradFn(GradientOpContext* gc) {
+    if (!g_compress_activations().empty()) {
+        gc->GradOp(Node::kChainerMaskByBits, 0, {gc->PackedBits(gc->NoRetainY(0)), gc->gy(0)});
+        return;
+    }
     gc->GradOp(Node::kChainerReluGrad, 0, {gc->y(0), gc->gy(0)});
 }
 
@@ -253,7 +322,8 @@ void TanhGradFn(GradientOpContext* gc) {
     GraphBuilder gb{gc->builder(0)};
     Value* one = gb.Const(Type(GetFloatDtype(gc->NoRetainX(0)), {}), {1.0});
     Value* gy = gc->gy(0);
-    Value* t0 = gb.Op(Node::kMul, {gc->y(0), gc->y(0)});
+    Value* y = gc->CompressedY(0);
+    Value* t0 = gb.Op(Node::kMul, {y, y});
     Value* t1 = gb.Op(Node::kSub, {one, t0});
     gc->GradOp(Node::kMul, 0, {gy, t1});
 }
@@ -262,6 +332,35 @@ void IdentityGradFn(GradientOpContext* gc) {
     gc->GradOp(Node::kIdentity, 0, {gc->gy(0)});
 }
 
+void DropoutGradFn(GradientOpContext* gc) {
+    Node* node = gc->node();
+    if (node->outputs().size() == 2 && node->output(1)->IsNull()) {
+        // TODO(hamaji): Replace the null output with the mask.
+        IdentityGradFn(gc);
+        return;
+    }
+    const Dtype dtype = GetFloatDtype(gc->NoRetainX(0));
+    if (node->outputs().size() == 1) {
+        const Type& type = gc->NoRetainX(0)->type();
+        if (type.HasKnownShape()) {
+            gc->AddOutput(Type(dtype, type.dims()));
+        } else {
+            gc->AddOutput(Type(dtype));
+        }
+    }
+    CHECK_EQ(2, node->outputs().size());
+
+    Value* gy = gc->gy(0);
+    if (!g_compress_activations().empty()) {
+        gc->GradOp(Node::kChainerMaskByBits, 0, {gc->PackedBits(gc->NoRetainY(1)), gy});
+        return;
+    }
+    GraphBuilder gb{gc->builder(0)};
+    Value* mask = gb.Op(Node::kCast, {gc->y(1)});
+    mask->producer()->set_to(dtype);
+    gc->GradOp(Node::kMul, 0, {gy, mask});
+}
+
 void ReshapeGradFn(GradientOpContext* gc) {
     GraphBuilder gb{gc->builder(0)};
     Value* t0 = gb.Op(Node::kShape, {gc->x(0)});
@@ -358,19 +457,21 @@ void ReduceMeanGradFn(GradientOpContext* gc) {
 void GemmGradFn(GradientOpContext* gc) {
     const Node* node = gc->node();
     Value* gy = gc->gy(0);
+    Value* x0 = gc->CompressedX(0);
+    Value* x1 = gc->CompressedX(1);
 
     // Note bias will be ignored thanks to beta=0.
     {
         GraphBuilder gb{gc->builder(0)};
         if (node->trans_a()) {
-            gc->GradOp(Node::kGemm, 0, {gc->x(1), gy, gc->x(0)})
+            gc->GradOp(Node::kGemm, 0, {x1, gy, x0})
                     ->producer()
                     ->set_alpha(node->alpha())
                     ->set_beta(0)
                     ->set_trans_a(node->trans_b())
                     ->set_trans_b(true);
         } else {
-            gc->GradOp(Node::kGemm, 0, {gy, gc->x(1), gc->x(0)})
+            gc->GradOp(Node::kGemm, 0, {gy, x1, x0})
                     ->producer()
                     ->set_alpha(node->alpha())
                     ->set_beta(0)
@@ -382,14 +483,14 @@ void GemmGradFn(GradientOpContext* gc) {
     {
         GraphBuilder gb{gc->builder(1)};
         if (node->trans_b()) {
-            gc->GradOp(Node::kGemm, 1, {gy, gc->x(0), gc->x(1)})
+            gc->GradOp(Node::kGemm, 1, {gy, x0, x1})
                     ->producer()
                     ->set_alpha(node->alpha())
                     ->set_beta(0)
                     ->set_trans_a(true)
                     ->set_trans_b(node->trans_a());
         } else {
-            gc->GradOp(Node::kGemm, 1, {gc->x(0), gy, gc->x(1)})
+            gc->GradOp(Node::kGemm, 1, {x0, gy, x1})
                     ->producer()
                     ->set_alpha(node->alpha())
                     ->set_beta(0)
@@ -413,12 +514,12 @@ void MatMulGradFn(GradientOpContext* gc) {
     Value* gy = gc->gy(0);
     {
         GraphBuilder gb{gc->builder(0)};
-        Value* x1 = gb.Op(Node::kTranspose, {gc->x(1)});
+        Value* x1 = gb.Op(Node::kTranspose, {gc->CompressedX(1)});
         gc->GradOp(Node::kMatMul, 0, {gy, x1});
     }
     {
         GraphBuilder gb{gc->builder(1)};
-        Value* x0 = gb.Op(Node::kTranspose, {gc->x(0)});
+        Value* x0 = gb.Op(Node::kTranspose, {gc->CompressedX(0)});
         gc->GradOp(Node::kMatMul, 1, {x0, gy});
     }
 }
@@ -442,7 +543,7 @@ void ConvGradFn(GradientOpContext* gc) {
     Value* w = gc->x(1);
     {
         GraphBuilder gb{gc->builder(0)};
-        Value* x = gc->x(0);
+        Value* x = gc->NoRetainX(0);
         if (x->type().dims().size() > 2) {
             gc->GradOp(Node::kConvTranspose, 0, {gy, w})
                     ->producer()
@@ -461,7 +562,7 @@ void ConvGradFn(GradientOpContext* gc) {
                     ->set_strides(node->strides());
         }
     }
-    gc->GradOp(Node::kChainerConvGradWeight, 1, {w, gc->x(0), gy})
+    gc->GradOp(Node::kChainerConvGradWeight, 1, {w, gc->CompressedX(0), gy})
             ->producer()
             ->set_dilations(node->dilations())
             ->set_group(node->group())
@@ -509,6 +610,9 @@ void ConvTransposeGradFn(GradientOpContext* gc) {
 void MaxPoolGradFn(GradientOpContext* gc) {
     GraphBuilder gb{gc->builder(0)};
     Node* node = gc->node();
+    if (!g_compress_activations().empty()) {
+        node->set_chainer_compress_indices(1);
+    }
     if (node->outputs().size() == 1) gc->AddNullOutput();
     CHECK_EQ(2, node->outputs().size());
     Value* context = gc->AddOutput(Type(Type::Kind::kOpaque));
@@ -1109,8 +1213,7 @@ bool AddGradientForNode(Graph* graph, Graph* dest_graph, Node* node, std::map<Va
         register_grad_fn(Node::kChainerLinear, &LinearGradFn);
         register_grad_fn(Node::kLSTM, &LSTMGradFn);
 
-        // TODO(hamaji): Implement dropout.
-        register_grad_fn(Node::kDropout, &IdentityGradFn);
+        register_grad_fn(Node::kDropout, &DropoutGradFn);
 
         register_grad_fn(Node::kGreater, &DoNothingGradFn);
         register_grad_fn(Node::kConstant, &DoNothingGradFn);
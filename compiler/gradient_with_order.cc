@@ -1,5 +1,6 @@
 #include "compiler/computation_order/core.h"
 
+#include "compiler/computation_order/policy_budget.h"
 #include "compiler/computation_order/policy_chen.h"
 #include "compiler/computation_order/policy_custom.h"
 #include "compiler/computation_order/policy_dummy.h"
@@ -62,7 +63,7 @@ void ExposeParamGradsAsOutputs(Graph* graph, Graph* dest_graph, const std::set<V
 // TODO(mkusumoto): Re-organize dup code.
 std::set<Value*> GetParamValues(Graph* graph) {
     std::set<Value*> xs;
-    for (Value* value : graph->GetNecessaryValues(graph->output_values())) {
+    for (Value* value : graph->GetNecessaryValues(graph->output_values()).keys()) {
         if (!value->IsInput() || !value->initializer()) continue;
         CHECK(xs.emplace(value).second);
     }
@@ -109,6 +110,8 @@ std::vector<Order> GetComputationOrder(const Graph& graph, const std::string& po
         return GTPolicyTimeCentric(graph);
     } else if (policy == "gtmem") {
         return GTPolicyMemoryCentric(graph);
+    } else if (policy == "budget") {
+        return BudgetPolicy(graph);
     } else {
         CHECK(false) << "Unknown policy of computation order: " << policy;
         return {};
@@ -137,7 +140,7 @@ void AddRetainedParts(Graph* fwd_graph, Graph* bwd_graph, const std::map<Value*,
 }
 
 bool IsComputationOrderSupported(const Graph& graph) {
-    for (auto* value : graph.GetNecessaryValues()) {
+    for (auto* value : graph.GetNecessaryValues().keys()) {
         if (value->type().GetNBytes() < 0) {
             return false;
         }
@@ -7,12 +7,12 @@
 #include <set>
 
 #include <compiler/onnx.h>
-#include <onnx/shape_inference/implementation.h>
 
 #include <common/log.h>
 #include <common/strutil.h>
 #include <compiler/node.h>
 #include <compiler/serializer_util.h>
+#include <compiler/shape_inference.h>
 #include <compiler/tensor.h>
 #include <compiler/topology.h>
 #include <compiler/util.h>
@@ -29,8 +29,7 @@ void Graph::Construct(const onnx::GraphProto& xgraph) {
     doc_string_ = xgraph.doc_string();
     std::map<std::string, Value*> values_by_name;
     for (const onnx::ValueInfoProto& input : xgraph.input()) {
-        Value* value = new Value(input, Value::Kind::kInput);
-        all_values_.emplace_back(value);
+        Value* value = AddValueImpl(std::make_unique<Value>(input, Value::Kind::kInput));
         input_values_.push_back(value);
         CHECK(values_by_name.emplace(value->name(), value).second) << "Duplicated value name: " << value->name();
     }
@@ -38,8 +37,7 @@ void Graph::Construct(const onnx::GraphProto& xgraph) {
         std::unique_ptr<Value> value(new Value(output, Value::Kind::kOutput));
         auto p = values_by_name.emplace(value->name(), value.get());
         if (p.second) {
-            output_values_.push_back(value.get());
-            all_values_.emplace_back(std::move(value));
+            output_values_.push_back(AddValueImpl(std::move(value)));
         } else {
             // We allow graph output to be null.
             // TODO(hamaji): Revisit this design. Probably, it would
@@ -50,8 +48,7 @@ void Graph::Construct(const onnx::GraphProto& xgraph) {
         }
     }
     for (const onnx::ValueInfoProto& temp : xgraph.value_info()) {
-        Value* value = new Value(temp, Value::Kind::kTemp);
-        all_values_.emplace_back(value);
+        Value* value = AddValueImpl(std::make_unique<Value>(temp, Value::Kind::kTemp));
         temp_values_.push_back(value);
         CHECK(values_by_name.emplace(value->name(), value).second) << "Duplicated value name: " << value->name();
     }
@@ -141,17 +138,17 @@ std::vector<Node*> Graph::GetLiveNodes() const {
     return nodes;
 }
 
-std::set<Value*> Graph::GetNecessaryValues(const std::vector<Value*>& output_values) const {
+IdSet<Value> Graph::GetNecessaryValues(const std::vector<Value*>& output_values) const {
     std::queue<Value*> q;
     for (Value* value : output_values) q.push(value);
 
-    std::set<Value*> seen_values;
+    IdSet<Value> seen_values(num_value_ids_);
     while (!q.empty()) {
         Value* value = q.front();
         q.pop();
         if (Node* node = value->producer()) {
             for (Value* input : node->inputs()) {
-                if (!seen_values.emplace(input).second) continue;
+                if (!seen_values.emplace(input)) continue;
                 q.push(input);
             }
         }
@@ -159,13 +156,18 @@ std::set<Value*> Graph::GetNecessaryValues(const std::vector<Value*>& output_val
     return seen_values;
 }
 
-std::set<Value*> Graph::GetNecessaryValues() const {
+IdSet<Value> Graph::GetNecessaryValues() const {
     return GetNecessaryValues(output_values_);
 }
 
+Value* Graph::AddValueImpl(std::unique_ptr<Value> value) {
+    value->id_ = num_value_ids_++;
+    all_values_.emplace_back(std::move(value));
+    return all_values_.back().get();
+}
+
 Value* Graph::AddValue(const std::string& name, const Type& type, Value::Kind kind) {
-    Value* value = new Value(MakeUnique(name), type, kind);
-    all_values_.emplace_back(value);
+    Value* value = AddValueImpl(std::make_unique<Value>(MakeUnique(name), type, kind));
     if (value->IsInput()) input_values_.push_back(value);
     if (value->IsOutput()) output_values_.push_back(value);
     if (value->IsTemp()) temp_values_.push_back(value);
@@ -237,18 +239,19 @@ std::vector<Node*> Graph::GetTopologicallySortedNodes() const {
 }
 
 void Graph::SortNodesTopologically() {
-    std::set<Node*> node_set{nodes_.begin(), nodes_.end()};
+    IdSet<Node> node_set(num_node_ids_);
+    for (Node* node : nodes_) node_set.emplace(node);
     std::vector<Node*> next_nodes = GetTopologicallySortedNodes();
     for (Node* node : next_nodes) {
         CHECK(node_set.erase(node));
     }
-    for (Node* node : node_set) {
+    for (Node* node : node_set.keys()) {
         next_nodes.push_back(node);
     }
     nodes_.swap(next_nodes);
 }
 
-std::map<Node*, int> Graph::GetNecessaryNodesAndInputCounts(const std::vector<Value*>& output_values) const {
+IdMap<Node, int> Graph::GetNecessaryNodesAndInputCounts(const std::vector<Value*>& output_values) const {
     std::queue<Node*> q;
     for (const Value* value : output_values) {
         q.push(value->producer());
@@ -262,14 +265,15 @@ std::map<Node*, int> Graph::GetNecessaryNodesAndInputCounts(const std::vector<Va
     }
 
     // All node in this graph for sanity check.
-    std::set<Node*> node_set(nodes_.begin(), nodes_.end());
+    IdSet<Node> node_set(num_node_ids_);
+    for (Node* node : nodes_) node_set.emplace(node);
 
-    std::map<Node*, int> input_counts;
+    IdMap<Node, int> input_counts(num_node_ids_);
     while (!q.empty()) {
         Node* node = q.front();
         q.pop();
         if (!node) continue;
-        if (!input_counts.emplace(node, node->GetNumActualInputs()).second) continue;
+        if (!input_counts.emplace(node, node->GetNumActualInputs())) continue;
         if (!node_set.count(node)) {
             std::cerr << "External reference from " << this->name() << ". External node:\n" << node->DebugString();
             DumpONNXOnFailure();
@@ -310,6 +314,7 @@ std::string Graph::MakeUnique(const std::string& name) {
 }
 
 void Graph::AddNodeImpl(std::unique_ptr<Node> node, const std::vector<Value*>& inputs, const std::vector<Value*>& outputs) {
+    node->id_ = num_node_ids_++;
     for (Value* input : inputs) input->AddUser(node.get());
     for (Value* output : outputs) output->SetProducer(node.get());
     nodes_.push_back(node.get());
@@ -317,32 +322,35 @@ void Graph::AddNodeImpl(std::unique_ptr<Node> node, const std::vector<Value*>& i
 }
 
 void Graph::MigrateNodes(const std::vector<Node*>& nodes, const std::vector<Value*>& temps, Graph* to) {
+    IdSet<Node> node_set(num_node_ids_);
+    for (Node* node : nodes) node_set.emplace(node);
+    const size_t num_nodes = nodes_.size();
+    nodes_.erase(std::remove_if(nodes_.begin(), nodes_.end(), [&node_set](Node* node) { return node_set.count(node); }), nodes_.end());
+    CHECK_EQ(num_nodes, nodes_.size() + node_set.size());
+
+    IdSet<Value> temp_set(num_value_ids_);
+    for (Value* value : temps) temp_set.emplace(value);
+    const size_t num_temps = temp_values_.size();
+    temp_values_.erase(
+            std::remove_if(temp_values_.begin(), temp_values_.end(), [&temp_set](Value* value) { return temp_set.count(value); }),
+            temp_values_.end());
+    CHECK_EQ(num_temps, temp_values_.size() + temp_set.size());
+
+    // Objects are still owned by this graph, but their IDs are
+    // renumbered so side tables of `to` can hold them.
     for (Node* node : nodes) {
-        auto found = std::find(nodes_.begin(), nodes_.end(), node);
-        CHECK(found != nodes_.end()) << node->DebugString();
-        nodes_.erase(found);
+        node->id_ = to->num_node_ids_++;
         to->nodes_.push_back(node);
     }
     for (Value* value : temps) {
-        auto found = std::find(temp_values_.begin(), temp_values_.end(), value);
-        CHECK(found != temp_values_.end()) << value->DebugString();
-        temp_values_.erase(found);
+        value->id_ = to->num_value_ids_++;
         to->temp_values_.push_back(value);
     }
     to->SortNodesTopologically();
 }
 
 void Graph::InferShapes() {
-    onnx::GraphProto xgraph;
-    ToONNX(&xgraph);
-    output_values_.clear();
-    input_values_.clear();
-    temp_values_.clear();
-    all_values_.clear();
-    nodes_.clear();
-    nodes_buf_.clear();
-    onnx::shape_inference::InferShapes(&xgraph, OpsetImports());
-    Construct(xgraph);
+    chainer_compiler::InferShapes(this);
 }
 
 void Graph::ResetGradients() {
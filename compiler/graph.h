@@ -2,10 +2,12 @@
 
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <compiler/onnx.h>
 
+#include <compiler/id_map.h>
 #include <compiler/node.h>
 #include <compiler/tensor.h>
 #include <compiler/type.h>
@@ -43,12 +45,21 @@ public:
         return nodes_;
     }
 
+    // Upper bounds of `Node::id()` and `Value::id()` of this graph,
+    // which are the sizes of side tables indexed by them.
+    int num_node_ids() const {
+        return num_node_ids_;
+    }
+    int num_value_ids() const {
+        return num_value_ids_;
+    }
+
     std::vector<Node*> GetLiveNodes() const;
 
     // All values which is required to produce `output_values`.
-    std::set<Value*> GetNecessaryValues(const std::vector<Value*>& output_values) const;
+    IdSet<Value> GetNecessaryValues(const std::vector<Value*>& output_values) const;
     // All values which is required to produce `output_values_`.
-    std::set<Value*> GetNecessaryValues() const;
+    IdSet<Value> GetNecessaryValues() const;
 
     const std::string& name() const {
         return name_;
@@ -83,7 +94,7 @@ public:
     void SortNodesTopologically();
 
     // Returns a map from nodes to the number of their users.
-    std::map<Node*, int> GetNecessaryNodesAndInputCounts(const std::vector<Value*>& output_values) const;
+    IdMap<Node, int> GetNecessaryNodesAndInputCounts(const std::vector<Value*>& output_values) const;
 
     // Gets a sequence of scheduled nodes. Node::order() must be set
     // before calling this function.
@@ -118,6 +129,8 @@ private:
 
     void Construct(const onnx::GraphProto& xgraph);
 
+    Value* AddValueImpl(std::unique_ptr<Value> value);
+
     std::vector<Value*> output_values_;
     std::vector<Value*> input_values_;
     std::vector<Value*> temp_values_;
@@ -127,8 +140,11 @@ private:
     std::string name_;
     std::string doc_string_;
 
+    int num_node_ids_{0};
+    int num_value_ids_{0};
+
     // A monotonically increasing ID to generate unique symbols.
-    std::map<std::string, int> ids_;
+    std::unordered_map<std::string, int> ids_;
 };
 
 }  // namespace chainer_compiler
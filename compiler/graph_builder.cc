@@ -3,13 +3,13 @@
 #include <stdint.h>
 
 #include <compiler/onnx.h>
-#include <onnx/shape_inference/implementation.h>
 
 #include <common/strutil.h>
 #include <compiler/dtype_inference.h>
 #include <compiler/flags.h>
 #include <compiler/graph.h>
 #include <compiler/node.h>
+#include <compiler/shape_inference.h>
 #include <compiler/topology.h>
 #include <compiler/value.h>
 
@@ -23,7 +23,7 @@ GraphBuilder::~GraphBuilder() {
         node->Validate();
     }
 
-    if (!g_skip_inference) {
+    if (!g_skip_inference()) {
         std::vector<Value*> inputs, outputs, temps;
         ClassifyValues(added_nodes_, &inputs, &outputs, &temps);
         std::vector<Node*> nodes = SortTopologically(added_nodes_, inputs, false /* is_full_graph */);
@@ -35,27 +35,7 @@ GraphBuilder::~GraphBuilder() {
         }
         CHECK_EQ(added_nodes_.size(), nodes.size());
 
-        onnx::GraphProto xgraph;
-        for (Node* node : nodes) {
-            node->ToONNX(xgraph.add_node());
-        }
-        for (Value* value : inputs) {
-            value->ToONNX(xgraph.add_input());
-        }
-        for (Value* value : outputs) {
-            value->ToONNX(xgraph.add_output());
-        }
-        for (Value* value : temps) {
-            value->ToONNX(xgraph.add_value_info());
-        }
-        onnx::shape_inference::InferShapes(&xgraph, OpsetImports());
-
-        for (size_t i = 0; i < outputs.size(); ++i) {
-            if (xgraph.output(i).type().has_tensor_type()) outputs[i]->set_type(new Type(xgraph.output(i).type()));
-        }
-        for (size_t i = 0; i < temps.size(); ++i) {
-            if (xgraph.value_info(i).type().has_tensor_type()) temps[i]->set_type(new Type(xgraph.value_info(i).type()));
-        }
+        InferShapes(graph_, nodes);
     }
 
     for (Node* node : added_nodes_) {
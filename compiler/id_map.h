@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+namespace chainer_compiler {
+
+// A map keyed by nodes or values, which is used as a side table of
+// graph analyses. `Key::id()` of objects in a graph are dense so they
+// are kept in vectors of `num_ids` elements (e.g., `num_node_ids()` of
+// the graph). Keys from other graphs fall back to a tree map.
+template <class Key, class T>
+class IdMap {
+public:
+    explicit IdMap(int num_ids) : keys_(num_ids), values_(num_ids) {
+    }
+
+    // Returns the value for `key`, or nullptr if `key` is not in the map.
+    T* find(const Key* key) {
+        const int id = key->id();
+        if (id >= 0 && id < static_cast<int>(keys_.size()) && keys_[id] == key) return &values_[id];
+        auto found = others_.find(const_cast<Key*>(key));
+        return found == others_.end() ? nullptr : &found->second;
+    }
+    const T* find(const Key* key) const {
+        return const_cast<IdMap*>(this)->find(key);
+    }
+
+    bool count(const Key* key) const {
+        return find(key) != nullptr;
+    }
+
+    // Returns false and keeps the current value if `key` is already in
+    // the map.
+    bool emplace(Key* key, const T& value = T()) {
+        if (find(key)) return false;
+        const int id = key->id();
+        if (id >= 0 && id < static_cast<int>(keys_.size()) && !keys_[id]) {
+            keys_[id] = key;
+            values_[id] = value;
+        } else {
+            others_.emplace(key, value);
+        }
+        ++size_;
+        return true;
+    }
+
+    bool erase(const Key* key) {
+        const int id = key->id();
+        if (id >= 0 && id < static_cast<int>(keys_.size()) && keys_[id] == key) {
+            keys_[id] = nullptr;
+        } else if (!others_.erase(const_cast<Key*>(key))) {
+            return false;
+        }
+        --size_;
+        return true;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Returns keys in the order of their IDs, followed by keys from
+    // other graphs.
+    std::vector<Key*> keys() const {
+        std::vector<Key*> keys;
+        keys.reserve(size_);
+        for (Key* key : keys_) {
+            if (key) keys.push_back(key);
+        }
+        for (const auto& p : others_) keys.push_back(p.first);
+        return keys;
+    }
+
+private:
+    std::vector<Key*> keys_;
+    std::vector<T> values_;
+    std::map<Key*, T> others_;
+    size_t size_{0};
+};
+
+// A set of nodes or values. See `IdMap`. `char` is used instead of
+// `bool` as `std::vector<bool>` cannot return pointers to elements.
+template <class Key>
+using IdSet = IdMap<Key, char>;
+
+}  // namespace chainer_compiler
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include <compiler/graph.h>
+#include <compiler/id_map.h>
+#include <compiler/type.h>
+
+namespace chainer_compiler {
+namespace {
+
+TEST(IdMapTest, DenseIds) {
+    Type type(Dtype::kFloat32, {});
+    Graph graph("test");
+    Value* input = graph.AddInputValue("input", type);
+    Value* temp = graph.AddValue("temp", type);
+    Value* output = graph.AddOutputValue("output", type);
+    Node* op0 = graph.AddNode(Node::kRelu, {input}, {temp});
+    Node* op1 = graph.AddNode(Node::kTanh, {temp}, {output});
+    EXPECT_EQ(0, input->id());
+    EXPECT_EQ(1, temp->id());
+    EXPECT_EQ(2, output->id());
+    EXPECT_EQ(0, op0->id());
+    EXPECT_EQ(1, op1->id());
+    EXPECT_EQ(3, graph.num_value_ids());
+    EXPECT_EQ(2, graph.num_node_ids());
+
+    IdMap<Node, int> counts(graph.num_node_ids());
+    EXPECT_TRUE(counts.emplace(op1, 1));
+    EXPECT_TRUE(counts.emplace(op0, 0));
+    EXPECT_FALSE(counts.emplace(op0, 42));
+    EXPECT_EQ(0, *counts.find(op0));
+    ++*counts.find(op1);
+    EXPECT_EQ(2, *counts.find(op1));
+    EXPECT_EQ(std::vector<Node*>({op0, op1}), counts.keys());
+    EXPECT_TRUE(counts.erase(op0));
+    EXPECT_FALSE(counts.erase(op0));
+    EXPECT_EQ(nullptr, counts.find(op0));
+    EXPECT_EQ(1, counts.size());
+}
+
+TEST(IdMapTest, OtherGraphs) {
+    Type type(Dtype::kFloat32, {});
+    Graph graph("test");
+    Value* value = graph.AddInputValue("value", type);
+    Graph other("other");
+    Value* other_value = other.AddInputValue("other_value", type);
+    Value standalone("standalone");
+    // Both `value` and `other_value` have ID 0.
+    ASSERT_EQ(value->id(), other_value->id());
+    EXPECT_EQ(-1, standalone.id());
+
+    IdSet<Value> values(graph.num_value_ids());
+    EXPECT_TRUE(values.emplace(other_value));
+    EXPECT_TRUE(values.emplace(value));
+    EXPECT_TRUE(values.emplace(&standalone));
+    EXPECT_EQ(3, values.size());
+    EXPECT_TRUE(values.count(value));
+    EXPECT_TRUE(values.count(other_value));
+    EXPECT_TRUE(values.count(&standalone));
+    EXPECT_TRUE(values.erase(other_value));
+    EXPECT_TRUE(values.count(value));
+    EXPECT_FALSE(values.count(other_value));
+    EXPECT_EQ(2, values.keys().size());
+}
+
+}  // namespace
+}  // namespace chainer_compiler
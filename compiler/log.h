@@ -7,6 +7,6 @@
 namespace chainer_compiler {
 
 #define CLOG() \
-    if (g_compiler_log) std::cerr
+    if (g_compiler_log()) std::cerr
 
 }  // namespace chainer_compiler
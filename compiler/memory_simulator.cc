@@ -1,62 +1,232 @@
 #include "compiler/memory_simulator.h"
 
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
 #include <map>
 #include <numeric>
+#include <set>
+
+#include <nlohmann/json.hpp>
 
 #include <common/log.h>
 #include <common/strutil.h>
 #include <compiler/graph.h>
 #include <compiler/log.h>
+#include <compiler/node.h>
+#include <compiler/value.h>
 
 namespace chainer_compiler {
 
+namespace {
+
+// Simulates an allocator which places each array at the best fitting
+// free block, to estimate the fragmentation of the memory pool.
+class Arena {
+public:
+    static constexpr int64_t kAlignment = 512;
+
+    int64_t Allocate(int64_t bytes) {
+        bytes = Align(bytes);
+        auto best = free_blocks_.end();
+        for (auto iter = free_blocks_.begin(); iter != free_blocks_.end(); ++iter) {
+            if (iter->second >= bytes && (best == free_blocks_.end() || iter->second < best->second)) {
+                best = iter;
+            }
+        }
+        if (best == free_blocks_.end()) {
+            const int64_t offset = end_;
+            end_ += bytes;
+            peak_ = std::max(peak_, end_);
+            return offset;
+        }
+        const int64_t offset = best->first;
+        const int64_t rest = best->second - bytes;
+        free_blocks_.erase(best);
+        if (rest) {
+            CHECK(free_blocks_.emplace(offset + bytes, rest).second);
+        }
+        return offset;
+    }
+
+    void Free(int64_t offset, int64_t bytes) {
+        bytes = Align(bytes);
+        auto next = free_blocks_.lower_bound(offset);
+        if (next != free_blocks_.end() && offset + bytes == next->first) {
+            bytes += next->second;
+            next = free_blocks_.erase(next);
+        }
+        if (next != free_blocks_.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset) {
+                offset = prev->first;
+                bytes += prev->second;
+                free_blocks_.erase(prev);
+            }
+        }
+        if (offset + bytes == end_) {
+            end_ = offset;
+        } else {
+            CHECK(free_blocks_.emplace(offset, bytes).second);
+        }
+    }
+
+    int64_t end() const {
+        return end_;
+    }
+
+    int64_t peak() const {
+        return peak_;
+    }
+
+private:
+    static int64_t Align(int64_t bytes) {
+        return (bytes + kAlignment - 1) / kAlignment * kAlignment;
+    }
+
+    // From offsets to sizes.
+    std::map<int64_t, int64_t> free_blocks_;
+    int64_t end_{0};
+    int64_t peak_{0};
+};
+
+struct ValueState {
+    int num_users{0};
+    // -1 for unknown sizes and retained contexts.
+    int64_t bytes{-1};
+    int64_t offset{-1};
+    int alloc_step{-1};
+    int free_step{std::numeric_limits<int>::max()};
+    std::vector<const Value*> retained;
+};
+
+}  // namespace
+
 SimulatedMemoryUsage SimulateMemoryUsage(const Graph& graph) {
-    std::map<const Value*, int> num_users;
+    std::map<const Value*, ValueState> states;
     SimulatedMemoryUsage usage{};
+    usage.peak_step = -1;
+    Arena arena;
     int64_t mem = 0;
+    int step = -1;
 
-    auto alloc = [&usage, &mem](const Value* value) {
-        const int64_t increase = value->GetNBytes();
+    auto alloc = [&usage, &states, &arena, &mem, &step](const Value* value) {
         usage.num_values++;
+        auto found = states.find(value);
+        CHECK(found != states.end()) << value->ToString();
+        ValueState* state = &found->second;
+        state->alloc_step = step;
+
+        std::vector<Value*> retained;
+        if (value->type().kind() == Type::Kind::kOpaque && value->GetRetainedValues(&retained)) {
+            // Arrays in a backward context are kept alive until the
+            // context is freed, without being counted twice.
+            for (const Value* r : retained) {
+                auto found = states.find(r);
+                if (found == states.end()) continue;
+                found->second.num_users++;
+                state->retained.push_back(r);
+            }
+            return;
+        }
+
+        const int64_t increase = value->GetNBytes();
         if (increase < 0) {
             CLOG() << "Unknown " << value->type().kind() << " shape: " << value->name()
                    << " producer=" << (value->producer() ? Node::OpTypeToString(value->producer()->op_type()) : "") << std::endl;
             usage.num_unknowns++;
             return;
         }
+        state->bytes = increase;
+        state->offset = arena.Allocate(increase);
         mem += increase;
         usage.all += increase;
-        usage.peak = std::max<int64_t>(usage.peak, mem);
     };
 
-    for (const Value* value : graph.GetNecessaryValues()) {
-        int nu = value->users().size();
-        if (value->IsInput()) {
+    std::function<void(const Value*)> release = [&states, &arena, &mem, &step, &release](const Value* value) {
+        auto found = states.find(value);
+        if (found == states.end()) return;
+        ValueState* state = &found->second;
+        if (--state->num_users != 0) return;
+        state->free_step = step;
+        if (state->bytes >= 0) {
+            arena.Free(state->offset, state->bytes);
+            mem -= state->bytes;
+        }
+        for (const Value* r : state->retained) {
+            release(r);
+        }
+    };
+
+    auto update_peak = [&usage, &mem, &arena, &step](int64_t transient) {
+        if (usage.peak < mem + transient) {
+            usage.peak = mem + transient;
+            usage.peak_step = step;
+        }
+        usage.arena_peak = std::max(usage.arena_peak, arena.peak());
+    };
+
+    const std::vector<Value*> values = graph.GetNecessaryValues().keys();
+    for (const Value* value : values) {
+        ValueState state;
+        state.num_users = value->users().size();
+        if (value->initializer()) {
+            // We assume parameters will never be freed.
+            state.num_users++;
+        }
+        CHECK(states.emplace(value, state).second);
+    }
+    for (const Value* value : graph.output_values()) {
+        states.emplace(value, ValueState());
+    }
+
+    for (const Value* value : values) {
+        if (!value->IsInput()) continue;
+        if (value->initializer()) {
             int64_t bytes = value->GetNBytes();
-            if (value->initializer()) {
-                usage.param += bytes >= 0 ? bytes : 0;
-                // We assume parameters will never be freed.
-                nu++;
-            }
-            alloc(value);
+            usage.param += bytes >= 0 ? bytes : 0;
         }
-        CHECK(num_users.emplace(value, nu).second);
+        alloc(value);
     }
+    update_peak(0);
 
     std::vector<const Node*> nodes(graph.GetComputationSequence());
     for (const Node* node : nodes) {
+        ++step;
         for (const Value* value : node->outputs()) {
             alloc(value);
         }
+
+        int64_t subgraph = 0;
+        for (const Graph* g : node->GetSubGraphs()) {
+            SimulatedMemoryUsage sub = SimulateMemoryUsage(*g);
+            subgraph = std::max(subgraph, sub.peak);
+            usage.num_values += sub.num_values;
+            usage.num_unknowns += sub.num_unknowns;
+        }
+        if (subgraph) {
+            arena.Free(arena.Allocate(subgraph), subgraph);
+        }
+        update_peak(subgraph);
+        usage.steps.push_back(SimulatedMemoryStep{node, mem + subgraph, subgraph, arena.end()});
+
         for (const Value* value : node->inputs()) {
-            auto found = num_users.find(value);
-            if (found == num_users.end()) continue;
-            if (--found->second == 0) {
-                mem -= value->GetNBytes();
-            }
+            release(value);
         }
     }
 
+    for (const auto& p : states) {
+        const ValueState& state = p.second;
+        if (state.bytes > 0 && state.alloc_step <= usage.peak_step && usage.peak_step <= state.free_step) {
+            usage.peak_values.push_back(p.first);
+        }
+    }
+    std::stable_sort(usage.peak_values.begin(), usage.peak_values.end(), [&states](const Value* a, const Value* b) {
+        return states[a].bytes > states[b].bytes;
+    });
+
     return usage;
 }
 
@@ -68,7 +238,68 @@ void ShowSimulatedMemoryUsage(const Graph& graph) {
     int64_t param_mb = usage.param / 1000 / 1000;
     int64_t peak_mb = usage.peak / 1000 / 1000;
     int64_t all_mb = usage.all / 1000 / 1000;
-    std::cerr << "Simulated memory usage: param=" << param_mb << "MB peak=" << peak_mb << "MB all=" << all_mb << "MB" << std::endl;
+    int64_t arena_mb = usage.arena_peak / 1000 / 1000;
+    std::cerr << "Simulated memory usage: param=" << param_mb << "MB peak=" << peak_mb << "MB all=" << all_mb << "MB arena=" << arena_mb
+              << "MB" << std::endl;
+    if (usage.arena_peak > 0) {
+        std::cerr << "Simulated fragmentation: " << 100.0 * (usage.arena_peak - usage.peak) / usage.arena_peak << "%" << std::endl;
+    }
+    if (usage.peak_step >= 0) {
+        std::cerr << "Simulated peak at: " << usage.steps[usage.peak_step].node->ToString() << std::endl;
+    }
+    const size_t kNumLargestValues = 10;
+    for (size_t i = 0; i < std::min(kNumLargestValues, usage.peak_values.size()); ++i) {
+        const Value* value = usage.peak_values[i];
+        std::cerr << " " << value->name() << " " << value->GetNBytes() / 1000 / 1000 << "MB" << std::endl;
+    }
+}
+
+void DumpMemoryTimeline(const Graph& graph, const std::string& filename) {
+    SimulatedMemoryUsage usage = SimulateMemoryUsage(graph);
+    nlohmann::json steps = nlohmann::json::array();
+    for (const SimulatedMemoryStep& step : usage.steps) {
+        steps.push_back({{"op", Node::OpTypeToString(step.node->op_type())},
+                         {"name", step.node->name()},
+                         {"live", step.live},
+                         {"subgraph", step.subgraph},
+                         {"arena", step.arena}});
+    }
+    nlohmann::json peak_values = nlohmann::json::array();
+    for (const Value* value : usage.peak_values) {
+        peak_values.push_back({{"name", value->name()}, {"bytes", value->GetNBytes()}});
+    }
+    nlohmann::json timeline = {{"param", usage.param},
+                               {"peak", usage.peak},
+                               {"all", usage.all},
+                               {"arena_peak", usage.arena_peak},
+                               {"peak_step", usage.peak_step},
+                               {"num_values", usage.num_values},
+                               {"num_unknowns", usage.num_unknowns},
+                               {"steps", steps},
+                               {"peak_values", peak_values}};
+
+    std::ofstream ofs(filename);
+    CHECK(ofs) << "Failed to open: " << filename;
+    ofs << timeline.dump(2) << std::endl;
+}
+
+void DumpMemoryTimelineChromeTrace(const Graph& graph, const std::string& filename) {
+    SimulatedMemoryUsage usage = SimulateMemoryUsage(graph);
+    nlohmann::json events = nlohmann::json::array();
+    for (size_t i = 0; i < usage.steps.size(); ++i) {
+        const SimulatedMemoryStep& step = usage.steps[i];
+        const std::string op = Node::OpTypeToString(step.node->op_type());
+        events.push_back({{"name", op}, {"ph", "X"}, {"ts", i}, {"dur", 1}, {"pid", 0}, {"tid", 0}, {"args", {{"name", step.node->name()}}}});
+        events.push_back({{"name", "memory"},
+                          {"ph", "C"},
+                          {"ts", i},
+                          {"pid", 0},
+                          {"args", {{"live", step.live}, {"subgraph", step.subgraph}, {"arena", step.arena}}}});
+    }
+
+    std::ofstream ofs(filename);
+    CHECK(ofs) << "Failed to open: " << filename;
+    ofs << nlohmann::json{{"traceEvents", events}}.dump() << std::endl;
 }
 
 }  // namespace chainer_compiler
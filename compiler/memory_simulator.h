@@ -2,9 +2,27 @@
 
 #include <stdint.h>
 
+#include <string>
+#include <vector>
+
 namespace chainer_compiler {
 
 class Graph;
+class Node;
+class Value;
+
+// A step of the simulation, i.e., a node in the computation sequence.
+struct SimulatedMemoryStep {
+    const Node* node;
+    // Live bytes while `node` runs, i.e., after its outputs are
+    // allocated and before its inputs are freed.
+    int64_t live;
+    // The peak of temporary bytes used by sub-graphs of `node` (e.g.,
+    // the body of Loop), which are also included in `live`.
+    int64_t subgraph;
+    // The size of the arena after `node` runs.
+    int64_t arena;
+};
 
 struct SimulatedMemoryUsage {
     int64_t param;
@@ -12,10 +30,30 @@ struct SimulatedMemoryUsage {
     int64_t all;
     int num_values;
     int num_unknowns;
+    // The size of an arena where values are placed by best fit. The
+    // difference from `peak` is the fragmentation.
+    int64_t arena_peak;
+    // The index of the step of `peak`, or -1 if the peak is before
+    // running any node.
+    int peak_step;
+    // Values alive at `peak`, the largest first.
+    std::vector<const Value*> peak_values;
+    std::vector<SimulatedMemoryStep> steps;
 };
 
+// Simulates the memory usage of the computation sequence of `graph`.
+// Sub-graphs are simulated recursively and their peaks are added to
+// the steps of their owner nodes. Arrays retained by backward
+// contexts are kept alive until the contexts are freed.
 SimulatedMemoryUsage SimulateMemoryUsage(const Graph& graph);
 
 void ShowSimulatedMemoryUsage(const Graph& graph);
 
+// Outputs the simulated steps and values alive at the peak in JSON.
+void DumpMemoryTimeline(const Graph& graph, const std::string& filename);
+
+// Outputs the simulated live bytes as counters of Chrome's trace event
+// format, with an event per node. Each step takes a microsecond.
+void DumpMemoryTimelineChromeTrace(const Graph& graph, const std::string& filename);
+
 }  // namespace chainer_compiler
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include <common/log.h>
+#include <compiler/graph.h>
+#include <compiler/memory_simulator.h>
+#include <compiler/node.h>
+#include <compiler/type.h>
+
+namespace chainer_compiler {
+namespace {
+
+Type FloatType(int64_t size) {
+    return Type(Dtype::kFloat32, {size});
+}
+
+void SetOrder(const std::vector<Node*>& nodes) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i]->set_chainer_order(i + 1);
+    }
+}
+
+TEST(MemorySimulatorTest, Fragmentation) {
+    Graph graph("test");
+    Value* in = graph.AddInputValue("in", FloatType(1));
+    Value* a = graph.AddValue("a", FloatType(1000));
+    Value* b = graph.AddOutputValue("b", FloatType(1000));
+    Value* a2 = graph.AddOutputValue("a2", FloatType(1));
+    Value* c = graph.AddOutputValue("c", FloatType(2000));
+    SetOrder({graph.AddNode(Node::kExpand, {in}, {a}),
+              graph.AddNode(Node::kExpand, {in}, {b}),
+              graph.AddNode(Node::kReduceSum, {a}, {a2}),
+              graph.AddNode(Node::kExpand, {in}, {c})});
+
+    SimulatedMemoryUsage usage = SimulateMemoryUsage(graph);
+    EXPECT_EQ(0, usage.num_unknowns);
+    EXPECT_EQ(12008, usage.peak);
+    EXPECT_EQ(3, usage.peak_step);
+    // `c` does not fit in the hole left by `a`.
+    EXPECT_EQ(512 + 4096 + 4096 + 512 + 8192, usage.arena_peak);
+
+    ASSERT_EQ(4UL, usage.steps.size());
+    EXPECT_EQ(4004, usage.steps[0].live);
+    EXPECT_EQ(8008, usage.steps[2].live);
+    EXPECT_EQ(12008, usage.steps[3].live);
+
+    ASSERT_EQ(4UL, usage.peak_values.size());
+    EXPECT_EQ(c, usage.peak_values[0]);
+    EXPECT_EQ(b, usage.peak_values[1]);
+}
+
+TEST(MemorySimulatorTest, RetainedValues) {
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", FloatType(1000));
+    Value* y = graph.AddValue("y", FloatType(250));
+    Value* ctx = graph.AddValue("ctx", Type(Type::Kind::kOpaque));
+    Value* z = graph.AddValue("z", FloatType(250));
+    Value* gx = graph.AddOutputValue("gx", FloatType(1000));
+    SetOrder({graph.AddNode(Node::kMaxPool, {x}, {y, ctx}),
+              graph.AddNode(Node::kRelu, {y}, {z}),
+              graph.AddNode(Node::kChainerMaxPoolGrad, {z, ctx}, {gx})});
+
+    // `x` and `y` kept by `ctx` are not counted twice.
+    SimulatedMemoryUsage usage = SimulateMemoryUsage(graph);
+    EXPECT_EQ(0, usage.num_unknowns);
+    EXPECT_EQ(10000, usage.peak);
+    EXPECT_EQ(2, usage.peak_step);
+    ASSERT_EQ(3UL, usage.steps.size());
+    EXPECT_EQ(5000, usage.steps[0].live);
+    EXPECT_EQ(6000, usage.steps[1].live);
+    EXPECT_EQ(4UL, usage.peak_values.size());
+}
+
+}  // namespace
+}  // namespace chainer_compiler
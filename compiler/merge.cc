@@ -9,6 +9,7 @@
 #include <compiler/graph_builder.h>
 #include <compiler/log.h>
 #include <compiler/node.h>
+#include <compiler/rewriter.h>
 #include <compiler/value.h>
 
 namespace chainer_compiler {
@@ -386,28 +387,14 @@ void MergeOperations(const std::set<std::string>& merger_names, Graph* graph, bo
         CHECK_EQ(1, all_merger_names.count(name)) << name << "not registerd";
     }
 
-    bool replaced = true;
-    while (replaced) {
-        replaced = false;
-        for (Node* node : graph->GetLiveNodes()) {
-            if (node->detached()) {
-                continue;
-            }
-
-            for (auto found = mergers.find(node->op_type()); found != mergers.end() && found->first == node->op_type(); ++found) {
-                const Merger& merger = found->second;
-                if (merger_names.count(merger.name) == 0) {
-                    continue;
-                }
-
-                const bool merge_happened = merger.fn(graph, node);
-                replaced |= merge_happened;
-                if (merge_happened) {
-                    break;
-                }
-            }
+    Rewriter rewriter("Merge");
+    for (const auto& p : mergers) {
+        const Merger& merger = p.second;
+        if (merger_names.count(merger.name)) {
+            rewriter.AddRule(p.first, merger.name, merger.fn);
         }
     }
+    rewriter.Run(graph);
 }
 
 }  // namespace chainer_compiler
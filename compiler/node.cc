@@ -7,6 +7,7 @@
 #include <common/strutil.h>
 #include <compiler/dtype.h>
 #include <compiler/graph.h>
+#include <compiler/object_pool.h>
 #include <compiler/serializer_util.h>
 #include <compiler/tensor.h>
 #include <compiler/value.h>
@@ -44,6 +45,16 @@ Node::Node(
 Node::~Node() {
 }
 
+void* Node::operator new(size_t size) {
+    if (size != sizeof(Node)) return ::operator new(size);
+    return ObjectPool<sizeof(Node)>::Allocate();
+}
+
+void Node::operator delete(void* p, size_t size) {
+    if (size != sizeof(Node)) return ::operator delete(p);
+    ObjectPool<sizeof(Node)>::Free(p);
+}
+
 void Node::ToONNX(onnx::NodeProto* xnode) const {
     for (const auto& value : inputs_) {
         xnode->add_input(value->name());
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <iosfwd>
 #include <string>
 #include <vector>
@@ -25,6 +26,10 @@ public:
     Node(const Node&) = delete;
     Node& operator=(const Node&) = delete;
 
+    // Nodes are allocated by `ObjectPool`.
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+
     void ToONNX(onnx::NodeProto* xnode) const;
     std::string DebugString() const;
 
@@ -45,6 +50,10 @@ public:
     const std::string& name() const {
         return name_;
     }
+    // A dense ID in the graph which owns this node, or -1.
+    int id() const {
+        return id_;
+    }
     const std::string& domain() const {
         return domain_;
     }
@@ -72,6 +81,8 @@ public:
     std::string ToString() const;
 
 private:
+    friend class Graph;
+
     std::vector<Value*> inputs_;
     std::vector<Value*> outputs_;
     std::string name_;
@@ -79,6 +90,7 @@ private:
     std::string doc_string_;
 
     bool detached_ = false;
+    int id_ = -1;
 };
 
 std::ostream& operator<<(std::ostream& os, Node::OpType op_type);
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+namespace chainer_compiler {
+
+// Allocates objects of `kSize` bytes from blocks of many objects, which
+// reduces the cost of `new` and improves the locality of nodes and
+// values of large graphs. Freed objects are kept in a free list shared
+// by all threads, so objects allocated by worker threads and freed by
+// another thread are reused by any thread. Each thread caches a bounded
+// number of free objects to avoid taking the lock for every object, and
+// returns them to the shared list when it exits. Blocks are never
+// returned to the system, so the memory kept by the pool is bounded by
+// the peak number of live objects plus the caches of threads.
+template <size_t kSize>
+class ObjectPool {
+public:
+    static void* Allocate() {
+        LocalList* local = GetLocalList();
+        if (!local->head) GetGlobalList()->Take(local);
+        Chunk* chunk = local->head;
+        local->head = chunk->next;
+        --local->size;
+        return chunk;
+    }
+
+    static void Free(void* p) {
+        Chunk* chunk = static_cast<Chunk*>(p);
+        LocalList* local = GetLocalList();
+        chunk->next = local->head;
+        local->head = chunk;
+        if (++local->size >= kNumChunksPerBatch * 2) GetGlobalList()->Give(local, kNumChunksPerBatch);
+    }
+
+private:
+    union Chunk {
+        Chunk* next;
+        alignas(std::max_align_t) char buf[kSize];
+    };
+
+    static constexpr size_t kNumChunksPerBlock = 256;
+    static constexpr size_t kNumChunksPerBatch = 64;
+
+    struct LocalList {
+        ~LocalList() {
+            GetGlobalList()->Give(this, size);
+        }
+
+        Chunk* head{nullptr};
+        size_t size{0};
+    };
+
+    class GlobalList {
+    public:
+        // Moves up to `kNumChunksPerBatch` chunks to `local`, which must
+        // be empty.
+        void Take(LocalList* local) {
+            std::lock_guard<std::mutex> lock(mu_);
+            if (!head_) Refill();
+            for (size_t i = 0; i < kNumChunksPerBatch && head_; ++i) {
+                Chunk* chunk = head_;
+                head_ = chunk->next;
+                chunk->next = local->head;
+                local->head = chunk;
+                ++local->size;
+            }
+        }
+
+        // Moves `n` chunks from `local`.
+        void Give(LocalList* local, size_t n) {
+            std::lock_guard<std::mutex> lock(mu_);
+            for (size_t i = 0; i < n; ++i) {
+                Chunk* chunk = local->head;
+                local->head = chunk->next;
+                --local->size;
+                chunk->next = head_;
+                head_ = chunk;
+            }
+        }
+
+    private:
+        void Refill() {
+            Chunk* block = static_cast<Chunk*>(::operator new(sizeof(Chunk) * kNumChunksPerBlock));
+            // Link backwards so objects are handed out in address order.
+            for (size_t i = kNumChunksPerBlock; i > 0; --i) {
+                block[i - 1].next = head_;
+                head_ = &block[i - 1];
+            }
+        }
+
+        std::mutex mu_;
+        Chunk* head_{nullptr};
+    };
+
+    static GlobalList* GetGlobalList() {
+        // Never destructed so threads which exit after static
+        // destruction can still return their chunks.
+        static GlobalList* list = new GlobalList();
+        return list;
+    }
+
+    static LocalList* GetLocalList() {
+        static thread_local LocalList list;
+        return &list;
+    }
+};
+
+}  // namespace chainer_compiler
@@ -0,0 +1,125 @@
+#include "compiler/optimizer_update.h"
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <chainerx/routines/creation.h>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/log.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+constexpr char kGradOutputPrefix[] = "grad_out@";
+
+Value* AddZeroParam(Graph* graph, const std::string& name, const Value* param) {
+    Value* value = graph->AddInputValue(name, param->type());
+    value->ResetInitializer(std::make_unique<Tensor>(name, chainerx::ZerosLike(param->initializer()->chx())));
+    return value;
+}
+
+}  // namespace
+
+bool ParseOptimizerType(const std::string& name, OptimizerType* type) {
+    static const std::map<std::string, OptimizerType> kTypes = {
+            {"sgd", OptimizerType::kSGD},
+            {"momentum", OptimizerType::kMomentumSGD},
+            {"nesterov", OptimizerType::kNesterov},
+            {"adam", OptimizerType::kAdam},
+            {"adamw", OptimizerType::kAdamW},
+    };
+    auto found = kTypes.find(name);
+    if (found == kTypes.end()) {
+        return false;
+    }
+    *type = found->second;
+    return true;
+}
+
+OptimizerConfig GetOptimizerConfigFromFlags() {
+    OptimizerConfig config;
+    CHECK(ParseOptimizerType(g_optimizer(), &config.type)) << "Unknown optimizer: " << g_optimizer();
+    if (g_optimizer_momentum() >= 0) config.momentum = g_optimizer_momentum();
+    if (g_optimizer_beta1() >= 0) config.beta1 = g_optimizer_beta1();
+    if (g_optimizer_beta2() >= 0) config.beta2 = g_optimizer_beta2();
+    if (g_optimizer_epsilon() >= 0) config.epsilon = g_optimizer_epsilon();
+    config.weight_decay = g_optimizer_weight_decay();
+    if (g_micro_batches()) config.num_micro_batches = g_micro_batches();
+    CHECK_LT(0, config.num_micro_batches);
+    return config;
+}
+
+Node* AddOptimizerUpdate(const OptimizerConfig& config, Graph* graph) {
+    std::map<std::string, Value*> inputs;
+    for (Value* value : graph->input_values()) {
+        CHECK(inputs.emplace(value->name(), value).second) << value->name();
+    }
+
+    std::vector<Value*> params, grads;
+    for (Value* value : graph->output_values()) {
+        if (!HasPrefix(value->name(), kGradOutputPrefix)) continue;
+        auto found = inputs.find(value->name().substr(strlen(kGradOutputPrefix)));
+        CHECK(found != inputs.end()) << "No parameter for " << value->name();
+        // The caller must update parameters which are fed every step.
+        if (!found->second->initializer()) continue;
+        params.push_back(found->second);
+        grads.push_back(value);
+    }
+    for (Value* grad : grads) {
+        graph->ResetKind(grad);
+    }
+
+    Value* lr = graph->AddInputValue(kOptimizerLearningRateName, Type(Dtype::kFloat32, {}));
+    std::vector<Value*> node_inputs = {lr};
+    const bool is_adam = config.type == OptimizerType::kAdam || config.type == OptimizerType::kAdamW;
+    if (is_adam) {
+        node_inputs.push_back(graph->AddInputValue(kOptimizerStepName, Type(Dtype::kInt64, {})));
+    }
+    const bool accumulates = config.num_micro_batches > 1;
+    if (accumulates) {
+        node_inputs.push_back(graph->AddInputValue(kOptimizerMicroBatchName, Type(Dtype::kInt64, {})));
+    }
+    node_inputs.insert(node_inputs.end(), params.begin(), params.end());
+    node_inputs.insert(node_inputs.end(), grads.begin(), grads.end());
+
+    std::vector<std::string> state_names;
+    if (is_adam) {
+        state_names = {"optimizer_m@", "optimizer_v@"};
+    } else if (config.type != OptimizerType::kSGD) {
+        state_names = {"optimizer_m@"};
+    }
+    if (accumulates) {
+        state_names.push_back("grad_acc@");
+    }
+    for (const std::string& prefix : state_names) {
+        for (Value* param : params) {
+            node_inputs.push_back(AddZeroParam(graph, prefix + param->name(), param));
+        }
+    }
+
+    Node* node = nullptr;
+    if (is_adam) {
+        node = graph->AddNode(Node::kChainerAdamUpdate, node_inputs, {});
+        node->set_beta1(config.beta1)->set_beta2(config.beta2)->set_epsilon(config.epsilon)->set_weight_decay(config.weight_decay);
+        node->set_decoupled_weight_decay(config.type == OptimizerType::kAdamW)->set_num_micro_batches(config.num_micro_batches);
+    } else {
+        node = graph->AddNode(Node::kChainerSGDUpdate, node_inputs, {});
+        node->set_momentum(config.type == OptimizerType::kSGD ? 0.0f : config.momentum)->set_weight_decay(config.weight_decay);
+        node->set_nesterov(config.type == OptimizerType::kNesterov)->set_num_micro_batches(config.num_micro_batches);
+    }
+    CLOG() << "Optimizer updates " << params.size() << " parameters" << std::endl;
+    return node;
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+namespace chainer_compiler {
+
+class Graph;
+class Node;
+
+// Inputs added by `AddOptimizerUpdate`. The learning rate is a float32
+// scalar and the step is an int64 scalar which counts updates including
+// the current one. The micro-batch is an int64 scalar in
+// [0, num_micro_batches) and parameters are updated when it is the last.
+constexpr char kOptimizerLearningRateName[] = "optimizer@lr";
+constexpr char kOptimizerStepName[] = "optimizer@step";
+constexpr char kOptimizerMicroBatchName[] = "optimizer@micro_batch";
+
+enum class OptimizerType {
+    kSGD,
+    kMomentumSGD,
+    kNesterov,
+    kAdam,
+    // Adam with the decoupled weight decay.
+    kAdamW,
+};
+
+bool ParseOptimizerType(const std::string& name, OptimizerType* type);
+
+struct OptimizerConfig {
+    OptimizerType type{OptimizerType::kSGD};
+    float momentum{0.9f};
+    float beta1{0.9f};
+    float beta2{0.999f};
+    float epsilon{1e-8f};
+    float weight_decay{0.0f};
+    // Gradients of this number of runs are accumulated in place and
+    // their mean updates parameters once.
+    int num_micro_batches{1};
+};
+
+// Makes a config from --optimizer, --optimizer_*, and --micro_batches.
+OptimizerConfig GetOptimizerConfigFromFlags();
+
+// Appends a node which updates parameters with initializers in place
+// by their `grad_out@` outputs, which are no longer outputs of `graph`.
+// Optimizer states are added as parameters initialized by zeros. The
+// returned node must run after all other nodes.
+Node* AddOptimizerUpdate(const OptimizerConfig& config, Graph* graph);
+
+}  // namespace chainer_compiler
@@ -0,0 +1,131 @@
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <chainerx/testing/context_session.h>
+
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/optimizer_update.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+// Makes a graph which has a parameter `w` with an initializer and an
+// input `x`, and their gradients as outputs.
+void MakeGraph(Graph* graph) {
+    Value* w = graph->AddInputValue("w", Type(Dtype::kFloat32, {2}));
+    w->ResetInitializer(std::make_unique<Tensor>("w", Dtype::kFloat32, std::vector<int64_t>{2}, std::vector<float>{1, 2}));
+    Value* x = graph->AddInputValue("x", Type(Dtype::kFloat32, {2}));
+    Value* loss = graph->AddOutputValue("loss", Type(Dtype::kFloat32, {2}));
+    Value* gw = graph->AddOutputValue("grad_out@w", Type(Dtype::kFloat32, {2}));
+    Value* gx = graph->AddOutputValue("grad_out@x", Type(Dtype::kFloat32, {2}));
+    graph->AddNode(Node::kMul, {w, x}, {loss});
+    graph->AddNode(Node::kIdentity, {x}, {gw});
+    graph->AddNode(Node::kIdentity, {w}, {gx});
+}
+
+TEST(OptimizerUpdateTest, MomentumSGD) {
+    chainerx::testing::ContextSession sess;
+    Graph graph("test");
+    MakeGraph(&graph);
+
+    OptimizerConfig config;
+    config.type = OptimizerType::kMomentumSGD;
+    config.weight_decay = 1e-4;
+    Node* node = AddOptimizerUpdate(config, &graph);
+    ASSERT_EQ(Node::kChainerSGDUpdate, node->op_type());
+    EXPECT_FLOAT_EQ(0.9, node->momentum());
+    EXPECT_FLOAT_EQ(1e-4, node->weight_decay());
+    EXPECT_EQ(0, node->nesterov());
+    EXPECT_TRUE(node->outputs().empty());
+
+    // `x` has no initializer so its gradient is still an output.
+    ASSERT_EQ(2UL, graph.output_values().size());
+    EXPECT_EQ("loss", graph.output_values()[0]->name());
+    EXPECT_EQ("grad_out@x", graph.output_values()[1]->name());
+
+    ASSERT_EQ(4UL, node->inputs().size());
+    EXPECT_EQ(kOptimizerLearningRateName, node->input(0)->name());
+    EXPECT_EQ("w", node->input(1)->name());
+    EXPECT_EQ("grad_out@w", node->input(2)->name());
+    EXPECT_TRUE(node->input(2)->IsTemp());
+    Value* mom = node->input(3);
+    EXPECT_EQ("optimizer_m@w", mom->name());
+    EXPECT_TRUE(mom->IsInput());
+    ASSERT_TRUE(mom->initializer());
+    EXPECT_EQ(std::vector<int64_t>({2}), mom->initializer()->dims());
+    EXPECT_EQ(0.0f, mom->initializer()->Get<float>(1));
+}
+
+TEST(OptimizerUpdateTest, AdamW) {
+    chainerx::testing::ContextSession sess;
+    Graph graph("test");
+    MakeGraph(&graph);
+
+    OptimizerConfig config;
+    config.type = OptimizerType::kAdamW;
+    config.weight_decay = 0.01;
+    Node* node = AddOptimizerUpdate(config, &graph);
+    ASSERT_EQ(Node::kChainerAdamUpdate, node->op_type());
+    EXPECT_EQ(1, node->decoupled_weight_decay());
+    ASSERT_EQ(6UL, node->inputs().size());
+    EXPECT_EQ(kOptimizerLearningRateName, node->input(0)->name());
+    EXPECT_EQ(kOptimizerStepName, node->input(1)->name());
+    EXPECT_EQ("optimizer_m@w", node->input(4)->name());
+    EXPECT_EQ("optimizer_v@w", node->input(5)->name());
+}
+
+TEST(OptimizerUpdateTest, MicroBatches) {
+    chainerx::testing::ContextSession sess;
+    Graph graph("test");
+    MakeGraph(&graph);
+
+    OptimizerConfig config;
+    config.type = OptimizerType::kSGD;
+    config.num_micro_batches = 4;
+    Node* node = AddOptimizerUpdate(config, &graph);
+    EXPECT_EQ(4, node->num_micro_batches());
+    ASSERT_EQ(5UL, node->inputs().size());
+    EXPECT_EQ(kOptimizerLearningRateName, node->input(0)->name());
+    EXPECT_EQ(kOptimizerMicroBatchName, node->input(1)->name());
+    EXPECT_TRUE(node->input(1)->IsInput());
+    EXPECT_EQ("w", node->input(2)->name());
+    EXPECT_EQ("grad_out@w", node->input(3)->name());
+    Value* acc = node->input(4);
+    EXPECT_EQ("grad_acc@w", acc->name());
+    ASSERT_TRUE(acc->initializer());
+    EXPECT_EQ(std::vector<int64_t>({2}), acc->initializer()->dims());
+}
+
+TEST(OptimizerUpdateTest, ParseOptimizerType) {
+    OptimizerType type;
+    EXPECT_TRUE(ParseOptimizerType("nesterov", &type));
+    EXPECT_EQ(OptimizerType::kNesterov, type);
+    EXPECT_FALSE(ParseOptimizerType("rmsprop", &type));
+}
+
+TEST(OptimizerUpdateTest, ConfigFromFlags) {
+    CompilerContext context;
+    context.optimizer = "adam";
+    CompilerContextScope scope(&context);
+
+    OptimizerConfig config = GetOptimizerConfigFromFlags();
+    EXPECT_EQ(OptimizerType::kAdam, config.type);
+    EXPECT_FLOAT_EQ(0.9, config.beta1);
+    EXPECT_FLOAT_EQ(0.999, config.beta2);
+
+    // Zero is a valid value, unlike negative ones.
+    context.optimizer_beta1 = 0;
+    config = GetOptimizerConfigFromFlags();
+    EXPECT_FLOAT_EQ(0, config.beta1);
+    EXPECT_FLOAT_EQ(0.999, config.beta2);
+}
+
+}  // namespace
+}  // namespace chainer_compiler
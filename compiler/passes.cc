@@ -5,6 +5,7 @@
 #include <map>
 #include <memory>
 
+#include <compiler/calibration.h>
 #include <compiler/computation_order/core.h>
 #include <compiler/constant_propagation.h>
 #include <compiler/dtype_inference.h>
@@ -17,11 +18,14 @@
 #include <compiler/memory_simulator.h>
 #include <compiler/merge.h>
 #include <compiler/model.h>
+#include <compiler/optimizer_update.h>
 #include <compiler/quantize.h>
 #include <compiler/scheduler.h>
+#include <compiler/sequence_batching.h>
 #include <compiler/shape_evaluator.h>
 #include <compiler/simplifier.h>
 #include <compiler/subgraph_canonicalizer.h>
+#include <compiler/thread_pool.h>
 #include <configs/backend_config.h>
 
 namespace chainer_compiler {
@@ -44,26 +48,54 @@ void Recursively(const std::function<void(Graph*)>& fn, Graph* graph) {
     }
 }
 
-void Recursively(const BackendConfig& bc, Graph* graph, const std::function<void(const BackendConfig&, Graph*)>& fn) {
+// Runs `fn` for `graph` and then for its subgraphs. Subgraphs of a
+// graph are processed in parallel, so `fn` must not touch graphs other
+// than the given one. State shared by the passes run by this is safe to
+// use from threads: the constant cache of `PropagateConstants` is
+// guarded by a mutex, `ObjectPool` keeps its shared free list under a
+// lock, schemas and op tables are only read after their thread-safe
+// static initialization, and `CLOG` writes to `std::cerr`, whose lines
+// may interleave but do not race.
+void RecursivelyInParallel(const std::function<void(Graph*)>& fn, Graph* graph) {
+    fn(graph);
+    std::vector<Graph*> subgraphs;
+    for (const Node* node : graph->nodes()) {
+        for (Graph* subgraph : node->GetSubGraphs()) {
+            subgraphs.push_back(subgraph);
+        }
+    }
+    ParallelFor(subgraphs.size(), [&fn, &subgraphs](int64_t i) { RecursivelyInParallel(fn, subgraphs[i]); });
+}
+
+void RecursivelyInParallel(const BackendConfig& bc, Graph* graph, const std::function<void(const BackendConfig&, Graph*)>& fn) {
     fn(bc, graph);
 
+    std::vector<std::pair<const BackendConfig*, Graph*>> subgraphs;
+    std::vector<std::unique_ptr<BackendConfig>> backend_configs;
     for (const Node* node : graph->nodes()) {
-        const std::vector<Graph*>& subgraphs = node->GetSubGraphs();
-        if (subgraphs.empty()) {
+        const std::vector<Graph*>& node_subgraphs = node->GetSubGraphs();
+        if (node_subgraphs.empty()) {
             continue;
         }
 
+        const BackendConfig* subgraph_bc = &bc;
         if (node->op_type() == Node::kChainerFusionGroup) {
-            std::unique_ptr<BackendConfig> backend_config(BackendConfig::FromName(node->fusion_type()));
-            for (Graph* subgraph : node->GetSubGraphs()) {
-                Recursively(*backend_config, subgraph, fn);
-            }
-        } else {
-            for (Graph* subgraph : node->GetSubGraphs()) {
-                Recursively(bc, subgraph, fn);
-            }
+            backend_configs.emplace_back(BackendConfig::FromName(node->fusion_type()));
+            subgraph_bc = backend_configs.back().get();
+        }
+        for (Graph* subgraph : node_subgraphs) {
+            subgraphs.emplace_back(subgraph_bc, subgraph);
         }
     }
+    ParallelFor(subgraphs.size(), [&fn, &subgraphs](int64_t i) {
+        RecursivelyInParallel(*subgraphs[i].first, subgraphs[i].second, fn);
+    });
+}
+
+// Runs `PropagateConstants` for `graph` and its subgraphs. Only the
+// top-level graph is treated as a main graph.
+void PropagateConstantsRecursively(Graph* graph) {
+    RecursivelyInParallel([graph](Graph* g) { PropagateConstants(g, g != graph /* in_subgraph */); }, graph);
 }
 
 void CheckAllOpsSupported(const BackendConfig& backend_config, Graph* graph) {
@@ -76,24 +108,25 @@ void CheckAllOpsSupported(const BackendConfig& backend_config, Graph* graph) {
 
 }  //  namespace
 
-void RunDefaultPasses(Model* model, bool gen_backprop) {
-    RunDefaultPasses(model->mutable_graph(), gen_backprop);
+void RunDefaultPasses(Model* model, bool gen_backprop, CompilerContext* context) {
+    RunDefaultPasses(model->mutable_graph(), gen_backprop, false /* skip_scheduling */, context);
 }
 
-void RunDefaultPasses(Graph* graph, bool gen_backprop, bool skip_scheduling) {
-    std::unique_ptr<BackendConfig> backend_config(BackendConfig::FromName(g_backend_name));
+void RunDefaultPasses(Graph* graph, bool gen_backprop, bool skip_scheduling, CompilerContext* context) {
+    CompilerContextScope context_scope(context ? context : GetCompilerContext());
+    std::unique_ptr<BackendConfig> backend_config(BackendConfig::FromName(g_backend_name()));
 
-    if (g_reset_output_shape) {
+    if (g_reset_output_shape()) {
         for (Value* value : graph->output_values()) {
             value->set_type(new Type());
         }
     }
-    if (g_reset_shape) {
+    if (g_reset_shape()) {
         for (const std::unique_ptr<Value>& value : graph->all_values()) {
             value->set_type(new Type());
         }
     }
-    if (!g_skip_inference) {
+    if (!g_skip_inference()) {
         graph->InferShapes();
         InferAllDtype(graph);
     }
@@ -104,50 +137,64 @@ void RunDefaultPasses(Graph* graph, bool gen_backprop, bool skip_scheduling) {
             std::cerr << graph->DebugString();
             std::cerr << "=== ^^^ " << msg << " ^^^ ===\n";
         }
-        Recursively([msg](Graph* g) { g->CheckSanity(msg); }, graph);
+        RecursivelyInParallel([msg](Graph* g) { g->CheckSanity(msg); }, graph);
     };
 
-    dump_onnx(g_dump_after_inference, "after inference");
+    dump_onnx(g_dump_after_inference(), "after inference");
 
     if (!skip_scheduling) {
         CanonicalizeSubGraphs(graph);
 
-        Recursively(*backend_config, graph, [gen_backprop](const BackendConfig& bc, Graph* graph) {
+        RecursivelyInParallel(*backend_config, graph, [gen_backprop](const BackendConfig& bc, Graph* graph) {
             Simplify(bc, bc.GetSimplifyPreproc(), graph, gen_backprop);
         });
 
         CanonicalizeSubGraphs(graph);
 
-        if (g_quantize) {
+        if (g_calibrate_quantization()) {
+            // Only activations of the main graph are calibrated.
+            AddCalibrationOutputs(graph);
+        } else if (g_quantize()) {
+            QuantizationOptions q_opts;
+            q_opts.per_channel = !g_disable_per_channel_quantize();
+            if (!g_quantization_calibration().empty()) {
+                q_opts.mode = QuantizationMode::QLinearOps;
+                q_opts.is_static = true;
+                ReadCalibrationTable(g_quantization_calibration(), &q_opts);
+            }
+            RecursivelyInParallel([q_opts](Graph* graph) { Quantize(q_opts, graph); }, graph);
+        } else if (g_weight_only_quantize()) {
             QuantizationOptions q_opts;
-            q_opts.per_channel = !g_disable_per_channel_quantize;
-            Recursively([q_opts](Graph* graph) { Quantize(q_opts, graph); }, graph);
+            q_opts.mode = QuantizationMode::WeightOnly;
+            q_opts.nbits = g_weight_only_quantize();
+            q_opts.group_size = g_weight_only_quantize_group_size();
+            RecursivelyInParallel([q_opts](Graph* graph) { Quantize(q_opts, graph); }, graph);
         }
 
-        Recursively(
+        RecursivelyInParallel(
                 [gen_backprop, &backend_config](Graph* graph) { MergeOperations(backend_config->GetMerge(), graph, gen_backprop); }, graph);
 
-        Recursively(PropagateConstants, graph);
+        PropagateConstantsRecursively(graph);
 
-        Recursively(EvaluateShapes, graph);
+        RecursivelyInParallel(EvaluateShapes, graph);
 
-        Recursively([](Graph* g) { g->DeleteDetached(); }, graph);
+        RecursivelyInParallel([](Graph* g) { g->DeleteDetached(); }, graph);
 
-        dump_onnx(g_dump_after_simplification, "after simplification");
+        dump_onnx(g_dump_after_simplification(), "after simplification");
     }
 
     if (gen_backprop) {
-        Recursively(*backend_config, graph, [gen_backprop](const BackendConfig& bc, Graph* graph) {
+        RecursivelyInParallel(*backend_config, graph, [gen_backprop](const BackendConfig& bc, Graph* graph) {
             Simplify(bc, bc.GetSimplify(), graph, gen_backprop);
         });
 
-        if (g_computation_order.empty()) {
+        if (g_computation_order().empty()) {
             // normal computation order
             AddGradientNodesForTraining(graph);
         } else {
             // specified computation order
             skip_scheduling = true;
-            auto orders = GetComputationOrder(*graph, g_computation_order);
+            auto orders = GetComputationOrder(*graph, g_computation_order());
             if (!AddGradientNodesForTrainingWithOrders(graph, orders)) {
                 CHECK(false) << "Computation order is not supported in this graph.";
             }
@@ -155,62 +202,86 @@ void RunDefaultPasses(Graph* graph, bool gen_backprop, bool skip_scheduling) {
     }
 
     // TODO(hamaji): Make it possible to infer shapes here.
-    // if (!g_skip_inference) graph->InferShapes();
+    // if (!g_skip_inference()) graph->InferShapes();
 
     if (!skip_scheduling) {
-        Recursively(*backend_config, graph, [gen_backprop](const BackendConfig& bc, Graph* graph) {
+        RecursivelyInParallel(*backend_config, graph, [gen_backprop](const BackendConfig& bc, Graph* graph) {
             Simplify(bc, bc.GetSimplifyPreproc(), graph, gen_backprop);
         });
 
-        Recursively(PropagateConstants, graph);
+        PropagateConstantsRecursively(graph);
+
+        // These update both loops and their enclosing graphs so they
+        // run sequentially.
+        HoistLoopInvariants(graph);
+        BatchSequenceLoops(graph);
 
-        Recursively([](Graph* g) { g->DeleteDetached(); }, graph);
+        RecursivelyInParallel([](Graph* g) { g->DeleteDetached(); }, graph);
     }
 
-    dump_onnx(g_dump_after_gradient, "after gradient generation");
+    dump_onnx(g_dump_after_gradient(), "after gradient generation");
 
-    if (g_dump_subgraphs) {
+    if (g_dump_subgraphs()) {
         graph->DumpSubGraphs();
     }
 
     if (!skip_scheduling) {
         FuseOperations(graph);
-        dump_onnx(g_dump_after_fusion, "after fusion");
+        dump_onnx(g_dump_after_fusion(), "after fusion");
     }
 
     if (!skip_scheduling) {
-        Recursively(*backend_config, graph, [gen_backprop](const BackendConfig& bc, Graph* graph) {
+        RecursivelyInParallel(*backend_config, graph, [gen_backprop](const BackendConfig& bc, Graph* graph) {
             Simplify(bc, bc.GetSimplify(), graph, gen_backprop);
         });
 
-        Recursively(PropagateConstants, graph);
+        PropagateConstantsRecursively(graph);
 
-        Recursively([](Graph* g) { g->DeleteDetached(); }, graph);
+        RecursivelyInParallel([](Graph* g) { g->DeleteDetached(); }, graph);
     }
 
+    Node* optimizer_update = nullptr;
+    if (gen_backprop && !g_optimizer().empty()) {
+        optimizer_update = AddOptimizerUpdate(GetOptimizerConfigFromFlags(), graph);
+    }
+
+    SchedulerType scheduler_type = SchedulerType::kGreedy;
+    if (!g_scheduler().empty()) {
+        CHECK(ParseSchedulerType(g_scheduler(), &scheduler_type)) << "Unknown scheduler: " << g_scheduler();
+    }
     int64_t order = 0;
-    Recursively([&order](Graph* g) { order = ScheduleComputation(*g, order); }, graph);
+    Recursively([&order, scheduler_type](Graph* g) { order = ScheduleComputation(*g, order, scheduler_type); }, graph);
+    if (optimizer_update) {
+        // Parameters are updated in place so nothing can read them later.
+        optimizer_update->set_chainer_order(order++);
+    }
 
-    if (g_compiler_log) {
+    if (g_compiler_log()) {
         ShowSimulatedMemoryUsage(*graph);
         ShowFlops(*graph);
     }
+    if (!g_dump_memory_timeline().empty()) {
+        DumpMemoryTimeline(*graph, g_dump_memory_timeline());
+    }
+    if (!g_dump_memory_timeline_chrome_trace().empty()) {
+        DumpMemoryTimelineChromeTrace(*graph, g_dump_memory_timeline_chrome_trace());
+    }
 
-    Recursively(CollectGarbageNode, graph);
+    RecursivelyInParallel(CollectGarbageNode, graph);
 
-    dump_onnx(g_dump_after_scheduling, "after scheduling");
+    dump_onnx(g_dump_after_scheduling(), "after scheduling");
 
-    Recursively(*backend_config, graph, CheckAllOpsSupported);
+    RecursivelyInParallel(*backend_config, graph, CheckAllOpsSupported);
 }
 
 void RunDefaultPassesBeforeGradient(Graph* graph) {
-    std::unique_ptr<BackendConfig> backend_config(BackendConfig::FromName(g_backend_name));
+    std::unique_ptr<BackendConfig> backend_config(BackendConfig::FromName(g_backend_name()));
     graph->InferShapes();
     CanonicalizeSubGraphs(graph);
-    Recursively(*backend_config, graph, [](const BackendConfig& bc, Graph* graph) { Simplify(bc, bc.GetSimplify(), graph, true); });
-    Recursively(PropagateConstants, graph);
-    Recursively([](Graph* g) { g->DeleteDetached(); }, graph);
-    Recursively(*backend_config, graph, CheckAllOpsSupported);
+    RecursivelyInParallel(*backend_config, graph, [](const BackendConfig& bc, Graph* graph) { Simplify(bc, bc.GetSimplify(), graph, true); });
+    PropagateConstantsRecursively(graph);
+    RecursivelyInParallel([](Graph* g) { g->DeleteDetached(); }, graph);
+    RecursivelyInParallel(*backend_config, graph, CheckAllOpsSupported);
 }
 
 }  // namespace chainer_compiler
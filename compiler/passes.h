@@ -4,13 +4,17 @@
 
 namespace chainer_compiler {
 
+struct CompilerContext;
 class Graph;
 class Model;
 class Node;
 
-void RunDefaultPasses(Model* model, bool gen_backprop = false);
+// Compiles `model` with the options in `context`, or the current ones
+// if it is null. Models can be compiled concurrently with different
+// contexts.
+void RunDefaultPasses(Model* model, bool gen_backprop = false, CompilerContext* context = nullptr);
 
-void RunDefaultPasses(Graph* graph, bool gen_backprop = false, bool skip_scheduling = false);
+void RunDefaultPasses(Graph* graph, bool gen_backprop = false, bool skip_scheduling = false, CompilerContext* context = nullptr);
 
 void RunLoopBodyPasses(Node* loop, const std::vector<Node*>& refs);
 
@@ -0,0 +1,159 @@
+#include "compiler/pipeline.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <set>
+
+#include <compiler/onnx.h>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <compiler/chxvm/emitter.h>
+#include <compiler/flops.h>
+#include <compiler/graph.h>
+#include <compiler/log.h>
+#include <compiler/node.h>
+#include <compiler/value.h>
+#include <runtime/chxvm.pb.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+// A boundary may be placed where the flops before it differ from its
+// share by up to this fraction of a stage.
+constexpr int64_t kBalanceSlackPercent = 10;
+
+}  // namespace
+
+std::vector<PipelineStage> PartitionPipeline(const Graph& graph, int num_stages) {
+    const std::vector<const Node*> nodes = graph.GetComputationSequence();
+    const int n = nodes.size();
+    if (n == 0) return {};
+    num_stages = std::max(1, std::min(num_stages, n));
+
+    std::map<const Node*, int> node_index;
+    // The flops of nodes before each index. Nodes are counted instead
+    // when no flops are known.
+    std::vector<int64_t> prefix(n + 1);
+    for (int i = 0; i < n; ++i) {
+        node_index.emplace(nodes[i], i);
+        prefix[i + 1] = prefix[i] + std::max<int64_t>(0, CalculateFlops(*nodes[i]));
+    }
+    if (prefix[n] == 0) {
+        for (int i = 0; i <= n; ++i) prefix[i] = i;
+    }
+
+    // The index of the producer and the last user of each value. Graph
+    // inputs are produced at -1 and graph outputs are used at `n`.
+    const std::set<Value*> output_set(graph.output_values().begin(), graph.output_values().end());
+    std::map<const Value*, std::pair<int, int>> ranges;
+    for (const std::unique_ptr<Value>& value : graph.all_values()) {
+        if (value->IsNull()) continue;
+        int def = -1;
+        if (const Node* producer = value->producer()) {
+            auto found = node_index.find(producer);
+            if (found == node_index.end()) continue;
+            def = found->second;
+        } else if (!value->IsInput()) {
+            continue;
+        }
+        int last = def;
+        for (const Node* user : value->users()) {
+            auto found = node_index.find(user);
+            if (found != node_index.end()) last = std::max(last, found->second);
+        }
+        if (output_set.count(value.get())) last = n;
+        ranges.emplace(value.get(), std::make_pair(def, last));
+    }
+
+    // Bytes of values which cross the boundary before each node.
+    // Parameters are shared by all stages and not counted.
+    std::vector<int64_t> cut(n + 2);
+    for (const auto& p : ranges) {
+        if (p.first->initializer()) continue;
+        const int64_t nbytes = std::max<int64_t>(1, p.first->GetNBytes());
+        cut[p.second.first + 1] += nbytes;
+        cut[p.second.second + 1] -= nbytes;
+    }
+    for (int i = 1; i <= n; ++i) cut[i] += cut[i - 1];
+
+    std::vector<int> bounds = {0};
+    const int64_t total = prefix[n];
+    const int64_t slack = total / num_stages * kBalanceSlackPercent / 100;
+    for (int k = 1; k < num_stages; ++k) {
+        const int64_t target = total * k / num_stages;
+        // Leave at least a node for each remaining stage.
+        const int lo = bounds.back() + 1;
+        const int hi = n - (num_stages - k);
+        int best = -1;
+        int nearest = lo;
+        for (int b = lo; b <= hi; ++b) {
+            const int64_t diff = std::abs(prefix[b] - target);
+            if (diff < std::abs(prefix[nearest] - target)) nearest = b;
+            if (diff > slack) continue;
+            if (best < 0 || cut[b] < cut[best] || (cut[b] == cut[best] && diff < std::abs(prefix[best] - target))) {
+                best = b;
+            }
+        }
+        bounds.push_back(best < 0 ? nearest : best);
+    }
+    bounds.push_back(n);
+
+    std::vector<PipelineStage> stages(num_stages);
+    for (int s = 0; s < num_stages; ++s) {
+        PipelineStage& stage = stages[s];
+        const int begin = bounds[s];
+        const int end = bounds[s + 1];
+        stage.flops = prefix[end] - prefix[begin];
+        std::set<Value*> seen;
+        for (int i = begin; i < end; ++i) {
+            const Node* node = nodes[i];
+            stage.nodes.push_back(node);
+            for (Value* value : node->inputs()) {
+                auto found = ranges.find(value);
+                if (found == ranges.end() || found->second.first >= begin) continue;
+                if (seen.insert(value).second) stage.inputs.push_back(value);
+            }
+            for (Value* value : node->outputs()) {
+                auto found = ranges.find(value);
+                if (found != ranges.end() && found->second.second >= end) stage.outputs.push_back(value);
+            }
+        }
+        CLOG() << "Pipeline stage #" << s << ": " << stage.nodes.size() << " nodes " << stage.flops << " flops "
+               << stage.inputs.size() << " inputs " << cut[end] << " bytes to the next stage" << std::endl;
+    }
+    return stages;
+}
+
+std::vector<runtime::ChxVMProgramProto> EmitPipeline(const Graph& graph, int num_stages) {
+    const std::vector<PipelineStage> stages = PartitionPipeline(graph, num_stages);
+    std::vector<runtime::ChxVMProgramProto> programs(stages.size());
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const PipelineStage& stage = stages[i];
+        onnx::GraphProto xgraph;
+        xgraph.set_name(StrCat(graph.name(), "_stage", i));
+        // Parameters are fed by the caller so initializers are omitted.
+        for (const Value* value : stage.inputs) {
+            value->ToONNX(xgraph.add_input());
+        }
+        const std::set<Value*> outputs(stage.outputs.begin(), stage.outputs.end());
+        for (const Value* value : stage.outputs) {
+            value->ToONNX(xgraph.add_output());
+        }
+        for (const Node* node : stage.nodes) {
+            for (Value* value : node->outputs()) {
+                if (!value->IsNull() && !outputs.count(value)) value->ToONNX(xgraph.add_value_info());
+            }
+            node->ToONNX(xgraph.add_node());
+        }
+
+        // Nodes keep their `chainer_order` so the stage is scheduled.
+        Graph stage_graph(xgraph);
+        chxvm::Emit(stage_graph, &programs[i]);
+    }
+    return programs;
+}
+
+}  // namespace chainer_compiler
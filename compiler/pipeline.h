@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace chainer_compiler {
+
+namespace runtime {
+class ChxVMProgramProto;
+}
+
+class Graph;
+class Node;
+class Value;
+
+// A contiguous part of the computation sequence of a graph, run by a
+// thread of a pipeline.
+struct PipelineStage {
+    std::vector<const Node*> nodes;
+    // Values used in this stage but computed by earlier stages or fed
+    // by the caller.
+    std::vector<Value*> inputs;
+    // Values computed in this stage which are used by later stages or
+    // are outputs of the graph.
+    std::vector<Value*> outputs;
+    int64_t flops{0};
+};
+
+// Splits the computation sequence of a scheduled `graph` into at most
+// `num_stages` stages. Each boundary is placed where the flops before
+// it are close to its share of the total, and among such places, where
+// the fewest bytes of values cross it.
+std::vector<PipelineStage> PartitionPipeline(const Graph& graph, int num_stages);
+
+// Emits a ChxVM program for each stage of `PartitionPipeline`. Each
+// program takes its inputs and returns its outputs by their names.
+std::vector<runtime::ChxVMProgramProto> EmitPipeline(const Graph& graph, int num_stages);
+
+}  // namespace chainer_compiler
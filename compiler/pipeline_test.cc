@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <chainerx/array.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/testing/context_session.h>
+
+#include <common/log.h>
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/pipeline.h>
+#include <compiler/type.h>
+#include <runtime/chainerx_util.h>
+#include <runtime/chxvm.pb.h>
+#include <runtime/chxvm_var.h>
+#include <runtime/pipeline.h>
+
+namespace chainer_compiler {
+namespace {
+
+Type FloatType(int64_t size) {
+    return Type(Dtype::kFloat32, {size});
+}
+
+void SetOrder(const std::vector<Node*>& nodes) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i]->set_chainer_order(i + 1);
+    }
+}
+
+// Makes a graph whose flops are balanced at the boundary before `s` is
+// computed, but crossing it passes `b`, which is much larger than `s`.
+void MakeGraph(Graph* graph) {
+    Value* x = graph->AddInputValue("x", FloatType(100));
+    Value* y = graph->AddInputValue("y", FloatType(100));
+    Value* a = graph->AddValue("a", FloatType(100));
+    Value* b = graph->AddValue("b", FloatType(100));
+    Value* s = graph->AddValue("s", FloatType(1));
+    Value* d = graph->AddValue("d", FloatType(100));
+    Value* e = graph->AddOutputValue("e", FloatType(100));
+    SetOrder({graph->AddNode(Node::kRelu, {x}, {a}),
+              graph->AddNode(Node::kRelu, {a}, {b}),
+              graph->AddNode(Node::kReduceSum, {b}, {s}),
+              graph->AddNode(Node::kRelu, {y}, {d}),
+              graph->AddNode(Node::kAdd, {d, s}, {e})});
+}
+
+TEST(PipelineTest, PartitionByFlopsAndCut) {
+    Graph graph("test");
+    MakeGraph(&graph);
+
+    std::vector<PipelineStage> stages = PartitionPipeline(graph, 2);
+    ASSERT_EQ(2UL, stages.size());
+    EXPECT_EQ(3UL, stages[0].nodes.size());
+    EXPECT_EQ(2UL, stages[1].nodes.size());
+    EXPECT_EQ(201, stages[0].flops);
+    EXPECT_EQ(200, stages[1].flops);
+
+    ASSERT_EQ(1UL, stages[0].inputs.size());
+    EXPECT_EQ("x", stages[0].inputs[0]->name());
+    ASSERT_EQ(1UL, stages[0].outputs.size());
+    EXPECT_EQ("s", stages[0].outputs[0]->name());
+    ASSERT_EQ(2UL, stages[1].inputs.size());
+    EXPECT_EQ("y", stages[1].inputs[0]->name());
+    EXPECT_EQ("s", stages[1].inputs[1]->name());
+    ASSERT_EQ(1UL, stages[1].outputs.size());
+    EXPECT_EQ("e", stages[1].outputs[0]->name());
+}
+
+TEST(PipelineTest, MoreStagesThanNodes) {
+    Graph graph("test");
+    MakeGraph(&graph);
+
+    std::vector<PipelineStage> stages = PartitionPipeline(graph, 10);
+    ASSERT_EQ(5UL, stages.size());
+    for (const PipelineStage& stage : stages) {
+        EXPECT_EQ(1UL, stage.nodes.size());
+    }
+}
+
+TEST(PipelineTest, Emit) {
+    Graph graph("test");
+    MakeGraph(&graph);
+
+    std::vector<runtime::ChxVMProgramProto> programs = EmitPipeline(graph, 2);
+    ASSERT_EQ(2UL, programs.size());
+    ASSERT_EQ(1, programs[0].input_names_size());
+    EXPECT_EQ("x", programs[0].input_names(0));
+    ASSERT_EQ(2, programs[1].input_names_size());
+    EXPECT_EQ("y", programs[1].input_names(0));
+    EXPECT_EQ("s", programs[1].input_names(1));
+}
+
+TEST(PipelineTest, Run) {
+    chainerx::testing::ContextSession sess;
+    Graph graph("test");
+    MakeGraph(&graph);
+
+    runtime::ChxVMOptions options;
+    runtime::Pipeline pipeline(EmitPipeline(graph, 2), {"e"}, options);
+    ASSERT_EQ(2UL, pipeline.num_stages());
+
+    std::vector<runtime::InOuts> inputs(5);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        std::vector<float> x(100, -1.0f), y(100, 1.0f);
+        x[i] = i;
+        inputs[i]["x"] = std::make_shared<runtime::ChxVMVar>(runtime::MakeArray(chainerx::Dtype::kFloat32, {100}, x.data()));
+        inputs[i]["y"] = std::make_shared<runtime::ChxVMVar>(runtime::MakeArray(chainerx::Dtype::kFloat32, {100}, y.data()));
+    }
+    std::vector<runtime::InOuts> outputs = pipeline.Run(inputs);
+    ASSERT_EQ(inputs.size(), outputs.size());
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        // Intermediate values are not returned.
+        ASSERT_EQ(1UL, outputs[i].size());
+        const chainerx::Array& e = outputs[i]["e"]->GetArray();
+        EXPECT_EQ(1.0f + i, static_cast<float>(chainerx::AsScalar(e.At({0}))));
+    }
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -1,12 +1,18 @@
 #include <compiler/quantize.h>
 
+#include <set>
+
 #include <chainerx/routines/creation.h>
 #include <chainerx/routines/manipulation.h>
 #include <chainerx/routines/statistics.h>
 #include <compiler/graph.h>
 #include <compiler/graph_builder.h>
+#include <compiler/node.h>
+#include <compiler/onnx.h>
+#include <compiler/tensor.h>
 #include <compiler/value.h>
 #include <runtime/chainerx_util.h>
+#include <runtime/native_weight_only.h>
 
 namespace chainer_compiler {
 
@@ -367,34 +373,213 @@ bool QuantizeMatMul(const QuantizationContext& ctx, Node* matmul) {
     return QuantizeMatMulQLinear(ctx, matmul);
 }
 
+bool IsQuantizationTarget(const Node& node) {
+    switch (node.op_type()) {
+        case Node::kConv:
+            // TODO(take-cheeze): Support bias
+            return node.inputs().size() <= 2;
+        case Node::kMatMul:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Returns non-constant inputs and outputs of `node` whose ranges must
+// be known to quantize `node` statically.
+std::vector<Value*> GetActivationsToQuantize(const Node& node) {
+    std::vector<Value*> values;
+    for (Value* input : node.inputs()) {
+        if (!input->GetConstTensor()) {
+            values.push_back(input);
+        }
+    }
+    values.push_back(node.output(0));
+    return values;
+}
+
+bool HasStaticQuantizationParams(const QuantizationContext& ctx, const Node& node) {
+    for (Value* value : GetActivationsToQuantize(node)) {
+        const auto& params = value == node.output(0) ? ctx.output_quantization_params : ctx.input_quantization_params;
+        if (!params.count(value->name())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IsSameScalar(Value* a, Value* b) {
+    const Tensor* ta = a->GetConstTensor();
+    const Tensor* tb = b->GetConstTensor();
+    if (!ta || !tb || ta->chx().GetTotalSize() != 1 || tb->chx().GetTotalSize() != 1 || ta->dtype() != tb->dtype()) {
+        return false;
+    }
+    return static_cast<double>(chainerx::AsScalar(ta->chx())) == static_cast<double>(chainerx::AsScalar(tb->chx()));
+}
+
+// Removes QuantizeLinear(DequantizeLinear(x)) with the same parameters
+// between consecutive quantized ops, which is the identity.
+void FoldDequantizeQuantize(Graph* graph) {
+    for (Node* node : graph->GetLiveNodes()) {
+        if (node->op_type() != Node::kQuantizeLinear || node->inputs().size() != 3) {
+            continue;
+        }
+        Node* dq = node->input(0)->producer();
+        if (!dq || dq->op_type() != Node::kDequantizeLinear || dq->inputs().size() != 3) {
+            continue;
+        }
+        if (!IsSameScalar(node->input(1), dq->input(1)) || !IsSameScalar(node->input(2), dq->input(2))) {
+            continue;
+        }
+        GraphBuilder gb(graph, "FoldDequantizeQuantize", node->output(0));
+        gb.Op(Node::kIdentity, {dq->input(0)}, node->output(0));
+        node->Detach();
+    }
+}
+
 bool QuantizeModel(const QuantizationContext& ctx) {
     bool result = false;
 
     for (Node* node : ctx.graph->GetLiveNodes()) {
+        if (!IsQuantizationTarget(*node)) {
+            continue;
+        }
+        // Ops whose activations were not calibrated (e.g., ops in
+        // sub-graphs) are kept in float.
+        if (ctx.is_static && !HasStaticQuantizationParams(ctx, *node)) {
+            continue;
+        }
         bool quantized_result = false;
         switch (node->op_type()) {
             case Node::kConv:
-                // TODO(take-cheeze): Support bias
-                if (node->inputs().size() > 2) {
-                    continue;
-                }
                 quantized_result = QuantizeConvolution(ctx, node);
                 break;
             case Node::kMatMul:
                 quantized_result = QuantizeMatMul(ctx, node);
                 break;
             default:
-                break;
+                CHECK(false) << node->ToString();
         }
         result = result || quantized_result;
     }
 
+    if (result && ctx.is_static) {
+        FoldDequantizeQuantize(ctx.graph);
+    }
+    return result;
+}
+
+// Returns a float32 2D constant tensor of `value`, or nullptr.
+const Tensor* GetWeightOnlyTarget(Value* value) {
+    const Tensor* tensor = value->GetConstTensor();
+    if (!tensor || tensor->dtype() != Dtype::kFloat32 || tensor->dims().size() != 2) {
+        return nullptr;
+    }
+    return tensor;
+}
+
+// Emits a weight-only quantized matrix multiplication of `a` and the
+// transpose of `w` of (N, K). Returns nullptr if `w` cannot be
+// quantized.
+Value* WeightOnlyMatMul(const QuantizationContext& ctx, GraphBuilder* gb, Value* a, const chainerx::Array& w, Value* output) {
+    chainerx::Array qw, scales;
+    if (!runtime::QuantizeWeightOnly(w, ctx.nbits, ctx.group_size, &qw, &scales)) {
+        return nullptr;
+    }
+    Value* y = gb->Op(Node::kChainerWeightOnlyMatMul, {a, gb->Const(qw), gb->Const(scales)}, output, CHAINER_ONNX_DOMAIN);
+    y->producer()->set_bits(ctx.nbits);
+    return y;
+}
+
+bool QuantizeWeightOnlyMatMul(const QuantizationContext& ctx, Node* matmul) {
+    const Tensor* b = GetWeightOnlyTarget(matmul->input(1));
+    if (!b || matmul->input(0)->type().dtype() != Dtype::kFloat32) {
+        return false;
+    }
+    GraphBuilder gb(ctx.graph, "QuantizeWeightOnlyMatMul", matmul->output(0));
+    if (!WeightOnlyMatMul(ctx, &gb, matmul->input(0), b->chx().Transpose(), matmul->output(0))) {
+        return false;
+    }
+    matmul->Detach();
+    return true;
+}
+
+bool QuantizeWeightOnlyGemm(const QuantizationContext& ctx, Node* gemm) {
+    const Tensor* b = GetWeightOnlyTarget(gemm->input(1));
+    if (!b || gemm->trans_a() || gemm->input(0)->type().dtype() != Dtype::kFloat32) {
+        return false;
+    }
+    GraphBuilder gb(ctx.graph, "QuantizeWeightOnlyGemm", gemm->output(0));
+    // `alpha` is folded into scales.
+    chainerx::Array w = gemm->trans_b() ? b->chx() : b->chx().Transpose();
+    if (gemm->alpha() != 1) {
+        w = w * gemm->alpha();
+    }
+    const bool has_c = gemm->inputs().size() == 3;
+    Value* y = WeightOnlyMatMul(ctx, &gb, gemm->input(0), w, has_c ? nullptr : gemm->output(0));
+    if (!y) {
+        return false;
+    }
+    if (has_c) {
+        Value* c = gemm->input(2);
+        if (gemm->beta() != 1) {
+            c = gb.Op(Node::kMul, {c, gb.Const(chainerx::Full({}, gemm->beta(), chainerx::Dtype::kFloat32, w.device()))});
+        }
+        gb.Op(Node::kAdd, {y, c}, gemm->output(0));
+    }
+    gemm->Detach();
+    return true;
+}
+
+bool QuantizeWeightOnlyGather(const QuantizationContext& ctx, Node* gather) {
+    const Tensor* data = GetWeightOnlyTarget(gather->input(0));
+    if (!data || (gather->axis() != 0 && gather->axis() != -2)) {
+        return false;
+    }
+    chainerx::Array qw, scales;
+    if (!runtime::QuantizeWeightOnly(data->chx(), ctx.nbits, ctx.group_size, &qw, &scales)) {
+        return false;
+    }
+    GraphBuilder gb(ctx.graph, "QuantizeWeightOnlyGather", gather->output(0));
+    gb.Op(Node::kChainerWeightOnlyGather, {gb.Const(qw), gb.Const(scales), gather->input(1)}, gather->output(0), CHAINER_ONNX_DOMAIN)
+            ->producer()
+            ->set_bits(ctx.nbits);
+    gather->Detach();
+    return true;
+}
+
+// Quantizes only constant weights of MatMul, Gemm, and Gather. Unlike
+// other modes, activations stay in float.
+bool QuantizeWeightOnlyModel(const QuantizationContext& ctx) {
+    CHECK(ctx.nbits == 8 || ctx.nbits == 4) << "Weight-only quantization supports only 8 or 4 bits: " << ctx.nbits;
+    bool result = false;
+    for (Node* node : ctx.graph->GetLiveNodes()) {
+        switch (node->op_type()) {
+            case Node::kMatMul:
+                result |= QuantizeWeightOnlyMatMul(ctx, node);
+                break;
+            case Node::kGemm:
+                result |= QuantizeWeightOnlyGemm(ctx, node);
+                break;
+            case Node::kGather:
+                result |= QuantizeWeightOnlyGather(ctx, node);
+                break;
+            default:
+                break;
+        }
+    }
     return result;
 }
 
 }  // namespace
 
 bool Quantize(const QuantizationOptions& opts, Graph* graph) {
+    if (opts.mode == QuantizationMode::WeightOnly) {
+        QuantizationContext ctx(opts);
+        ctx.graph = graph;
+        return QuantizeWeightOnlyModel(ctx);
+    }
+
     CHECK_EQ(8, opts.nbits);
     CHECK_EQ(QuantizationMethod::OnnxRuntime, opts.method);
     QuantizationContext ctx(opts);
@@ -405,6 +590,22 @@ bool Quantize(const QuantizationOptions& opts, Graph* graph) {
     return QuantizeModel(ctx);
 }
 
+std::vector<Value*> GetValuesToCalibrate(const Graph& graph) {
+    std::vector<Value*> values;
+    std::set<Value*> seen;
+    for (Node* node : graph.GetLiveNodes()) {
+        if (!IsQuantizationTarget(*node)) {
+            continue;
+        }
+        for (Value* value : GetActivationsToQuantize(*node)) {
+            if (seen.insert(value).second) {
+                values.push_back(value);
+            }
+        }
+    }
+    return values;
+}
+
 std::ostream& operator<<(std::ostream& os, QuantizationMode mode) {
     switch (mode) {
         case QuantizationMode::IntegerOps:
@@ -413,6 +614,9 @@ std::ostream& operator<<(std::ostream& os, QuantizationMode mode) {
         case QuantizationMode::QLinearOps:
             os << "QLinearOps";
             break;
+        case QuantizationMode::WeightOnly:
+            os << "WeightOnly";
+            break;
         default:
             os << "(Unknown)";
             break;
@@ -2,12 +2,14 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <compiler/dtype.h>
 
 namespace chainer_compiler {
 
 class Graph;
+class Value;
 
 enum class QuantizationMethod {
     OnnxRuntime,
@@ -20,6 +22,9 @@ enum class QuantizationMethod {
 enum class QuantizationMode {
     IntegerOps = 0,
     QLinearOps = 1,
+    // Only constant weights of MatMul, Gemm, and Gather are quantized
+    // into `nbits` (8 or 4). Activations stay in float.
+    WeightOnly = 2,
 };
 
 struct QuantizationParams {
@@ -35,6 +40,9 @@ struct QuantizationOptions {
     QuantizationMode mode = QuantizationMode::IntegerOps;
     bool is_static = false;
     bool asymmertic_input_types = false;
+    // The number of weights sharing a scale in the WeightOnly mode. 0
+    // means one scale per output channel.
+    int64_t group_size = 0;
 
     std::unordered_map<std::string, QuantizationParams> input_quantization_params;
     std::unordered_map<std::string, QuantizationParams> output_quantization_params;
@@ -42,6 +50,11 @@ struct QuantizationOptions {
 
 bool Quantize(const QuantizationOptions& opts, Graph* graph);
 
+// Returns activations whose ranges are necessary for static
+// quantization of `graph`, i.e., keys of `input_quantization_params`
+// and `output_quantization_params`.
+std::vector<Value*> GetValuesToCalibrate(const Graph& graph);
+
 std::ostream& operator<<(std::ostream& os, QuantizationMode mode);
 std::ostream& operator<<(std::ostream& os, QuantizationMethod meth);
 
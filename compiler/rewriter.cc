@@ -0,0 +1,105 @@
+#include "compiler/rewriter.h"
+
+#include <chrono>
+#include <deque>
+#include <set>
+
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/log.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+Rewriter::Rewriter(const std::string& name) : name_(name) {
+}
+
+void Rewriter::AddRule(Node::OpType op_type, const std::string& name, const RuleFn& fn, bool detach) {
+    rules_[op_type].push_back(Rule{name, fn, detach});
+}
+
+bool Rewriter::Run(Graph* graph) {
+    std::deque<Node*> q;
+    std::set<Node*> queued;
+    auto push = [this, &q, &queued](Node* node) {
+        if (node && !node->detached() && rules_.count(node->op_type()) && queued.insert(node).second) {
+            q.push_back(node);
+        }
+    };
+    auto push_neighbors = [&push](Node* node) {
+        for (Value* value : node->inputs()) {
+            push(value->producer());
+        }
+        for (Value* value : node->outputs()) {
+            for (Node* user : value->users()) push(user);
+        }
+    };
+
+    for (Node* node : graph->GetLiveNodes()) {
+        push(node);
+    }
+
+    bool rewritten = false;
+    std::vector<Node*> neighbors;
+    while (!q.empty()) {
+        Node* node = q.front();
+        q.pop_front();
+        queued.erase(node);
+        if (node->detached()) continue;
+
+        // Collected before the rewrite disconnects them from `node`.
+        neighbors.clear();
+        for (Value* value : node->inputs()) {
+            if (value->producer()) neighbors.push_back(value->producer());
+        }
+        for (Value* value : node->outputs()) {
+            neighbors.insert(neighbors.end(), value->users().begin(), value->users().end());
+        }
+
+        const size_t num_nodes = graph->nodes().size();
+        if (!Rewrite(graph, node)) continue;
+        rewritten = true;
+
+        push(node);
+        for (Node* neighbor : neighbors) {
+            push(neighbor);
+        }
+        // Nodes added by the rule are at the end.
+        const std::vector<Node*>& nodes = graph->nodes();
+        for (size_t i = num_nodes; i < nodes.size(); ++i) {
+            push(nodes[i]);
+            push_neighbors(nodes[i]);
+        }
+    }
+
+    if (g_compiler_log()) {
+        ShowStats();
+    }
+    return rewritten;
+}
+
+bool Rewriter::Rewrite(Graph* graph, Node* node) {
+    for (Rule& rule : rules_[node->op_type()]) {
+        ++rule.num_trials;
+        const auto start = std::chrono::steady_clock::now();
+        const bool fired = rule.fn(graph, node);
+        rule.elapsed_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!fired) continue;
+        ++rule.num_hits;
+        if (rule.detach) graph->DetachNode(node);
+        return true;
+    }
+    return false;
+}
+
+void Rewriter::ShowStats() const {
+    for (const auto& p : rules_) {
+        for (const Rule& rule : p.second) {
+            if (rule.num_trials == 0) continue;
+            CLOG() << name_ << ": " << rule.name << " fired " << rule.num_hits << "/" << rule.num_trials << " times in "
+                   << rule.elapsed_seconds * 1000 << "ms" << std::endl;
+        }
+    }
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <compiler/node.h>
+
+namespace chainer_compiler {
+
+class Graph;
+
+// Applies rewrite rules to nodes of a graph until no rule fires. After
+// a rewrite, only the nodes around it are visited again, so a run takes
+// time proportional to the size of the graph and the number of
+// rewrites.
+class Rewriter {
+public:
+    // Returns true if `node` was rewritten.
+    typedef std::function<bool(Graph* graph, Node* node)> RuleFn;
+
+    // `name` is used in logs of statistics.
+    explicit Rewriter(const std::string& name);
+
+    // Adds a rule for nodes of `op_type`. Rules of an op are tried in
+    // the order they were added until one fires. If `detach` is true,
+    // the node is detached once the rule fires.
+    void AddRule(Node::OpType op_type, const std::string& name, const RuleFn& fn, bool detach = false);
+
+    // Returns true if any rule fired.
+    bool Run(Graph* graph);
+
+private:
+    struct Rule {
+        std::string name;
+        RuleFn fn;
+        bool detach;
+        int64_t num_trials{0};
+        int64_t num_hits{0};
+        double elapsed_seconds{0};
+    };
+
+    bool Rewrite(Graph* graph, Node* node);
+
+    void ShowStats() const;
+
+    const std::string name_;
+    std::map<Node::OpType, std::vector<Rule>> rules_;
+};
+
+}  // namespace chainer_compiler
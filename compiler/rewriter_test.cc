@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <common/strutil.h>
+#include <compiler/graph.h>
+#include <compiler/rewriter.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+// Replaces Neg(Neg(x)) by Identity(x).
+bool MergeNegNeg(Graph* graph, Node* node) {
+    Node* producer = node->input(0)->producer();
+    if (!producer || producer->op_type() != Node::kNeg || node->input(0)->users().size() != 1) {
+        return false;
+    }
+    graph->AddNode(Node::kIdentity, {producer->input(0)}, {node->output(0)});
+    graph->DetachNode(producer);
+    return true;
+}
+
+TEST(RewriterTest, Chain) {
+    Graph graph("test");
+    Value* v = graph.AddInputValue("x", Type(Dtype::kFloat32, {2}));
+    for (int i = 0; i < 8; ++i) {
+        Value* next = i == 7 ? graph.AddOutputValue("y", Type(Dtype::kFloat32, {2})) : graph.AddValue(StrCat("t", i));
+        graph.AddNode(Node::kNeg, {v}, {next});
+        v = next;
+    }
+
+    int num_trials = 0;
+    Rewriter rewriter("Test");
+    rewriter.AddRule(Node::kNeg, "Unused", [&num_trials](Graph*, Node*) {
+        ++num_trials;
+        return false;
+    });
+    rewriter.AddRule(Node::kNeg, "MergeNegNeg", MergeNegNeg, true /* detach */);
+    EXPECT_TRUE(rewriter.Run(&graph));
+
+    std::vector<Node::OpType> ops;
+    for (Node* node : graph.GetLiveNodes()) {
+        ops.push_back(node->op_type());
+    }
+    EXPECT_EQ(std::vector<Node::OpType>(4, Node::kIdentity), ops);
+    // Each Neg was tried once or once more after its neighbor was
+    // rewritten, not once for each rewrite.
+    EXPECT_LE(8, num_trials);
+    EXPECT_GE(16, num_trials);
+
+    EXPECT_FALSE(rewriter.Run(&graph));
+}
+
+}  // namespace
+}  // namespace chainer_compiler
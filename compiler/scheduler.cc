@@ -5,6 +5,8 @@
 #include <iterator>
 #include <map>
 #include <queue>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 #include <compiler/graph.h>
@@ -104,7 +106,7 @@ std::vector<Node*> DelaySimpleNodes(const std::vector<Node*>& nodes_in) {
 
 // A simple topological sort.
 std::vector<Node*> ScheduleNaively(const Graph& graph, const std::vector<Value*>& input_values, const std::vector<Value*>& output_values) {
-    std::map<Node*, int> input_counts = graph.GetNecessaryNodesAndInputCounts(output_values);
+    IdMap<Node, int> input_counts = graph.GetNecessaryNodesAndInputCounts(output_values);
 
     std::queue<const Value*> q;
     // Sort them topologically.
@@ -122,9 +124,9 @@ std::vector<Node*> ScheduleNaively(const Graph& graph, const std::vector<Value*>
     };
 
     // Schedule nodes which are already schedulable (e.g., Constant).
-    for (const auto& p : input_counts) {
-        if (p.second == 0) {
-            schedule_node(p.first);
+    for (Node* node : input_counts.keys()) {
+        if (*input_counts.find(node) == 0) {
+            schedule_node(node);
         }
     }
 
@@ -133,9 +135,9 @@ std::vector<Node*> ScheduleNaively(const Graph& graph, const std::vector<Value*>
         q.pop();
         if (value->IsNull()) continue;
         for (Node* node : value->users()) {
-            auto found = input_counts.find(node);
-            if (found == input_counts.end()) continue;
-            int cnt = --found->second;
+            int* found = input_counts.find(node);
+            if (!found) continue;
+            int cnt = --*found;
             if (cnt > 0) continue;
             schedule_node(node);
         }
@@ -146,7 +148,7 @@ std::vector<Node*> ScheduleNaively(const Graph& graph, const std::vector<Value*>
 // A greedy scheduler which tries to reduce the current working
 // memory in greedy mannar.
 std::vector<Node*> ScheduleGreedy(const Graph& graph, const std::vector<Value*>& input_values, const std::vector<Value*>& output_values) {
-    std::map<Node*, int> input_counts = graph.GetNecessaryNodesAndInputCounts(output_values);
+    IdMap<Node, int> input_counts = graph.GetNecessaryNodesAndInputCounts(output_values);
     // A map from estimated memory increase to schedulable nodes.
     std::multimap<int64_t, Node*> q;
     // TODO(hamaji): Redesign scheduler to allow delaying nodes for
@@ -162,9 +164,9 @@ std::vector<Node*> ScheduleGreedy(const Graph& graph, const std::vector<Value*>&
     auto make_value_ready = [&input_counts, enqueue_node](const Value* value) {
         if (value->IsNull()) return;
         for (Node* node : value->users()) {
-            auto found = input_counts.find(node);
-            if (found == input_counts.end()) continue;
-            int cnt = --found->second;
+            int* found = input_counts.find(node);
+            if (!found) continue;
+            int cnt = --*found;
             CHECK_LE(0, cnt) << node->ToString();
             if (cnt != 0) continue;
             enqueue_node(node);
@@ -172,9 +174,9 @@ std::vector<Node*> ScheduleGreedy(const Graph& graph, const std::vector<Value*>&
     };
 
     // Schedule nodes which are already schedulable (e.g., Constant).
-    for (const auto& p : input_counts) {
-        if (p.second == 0) {
-            enqueue_node(p.first);
+    for (Node* node : input_counts.keys()) {
+        if (*input_counts.find(node) == 0) {
+            enqueue_node(node);
         }
     }
 
@@ -199,6 +201,315 @@ std::vector<Node*> ScheduleGreedy(const Graph& graph, const std::vector<Value*>&
     return nodes;
 }
 
+// A model of live bytes while a sequence of `nodes` runs, which is
+// the same as the one of `SimulateMemoryUsage` but works for a part of
+// a graph. Values consumed by `nodes` but produced elsewhere are live
+// from the beginning. A value is freed after its last user in `nodes`
+// unless it is a graph output, a parameter, or used by a node which
+// is scheduled later.
+class MemoryModel {
+public:
+    explicit MemoryModel(const std::vector<Node*>& nodes) : nodes_(nodes) {
+        std::map<const Node*, int> node_ids;
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            CHECK(node_ids.emplace(nodes_[i], i).second);
+        }
+        inputs_.resize(nodes_.size());
+        outputs_.resize(nodes_.size());
+        producers_.resize(nodes_.size());
+
+        std::map<const Value*, int> value_ids;
+        auto get_value_id = [this, &value_ids, &node_ids](const Value* value) {
+            auto p = value_ids.emplace(value, values_.size());
+            if (p.second) {
+                bool freeable = !value->IsOutput() && !value->initializer();
+                std::vector<int> users;
+                for (const Node* user : value->users()) {
+                    auto found = node_ids.find(user);
+                    if (found != node_ids.end()) {
+                        users.push_back(found->second);
+                    } else if (user->chainer_order() < 0) {
+                        freeable = false;
+                    }
+                }
+                std::sort(users.begin(), users.end());
+                users.erase(std::unique(users.begin(), users.end()), users.end());
+                values_.push_back({std::max<int64_t>(0, value->GetNBytes()), freeable, users});
+            }
+            return p.first->second;
+        };
+
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            std::set<int> inputs;
+            std::set<int> producers;
+            for (const Value* value : nodes_[i]->inputs()) {
+                if (value->IsNull()) continue;
+                inputs.insert(get_value_id(value));
+                auto found = node_ids.find(value->producer());
+                if (found != node_ids.end()) producers.insert(found->second);
+            }
+            inputs_[i].assign(inputs.begin(), inputs.end());
+            producers_[i].assign(producers.begin(), producers.end());
+            for (const Value* value : nodes_[i]->outputs()) {
+                if (value->IsNull()) continue;
+                outputs_[i].push_back(get_value_id(value));
+            }
+        }
+
+        std::vector<bool> produced(values_.size());
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            for (int v : outputs_[i]) produced[v] = true;
+        }
+        for (size_t v = 0; v < values_.size(); ++v) {
+            if (!produced[v]) initial_bytes_ += values_[v].bytes;
+        }
+    }
+
+    size_t num_nodes() const {
+        return nodes_.size();
+    }
+
+    Node* node(int i) const {
+        return nodes_[i];
+    }
+
+    // Nodes in `nodes` which produce inputs of the `i`-th node.
+    const std::vector<int>& producers(int i) const {
+        return producers_[i];
+    }
+
+    // Returns the peak live bytes while `order` (indices of `nodes`) runs.
+    int64_t EstimatePeak(const std::vector<int>& order) const {
+        State state(*this);
+        int64_t peak = state.live;
+        for (int i : order) {
+            peak = std::max(peak, state.Run(i));
+        }
+        return peak;
+    }
+
+    // Live bytes after running some nodes.
+    struct State {
+        explicit State(const MemoryModel& m) : model(m), live(m.initial_bytes_) {
+            for (const ModelValue& value : m.values_) {
+                remaining_users.push_back(value.users.size());
+            }
+        }
+
+        // Returns the bytes which will be freed by running the `i`-th node.
+        int64_t GetFreedBytes(int i) const {
+            int64_t freed = 0;
+            for (int v : model.inputs_[i]) {
+                const ModelValue& value = model.values_[v];
+                if (value.freeable && remaining_users[v] == 1) freed += value.bytes;
+            }
+            for (int v : model.outputs_[i]) {
+                const ModelValue& value = model.values_[v];
+                if (value.freeable && value.users.empty()) freed += value.bytes;
+            }
+            return freed;
+        }
+
+        int64_t GetOutputBytes(int i) const {
+            int64_t bytes = 0;
+            for (int v : model.outputs_[i]) bytes += model.values_[v].bytes;
+            return bytes;
+        }
+
+        // Runs the `i`-th node and returns the peak during the run.
+        int64_t Run(int i) {
+            const int64_t freed = GetFreedBytes(i);
+            live += GetOutputBytes(i);
+            const int64_t peak = live;
+            live -= freed;
+            for (int v : model.inputs_[i]) --remaining_users[v];
+            return peak;
+        }
+
+        const MemoryModel& model;
+        int64_t live;
+        std::vector<int> remaining_users;
+    };
+
+    // Finds an order of the minimum peak by dynamic programming over
+    // sets of scheduled nodes, pruning states whose peak exceeds
+    // `upper_bound`. The live bytes after a set of nodes does not
+    // depend on their order, so the best peak to reach a set is the
+    // minimum over its last node. Only for 64 nodes or less. Returns
+    // an empty vector if no better order is found within `max_states`.
+    std::vector<int> ScheduleExactly(int64_t upper_bound, size_t max_states) const {
+        const int n = nodes_.size();
+        CHECK_GE(64, n);
+        std::vector<uint64_t> producer_masks(n), user_masks(values_.size());
+        for (int i = 0; i < n; ++i) {
+            for (int p : producers_[i]) producer_masks[i] |= 1ULL << p;
+        }
+        for (size_t v = 0; v < values_.size(); ++v) {
+            for (int u : values_[v].users) user_masks[v] |= 1ULL << u;
+        }
+
+        struct Entry {
+            int64_t peak;
+            int64_t live;
+            uint64_t parent;
+            int node;
+        };
+        std::vector<std::unordered_map<uint64_t, Entry>> layers(n + 1);
+        layers[0].emplace(0, Entry{initial_bytes_, initial_bytes_, 0, -1});
+        size_t num_states = 1;
+        for (int depth = 0; depth < n; ++depth) {
+            for (const auto& p : layers[depth]) {
+                const uint64_t mask = p.first;
+                const Entry& entry = p.second;
+                for (int i = 0; i < n; ++i) {
+                    const uint64_t bit = 1ULL << i;
+                    if ((mask & bit) || (producer_masks[i] & ~mask)) continue;
+                    const uint64_t next_mask = mask | bit;
+                    int64_t live = entry.live;
+                    for (int v : outputs_[i]) live += values_[v].bytes;
+                    const int64_t peak = std::max(entry.peak, live);
+                    if (peak >= upper_bound) continue;
+                    for (int v : inputs_[i]) {
+                        if (values_[v].freeable && !(user_masks[v] & ~next_mask)) live -= values_[v].bytes;
+                    }
+                    for (int v : outputs_[i]) {
+                        if (values_[v].freeable && !user_masks[v]) live -= values_[v].bytes;
+                    }
+                    auto inserted = layers[depth + 1].emplace(next_mask, Entry{peak, live, mask, i});
+                    if (inserted.second) {
+                        if (++num_states > max_states) return {};
+                    } else if (peak < inserted.first->second.peak) {
+                        inserted.first->second = Entry{peak, live, mask, i};
+                    }
+                }
+            }
+        }
+
+        const uint64_t all = n == 64 ? ~0ULL : (1ULL << n) - 1;
+        auto found = layers[n].find(all);
+        if (found == layers[n].end()) return {};
+        std::vector<int> order;
+        uint64_t mask = all;
+        for (int depth = n; depth > 0; --depth) {
+            const Entry& entry = layers[depth].find(mask)->second;
+            order.push_back(entry.node);
+            mask = entry.parent;
+        }
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
+private:
+    struct ModelValue {
+        int64_t bytes;
+        bool freeable;
+        std::vector<int> users;
+    };
+
+    std::vector<Node*> nodes_;
+    std::vector<ModelValue> values_;
+    std::vector<std::vector<int>> inputs_;
+    std::vector<std::vector<int>> outputs_;
+    std::vector<std::vector<int>> producers_;
+    int64_t initial_bytes_{0};
+};
+
+// A priority-list scheduler. Among ready nodes, it runs the one which
+// increases live bytes the least, preferring the one which became
+// ready most recently to finish a chain before starting another.
+std::vector<int> ScheduleByPriority(const MemoryModel& model) {
+    const int n = model.num_nodes();
+    std::vector<int> num_pending(n);
+    std::vector<std::vector<int>> consumers(n);
+    for (int i = 0; i < n; ++i) {
+        num_pending[i] = model.producers(i).size();
+        for (int p : model.producers(i)) consumers[p].push_back(i);
+    }
+
+    std::vector<int> ready;
+    for (int i = n - 1; i >= 0; --i) {
+        if (num_pending[i] == 0) ready.push_back(i);
+    }
+
+    MemoryModel::State state(model);
+    std::vector<int> order;
+    while (!ready.empty()) {
+        size_t best = 0;
+        int64_t best_increase = 0;
+        int64_t best_output = 0;
+        for (size_t j = 0; j < ready.size(); ++j) {
+            const int64_t output = state.GetOutputBytes(ready[j]);
+            const int64_t increase = output - state.GetFreedBytes(ready[j]);
+            // `ready` is sorted by the time they became ready, so ties
+            // are broken by the later one.
+            if (j == 0 || increase < best_increase || (increase == best_increase && output <= best_output)) {
+                best = j;
+                best_increase = increase;
+                best_output = output;
+            }
+        }
+        const int i = ready[best];
+        ready.erase(ready.begin() + best);
+        state.Run(i);
+        order.push_back(i);
+        for (int c : consumers[i]) {
+            if (--num_pending[c] == 0) ready.push_back(c);
+        }
+    }
+    CHECK_EQ(n, order.size());
+    return order;
+}
+
+// Chooses the order of the minimum estimated peak among the greedy
+// scheduler, the priority-list scheduler, and, for small graphs, the
+// exact search.
+std::vector<Node*> ScheduleMemory(const Graph& graph, const std::vector<Value*>& input_values, const std::vector<Value*>& output_values) {
+    // The exact search is exponential in the worst case.
+    constexpr size_t kMaxNodesForExactSearch = 64;
+    constexpr size_t kMaxStatesForExactSearch = 100 * 1000;
+
+    const std::vector<Node*> nodes = ScheduleNaively(graph, input_values, output_values);
+    const MemoryModel model(nodes);
+    std::map<const Node*, int> node_ids;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        node_ids.emplace(nodes[i], i);
+    }
+
+    std::vector<int> best_order;
+    for (Node* node : ScheduleGreedy(graph, input_values, output_values)) {
+        auto found = node_ids.find(node);
+        CHECK(found != node_ids.end()) << node->ToString();
+        best_order.push_back(found->second);
+    }
+    int64_t best_peak = model.EstimatePeak(best_order);
+    CLOG() << "Scheduler: greedy peak=" << best_peak << std::endl;
+
+    std::vector<int> order = ScheduleByPriority(model);
+    int64_t peak = model.EstimatePeak(order);
+    CLOG() << "Scheduler: priority peak=" << peak << std::endl;
+    if (peak < best_peak) {
+        best_order.swap(order);
+        best_peak = peak;
+    }
+
+    if (nodes.size() <= kMaxNodesForExactSearch) {
+        order = model.ScheduleExactly(best_peak, kMaxStatesForExactSearch);
+        if (!order.empty()) {
+            peak = model.EstimatePeak(order);
+            CLOG() << "Scheduler: exact peak=" << peak << std::endl;
+            CHECK_LT(peak, best_peak);
+            best_order.swap(order);
+            best_peak = peak;
+        }
+    }
+
+    std::vector<Node*> scheduled;
+    for (int i : best_order) {
+        scheduled.push_back(model.node(i));
+    }
+    return scheduled;
+}
+
 void CheckSanity(
         const Graph& graph,
         const std::vector<Value*>& input_values,
@@ -212,7 +523,7 @@ void CheckSanity(
         for (const Value* output : node->outputs()) values.emplace(output);
     }
 
-    std::map<Node*, int> input_counts = graph.GetNecessaryNodesAndInputCounts(output_values);
+    IdMap<Node, int> input_counts = graph.GetNecessaryNodesAndInputCounts(output_values);
     for (Node* node : graph.nodes()) {
         if (node->chainer_order() > 0) input_counts.erase(node);
     }
@@ -220,8 +531,7 @@ void CheckSanity(
         input_counts.erase(node);
     }
     if (!input_counts.empty()) {
-        for (auto p : input_counts) {
-            Node* node = p.first;
+        for (Node* node : input_counts.keys()) {
             std::cerr << "Failed to schedule (" << graph.name() << "): " << node->ToString() << std::endl;
             for (Value* value : node->inputs()) {
                 if (!values.count(value) && !value->name().empty()) {
@@ -250,6 +560,9 @@ int64_t ScheduleComputation(
         case SchedulerType::kGreedy:
             nodes = ScheduleGreedy(graph, input_values, output_values);
             break;
+        case SchedulerType::kMemory:
+            nodes = ScheduleMemory(graph, input_values, output_values);
+            break;
     }
 
     CheckSanity(graph, input_values, output_values, nodes);
@@ -260,6 +573,19 @@ int64_t ScheduleComputation(
     return order;
 }
 
+bool ParseSchedulerType(const std::string& name, SchedulerType* scheduler_type) {
+    if (name == "naive") {
+        *scheduler_type = SchedulerType::kNaive;
+    } else if (name == "greedy") {
+        *scheduler_type = SchedulerType::kGreedy;
+    } else if (name == "memory") {
+        *scheduler_type = SchedulerType::kMemory;
+    } else {
+        return false;
+    }
+    return true;
+}
+
 int64_t ScheduleComputation(const Graph& graph, int64_t order, SchedulerType scheduler_type) {
     return ScheduleComputation(graph, graph.input_values(), graph.output_values(), order, scheduler_type);
 }
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 namespace chainer_compiler {
@@ -9,8 +10,15 @@ class Value;
 enum class SchedulerType {
     kNaive,
     kGreedy,
+    // Minimizes the peak of live bytes estimated in the same way as
+    // `SimulateMemoryUsage`, using a priority-list scheduler and an
+    // exact search for small graphs.
+    kMemory,
 };
 
+// Parses "naive", "greedy", or "memory".
+bool ParseSchedulerType(const std::string& name, SchedulerType* scheduler_type);
+
 int64_t ScheduleComputation(
         const Graph& graph,
         const std::vector<Value*>& input_values,
@@ -4,8 +4,10 @@
 
 #include <common/log.h>
 #include <compiler/graph.h>
+#include <compiler/memory_simulator.h>
 #include <compiler/node.h>
 #include <compiler/scheduler.h>
+#include <compiler/type.h>
 
 namespace chainer_compiler {
 namespace {
@@ -94,7 +96,45 @@ TEST_P(SchedulerTest, MultipleTimes) {
     EXPECT_EQ(2, n3->chainer_order());
 }
 
-INSTANTIATE_TEST_CASE_P(ForEachScheduler, SchedulerTest, ::testing::Values(SchedulerType::kNaive, SchedulerType::kGreedy));
+INSTANTIATE_TEST_CASE_P(
+        ForEachScheduler, SchedulerTest, ::testing::Values(SchedulerType::kNaive, SchedulerType::kGreedy, SchedulerType::kMemory));
+
+// Two branches, each of which creates a large temporary value and
+// reduces it. Running a branch to the end before starting the other
+// one halves the peak memory usage.
+int64_t GetPeakOfTwoBranches(SchedulerType scheduler_type) {
+    Graph graph("test");
+    auto type = [](int64_t size) { return Type(Dtype::kFloat32, {size}); };
+    Value* in = graph.AddInputValue("in", type(1));
+    Value* out = graph.AddOutputValue("out", type(1));
+    Value* a1 = graph.AddValue("a1", type(1000));
+    Value* a2 = graph.AddValue("a2", type(1));
+    Value* b1 = graph.AddValue("b1", type(1000));
+    Value* b2 = graph.AddValue("b2", type(1));
+    graph.AddNode(Node::kAdd, {a2, b2}, {out});
+    graph.AddNode(Node::kReduceSum, {b1}, {b2});
+    graph.AddNode(Node::kReduceSum, {a1}, {a2});
+    graph.AddNode(Node::kExpand, {in}, {b1});
+    graph.AddNode(Node::kExpand, {in}, {a1});
+
+    ScheduleComputation(graph, 0, scheduler_type);
+    EXPECT_EQ(5UL, graph.GetComputationSequence().size());
+    return SimulateMemoryUsage(graph).peak;
+}
+
+TEST(MemorySchedulerTest, MinimizePeakMemory) {
+    EXPECT_EQ(8004, GetPeakOfTwoBranches(SchedulerType::kNaive));
+    EXPECT_EQ(4008, GetPeakOfTwoBranches(SchedulerType::kMemory));
+}
+
+TEST(MemorySchedulerTest, ParseSchedulerType) {
+    SchedulerType scheduler_type;
+    ASSERT_TRUE(ParseSchedulerType("memory", &scheduler_type));
+    EXPECT_EQ(SchedulerType::kMemory, scheduler_type);
+    ASSERT_TRUE(ParseSchedulerType("naive", &scheduler_type));
+    EXPECT_EQ(SchedulerType::kNaive, scheduler_type);
+    EXPECT_FALSE(ParseSchedulerType("unknown", &scheduler_type));
+}
 
 }  // namespace
 }  // namespace chainer_compiler
@@ -0,0 +1,366 @@
+#include "compiler/sequence_batching.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <compiler/onnx.h>
+
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/graph_builder.h>
+#include <compiler/id_map.h>
+#include <compiler/log.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+Value* Unalias(Value* value) {
+    while (value->producer() && value->producer()->op_type() == Node::kIdentity) {
+        value = value->producer()->input(0);
+    }
+    return value;
+}
+
+bool IsTrue(Value* value) {
+    const Node* node = value->producer();
+    if (!node || node->op_type() != Node::kConstant) return false;
+    const Tensor& tensor = *node->tensor_value();
+    return tensor.dtype() == Dtype::kBool && tensor.NumElements() == 1 && tensor.Get<bool>(0);
+}
+
+// Returns the rank of `value` or -1 if it is unknown.
+int GetKnownRank(const Value& value) {
+    const Node* node = value.producer();
+    if (node && node->op_type() == Node::kConstant) return node->tensor_value()->dims().size();
+    const Type& type = value.type();
+    if (type.kind() != Type::Kind::kTensor || !type.HasKnownShape()) return -1;
+    return type.ndim();
+}
+
+// Rewrites a Loop of the form
+//
+//   ys = []
+//   for i in range(len(xs)):
+//     ys.append(f(xs[i], w))
+//
+// to `ys = unpad(f(pad(xs), w), lengths(xs))`, where `f` consists of
+// ops which compute each row of the padded batch from the same row of
+// inputs. Loops which only have scan outputs are rewritten to
+// `f(stack(xs), w)` as their outputs are stacked anyway.
+class LoopBatcher {
+public:
+    LoopBatcher(Graph* graph, Node* loop)
+        : graph_(graph),
+          loop_(loop),
+          body_(loop->body().get()),
+          invariants_(body_->num_value_ids()),
+          ranks_(body_->num_value_ids()) {
+    }
+
+    bool Match() {
+        const int num_states = loop_->inputs().size() - 2;
+        const int num_scans = body_->output_values().size() - 1 - num_states;
+
+        // The loop must visit all elements of a sequence.
+        Value* max_trip_count = loop_->input(0);
+        Node* size = max_trip_count->IsNull() ? nullptr : max_trip_count->producer();
+        if (!size || (size->op_type() != Node::kChainerSequenceSize && size->op_type() != Node::kSequenceLength)) return false;
+        seq_ = size->input(0);
+        if (!loop_->input(1)->IsNull() && !IsTrue(loop_->input(1))) return false;
+        Value* cond_out = Unalias(body_->output_values()[0]);
+        if (cond_out != body_->input_values()[1] && !IsTrue(cond_out)) return false;
+        if (num_scans > 0 && loop_->chainer_stack_axis() != 0) return false;
+
+        // Loop states must be either forwarded or appended one element
+        // in each iteration.
+        for (int i = 0; i < num_states; ++i) {
+            Value* body_in = body_->input_values()[i + 2];
+            Value* body_out = body_->output_values()[i + 1];
+            if (loop_->input(i + 2)->IsNull()) return false;
+            if (Unalias(body_out) == body_in) {
+                invariants_.emplace(body_in, loop_->input(i + 2));
+                continue;
+            }
+            Node* append = body_out->producer();
+            if (append && append->op_type() == Node::kChainerSequenceAppend && append->input(0) == body_in &&
+                body_in->users().size() == 1 && body_out->users().empty()) {
+                appends_.emplace_back(i, append);
+                continue;
+            }
+            return false;
+        }
+        if (appends_.empty() && num_scans == 0) return false;
+        // Appended elements may have different shapes so they are
+        // padded.
+        pad_ = !appends_.empty();
+
+        Value* iter = body_->input_values()[0];
+        bool has_lookup = false;
+        for (Node* node : body_->GetTopologicallySortedNodes()) {
+            switch (node->op_type()) {
+                case Node::kIdentity: {
+                    if (Value** value = invariants_.find(node->input(0))) {
+                        invariants_.emplace(node->output(0), *value);
+                    } else if (const int* rank = ranks_.find(node->input(0))) {
+                        ranks_.emplace(node->output(0), *rank);
+                        batched_nodes_.push_back(node);
+                    }
+                    continue;
+                }
+
+                case Node::kConstant:
+                    // Constants in the body are copied when they are used.
+                    invariants_.emplace(node->output(0), nullptr);
+                    continue;
+
+                case Node::kChainerSequenceLookup:
+                case Node::kSequenceAt: {
+                    Value** value = invariants_.find(node->input(0));
+                    if (!value || *value != seq_ || Unalias(node->input(1)) != iter) break;
+                    ranks_.emplace(node->output(0), GetKnownRank(*node->output(0)));
+                    batched_nodes_.push_back(node);
+                    has_lookup = true;
+                    continue;
+                }
+
+                case Node::kChainerSequenceAppend: {
+                    auto found = std::find_if(appends_.begin(), appends_.end(), [node](const std::pair<int, Node*>& p) {
+                        return p.second == node;
+                    });
+                    if (found == appends_.end()) break;
+                    continue;
+                }
+
+                default: {
+                    int rank;
+                    if (!GetBatchedRank(*node, &rank)) break;
+                    ranks_.emplace(node->output(0), rank);
+                    batched_nodes_.push_back(node);
+                    continue;
+                }
+            }
+            CLOG() << "Not batch " << loop_->ToString() << " due to " << node->ToString() << std::endl;
+            return false;
+        }
+        if (!has_lookup) return false;
+
+        for (const auto& p : appends_) {
+            const int* rank = ranks_.find(p.second->input(1));
+            if (!rank) return false;
+            // ChainerSequencePad needs the first axis of each element.
+            if (*rank < 1) return false;
+        }
+        for (int i = 0; i < num_scans; ++i) {
+            if (!ranks_.count(body_->output_values()[i + 1 + num_states])) return false;
+        }
+        return true;
+    }
+
+    void Rewrite() {
+        CLOG() << "Batch " << loop_->ToString() << std::endl;
+        const int num_states = loop_->inputs().size() - 2;
+        const int num_scans = body_->output_values().size() - 1 - num_states;
+
+        GraphBuilder gb(graph_, "BatchSequenceLoop", seq_);
+        IdMap<Value, Value*> batched(body_->num_value_ids());
+        Value* xs = gb.Op(pad_ ? Node::kChainerSequencePad : Node::kChainerSequenceStack, {seq_});
+
+        auto get_input = [this, &gb, &batched](Value* value) {
+            if (value->IsNull()) return gb.Null();
+            if (Value** found = batched.find(value)) return *found;
+            Value** found = invariants_.find(value);
+            CHECK(found) << value->ToString();
+            if (!*found) {
+                onnx::NodeProto xconst;
+                Unalias(value)->producer()->ToONNX(&xconst);
+                *found = gb.Temp(value->type());
+                gb.MOp(xconst, {}, {*found});
+            }
+            return *found;
+        };
+
+        for (Node* node : batched_nodes_) {
+            if (node->op_type() == Node::kChainerSequenceLookup || node->op_type() == Node::kSequenceAt) {
+                batched.emplace(node->output(0), xs);
+                continue;
+            }
+            std::vector<Value*> inputs;
+            for (Value* value : node->inputs()) inputs.push_back(get_input(value));
+            onnx::NodeProto xnode;
+            node->ToONNX(&xnode);
+            Value* output = gb.Temp();
+            Node* batched_node = gb.MOp(xnode, inputs, {output});
+            // The batch axis is prepended to axes of elements.
+            switch (node->op_type()) {
+                case Node::kSoftmax:
+                case Node::kLogSoftmax:
+                    batched_node->set_axis(node->axis() + 1);
+                    break;
+                case Node::kChainerLinear:
+                    batched_node->set_n_batch_axes(node->n_batch_axes() + 1);
+                    break;
+                default:
+                    break;
+            }
+            batched.emplace(node->output(0), output);
+        }
+
+        std::vector<Value*> results(loop_->outputs().size());
+        for (int i = 0; i < num_states; ++i) {
+            results[i] = loop_->input(i + 2);
+        }
+        Value* lengths = pad_ ? gb.Op(Node::kChainerSequenceLengths, {seq_}) : nullptr;
+        for (const auto& p : appends_) {
+            Value* ys = gb.Op(Node::kChainerSequenceUnpad, {*batched.find(p.second->input(1)), lengths});
+            Value* init = loop_->input(p.first + 2);
+            const Node* create = init->producer();
+            if (!create || create->op_type() != Node::kChainerSequenceCreate || !create->inputs().empty()) {
+                ys = gb.Op(Node::kChainerSequenceExtend, {init, ys});
+            }
+            results[p.first] = ys;
+        }
+        for (int i = 0; i < num_scans; ++i) {
+            results[i + num_states] = *batched.find(body_->output_values()[i + 1 + num_states]);
+        }
+
+        const std::vector<Value*> outputs = loop_->outputs();
+        graph_->DetachNode(loop_);
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            Value* output = outputs[i];
+            if (output->IsNull() || (output->users().empty() && !output->IsOutput())) continue;
+            gb.Op(Node::kIdentity, {results[i]}, output);
+        }
+    }
+
+private:
+    // Returns true and the rank of the output of `node` for an element
+    // if `node` can be applied to a batch of elements.
+    bool GetBatchedRank(const Node& node, int* rank) const {
+        if (node.outputs().size() != 1) return false;
+        for (Value* value : node.inputs()) {
+            if (!value->IsNull() && !ranks_.count(value) && !invariants_.count(value)) return false;
+        }
+        const int* input_rank = ranks_.find(node.input(0));
+
+        switch (node.op_type()) {
+            case Node::kNeg:
+            case Node::kReciprocal:
+            case Node::kExp:
+            case Node::kLog:
+            case Node::kSqrt:
+            case Node::kTanh:
+            case Node::kErf:
+            case Node::kAbs:
+            case Node::kRelu:
+            case Node::kSelu:
+            case Node::kLeakyRelu:
+            case Node::kElu:
+            case Node::kSigmoid:
+            case Node::kSoftplus:
+            case Node::kCast:
+                if (!input_rank) return false;
+                *rank = *input_rank;
+                return true;
+
+            case Node::kAdd:
+            case Node::kSub:
+            case Node::kMul:
+            case Node::kDiv: {
+                const int* rank1 = ranks_.find(node.input(1));
+                if (input_rank && rank1) {
+                    if (*input_rank != *rank1) return false;
+                    *rank = *input_rank;
+                    return true;
+                }
+                const int* element_rank = input_rank ? input_rank : rank1;
+                if (!element_rank) return false;
+                // Invariant operands must not be broadcast along the
+                // first axis of elements.
+                const int invariant_rank = GetInvariantRank(input_rank ? node.input(1) : node.input(0));
+                if (invariant_rank != 0 && (invariant_rank < 0 || invariant_rank >= *element_rank)) return false;
+                *rank = *element_rank;
+                return true;
+            }
+
+            case Node::kMatMul:
+                // A padded vector cannot be multiplied.
+                if (!input_rank || !invariants_.count(node.input(1)) || GetInvariantRank(node.input(1)) != 2) return false;
+                if (pad_ && *input_rank < 2) return false;
+                *rank = *input_rank;
+                return true;
+
+            case Node::kChainerLinear:
+                if (!input_rank || node.n_batch_axes() < 1) return false;
+                for (size_t i = 1; i < node.inputs().size(); ++i) {
+                    if (ranks_.count(node.input(i))) return false;
+                }
+                *rank = node.n_batch_axes() + 1;
+                return true;
+
+            case Node::kSoftmax:
+            case Node::kLogSoftmax:
+                // Normalization must not mix padded rows.
+                if (!input_rank || node.axis() < 1) return false;
+                *rank = *input_rank;
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    int GetInvariantRank(Value* value) const {
+        const int rank = GetKnownRank(*value);
+        if (rank >= 0) return rank;
+        Value* const* outer = invariants_.find(value);
+        return outer && *outer ? GetKnownRank(**outer) : -1;
+    }
+
+    Graph* graph_;
+    Node* loop_;
+    Graph* body_;
+    // The sequence in `graph_` whose elements are visited.
+    Value* seq_{nullptr};
+    // Values in the body which are the same in all iterations and their
+    // counterparts in `graph_`. Constants in the body are mapped to
+    // nullptr until they are copied.
+    IdMap<Value, Value*> invariants_;
+    // Values computed from an element in each iteration and their ranks,
+    // which are -1 if unknown.
+    IdMap<Value, int> ranks_;
+    // Nodes to be applied to the batch in a topological order.
+    std::vector<Node*> batched_nodes_;
+    // Indices of loop states and ChainerSequenceAppend which update them.
+    std::vector<std::pair<int, Node*>> appends_;
+    bool pad_{false};
+};
+
+void BatchSequenceLoopsImpl(Graph* graph) {
+    // Copy nodes as batched nodes are added to `graph`.
+    const std::vector<Node*> nodes = graph->nodes();
+    for (Node* node : nodes) {
+        if (node->detached()) continue;
+        for (Graph* subgraph : node->GetSubGraphs()) {
+            BatchSequenceLoopsImpl(subgraph);
+        }
+        if (node->op_type() == Node::kLoop) {
+            LoopBatcher batcher(graph, node);
+            if (batcher.Match()) batcher.Rewrite();
+        }
+    }
+}
+
+}  // namespace
+
+void BatchSequenceLoops(Graph* graph) {
+    if (!g_batch_sequence_loops()) return;
+    BatchSequenceLoopsImpl(graph);
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace chainer_compiler {
+
+class Graph;
+
+// Rewrites Loops which apply the same ops to each element of a sequence
+// (e.g., `for x in xs: ys.append(F.relu(l(x)))`) into ops on a batch
+// of all elements. Elements are padded by ChainerSequencePad and the
+// results are split by ChainerSequenceUnpad, so sequences of ragged
+// tensors are supported. Subgraphs must be canonicalized by
+// `CanonicalizeSubGraphs`. Sequences must not be empty as an empty
+// sequence cannot be padded.
+void BatchSequenceLoops(Graph* graph);
+
+}  // namespace chainer_compiler
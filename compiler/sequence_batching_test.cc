@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+
+#include <compiler/flags.h>
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/sequence_batching.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+int CountLiveNodes(const Graph& graph, Node::OpType op_type) {
+    int count = 0;
+    for (const Node* node : graph.nodes()) {
+        if (!node->detached() && node->op_type() == op_type) ++count;
+    }
+    return count;
+}
+
+// Builds a loop which computes `[f(x, w) for x in xs]`. With
+// `carry_state`, `f` also depends on the result of the previous
+// iteration.
+Node* BuildListLoop(Graph* graph, bool carry_state) {
+    Type type(Dtype::kFloat32, {5, 3});
+    Value* xs = graph->AddInputValue("xs", Type(Type::Kind::kSequence));
+    Value* w = graph->AddInputValue("w", Type(Dtype::kFloat32, {4, 3}));
+    Value* h = graph->AddInputValue("h", Type(Dtype::kFloat32, {5, 4}));
+    Value* ys = graph->AddOutputValue("ys", Type(Type::Kind::kSequence));
+    Value* size = graph->AddValue("size", Type(Dtype::kInt64, {}));
+    Value* init = graph->AddValue("init", Type(Type::Kind::kSequence));
+    graph->AddNode(Node::kChainerSequenceSize, {xs}, {size});
+    graph->AddNode(Node::kChainerSequenceCreate, {}, {init});
+
+    Graph* body = new Graph("body");
+    {
+        Value* iter = body->AddInputValue("iter", Type(Dtype::kInt64, {}));
+        Value* cond = body->AddInputValue("cond", Type(Dtype::kBool, {}));
+        Value* xs_in = body->AddInputValue("xs_in", Type(Type::Kind::kSequence));
+        Value* w_in = body->AddInputValue("w_in", Type(Dtype::kFloat32, {4, 3}));
+        Value* h_in = body->AddInputValue("h_in", Type(Dtype::kFloat32, {5, 4}));
+        Value* ys_in = body->AddInputValue("ys_in", Type(Type::Kind::kSequence));
+        Value* cond_out = body->AddOutputValue("cond_out", Type(Dtype::kBool, {}));
+        Value* xs_out = body->AddOutputValue("xs_out", Type(Type::Kind::kSequence));
+        Value* w_out = body->AddOutputValue("w_out", Type(Dtype::kFloat32, {4, 3}));
+        Value* h_out = body->AddOutputValue("h_out", Type(Dtype::kFloat32, {5, 4}));
+        Value* ys_out = body->AddOutputValue("ys_out", Type(Type::Kind::kSequence));
+        Value* x = body->AddValue("x", type);
+        Value* l = body->AddValue("l", Type(Dtype::kFloat32, {5, 4}));
+        Value* y = body->AddValue("y", Type(Dtype::kFloat32, {5, 4}));
+        body->AddNode(Node::kIdentity, {cond}, {cond_out});
+        body->AddNode(Node::kIdentity, {xs_in}, {xs_out});
+        body->AddNode(Node::kIdentity, {w_in}, {w_out});
+        body->AddNode(Node::kChainerSequenceLookup, {xs_in, iter}, {x});
+        body->AddNode(Node::kChainerLinear, {x, w_in}, {l});
+        if (carry_state) {
+            Value* a = body->AddValue("a", Type(Dtype::kFloat32, {5, 4}));
+            body->AddNode(Node::kAdd, {l, h_in}, {a});
+            body->AddNode(Node::kRelu, {a}, {y});
+            body->AddNode(Node::kIdentity, {y}, {h_out});
+        } else {
+            body->AddNode(Node::kRelu, {l}, {y});
+            body->AddNode(Node::kIdentity, {h_in}, {h_out});
+        }
+        body->AddNode(Node::kChainerSequenceAppend, {ys_in, y}, {ys_out});
+    }
+    Node* loop = graph->AddNode(
+            Node::kLoop,
+            {size, graph->AddNullValue(), xs, w, h, init},
+            {graph->AddValue("xs_final"), graph->AddValue("w_final"), graph->AddValue("h_final"), ys});
+    loop->set_body(body);
+    return loop;
+}
+
+TEST(SequenceBatchingTest, BatchAppendLoop) {
+    CompilerContext context;
+    context.batch_sequence_loops = true;
+    CompilerContextScope scope(&context);
+
+    Graph graph("test");
+    Node* loop = BuildListLoop(&graph, false /* carry_state */);
+    BatchSequenceLoops(&graph);
+
+    EXPECT_TRUE(loop->detached());
+    EXPECT_EQ(1, CountLiveNodes(graph, Node::kChainerSequencePad));
+    EXPECT_EQ(1, CountLiveNodes(graph, Node::kRelu));
+    EXPECT_EQ(0, CountLiveNodes(graph, Node::kChainerSequenceExtend));
+    Node* linear = nullptr;
+    for (Node* node : graph.nodes()) {
+        if (!node->detached() && node->op_type() == Node::kChainerLinear) linear = node;
+    }
+    ASSERT_TRUE(linear);
+    EXPECT_EQ(2, linear->n_batch_axes());
+    EXPECT_EQ(Node::kChainerSequencePad, linear->input(0)->producer()->op_type());
+
+    Value* ys = graph.output_values()[0];
+    Node* forward = ys->producer();
+    ASSERT_EQ(Node::kIdentity, forward->op_type());
+    Node* unpad = forward->input(0)->producer();
+    ASSERT_EQ(Node::kChainerSequenceUnpad, unpad->op_type());
+    EXPECT_EQ(Node::kRelu, unpad->input(0)->producer()->op_type());
+    EXPECT_EQ(Node::kChainerSequenceLengths, unpad->input(1)->producer()->op_type());
+}
+
+TEST(SequenceBatchingTest, KeepLoopWithCarriedState) {
+    CompilerContext context;
+    context.batch_sequence_loops = true;
+    CompilerContextScope scope(&context);
+
+    Graph graph("test");
+    Node* loop = BuildListLoop(&graph, true /* carry_state */);
+    BatchSequenceLoops(&graph);
+
+    EXPECT_FALSE(loop->detached());
+    EXPECT_EQ(0, CountLiveNodes(graph, Node::kChainerSequencePad));
+}
+
+TEST(SequenceBatchingTest, KeepLoopAppendingScalars) {
+    CompilerContext context;
+    context.batch_sequence_loops = true;
+    CompilerContextScope scope(&context);
+
+    // ys = [x * w for x in xs], where elements of `xs` are scalars,
+    // which cannot be padded.
+    Graph graph("test");
+    Type scalar(Dtype::kFloat32, {});
+    Value* xs = graph.AddInputValue("xs", Type(Type::Kind::kSequence));
+    Value* w = graph.AddInputValue("w", scalar);
+    Value* ys = graph.AddOutputValue("ys", Type(Type::Kind::kSequence));
+    Value* size = graph.AddValue("size", Type(Dtype::kInt64, {}));
+    Value* init = graph.AddValue("init", Type(Type::Kind::kSequence));
+    graph.AddNode(Node::kChainerSequenceSize, {xs}, {size});
+    graph.AddNode(Node::kChainerSequenceCreate, {}, {init});
+
+    Graph* body = new Graph("body");
+    {
+        Value* iter = body->AddInputValue("iter", Type(Dtype::kInt64, {}));
+        Value* cond = body->AddInputValue("cond", Type(Dtype::kBool, {}));
+        Value* xs_in = body->AddInputValue("xs_in", Type(Type::Kind::kSequence));
+        Value* w_in = body->AddInputValue("w_in", scalar);
+        Value* ys_in = body->AddInputValue("ys_in", Type(Type::Kind::kSequence));
+        Value* cond_out = body->AddOutputValue("cond_out", Type(Dtype::kBool, {}));
+        Value* xs_out = body->AddOutputValue("xs_out", Type(Type::Kind::kSequence));
+        Value* w_out = body->AddOutputValue("w_out", scalar);
+        Value* ys_out = body->AddOutputValue("ys_out", Type(Type::Kind::kSequence));
+        Value* x = body->AddValue("x", scalar);
+        Value* y = body->AddValue("y", scalar);
+        body->AddNode(Node::kIdentity, {cond}, {cond_out});
+        body->AddNode(Node::kIdentity, {xs_in}, {xs_out});
+        body->AddNode(Node::kIdentity, {w_in}, {w_out});
+        body->AddNode(Node::kChainerSequenceLookup, {xs_in, iter}, {x});
+        body->AddNode(Node::kMul, {x, w_in}, {y});
+        body->AddNode(Node::kChainerSequenceAppend, {ys_in, y}, {ys_out});
+    }
+    Node* loop = graph.AddNode(
+            Node::kLoop, {size, graph.AddNullValue(), xs, w, init}, {graph.AddValue("xs_final"), graph.AddValue("w_final"), ys});
+    loop->set_body(body);
+    BatchSequenceLoops(&graph);
+
+    EXPECT_FALSE(loop->detached());
+    EXPECT_EQ(0, CountLiveNodes(graph, Node::kChainerSequencePad));
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -0,0 +1,305 @@
+#include "compiler/shape_inference.h"
+
+#include <map>
+#include <memory>
+#include <queue>
+#include <set>
+#include <string>
+
+#include <compiler/onnx.h>
+#include <onnx/defs/schema.h>
+#include <onnx/defs/shape_inference.h>
+#include <onnx/shape_inference/implementation.h>
+
+#include <common/log.h>
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+// Values visible from subgraphs by their names.
+typedef std::map<std::string, const Value*> Scope;
+
+// Merges `inferred` into the type of `value` and returns true if the
+// type was changed.
+bool MergeType(const onnx::TypeProto& inferred, Value* value) {
+    onnx::TypeProto existing;
+    value->type().ToONNX(&existing);
+    onnx::TypeProto merged;
+    if (inferred.has_tensor_type() && existing.has_tensor_type()) {
+        onnx::shape_inference::checkShapesAndTypes(inferred.tensor_type(), existing.tensor_type());
+        merged = existing;
+        onnx::shape_inference::mergeShapesAndTypes(inferred.tensor_type(), merged.mutable_tensor_type());
+    } else if (inferred.has_tensor_type() || inferred.has_sequence_type()) {
+        merged = inferred;
+    } else {
+        return false;
+    }
+    if (merged.SerializeAsString() == existing.SerializeAsString()) {
+        return false;
+    }
+    value->set_type(new Type(merged));
+    return true;
+}
+
+class ShapeInferencer {
+public:
+    ShapeInferencer(Graph* graph, const Scope* outer_scope) : graph_(graph), outer_scope_(outer_scope) {
+    }
+
+    void InferAll() {
+        for (Node* node : SortNodes()) {
+            InferNode(node);
+        }
+    }
+
+    void InferIncrementally(const std::vector<Node*>& nodes) {
+        std::queue<Node*> q;
+        std::set<Node*> queued;
+        for (Node* node : nodes) {
+            if (queued.insert(node).second) q.push(node);
+        }
+        // Merging only fills unknown parts of types, so each value
+        // changes a limited number of times.
+        while (!q.empty()) {
+            Node* node = q.front();
+            q.pop();
+            queued.erase(node);
+            for (Value* value : InferNode(node)) {
+                for (Node* user : value->users()) {
+                    if (!user->detached() && queued.insert(user).second) q.push(user);
+                }
+            }
+        }
+    }
+
+    // Returns the type of `value` given to inference functions.
+    void GetType(const Value* value, onnx::TypeProto* xtype) const {
+        if (outer_scope_ && !value->producer() && !value->IsInput()) {
+            // A value defined in an outer graph.
+            auto found = outer_scope_->find(value->name());
+            if (found != outer_scope_->end()) {
+                found->second->type().ToONNX(xtype);
+                return;
+            }
+        }
+        value->type().ToONNX(xtype);
+    }
+
+    // Returns the scope of subgraphs of `graph_`.
+    const Scope* GetInnerScope() {
+        if (!inner_scope_) {
+            inner_scope_.reset(outer_scope_ ? new Scope(*outer_scope_) : new Scope());
+            for (const std::unique_ptr<Value>& value : graph_->all_values()) {
+                if (!value->IsNull()) (*inner_scope_)[value->name()] = value.get();
+            }
+        }
+        return inner_scope_.get();
+    }
+
+private:
+    // Sorts live nodes topologically. Unlike `SortTopologically`, nodes
+    // which use values defined in outer graphs are kept.
+    std::vector<Node*> SortNodes() const {
+        const std::vector<Node*> nodes = graph_->GetLiveNodes();
+        const std::set<Node*> node_set(nodes.begin(), nodes.end());
+        std::map<Node*, int> num_pending_inputs;
+        std::queue<Node*> q;
+        for (Node* node : nodes) {
+            std::set<Value*> inputs;
+            for (Value* value : node->inputs()) {
+                if (value->producer() && node_set.count(value->producer())) inputs.insert(value);
+            }
+            num_pending_inputs[node] = inputs.size();
+            if (inputs.empty()) q.push(node);
+        }
+
+        std::vector<Node*> sorted_nodes;
+        while (!q.empty()) {
+            Node* node = q.front();
+            q.pop();
+            sorted_nodes.push_back(node);
+            for (Value* value : node->outputs()) {
+                const std::set<Node*> users(value->users().begin(), value->users().end());
+                for (Node* user : users) {
+                    if (node_set.count(user) && --num_pending_inputs[user] == 0) q.push(user);
+                }
+            }
+        }
+        return sorted_nodes;
+    }
+
+    // Returns values whose types were changed.
+    std::vector<Value*> InferNode(Node* node);
+
+    Graph* graph_;
+    const Scope* outer_scope_;
+    std::unique_ptr<Scope> inner_scope_;
+};
+
+// Infers a subgraph of a node for the inference function of the node.
+class SubGraphInferencer : public onnx::GraphInferencer {
+public:
+    SubGraphInferencer(Graph* graph, const Scope* scope) : graph_(graph), scope_(scope) {
+    }
+
+    std::vector<const onnx::TypeProto*> doInferencing(
+            const std::vector<const onnx::TypeProto*>& input_types, const std::vector<const onnx::TensorProto*>& input_data) override {
+        const std::vector<Value*>& inputs = graph_->input_values();
+        if (input_types.size() != inputs.size()) {
+            fail_type_inference("Graph has ", inputs.size(), " inputs but ", input_types.size(), " were provided");
+        }
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (input_types[i]) MergeType(*input_types[i], inputs[i]);
+        }
+
+        ShapeInferencer inferencer(graph_, scope_);
+        inferencer.InferAll();
+
+        output_types_.clear();
+        std::vector<const onnx::TypeProto*> output_types;
+        for (const Value* value : graph_->output_values()) {
+            output_types_.emplace_back(new onnx::TypeProto());
+            value->type().ToONNX(output_types_.back().get());
+            output_types.push_back(output_types_.back().get());
+        }
+        return output_types;
+    }
+
+private:
+    Graph* graph_;
+    const Scope* scope_;
+    std::vector<std::unique_ptr<onnx::TypeProto>> output_types_;
+};
+
+class NodeInferenceContext : public onnx::InferenceContext {
+public:
+    NodeInferenceContext(const Node& node, ShapeInferencer* inferencer) : node_(node), inferencer_(inferencer) {
+        for (const Value* value : node.inputs()) {
+            input_types_.emplace_back();
+            if (!value->IsNull()) inferencer->GetType(value, &input_types_.back());
+        }
+        input_data_.resize(node.inputs().size());
+        output_types_.resize(node.outputs().size());
+    }
+
+    // Attributes are converted when inference functions ask them
+    // first. Tensor attributes have only their types and shapes, which
+    // are all inference functions use, and graph attributes are omitted
+    // as subgraphs are inferred by `getGraphAttributeInferencer`.
+    const onnx::AttributeProto* getAttribute(const std::string& name) const override {
+        if (!xattributes_) {
+            xattributes_.reset(new onnx::NodeProto());
+            node_.FillONNXAttributes(xattributes_.get(), true /* shallow */);
+            for (const onnx::AttributeProto& xattr : xattributes_->attribute()) {
+                attributes_.emplace(xattr.name(), &xattr);
+            }
+        }
+        auto found = attributes_.find(name);
+        return found == attributes_.end() ? nullptr : found->second;
+    }
+
+    size_t getNumInputs() const override {
+        return input_types_.size();
+    }
+
+    const onnx::TypeProto* getInputType(size_t index) const override {
+        CHECK_LT(index, input_types_.size());
+        return node_.input(index)->IsNull() ? nullptr : &input_types_[index];
+    }
+
+    // Only tensors of initializers and Constant ops are converted, when
+    // inference functions ask them.
+    const onnx::TensorProto* getInputData(size_t index) const override {
+        CHECK_LT(index, input_data_.size());
+        if (!input_data_[index]) {
+            const Tensor* tensor = node_.input(index)->GetConstTensor();
+            if (!tensor) return nullptr;
+            input_data_[index].reset(new onnx::TensorProto());
+            tensor->ToONNX(input_data_[index].get());
+        }
+        return input_data_[index].get();
+    }
+
+    size_t getNumOutputs() const override {
+        return output_types_.size();
+    }
+
+    onnx::TypeProto* getOutputType(size_t index) override {
+        CHECK_LT(index, output_types_.size());
+        return &output_types_[index];
+    }
+
+    onnx::GraphInferencer* getGraphAttributeInferencer(const std::string& name) override {
+        Graph* graph = nullptr;
+        if (name == "body") {
+            graph = node_.body().get();
+        } else if (name == "then_branch") {
+            graph = node_.then_branch().get();
+        } else if (name == "else_branch") {
+            graph = node_.else_branch().get();
+        } else if (name == "subgraph") {
+            graph = node_.subgraph().get();
+        }
+        if (!graph) return nullptr;
+        graph_inferencers_.emplace_back(new SubGraphInferencer(graph, inferencer_->GetInnerScope()));
+        return graph_inferencers_.back().get();
+    }
+
+private:
+    const Node& node_;
+    ShapeInferencer* inferencer_;
+    mutable std::unique_ptr<onnx::NodeProto> xattributes_;
+    mutable std::map<std::string, const onnx::AttributeProto*> attributes_;
+    std::vector<onnx::TypeProto> input_types_;
+    mutable std::vector<std::unique_ptr<onnx::TensorProto>> input_data_;
+    std::vector<onnx::TypeProto> output_types_;
+    std::vector<std::unique_ptr<SubGraphInferencer>> graph_inferencers_;
+};
+
+std::vector<Value*> ShapeInferencer::InferNode(Node* node) {
+    static const std::unordered_map<std::string, int> opset_imports = OpsetImports();
+    auto found = opset_imports.find(node->domain());
+    if (found == opset_imports.end()) return {};
+    const onnx::OpSchema* schema = onnx::OpSchemaRegistry::Schema(Node::OpTypeToString(node->op_type()), found->second, node->domain());
+    if (!schema || !schema->has_type_and_shape_inference_function()) return {};
+
+    NodeInferenceContext ctx(*node, this);
+    try {
+        schema->GetTypeAndShapeInferenceFunction()(ctx);
+    } catch (const onnx::InferenceError&) {
+        // Like ONNX, continue without types of this node.
+        return {};
+    }
+
+    std::vector<Value*> changed;
+    for (size_t i = 0; i < node->outputs().size(); ++i) {
+        Value* value = node->output(i);
+        if (value->IsNull()) continue;
+        try {
+            if (MergeType(*ctx.getOutputType(i), value)) changed.push_back(value);
+        } catch (const onnx::InferenceError&) {
+            // Keep the known type which conflicts with the inferred one.
+        }
+    }
+    return changed;
+}
+
+}  // namespace
+
+void InferShapes(Graph* graph) {
+    ShapeInferencer inferencer(graph, nullptr);
+    inferencer.InferAll();
+}
+
+void InferShapes(Graph* graph, const std::vector<Node*>& nodes) {
+    ShapeInferencer inferencer(graph, nullptr);
+    inferencer.InferIncrementally(nodes);
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+namespace chainer_compiler {
+
+class Graph;
+class Node;
+
+// Infers types of values in `graph` and its subgraphs by the type and
+// shape inference functions of ONNX op schemas, which include the ones
+// of custom ops. Unlike ONNX's shape inference, the graph is neither
+// serialized nor reconstructed. Inferred types are merged into the
+// known types of values.
+void InferShapes(Graph* graph);
+
+// Infers types of outputs of `nodes` in their order and then re-infers
+// nodes which use values whose types were changed. Passes only need to
+// pass nodes they added or modified.
+void InferShapes(Graph* graph, const std::vector<Node*>& nodes);
+
+}  // namespace chainer_compiler
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <chainerx/testing/context_session.h>
+
+#include <compiler/graph.h>
+#include <compiler/shape_inference.h>
+#include <compiler/tensor.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+TEST(ShapeInferenceTest, InferShapes) {
+    chainerx::testing::ContextSession sess;
+
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {2, 3}));
+    Value* shape = graph.AddInputValue("shape", Type(Dtype::kInt64, {2}));
+    shape->ResetInitializer(std::make_unique<Tensor>("shape", Dtype::kInt64, std::vector<int64_t>{3, 2}, std::vector<int64_t>{3, 2}));
+    Value* y = graph.AddOutputValue("y", Type());
+    Value* t = graph.AddValue("t");
+    // Added in a reversed order.
+    graph.AddNode(Node::kReshape, {t, shape}, {y});
+    graph.AddNode(Node::kRelu, {x}, {t});
+
+    InferShapes(&graph);
+
+    EXPECT_EQ(Dtype::kFloat32, t->type().dtype());
+    EXPECT_EQ(std::vector<int64_t>({2, 3}), t->type().dims());
+    // The shape is taken from the initializer.
+    ASSERT_TRUE(y->type().HasKnownShape());
+    EXPECT_EQ(Dtype::kFloat32, y->type().dtype());
+    EXPECT_EQ(std::vector<int64_t>({3, 2}), y->type().dims());
+}
+
+TEST(ShapeInferenceTest, Incremental) {
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32));
+    Value* y = graph.AddOutputValue("y", Type());
+    Value* t = graph.AddValue("t");
+    Node* relu = graph.AddNode(Node::kRelu, {x}, {t});
+    graph.AddNode(Node::kTranspose, {t}, {y});
+
+    InferShapes(&graph);
+    EXPECT_EQ(Dtype::kFloat32, y->type().dtype());
+    EXPECT_FALSE(y->type().HasKnownShape());
+
+    // Only the touched node is given and the change reaches `y`.
+    x->set_type(new Type(Dtype::kFloat32, {2, 3, 4}));
+    InferShapes(&graph, {relu});
+    ASSERT_TRUE(y->type().HasKnownShape());
+    EXPECT_EQ(std::vector<int64_t>({4, 3, 2}), y->type().dims());
+}
+
+TEST(ShapeInferenceTest, KeepKnownDims) {
+    Graph graph("test");
+    Value* x = graph.AddInputValue("x", Type(Dtype::kFloat32, {-1, 3}));
+    Value* y = graph.AddOutputValue("y", Type(Dtype::kFloat32, {5, -1}));
+    graph.AddNode(Node::kRelu, {x}, {y});
+
+    InferShapes(&graph);
+    EXPECT_EQ(std::vector<int64_t>({5, 3}), y->type().dims());
+}
+
+TEST(ShapeInferenceTest, TensorAttribute) {
+    chainerx::testing::ContextSession sess;
+
+    Graph graph("test");
+    Value* y = graph.AddOutputValue("y", Type());
+    Value* t = graph.AddValue("t");
+    Node* constant = graph.AddNode(Node::kConstant, {}, {t});
+    constant->set_tensor_value(new Tensor("t", Dtype::kInt32, {2, 3}, std::vector<int>{1, 2, 3, 4, 5, 6}));
+    graph.AddNode(Node::kTranspose, {t}, {y})->set_perm({1, 0});
+
+    InferShapes(&graph);
+
+    // The type of a Constant comes from its tensor attribute.
+    EXPECT_EQ(Dtype::kInt32, t->type().dtype());
+    EXPECT_EQ(std::vector<int64_t>({2, 3}), t->type().dims());
+    ASSERT_TRUE(y->type().HasKnownShape());
+    EXPECT_EQ(std::vector<int64_t>({3, 2}), y->type().dims());
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -14,6 +14,7 @@
 #include <compiler/graph_builder.h>
 #include <compiler/log.h>
 #include <compiler/node.h>
+#include <compiler/rewriter.h>
 #include <compiler/value.h>
 #include <configs/backend_config.h>
 
@@ -147,30 +148,34 @@ bool ReplaceScan(Graph* graph, Node* scan) {
 
     {
         GraphBuilder gb(body, "SimplifyScanBody", body->output_values()[0]);
-
-        Value* iter = new Value(gb.GenName(), Type(Dtype::kInt64, {}), Value::Kind::kInput);
-        Value* cond_in = new Value(gb.GenName(), Type(Dtype::kBool, {}), Value::Kind::kInput);
-        Value* cond_out = new Value(gb.GenName(), Type(Dtype::kBool, {}), Value::Kind::kOutput);
+        // New values are added to inputs and outputs of `body`, which
+        // are replaced by `new_loop_inputs` and `new_loop_outputs`.
+        const std::vector<Value*> body_inputs = body->input_values();
+        const std::vector<Value*> body_outputs = body->output_values();
+
+        Value* iter = body->AddValue(gb.GenName(), Type(Dtype::kInt64, {}), Value::Kind::kInput);
+        Value* cond_in = body->AddValue(gb.GenName(), Type(Dtype::kBool, {}), Value::Kind::kInput);
+        Value* cond_out = body->AddValue(gb.GenName(), Type(Dtype::kBool, {}), Value::Kind::kOutput);
         gb.Op(Node::kIdentity, {cond_in}, cond_out);
 
         std::vector<Value*> new_loop_inputs = {iter, cond_in};
         std::vector<Value*> new_loop_outputs = {cond_out};
 
         for (size_t i = 0; i < num_states; ++i) {
-            CHECK_LT(i, body->input_values().size());
-            new_loop_inputs.push_back(body->input_values()[i]);
-            CHECK_LT(i, body->output_values().size());
-            new_loop_outputs.push_back(body->output_values()[i]);
+            CHECK_LT(i, body_inputs.size());
+            new_loop_inputs.push_back(body_inputs[i]);
+            CHECK_LT(i, body_outputs.size());
+            new_loop_outputs.push_back(body_outputs[i]);
         }
 
         for (size_t i = 0; i < num_scan_inputs; ++i) {
             size_t j = i + num_states;
-            CHECK_LT(j, body->input_values().size());
-            Value* orig_input = body->input_values()[j];
+            CHECK_LT(j, body_inputs.size());
+            Value* orig_input = body_inputs[j];
             body->ResetKind(orig_input);
 
-            Value* input_in = new Value(gb.GenName(), Type(), Value::Kind::kInput);
-            Value* input_out = new Value(gb.GenName(), Type(), Value::Kind::kOutput);
+            Value* input_in = body->AddValue(gb.GenName(), Type(), Value::Kind::kInput);
+            Value* input_out = body->AddValue(gb.GenName(), Type(), Value::Kind::kOutput);
             gb.Op(Node::kChainerSequenceLookup, {input_in, iter}, orig_input);
             gb.Op(Node::kIdentity, {input_in}, input_out);
 
@@ -180,12 +185,12 @@ bool ReplaceScan(Graph* graph, Node* scan) {
 
         for (size_t i = 0; i < num_scan_outputs; ++i) {
             size_t j = i + num_states;
-            CHECK_LT(j, body->output_values().size());
-            Value* orig_output = body->output_values()[j];
+            CHECK_LT(j, body_outputs.size());
+            Value* orig_output = body_outputs[j];
             body->ResetKind(orig_output);
 
-            Value* output_in = new Value(gb.GenName(), Type(), Value::Kind::kInput);
-            Value* output_out = new Value(gb.GenName(), Type(), Value::Kind::kOutput);
+            Value* output_in = body->AddValue(gb.GenName(), Type(), Value::Kind::kInput);
+            Value* output_out = body->AddValue(gb.GenName(), Type(), Value::Kind::kOutput);
             gb.Op(Node::kChainerSequenceAppend, {output_in, orig_output}, output_out);
 
             new_loop_inputs.push_back(output_in);
@@ -810,25 +815,14 @@ void Simplify(const BackendConfig& bc, const std::set<std::string>& simplifier_n
         }
     }
 
-    bool replaced = true;
-    while (replaced) {
-        replaced = false;
-        for (Node* node : graph->GetLiveNodes()) {
-            auto found = simplifiers.find(node->op_type());
-            if (found == simplifiers.end()) {
-                continue;
-            }
-            const Simplifier& simplifier = found->second;
-            if (!simplifier_names.count(simplifier.name)) {
-                continue;
-            }
-            if (simplifier.fn(graph, node)) {
-                CLOG() << node->op_type() << " simplified" << std::endl;
-                graph->DetachNode(node);
-                replaced = true;
-            }
+    Rewriter rewriter("Simplify");
+    for (const auto& p : simplifiers) {
+        const Simplifier& simplifier = p.second;
+        if (simplifier_names.count(simplifier.name)) {
+            rewriter.AddRule(p.first, simplifier.name, simplifier.fn, true /* detach */);
         }
     }
+    rewriter.Run(graph);
 }
 
 }  // namespace chainer_compiler
@@ -1,6 +1,14 @@
 #include "compiler/subgraph_canonicalizer.h"
 
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <compiler/onnx.h>
+
 #include <compiler/graph.h>
+#include <compiler/id_map.h>
+#include <compiler/log.h>
 #include <compiler/node.h>
 #include <compiler/type.h>
 #include <compiler/value.h>
@@ -121,10 +129,164 @@ void ResolveExternalDependencies(Graph* graph) {
     }
 }
 
+// Returns true if `node` can be moved out of a loop body, i.e., it
+// always computes the same outputs from the same inputs, has no other
+// effects, and cannot fail. Hoisted nodes run even when the loop runs
+// no iterations, so ops which may CHECK-fail on inputs only valid in
+// the body (e.g., Gather and Reshape) are kept.
+bool IsHoistable(const Node& node) {
+    switch (node.op_type()) {
+        case Node::kShape:
+        case Node::kSize:
+        case Node::kCast:
+        case Node::kNeg:
+        case Node::kAbs:
+        case Node::kSign:
+        case Node::kExp:
+        case Node::kLog:
+        case Node::kSqrt:
+        case Node::kReciprocal:
+        case Node::kSin:
+        case Node::kCos:
+        case Node::kTanh:
+        case Node::kSigmoid:
+        case Node::kRelu:
+        case Node::kSoftplus:
+        case Node::kSoftsign:
+        case Node::kErf:
+        case Node::kFloor:
+        case Node::kCeil:
+        case Node::kNot:
+            return true;
+        case Node::kTranspose:
+            // An explicit permutation may not match the rank.
+            return node.perm().empty();
+        default:
+            return false;
+    }
+}
+
+// Returns true if the loop state is passed to the next iteration as
+// is, which is how `ResolveExternalDependencies` passes values of
+// enclosing scopes.
+bool IsForwardedState(const Value* body_in, const Value* body_out) {
+    const Node* node = body_out->producer();
+    return node && node->op_type() == Node::kIdentity && node->input(0) == body_in;
+}
+
+// Moves invariant nodes in the body of `loop` to `graph`. Values of
+// enclosing scopes, which are forwarded loop states after
+// canonicalization, are the roots of invariants.
+void HoistLoopInvariantsFromLoop(Graph* graph, Node* loop) {
+    Graph* body = loop->body().get();
+    const int num_states = loop->inputs().size() - 2;
+
+    // Values in `body` which are computed in all iterations as their
+    // counterparts in `graph`.
+    IdMap<Value, Value*> outer(body->num_value_ids());
+    for (int i = 0; i < num_states; ++i) {
+        Value* loop_in = loop->input(i + 2);
+        if (loop_in->IsNull() || !IsForwardedState(body->input_values()[i + 2], body->output_values()[i + 1])) continue;
+        outer.emplace(body->input_values()[i + 2], loop_in);
+    }
+    if (outer.empty()) return;
+
+    std::vector<Node*> hoisted;
+    IdSet<Node> hoisted_set(body->num_node_ids());
+    for (Node* node : body->GetTopologicallySortedNodes()) {
+        if (node->op_type() == Node::kIdentity) {
+            if (Value** value = outer.find(node->input(0))) outer.emplace(node->output(0), *value);
+            continue;
+        }
+        if (!IsHoistable(*node)) continue;
+
+        bool invariant = true;
+        for (Value* value : node->inputs()) {
+            if (value->IsNull() || outer.count(value)) continue;
+            if (value->producer() && value->producer()->op_type() == Node::kConstant) continue;
+            invariant = false;
+            break;
+        }
+        if (!invariant) continue;
+
+        std::vector<Value*> inputs;
+        for (Value* value : node->inputs()) {
+            if (value->IsNull()) {
+                inputs.push_back(graph->AddNullValue());
+            } else if (Value** found = outer.find(value)) {
+                inputs.push_back(*found);
+            } else {
+                // Constants in the body are copied as they may be used
+                // by other nodes in the body.
+                onnx::NodeProto xconst;
+                value->producer()->ToONNX(&xconst);
+                Value* copied = graph->AddValue("LICM@" + value->name(), value->type());
+                graph->AddNode(xconst, {}, {copied}, "LICM_" + value->producer()->name());
+                outer.emplace(value, copied);
+                inputs.push_back(copied);
+            }
+        }
+        std::vector<Value*> outputs;
+        for (Value* value : node->outputs()) {
+            outputs.push_back(value->IsNull() ? graph->AddNullValue() : graph->AddValue("LICM@" + value->name(), value->type()));
+        }
+
+        CLOG() << "Hoist " << node->ToString() << " from " << body->name() << std::endl;
+        onnx::NodeProto xnode;
+        node->ToONNX(&xnode);
+        graph->AddNode(xnode, inputs, outputs, "LICM_" + node->name());
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            if (!node->output(i)->IsNull()) outer.emplace(node->output(i), outputs[i]);
+        }
+        hoisted.push_back(node);
+        hoisted_set.emplace(node);
+    }
+
+    // Hoisted values which are still used in the body are passed as
+    // new loop states in the same way as `ResolveExternalDependencies`.
+    std::vector<std::pair<Value*, Value*>> forwarded;
+    for (Node* node : hoisted) {
+        for (Value* value : node->outputs()) {
+            if (value->IsNull()) continue;
+            bool used = value->IsOutput();
+            for (Node* user : value->users()) {
+                if (!hoisted_set.count(user)) used = true;
+            }
+            if (!used) continue;
+
+            int index = body->input_values().size() - 2;
+            Value* new_input = body->AddInputValue("LICMLoopBodyIn@" + value->name(), value->type());
+            Value* new_output = body->AddOutputValue("LICMLoopBodyOut@" + value->name(), value->type(), index + 1);
+            body->AddNode(Node::kIdentity, {new_input}, {new_output}, "LICM");
+            loop->AddInput(*outer.find(value));
+            loop->AddOutput(graph->AddValue("LICMLoopUnusedOut@" + value->name()), index);
+            forwarded.emplace_back(new_input, value);
+        }
+    }
+
+    for (Node* node : hoisted) body->DetachNode(node);
+    for (const auto& p : forwarded) body->AddNode(Node::kIdentity, {p.first}, {p.second}, "LICM");
+}
+
 }  // namespace
 
 void CanonicalizeSubGraphs(Graph* graph) {
     ResolveExternalDependencies(graph);
 }
 
+void HoistLoopInvariants(Graph* graph) {
+    // Copy nodes as hoisted nodes are added to `graph`.
+    const std::vector<Node*> nodes = graph->nodes();
+    for (Node* node : nodes) {
+        if (node->detached()) continue;
+        // Inner loops first so their invariants can be hoisted further.
+        for (Graph* subgraph : node->GetSubGraphs()) {
+            HoistLoopInvariants(subgraph);
+        }
+        if (node->op_type() == Node::kLoop) {
+            HoistLoopInvariantsFromLoop(graph, node);
+        }
+    }
+}
+
 }  // namespace chainer_compiler
@@ -7,4 +7,12 @@ class Graph;
 // Resolve references to values in enclosing scopes.
 void CanonicalizeSubGraphs(Graph* graph);
 
+// Moves nodes which compute the same values in all iterations out of
+// Loop bodies. Subgraphs must be canonicalized by
+// `CanonicalizeSubGraphs`. Nodes in If branches are kept, as hoisting
+// them would compute values which may not be used. For the same
+// reason, only ops which cannot fail are hoisted, as they run even if
+// the loop runs no iterations.
+void HoistLoopInvariants(Graph* graph);
+
 }  // namespace chainer_compiler
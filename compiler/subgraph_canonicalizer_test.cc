@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <compiler/graph.h>
+#include <compiler/node.h>
+#include <compiler/subgraph_canonicalizer.h>
+#include <compiler/type.h>
+#include <compiler/value.h>
+
+namespace chainer_compiler {
+namespace {
+
+int CountLiveNodes(const Graph& graph, Node::OpType op_type) {
+    int count = 0;
+    for (const Node* node : graph.nodes()) {
+        if (!node->detached() && node->op_type() == op_type) ++count;
+    }
+    return count;
+}
+
+TEST(SubGraphCanonicalizerTest, HoistLoopInvariants) {
+    Type type(Dtype::kFloat32, {2, 2});
+    Graph graph("test");
+    Value* max_trip_count = graph.AddInputValue("max_trip_count", Type(Dtype::kInt64, {}));
+    Value* x = graph.AddInputValue("x", type);
+    Value* w = graph.AddInputValue("w", type);
+    Value* y = graph.AddOutputValue("y", type);
+
+    // The body refers `w` of the enclosing graph and transposes it in
+    // all iterations.
+    Graph* body = new Graph("body");
+    {
+        body->AddInputValue("iter", Type(Dtype::kInt64, {}));
+        Value* cond = body->AddInputValue("cond", Type(Dtype::kBool, {}));
+        Value* h = body->AddInputValue("h", type);
+        Value* cond_out = body->AddOutputValue("cond_out", Type(Dtype::kBool, {}));
+        Value* h_out = body->AddOutputValue("h_out", type);
+        Value* outer_w = body->AddValue("w", type);
+        Value* wt = body->AddValue("wt", type);
+        body->AddNode(Node::kIdentity, {cond}, {cond_out});
+        body->AddNode(Node::kTranspose, {outer_w}, {wt});
+        body->AddNode(Node::kMatMul, {h, wt}, {h_out});
+    }
+    Node* loop = graph.AddNode(Node::kLoop, {max_trip_count, graph.AddNullValue(), x}, {y});
+    loop->set_body(body);
+
+    CanonicalizeSubGraphs(&graph);
+    HoistLoopInvariants(&graph);
+
+    EXPECT_EQ(1, CountLiveNodes(graph, Node::kTranspose));
+    EXPECT_EQ(0, CountLiveNodes(*body, Node::kTranspose));
+    // `w` and the transposed `w` are passed as loop states.
+    ASSERT_EQ(5, loop->inputs().size());
+    EXPECT_EQ(w, loop->input(3));
+    EXPECT_EQ(Node::kTranspose, loop->input(4)->producer()->op_type());
+    EXPECT_EQ(3, loop->outputs().size());
+    EXPECT_EQ(y, loop->output(0));
+    EXPECT_EQ(5, body->input_values().size());
+    EXPECT_EQ(4, body->output_values().size());
+
+    Node* matmul = nullptr;
+    for (Node* node : body->nodes()) {
+        if (!node->detached() && node->op_type() == Node::kMatMul) matmul = node;
+    }
+    ASSERT_TRUE(matmul);
+    Node* forward = matmul->input(1)->producer();
+    EXPECT_EQ(Node::kIdentity, forward->op_type());
+    EXPECT_EQ(body->input_values()[4], forward->input(0));
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -152,6 +152,9 @@ Tensor::Tensor(const onnx::TensorProto& xtensor)
 Tensor::Tensor(std::string const& name, chainerx::Array ary) : data_(chainerx::AsContiguous(ary)), name_(name) {
 }
 
+Tensor::Tensor(const std::string& name, const std::vector<std::string>& str) : data_(str), name_(name) {
+}
+
 Tensor::~Tensor() {
     if (data_.index() == 0) {
         CHECK(chx().IsContiguous());
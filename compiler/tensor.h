@@ -35,6 +35,7 @@ public:
 
     Tensor(const std::string& name, const Tensor& t);
     Tensor(const std::string& name, chainerx::Array ary);
+    Tensor(const std::string& name, const std::vector<std::string>& str);
 
     void ToONNX(onnx::TensorProto* xtensor) const;
     std::string DebugString() const;
@@ -0,0 +1,111 @@
+#include "compiler/thread_pool.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <chainerx/context.h>
+#include <chainerx/device.h>
+
+#include <compiler/flags.h>
+
+namespace chainer_compiler {
+
+namespace {
+
+// A `ParallelFor` call which is not finished yet.
+struct Batch {
+    const std::function<void(int64_t)>* fn;
+    CompilerContext* context;
+    // Constant propagation runs ChainerX in tasks.
+    chainerx::Context* chx_context;
+    chainerx::Device* device;
+    int64_t n;
+    // The index of the next task to be started.
+    int64_t next{0};
+    int64_t num_done{0};
+};
+
+class ThreadPool {
+public:
+    // Threads are never stopped as pools live until the process exits.
+    explicit ThreadPool(int num_threads) {
+        for (int i = 0; i < num_threads; ++i) {
+            std::thread([this]() { Work(); }).detach();
+        }
+    }
+
+    void Run(int64_t n, const std::function<void(int64_t)>& fn) {
+        Batch batch{&fn, GetCompilerContext(), &chainerx::GetDefaultContext(), &chainerx::GetDefaultDevice(), n};
+        std::unique_lock<std::mutex> lock(mu_);
+        batches_.push_back(&batch);
+        cond_.notify_all();
+        while (batch.num_done < n) {
+            if (!RunOne(&lock)) {
+                cond_.wait(lock);
+            }
+        }
+    }
+
+private:
+    void Work() {
+        std::unique_lock<std::mutex> lock(mu_);
+        while (true) {
+            if (!RunOne(&lock)) {
+                cond_.wait(lock);
+            }
+        }
+    }
+
+    // Runs a task of the oldest batch without holding `lock`. Returns
+    // false if there is no task to start.
+    bool RunOne(std::unique_lock<std::mutex>* lock) {
+        if (batches_.empty()) return false;
+        Batch* batch = batches_.front();
+        const int64_t index = batch->next++;
+        if (batch->next == batch->n) batches_.pop_front();
+
+        lock->unlock();
+        {
+            CompilerContextScope scope(batch->context);
+            chainerx::ContextScope context_scope(*batch->chx_context);
+            chainerx::DeviceScope device_scope(*batch->device);
+            (*batch->fn)(index);
+        }
+        lock->lock();
+
+        // `batch` may be destroyed once the lock is released after its
+        // last task.
+        if (++batch->num_done == batch->n) cond_.notify_all();
+        return true;
+    }
+
+    std::mutex mu_;
+    std::condition_variable cond_;
+    std::deque<Batch*> batches_;
+};
+
+ThreadPool* GetThreadPool(int num_threads) {
+    static std::mutex mu;
+    // Pools are leaked so tasks can still run while the process exits.
+    static std::map<int, ThreadPool*>* pools = new std::map<int, ThreadPool*>();
+    std::lock_guard<std::mutex> lock(mu);
+    ThreadPool*& pool = (*pools)[num_threads];
+    // The caller runs tasks too.
+    if (!pool) pool = new ThreadPool(num_threads - 1);
+    return pool;
+}
+
+}  // namespace
+
+void ParallelFor(int64_t n, const std::function<void(int64_t)>& fn) {
+    if (g_compiler_threads() <= 1 || n <= 1) {
+        for (int64_t i = 0; i < n; ++i) fn(i);
+        return;
+    }
+    GetThreadPool(g_compiler_threads())->Run(n, fn);
+}
+
+}  // namespace chainer_compiler
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+
+namespace chainer_compiler {
+
+// Runs `fn(i)` for each `i` in [0, n) with up to `g_compiler_threads()`
+// threads and returns when all of them finish. Tasks see the compiler
+// context and the default ChainerX context and device of the caller.
+// The caller also runs tasks while it waits, so `fn` can call
+// `ParallelFor` again.
+void ParallelFor(int64_t n, const std::function<void(int64_t)>& fn);
+
+}  // namespace chainer_compiler
@@ -0,0 +1,59 @@
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <chainerx/context.h>
+#include <chainerx/testing/context_session.h>
+
+#include <compiler/flags.h>
+#include <compiler/thread_pool.h>
+
+namespace chainer_compiler {
+namespace {
+
+TEST(ThreadPoolTest, Nested) {
+    chainerx::testing::ContextSession sess;
+    CompilerContext context;
+    context.compiler_threads = 4;
+    CompilerContextScope scope(&context);
+
+    std::atomic<int64_t> sum{0};
+    std::atomic<int> num_wrong_contexts{0};
+    ParallelFor(10, [&](int64_t i) {
+        ParallelFor(10, [&](int64_t j) {
+            sum += i * 10 + j;
+            if (GetCompilerContext() != &context) ++num_wrong_contexts;
+            if (&chainerx::GetDefaultContext() != &sess.context()) ++num_wrong_contexts;
+        });
+    });
+    EXPECT_EQ(4950, sum);
+    EXPECT_EQ(0, num_wrong_contexts);
+}
+
+TEST(ThreadPoolTest, ConcurrentContexts) {
+    chainerx::testing::ContextSession sess;
+    chainerx::Context* chx_context = &sess.context();
+    std::atomic<int> num_wrong_budgets{0};
+    auto compile = [&num_wrong_budgets, chx_context](int budget) {
+        chainerx::ContextScope chx_scope(*chx_context);
+        CompilerContext context;
+        context.compiler_threads = 3;
+        context.chen_budget = budget;
+        CompilerContextScope scope(&context);
+        for (int i = 0; i < 100; ++i) {
+            ParallelFor(8, [&num_wrong_budgets, budget](int64_t) {
+                if (g_chen_budget() != budget) ++num_wrong_budgets;
+            });
+        }
+    };
+    std::thread t1(compile, 1);
+    std::thread t2(compile, 2);
+    t1.join();
+    t2.join();
+    EXPECT_EQ(0, num_wrong_budgets);
+    EXPECT_EQ(0, GetDefaultCompilerContext()->chen_budget);
+}
+
+}  // namespace
+}  // namespace chainer_compiler
@@ -2,11 +2,13 @@
 
 #include <algorithm>
 #include <climits>
-#include <map>
 #include <queue>
-#include <set>
+#include <stack>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <common/log.h>
+#include <compiler/graph.h>
 #include <compiler/node.h>
 #include <compiler/value.h>
 
@@ -14,48 +16,48 @@ namespace chainer_compiler {
 
 void ClassifyValues(
         const std::vector<Node*>& nodes, std::vector<Value*>* inputs, std::vector<Value*>* outputs, std::vector<Value*>* temps) {
-    std::set<Value*> temp_set;
-    std::set<Value*> input_set;
-    std::map<Value*, int> output_users;
+    // Values are visited in the order of `nodes` and hash tables are
+    // only used for lookups, so the result does not depend on
+    // addresses of values.
+    std::unordered_map<Value*, int> output_users;
+    std::vector<Value*> output_values;
     for (Node* node : nodes) {
-        for (Value* value : node->inputs()) {
-            input_set.insert(value);
-            temp_set.insert(value);
-        }
         for (Value* value : node->outputs()) {
             size_t num_users = value->users().size();
             if (value->IsOutput()) num_users = INT_MAX;
             CHECK(output_users.emplace(value, num_users).second) << value->ToString();
-            temp_set.insert(value);
+            output_values.push_back(value);
         }
     }
 
+    std::unordered_set<Value*> seen_inputs;
+    std::vector<Value*> input_values;
     for (Node* node : nodes) {
         for (Value* value : node->inputs()) {
             auto found = output_users.find(value);
             if (found != output_users.end()) {
                 --found->second;
+            } else if (seen_inputs.insert(value).second) {
+                input_values.push_back(value);
             }
         }
-        for (const auto& p : output_users) {
-            input_set.erase(p.first);
-        }
     }
 
-    inputs->assign(input_set.begin(), input_set.end());
-    for (const auto& p : output_users) {
-        CHECK_LE(0, p.second);
-        if (p.second > 0) outputs->push_back(p.first);
+    *inputs = input_values;
+    for (Value* value : output_values) {
+        const int num_users = output_users[value];
+        CHECK_LE(0, num_users);
+        if (num_users > 0) {
+            outputs->push_back(value);
+        } else {
+            temps->push_back(value);
+        }
     }
 
-    for (Value* value : *inputs) temp_set.erase(value);
-    for (Value* value : *outputs) temp_set.erase(value);
-    temps->assign(temp_set.begin(), temp_set.end());
-
     auto by_name = [](const Value* a, const Value* b) { return a->name() < b->name(); };
-    std::sort(inputs->begin(), inputs->end(), by_name);
-    std::sort(outputs->begin(), outputs->end(), by_name);
-    std::sort(temps->begin(), temps->end(), by_name);
+    std::stable_sort(inputs->begin(), inputs->end(), by_name);
+    std::stable_sort(outputs->begin(), outputs->end(), by_name);
+    std::stable_sort(temps->begin(), temps->end(), by_name);
 }
 
 std::vector<Node*> SortTopologically(const std::vector<Node*>& nodes, const std::vector<Value*>& inputs, bool is_full_graph) {
@@ -64,7 +66,7 @@ std::vector<Node*> SortTopologically(const std::vector<Node*>& nodes, const std:
     for (Value* value : inputs) {
         q.push(value);
     }
-    std::map<Node*, int> input_counts;
+    std::unordered_map<Node*, int> input_counts;
     for (Node* node : nodes) {
         input_counts[node] = node->GetNumActualInputs();
     }
@@ -77,9 +79,9 @@ std::vector<Node*> SortTopologically(const std::vector<Node*>& nodes, const std:
         }
     };
 
-    for (const auto& p : input_counts) {
-        if (p.second == 0) {
-            add_sorted_node(p.first);
+    for (Node* node : nodes) {
+        if (input_counts[node] == 0) {
+            add_sorted_node(node);
         }
     }
 
@@ -104,4 +106,125 @@ std::vector<Node*> SortTopologically(const std::vector<Node*>& nodes, const std:
     return sorted_nodes;
 }
 
+TopologicalOrder::TopologicalOrder(const Graph& graph) {
+    const std::vector<Node*> nodes = graph.GetLiveNodes();
+    std::unordered_map<const Node*, int> input_counts;
+    for (Node* node : nodes) input_counts.emplace(node, 0);
+    for (Node* node : nodes) {
+        for (Value* input : node->inputs()) {
+            if (input->producer() && input_counts.count(input->producer())) ++input_counts[node];
+        }
+    }
+
+    std::queue<Node*> q;
+    for (Node* node : nodes) {
+        if (input_counts[node] == 0) q.push(node);
+    }
+    while (!q.empty()) {
+        Node* node = q.front();
+        q.pop();
+        CHECK(indices_.emplace(node, nodes_.size()).second);
+        nodes_.push_back(node);
+        for (Value* output : node->outputs()) {
+            for (Node* user : output->users()) {
+                auto found = input_counts.find(user);
+                if (found != input_counts.end() && --found->second == 0) q.push(user);
+            }
+        }
+    }
+    CHECK_EQ(nodes.size(), nodes_.size()) << "Cycle in " << graph.name();
+    marks_.resize(nodes_.size());
+}
+
+int TopologicalOrder::GetIndex(const Node* node) const {
+    auto found = indices_.find(node);
+    CHECK(found != indices_.end()) << "Unknown node: " << node->ToString();
+    return found->second;
+}
+
+void TopologicalOrder::RejectCyclicNodes(std::set<Node*>* nodes) {
+    int last = -1;
+    for (Node* node : *nodes) last = std::max(last, GetIndex(node));
+
+    ++epoch_;
+    std::stack<Node*> q;
+    auto push = [this, last, &q](Node* node) {
+        const int index = GetIndex(node);
+        // Nodes after the last of `nodes` cannot reach them.
+        if (index > last || marks_[index] == epoch_) return;
+        marks_[index] = epoch_;
+        q.push(node);
+    };
+    for (Node* node : *nodes) {
+        for (Value* output : node->outputs()) {
+            for (Node* user : output->users()) {
+                if (!nodes->count(user)) push(user);
+            }
+        }
+    }
+
+    std::vector<Node*> rejected;
+    while (!q.empty()) {
+        Node* node = q.top();
+        q.pop();
+        if (nodes->count(node)) rejected.push_back(node);
+        for (Value* output : node->outputs()) {
+            for (Node* user : output->users()) push(user);
+        }
+    }
+
+    for (Node* node : rejected) nodes->erase(node);
+}
+
+void TopologicalOrder::Fuse(const std::set<Node*>& nodes, Node* fused) {
+    int first = INT_MAX;
+    int last = -1;
+    for (Node* node : nodes) {
+        const int index = GetIndex(node);
+        first = std::min(first, index);
+        last = std::max(last, index);
+        indices_.erase(node);
+    }
+    CHECK_LE(first, last);
+
+    // Nodes between `first` and `last` which reach `fused` must come
+    // before it. Nodes before `first` are already ordered. `nodes` have
+    // been moved into the subgraph so the search starts from `fused`.
+    ++epoch_;
+    std::stack<Node*> q;
+    q.push(fused);
+    while (!q.empty()) {
+        Node* node = q.top();
+        q.pop();
+        for (Value* input : node->inputs()) {
+            Node* producer = input->producer();
+            if (!producer) continue;
+            const int index = GetIndex(producer);
+            if (index < first || marks_[index] == epoch_) continue;
+            CHECK_LT(index, last) << "Fusion created a cycle: " << fused->ToString();
+            marks_[index] = epoch_;
+            q.push(producer);
+        }
+    }
+
+    std::vector<Node*> before;
+    std::vector<Node*> after;
+    for (int i = first; i <= last; ++i) {
+        Node* node = nodes_[i];
+        if (!node || nodes.count(node)) continue;
+        (marks_[i] == epoch_ ? before : after).push_back(node);
+    }
+    int index = first;
+    auto place = [this, &index](Node* node) {
+        nodes_[index] = node;
+        indices_[node] = index;
+        marks_[index] = 0;
+        ++index;
+    };
+    for (Node* node : before) place(node);
+    place(fused);
+    for (Node* node : after) place(node);
+    for (; index <= last; ++index) nodes_[index] = nullptr;
+}
+
 }  // namespace chainer_compiler
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 namespace chainer_compiler {
 
+class Graph;
 class Node;
 class Value;
 
@@ -20,4 +23,32 @@ void ClassifyValues(const std::vector<Node*>& nodes, std::vector<Value*>* inputs
 // unreachable from `inputs` will be discarded.
 std::vector<Node*> SortTopologically(const std::vector<Node*>& nodes, const std::vector<Value*>& inputs, bool is_full_graph);
 
+// Keeps a topological order of live nodes in a graph while nodes are
+// fused. Nodes reachable from a node always come after it, so searches
+// for paths back to a set of nodes stop at the last of them instead of
+// visiting the whole downstream.
+class TopologicalOrder {
+public:
+    explicit TopologicalOrder(const Graph& graph);
+
+    // Removes nodes of `nodes` which are reachable from a node of
+    // `nodes` through a node outside of `nodes`. Fusing the remaining
+    // nodes does not create a cycle.
+    void RejectCyclicNodes(std::set<Node*>* nodes);
+
+    // Updates the order after `nodes` were replaced by `fused`. Only
+    // nodes between the first and the last of `nodes` are reordered.
+    void Fuse(const std::set<Node*>& nodes, Node* fused);
+
+    int GetIndex(const Node* node) const;
+
+private:
+    // Nodes by their indices. Slots of fused nodes are nullptr.
+    std::vector<Node*> nodes_;
+    std::unordered_map<const Node*, int> indices_;
+    // Marks of visited nodes by their indices.
+    std::vector<int> marks_;
+    int epoch_{0};
+};
+
 }  // namespace chainer_compiler
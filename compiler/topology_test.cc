@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <common/log.h>
+#include <compiler/fusion.h>
 #include <compiler/graph.h>
 #include <compiler/graph_builder.h>
 #include <compiler/topology.h>
@@ -65,5 +66,54 @@ TEST(TopologyTest, ClassifyValues) {
     }
 }
 
+TEST(TopologyTest, TopologicalOrder) {
+    Type type(Dtype::kFloat32, {});
+    Graph graph("test");
+    Value* input = graph.AddInputValue("input", type);
+    Value* output = graph.AddOutputValue("output", type);
+    Node *op0, *op1, *op2, *op3, *op4;
+    {
+        GraphBuilder gb(&graph, "test", output);
+        Value* temp0 = gb.Op(Node::kTanh, {input});
+        op0 = temp0->producer();
+        Value* temp1 = gb.Op(Node::kTanh, {temp0});
+        op1 = temp1->producer();
+        Value* temp2 = gb.Op(Node::kTanh, {input});
+        op2 = temp2->producer();
+        Value* temp3 = gb.Op(Node::kAdd, {temp0, temp1});
+        op3 = temp3->producer();
+        op4 = gb.Op(Node::kAdd, {temp2, temp3}, output)->producer();
+    }
+
+    TopologicalOrder order(graph);
+    EXPECT_LT(order.GetIndex(op0), order.GetIndex(op1));
+    EXPECT_LT(order.GetIndex(op1), order.GetIndex(op3));
+    EXPECT_LT(order.GetIndex(op3), order.GetIndex(op4));
+
+    {
+        // `op3` is reachable from `op0` through `op1`.
+        std::set<Node*> nodes = {op0, op3};
+        order.RejectCyclicNodes(&nodes);
+        EXPECT_EQ(std::set<Node*>({op0}), nodes);
+    }
+
+    {
+        std::set<Node*> nodes = {op0, op1, op3};
+        order.RejectCyclicNodes(&nodes);
+        EXPECT_EQ(3, nodes.size());
+        Node* fused = CreateFusionGroup(&graph, nodes, "test", 1, false);
+        ASSERT_TRUE(fused);
+        order.Fuse(nodes, fused);
+        EXPECT_LT(order.GetIndex(fused), order.GetIndex(op4));
+    }
+
+    {
+        // `op4` is reachable from `op2` only directly.
+        std::set<Node*> nodes = {op2, op4};
+        order.RejectCyclicNodes(&nodes);
+        EXPECT_EQ(2, nodes.size());
+    }
+}
+
 }  // namespace
 }  // namespace chainer_compiler
@@ -82,7 +82,7 @@ class TVMCompiler {
 public:
     TVMCompiler() {
         host_ = tvm::target::llvm();
-        if (g_use_cuda) {
+        if (g_use_cuda()) {
             target_ = tvm::target::cuda();
         } else {
             target_ = host_;
@@ -164,11 +164,11 @@ public:
 
         tvm::Schedule schedule;
         if (const tvm::PackedFunc* schedule_fn = Py(scheduler_name)) {
-            schedule = (*schedule_fn)(target_, g_autotvm_log, output_tensors);
+            schedule = (*schedule_fn)(target_, g_autotvm_log(), output_tensors);
         }
 
         if (!schedule.get()) {
-            if (g_use_cuda) {
+            if (g_use_cuda()) {
                 if (is_reduction) {
                     schedule = topi::cuda::schedule_reduce(target_, output_tensors);
                 } else {
@@ -195,7 +195,7 @@ public:
         input_files.push_back(obj_filename);
         module->SaveToFile(obj_filename, "o");
 
-        if (g_use_cuda) {
+        if (g_use_cuda()) {
             // TODO(hamaji): Temporarily commented out due to missing
             // `PackImportsToC` in recent TVM.
             CHECK(false) << "TVM+CUDA is temporarily disabled";
@@ -234,7 +234,7 @@ private:
     void DumpConvTask(const Node& node, int pad_h, int pad_w, int stride_h, int stride_w) {
         const Type& input = node.input(0)->type();
         const Type& weight = node.input(1)->type();
-        const std::string& filename = g_dump_autotvm_task_dir + "/" + CleanseIdent(node.output(0)->name()) + ".json";
+        const std::string& filename = g_dump_autotvm_task_dir() + "/" + CleanseIdent(node.output(0)->name()) + ".json";
         std::ofstream ofs(filename);
         CHECK(ofs) << filename;
         dmlc::JSONWriter writer(&ofs);
@@ -272,13 +272,13 @@ private:
             stride_h = node.strides()[1];
         }
 
-        if (!g_dump_autotvm_task_dir.empty()) {
+        if (!g_dump_autotvm_task_dir().empty()) {
             DumpConvTask(node, pad_h, pad_w, stride_h, stride_w);
         }
 
         tvm::Tensor out;
         if (const tvm::PackedFunc* conv2d_fn = Py("chainer_compiler.tvm.conv2d")) {
-            out = (*conv2d_fn)(target_, g_autotvm_log, inputs, pad_h, pad_w, stride_h, stride_w);
+            out = (*conv2d_fn)(target_, g_autotvm_log(), inputs, pad_h, pad_w, stride_h, stride_w);
         }
         if (!out.get()) {
             out = topi::conv2d_nchw(inputs[0], inputs[1], pad_h, pad_w, stride_h, stride_w, GetIdent(node.output(0)));
@@ -309,13 +309,13 @@ private:
             stride_h = node.strides()[1];
         }
 
-        if (!g_dump_autotvm_task_dir.empty()) {
+        if (!g_dump_autotvm_task_dir().empty()) {
             DumpConvTask(node, pad_h, pad_w, stride_h, stride_w);
         }
 
         tvm::Tensor out;
         if (const tvm::PackedFunc* conv2d_fn = Py("chainer_compiler.tvm.conv2d_transpose")) {
-            out = (*conv2d_fn)(target_, g_autotvm_log, inputs, pad_h, pad_w, stride_h, stride_w);
+            out = (*conv2d_fn)(target_, g_autotvm_log(), inputs, pad_h, pad_w, stride_h, stride_w);
         }
         if (!out.get()) {
             CHECK(false) << "C++ TOPI does not have ConvTranspose";
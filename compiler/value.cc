@@ -6,6 +6,7 @@
 #include <common/log.h>
 #include <common/strutil.h>
 #include <compiler/node.h>
+#include <compiler/object_pool.h>
 #include <compiler/serializer_util.h>
 #include <compiler/tensor.h>
 #include <compiler/type.h>
@@ -27,6 +28,16 @@ Value::~Value() {
     CHECK(grad_ == nullptr);
 }
 
+void* Value::operator new(size_t size) {
+    if (size != sizeof(Value)) return ::operator new(size);
+    return ObjectPool<sizeof(Value)>::Allocate();
+}
+
+void Value::operator delete(void* p, size_t size) {
+    if (size != sizeof(Value)) return ::operator delete(p);
+    ObjectPool<sizeof(Value)>::Free(p);
+}
+
 void Value::ToONNX(onnx::ValueInfoProto* xvalue) const {
     DUMP_STRING(xvalue, name);
     type_->ToONNX(xvalue->mutable_type());
@@ -78,20 +89,13 @@ int64_t Value::GetNBytes() const {
     if (type_->kind() != Type::Kind::kOpaque) {
         return type_->GetNBytes();
     }
-    // TODO(hamaji): Put the expected size in `Value` for two phase backprop.
-    if (!producer()) {
-        return -1;
+    if (producer() && producer()->op_type() == Node::kMaxPool && producer()->chainer_compress_indices()) {
+        // An int8 index is kept for each output element.
+        const Type& type = producer()->output(0)->type();
+        return type.HasKnownShape() ? type.NumElements() : -1;
     }
-
-    const Node& node = *producer();
     std::vector<Value*> retained;
-    if (node.op_type() == Node::kBatchNormalization) {
-        retained = node.inputs();
-    } else if (node.op_type() == Node::kMaxPool) {
-        retained = {node.input(0), node.output(0)};
-    } else if (node.op_type() == Node::kAveragePool) {
-        retained = {node.input(0), node.output(0)};
-    } else {
+    if (!GetRetainedValues(&retained)) {
         return -1;
     }
 
@@ -106,6 +110,26 @@ int64_t Value::GetNBytes() const {
     return total;
 }
 
+bool Value::GetRetainedValues(std::vector<Value*>* retained) const {
+    CHECK_EQ(Type::Kind::kOpaque, type_->kind());
+    // TODO(hamaji): Put the expected size in `Value` for two phase backprop.
+    if (!producer()) {
+        return false;
+    }
+
+    const Node& node = *producer();
+    if (node.op_type() == Node::kBatchNormalization) {
+        *retained = node.inputs();
+    } else if (node.op_type() == Node::kMaxPool) {
+        *retained = {node.input(0), node.output(0)};
+    } else if (node.op_type() == Node::kAveragePool) {
+        *retained = {node.input(0), node.output(0)};
+    } else {
+        return false;
+    }
+    return true;
+}
+
 Node* Value::user(int index) const {
     CHECK_LT(index, users_.size());
     return users_[index];
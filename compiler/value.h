@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
@@ -29,6 +30,10 @@ public:
     Value(const Value&) = delete;
     Value& operator=(const Value&) = delete;
 
+    // Values are allocated by `ObjectPool`.
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+
     void ToONNX(onnx::ValueInfoProto* xvalue) const;
     std::string DebugString() const;
     std::string ToString() const;
@@ -50,6 +55,11 @@ public:
         return name_;
     }
 
+    // A dense ID in the graph which owns this value, or -1.
+    int id() const {
+        return id_;
+    }
+
     const Type& type() const {
         return *type_;
     }
@@ -60,6 +70,10 @@ public:
 
     int64_t GetNBytes() const;
 
+    // Returns values an opaque backward context keeps alive, or false
+    // if they are unknown.
+    bool GetRetainedValues(std::vector<Value*>* retained) const;
+
     const std::string& doc_string() const {
         return doc_string_;
     }
@@ -109,6 +123,7 @@ private:
     // This should be used only during gradient calculation.
     Value* grad_ = nullptr;
     int counter_ = 0;
+    int id_ = -1;
 };
 
 std::ostream& operator<<(std::ostream& os, const Value::Kind& kind);
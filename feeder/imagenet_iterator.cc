@@ -25,8 +25,17 @@ chainerx::Array MakeArray(chainerx::Dtype dtype, chainerx::Shape shape, const vo
 }  // namespace
 
 ImageNetIterator::ImageNetIterator(
-        const std::string& labeled_image_dataset, int buf_size, int batch_size, const std::vector<float>& mean, int height, int width)
+        const std::string& labeled_image_dataset,
+        int buf_size,
+        int batch_size,
+        const std::vector<float>& mean,
+        int height,
+        int width,
+        int shard,
+        int num_shards)
     : DataIterator(buf_size), batch_size_(batch_size), mean_(mean), height_(height), width_(width) {
+    CHECK_LE(0, shard);
+    CHECK_LT(shard, num_shards);
     CHECK_EQ(3 * height * width, mean_.size());
     std::ifstream ifs(labeled_image_dataset);
     while (ifs) {
@@ -37,6 +46,16 @@ ImageNetIterator::ImageNetIterator(
     }
     std::mt19937 mt;
     std::shuffle(dataset_.begin(), dataset_.end(), mt);
+    if (num_shards > 1) {
+        // All shards have the same number of examples so data-parallel
+        // workers run the same number of iterations.
+        const size_t shard_size = dataset_.size() / num_shards;
+        std::vector<std::pair<std::string, int>> examples;
+        for (size_t i = 0; i < shard_size; ++i) {
+            examples.push_back(dataset_[i * num_shards + shard]);
+        }
+        dataset_.swap(examples);
+    }
     // std::cerr << dataset_.size() << " examples" << std::endl;
 }
 
@@ -10,8 +10,17 @@
 
 class ImageNetIterator : public DataIterator {
 public:
+    // Only examples of `shard` out of `num_shards` equally sized shards
+    // are used, for data-parallel training.
     explicit ImageNetIterator(
-            const std::string& labeled_image_dataset, int buf_size, int batch_size, const std::vector<float>& mean, int height, int width);
+            const std::string& labeled_image_dataset,
+            int buf_size,
+            int batch_size,
+            const std::vector<float>& mean,
+            int height,
+            int width,
+            int shard = 0,
+            int num_shards = 1);
 
     std::vector<chainerx::Array> GetNextImpl() override;
 
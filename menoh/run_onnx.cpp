@@ -102,8 +102,8 @@ int main(int argc, char** argv) {
     chainer_compiler::runtime::AddCompilerFlags(&args);
     args.parse_check(argc, argv);
     chainer_compiler::runtime::ApplyCompilerFlags(args);
-    chainer_compiler::g_compiler_log |= args.exist("trace") || args.exist("verbose");
-    chainer_compiler::g_backend_name = args.get<std::string>("backend");
+    chainer_compiler::g_compiler_log() |= args.exist("trace") || args.exist("verbose");
+    chainer_compiler::g_backend_name() = args.get<std::string>("backend");
     chainer_compiler::runtime::g_quiet = args.exist("quiet");
 
     std::string onnx_path = args.get<std::string>("onnx");
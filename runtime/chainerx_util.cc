@@ -21,6 +21,7 @@
 #endif
 
 #include <common/log.h>
+#include <runtime/native_conv.h>
 
 namespace chainer_compiler {
 namespace runtime {
@@ -324,6 +325,10 @@ chainerx::Array GroupedConv(
     if (group == 1) {
         return chainerx::Conv(x, w, b, strides, pads);
     }
+    if (IsNativeConvSupported(x, w, group)) {
+        NativeConvAlgorithm algorithm = ChooseNativeConvAlgorithm(x.shape(), w.shape(), strides, group);
+        return NativeConv(x, PackConvWeight(w, algorithm), w.shape(), b, strides, pads, group, algorithm);
+    }
 
     std::vector<chainerx::Array> inputs = SplitByLengths(x, 1, std::vector<int64_t>(group, x.shape()[1] / group));
     std::vector<chainerx::Array> weights = SplitByLengths(w, 0, std::vector<int64_t>(group, w.shape()[0] / group));
@@ -354,6 +359,9 @@ chainerx::Array GroupedConvTranspose(
     if (group == 1) {
         return chainerx::ConvTranspose(x, w, b, strides, pads, out_size);
     }
+    if (pads.size() == 2 && IsNativeConvSupported(x, w, group)) {
+        return NativeConvTranspose(x, w, b, strides, pads, output_shape, group);
+    }
 
     std::vector<chainerx::Array> inputs = SplitByLengths(x, 1, std::vector<int64_t>(group, x.shape()[1] / group));
     std::vector<chainerx::Array> weights = SplitByLengths(w, 0, std::vector<int64_t>(group, w.shape()[0] / group));
@@ -380,6 +388,9 @@ chainerx::Array GroupedConvGradWeight(
         return x.device().backend().CallKernel<chainerx::ConvGradWeightKernel>(
                 w.dtype(), w.shape(), x, gy, strides, pads, false /* cover_all */, absl::nullopt);
     }
+    if (pads.size() == 2 && IsNativeConvSupported(x, w, group)) {
+        return NativeConvGradWeight(w.shape(), x, gy, strides, pads, group);
+    }
 
     chainerx::Shape ws_shape = w.shape();
     ws_shape[0] /= group;
@@ -58,7 +58,18 @@ public:
 
     std::string dump_outputs_dir;
 
+    // Benchmarks native convolution algorithms for each shape and uses
+    // the fastest one.
+    bool tune_conv{false};
+    // A file which keeps results of `tune_conv` across processes.
+    std::string conv_tuning_cache;
+
     std::map<std::string, CustomOpFunc> custom_op_funcs;
+
+    // Called for each output as soon as it is computed, before the
+    // program finishes. Callers can start consuming outputs (e.g.,
+    // all-reduce gradients) while the rest of the program runs.
+    std::function<void(const std::string& name, const ChxVMVar& var)> output_callback;
 };
 
 struct ChxVMInputDesc;
@@ -227,13 +227,15 @@ CHX_OPS = [
     ('ReduceProd', [Array('data'), Ints('axes'), Int('keepdims')], ['reduced']),
 
     ('Linear',
-     [Array('x'), Array('w'), OptionalArray('b'), Int('n_batch_axes')],
+     [Array('x'), Array('w'), OptionalArray('b'), Int('n_batch_axes'),
+      Int('prepack')],
      ['y']),
     ('LinearGradWeight', [Array('x'), Array('gy')], ['gw']),
 
     ('Conv',
      [Array('x'), Array('w'), OptionalArray('b'),
-      Ints('strides'), Ints('pads'), Int('group'), String('auto_pad')], ['y']),
+      Ints('strides'), Ints('pads'), Int('group'), String('auto_pad'),
+      Int('prepack')], ['y']),
     ('ConvTranspose',
      [Array('x'), Array('w'), OptionalArray('b'),
       Ints('strides'), Ints('pads'), Int('group'), Ints('output_shape')],
@@ -303,12 +305,17 @@ CHX_OPS = [
 
     ('Dropout', [Array('data'), Float('ratio')], ['output', 'mask']),
 
+    ('PackBits', [Array('x')], ['bits']),
+    ('MaskByBits', [Array('bits'), Array('x')], ['y']),
+    ('FloatToBFloat16', [Array('x')], ['y']),
+    ('BFloat16ToFloat', [Array('x')], ['y']),
+
     ('Resize', [Array('x'), Array('scales')], ['y']),
     ('ResizeGrad', [Array('x'), Array('scales')], ['y']),
     ('Pad', [Array('data'), Ints('pads'), Float('value')], ['output']),
     ('MaxPool',
      [Array('x'), Ints('kernel_shape'), Ints('strides'), Ints('pads'),
-      Int('cover_all'), String('auto_pad')],
+      Int('cover_all'), String('auto_pad'), Int('compress_indices')],
      ['y', Opaque('ctx')]),
     ('AveragePool',
      [Array('x'), Ints('kernel_shape'), Ints('strides'), Ints('pads'),
@@ -344,10 +351,11 @@ CHX_OPS = [
      [Array('x'), Int('batch_size')],
      ['y']),
 
-    ('MatMul', [Array('a'), Array('b')], ['y']),
+    ('MatMul', [Array('a'), Array('b'), Int('prepack')], ['y']),
     ('Gemm',
      [Array('a'), Array('b'), Array('c'),
-      Float('alpha'), Float('beta'), Int('trans_a'), Int('trans_b')],
+      Float('alpha'), Float('beta'), Int('trans_a'), Int('trans_b'),
+      Int('prepack')],
      ['y']),
 
     ('RNN',
@@ -396,6 +404,23 @@ CHX_OPS = [
      [Array('x'), Array('y'), Array('gy'), Array('unit_scale'),
       Float('alpha'), Float('beta'), Float('bias'), Int('size')], ['gx']),
 
+    # Update parameters in place. See native_optimizer.h.
+    # Gradients are accumulated into `accs` and parameters are updated
+    # only for the last micro-batch if `num_micro_batches` > 1.
+    ('SGDUpdate',
+     [Array('lr'), OptionalArray('micro_batch'), ArrayList('params'),
+      ArrayList('grads'), ArrayList('moms'), ArrayList('accs'),
+      Float('momentum'), Float('weight_decay'), Int('nesterov'),
+      Int('num_micro_batches')],
+     []),
+    ('AdamUpdate',
+     [Array('lr'), Array('step'), OptionalArray('micro_batch'),
+      ArrayList('params'), ArrayList('grads'), ArrayList('ms'), ArrayList('vs'),
+      ArrayList('accs'), Float('beta1'), Float('beta2'), Float('epsilon'),
+      Float('weight_decay'), Int('decoupled_weight_decay'),
+      Int('num_micro_batches')],
+     []),
+
     ('Equal', [Array('a'), Array('b')], ['c']),
     ('Greater', [Array('a'), Array('b')], ['c']),
     ('GreaterEqual', [Array('a'), Array('b')], ['c']),
@@ -449,15 +474,24 @@ CHX_OPS = [
      [Array('x'), Scalar('x_scale'), Scalar('x_zero_point'),
       Array('w'), Array('w_scale'), Array('w_zero_point'),
       Scalar('y_scale'), Scalar('y_zero_point'), OptionalArray('b'),
-      Ints('strides'), Ints('pads'), Int('group'), String('auto_pad')], ['y']),
+      Ints('strides'), Ints('pads'), Int('group'), String('auto_pad'),
+      Int('prepack')], ['y']),
     ('MatMulInteger',
      [Array('a'), Array('b'),
-      OptionalArray('a_zero_point'), OptionalArray('b_zero_point')],
+      OptionalArray('a_zero_point'), OptionalArray('b_zero_point'),
+      Int('prepack')],
      [Array('y')]),
     ('ConvInteger',
      [Array('x'), Array('w'),
       OptionalScalar('x_zero_point'), OptionalArray('w_zero_point'),
-      Ints('strides'), Ints('pads'), Int('group'), String('auto_pad')], ['y']),
+      Ints('strides'), Ints('pads'), Int('group'), String('auto_pad'),
+      Int('prepack')], ['y']),
+    ('WeightOnlyMatMul',
+     [Array('a'), Array('w'), Array('scales'), Int('bits')],
+     [Array('y')]),
+    ('WeightOnlyGather',
+     [Array('data'), Array('scales'), Array('indices'), Int('bits')],
+     [Array('output')]),
     ('Round', [Array('x')], ['y']),
     ('BitShift', [Array('x'), Array('y'), String('direction')], ['z']),
 ]
@@ -489,17 +523,24 @@ CHX_CUSTOM_FIELD_OPS = [
      [ArrayList('outputs')]),
 ]
 
+# Ops which take values of any kinds and keep states in `impl_`.
+CHX_CUSTOM_FIELD_GENERIC_OPS = [
+    # Runs iterations of a loop body `program`, which has no loop
+    # carried dependencies, in parallel. Outputs are sequences of
+    # `scan_names` outputs of the body.
+    ('ParallelLoop',
+     [Array('max_trip_count'), OptionalArray('cond'),
+      ArrayList('inputs'), Strings('input_names'), String('iter_name'),
+      String('cond_name'), Strings('scan_names'), String('program'),
+      Int('num_threads')],
+     [ArrayList('outputs')]),
+]
+
 CHX_SEQ_OPS = [
     ('SequenceCreate', [ArrayList('inputs')], [Sequence('output')]),
-    ('SequenceInsert', [Sequence('seq'), Array('value'), Scalar('index')],
-     [Sequence('output')]),
-    ('SequenceExtend', [Sequence('a'), Sequence('b')], [Sequence('output')]),
-    ('SequenceErase', [Sequence('seq'), Scalar('index')], [Sequence('output')]),
     ('SequenceLookup', [Sequence('seq'), Scalar('index')], [Array('output')]),
     ('SequenceLookupGrad', [Array('gy'), Scalar('size'), Scalar('index')],
      [Sequence('gx')]),
-    ('SequenceUpdate', [Sequence('seq'), Scalar('index'), Array('value')],
-     [Sequence('output')]),
     ('SequenceGetSlice',
      [Sequence('seq'), OptionalScalar('start'),
       OptionalScalar('end'), OptionalScalar('step')],
@@ -525,16 +566,25 @@ CHX_SEQ_OPS = [
      [Sequence('output')]),
     ('SequenceSize', [Sequence('seq')], ['output']),
     ('SequenceLengths', [Sequence('seq')], [Sequence('output')]),
-    ('SequenceCopy', [Sequence('seq')], [Sequence('output')]),
 ]
 
-# Ops which modify the input in-place.
+# Ops which modify the input in-place. Sequences are shared by copies
+# of variables and copied on the first update.
 CHX_SEQ_OPS_UNTYPED = [
     ('SequenceClear', [Sequence('seq')], []),
     ('SequenceAppend', [Sequence('seq'), Array('value')],
      []),
+    ('SequenceInsert', [Sequence('seq'), Array('value'), Scalar('index')],
+     []),
+    ('SequenceExtend', [Sequence('seq'), Sequence('values')], []),
+    ('SequenceErase', [Sequence('seq'), Scalar('index')], []),
+    ('SequenceUpdate', [Sequence('seq'), Scalar('index'), Array('value')],
+     []),
     ('SequencePop', [Sequence('seq')], ['output']),
+    # Takes the sequence of `seq`, which is left empty.
     ('SequenceMove', [Sequence('seq')], [Sequence('output')]),
+    # Shares the sequence of `seq` until either of them is updated.
+    ('SequenceCopy', [Sequence('seq')], [Sequence('output')]),
 ]
 
 CHX_GENERIC_OPS = [
@@ -555,6 +605,16 @@ CHX_GENERIC_OPS = [
     ('GenericAdd', [Array('a'), Array('b')], ['output']),
     ('GenericIs', [Array('a'), Array('b')], ['output']),
     ('GenericAccumulateGrad', [Array('a'), Array('b')], ['output']),
+
+    # Advances a loop: increments `iter`, updates `cond`, moves
+    # `states_out` to `states_in`, appends `scan_values` to
+    # `scan_seqs`, and jumps to `pc` if the loop continues.
+    ('LoopControl',
+     [Array('iter'), Array('cond'), Array('body_cond'),
+      Int('use_body_cond'), OptionalArray('max_trip_count'),
+      ArrayList('states_in'), ArrayList('states_out'),
+      ArrayList('scan_seqs'), ArrayList('scan_values'), Int('pc')],
+     []),
 ]
 
 
@@ -577,8 +637,17 @@ class Op(object):
         self.has_custom_field = has_custom_field
 
 
-CHX_ALL_OPS = [Op(*op) for op in CHX_OPS]
+# Ops in `CHX_OPS` which keep their states across runs (e.g., weights
+# packed for their kernels) in `impl_`.
+CHX_STATEFUL_OPS = ['Linear', 'Conv', 'MatMul', 'Gemm',
+                    'QLinearConv', 'MatMulInteger', 'ConvInteger']
+
+
+CHX_ALL_OPS = [Op(*op, has_custom_field=op[0] in CHX_STATEFUL_OPS)
+               for op in CHX_OPS]
 CHX_ALL_OPS += [Op(*op, has_custom_field=True) for op in CHX_CUSTOM_FIELD_OPS]
 CHX_ALL_OPS += [Op(*op) for op in CHX_SEQ_OPS]
 CHX_ALL_OPS += [Op(*op, typed=False) for op in CHX_SEQ_OPS_UNTYPED]
 CHX_ALL_OPS += [Op(*op, typed=False) for op in CHX_GENERIC_OPS]
+CHX_ALL_OPS += [Op(*op, typed=False, has_custom_field=True)
+                for op in CHX_CUSTOM_FIELD_GENERIC_OPS]
@@ -1,6 +1,7 @@
 #include "runtime/chxvm_state.h"
 
 #include <map>
+#include <utility>
 
 #include <chainerx/routines/logic.h>
 #include <chainerx/routines/manipulation.h>
@@ -59,6 +60,13 @@ ChxVMSequence* ChxVMState::GetSequence(int index) {
     return variables_[index]->GetSequence();
 }
 
+ChxVMSequence* ChxVMState::GetMutableSequence(int index) {
+    CHECK_LE(0, index) << index;
+    CHECK_GT(variables_.size(), index) << index;
+    CHECK(variables_[index].get());
+    return variables_[index]->GetMutableSequence();
+}
+
 const ChxVMOpaque& ChxVMState::GetOpaque(int index) {
     CHECK_LE(0, index) << index;
     CHECK_GT(variables_.size(), index) << index;
@@ -182,6 +190,15 @@ void ChxVMState::FreeVar(int index) {
     variables_[index].reset();
 }
 
+void ChxVMState::MoveVar(int from, int to) {
+    CHECK_LE(0, from) << from;
+    CHECK_GT(variables_.size(), from) << from;
+    CHECK_LE(0, to) << to;
+    CHECK_GT(variables_.size(), to) << to;
+    CHECK(variables_[from].get()) << from;
+    variables_[to] = std::move(variables_[from]);
+}
+
 void ChxVMState::Input(const std::string& name, int index) {
     CHECK_LE(0, index) << index;
     CHECK_GT(variables_.size(), index) << index;
@@ -196,7 +213,11 @@ void ChxVMState::Output(const std::string& name, int index) {
     CHECK_LE(0, index) << index;
     CHECK_GT(variables_.size(), index) << index;
     CHECK(variables_[index].get()) << index;
-    CHECK(outputs_.emplace(name, std::shared_ptr<ChxVMVar>(new ChxVMVar(*variables_[index]))).second) << "Duplicated output name: " << name;
+    auto inserted = outputs_.emplace(name, std::shared_ptr<ChxVMVar>(new ChxVMVar(*variables_[index])));
+    CHECK(inserted.second) << "Duplicated output name: " << name;
+    if (options_.output_callback) {
+        options_.output_callback(name, *inserted.first->second);
+    }
 }
 
 void ChxVMState::ReportInvalidInOuts(const std::vector<int>& inputs, const std::vector<int>& outputs) {
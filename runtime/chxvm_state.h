@@ -34,12 +34,17 @@ public:
     absl::optional<chainerx::Array> GetOptionalArray(int index);
     void SetArray(int index, const chainerx::Array& value);
     void FreeVar(int index);
+    // Moves the variable at `from` to `to` without copying it. `from`
+    // will be unset and the variable at `to` is overwritten.
+    void MoveVar(int from, int to);
 
     std::vector<chainerx::Array> GetArrayList(const std::vector<int>& index);
     void SetArrayList(const std::vector<int>& index, const std::vector<chainerx::Array>& vars);
 
     ChxVMSequence* CreateSequence(int index);
     ChxVMSequence* GetSequence(int index);
+    // See `ChxVMVar::GetMutableSequence`.
+    ChxVMSequence* GetMutableSequence(int index);
 
     const ChxVMOpaque& GetOpaque(int index);
     void SetOpaque(int index, ChxVMOpaque* opaque);
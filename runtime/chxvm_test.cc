@@ -1,8 +1,11 @@
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include <chainerx/array.h>
+#include <chainerx/error.h>
 #include <chainerx/numeric.h>
 #include <chainerx/routines/creation.h>
 #include <chainerx/testing/array.h>
@@ -40,6 +43,188 @@ TEST(ChxVMTest, Run) {
     EXPECT_ARRAY_EQ(e, outputs["out"]->GetArray());
 }
 
+TEST(ChxVMTest, LoopControl) {
+    chainerx::testing::ContextSession sess;
+
+    const int kInt64 = static_cast<int>(chainerx::Dtype::kInt64);
+    const int kBool = static_cast<int>(chainerx::Dtype::kBool);
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "in");
+    chxvm::AddIntScalarConstantOp(&program, chxvm::ChxVMValue(1), 0, kInt64, true);
+    chxvm::AddIntScalarConstantOp(&program, chxvm::ChxVMValue(2), 1, kBool, true);
+    chxvm::AddIntScalarConstantOp(&program, chxvm::ChxVMValue(3), 3, kInt64, true);
+    chxvm::AddIdentityOp(&program, chxvm::ChxVMValue(4), 0);
+    // Doubles the state three times.
+    const int loop_begin = program.instructions_size();
+    chxvm::AddAddOp(&program, chxvm::ChxVMValue(5), 4, 4);
+    chxvm::AddIntScalarConstantOp(&program, chxvm::ChxVMValue(6), 1, kBool, true);
+    chxvm::AddLoopControlOp(&program, 1, 2, 6, true, 3, {4}, {5}, {}, {}, loop_begin);
+    chxvm::AddOutOp(&program, "out", 4);
+    chxvm::AddOutOp(&program, "iter", 1);
+
+    ChxVM chxvm(program);
+    InOuts inputs;
+    inputs.emplace("in", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::testing::BuildArray({2}).WithData<float>({1, 2}))));
+    InOuts outputs = chxvm.Run(inputs, ChxVMOptions());
+    ASSERT_EQ(1, outputs.count("out"));
+    chainerx::Array e = chainerx::testing::BuildArray({2}).WithData<float>({8, 16});
+    EXPECT_ARRAY_EQ(e, outputs["out"]->GetArray());
+    ASSERT_EQ(1, outputs.count("iter"));
+    EXPECT_EQ(3, static_cast<int64_t>(outputs["iter"]->GetScalar()));
+}
+
+TEST(ChxVMTest, CopyOnWriteSequence) {
+    chainerx::testing::ContextSession sess;
+
+    const int kInt64 = static_cast<int>(chainerx::Dtype::kInt64);
+    ChxVMProgramProto program;
+    chxvm::AddSequenceCreateOp(&program, chxvm::ChxVMValue(0), {});
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "in");
+    chxvm::AddSequenceAppendOp(&program, 0, 1);
+    // The copy shares the sequence until it is updated.
+    chxvm::AddSequenceCopyOp(&program, chxvm::ChxVMValue(2), 0);
+    chxvm::AddSequenceAppendOp(&program, 2, 1);
+    chxvm::AddSequenceMoveOp(&program, chxvm::ChxVMValue(3), 2);
+    chxvm::AddIntScalarConstantOp(&program, chxvm::ChxVMValue(4), 0, kInt64, true);
+    chxvm::AddSequenceEraseOp(&program, 3, 4);
+    chxvm::AddSequenceExtendOp(&program, 0, 3);
+    chxvm::AddOutOp(&program, "s0", 0);
+    chxvm::AddOutOp(&program, "s2", 2);
+    chxvm::AddOutOp(&program, "s3", 3);
+
+    ChxVM chxvm(program);
+    InOuts inputs;
+    inputs.emplace("in", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::testing::BuildArray({2}).WithData<float>({1, 2}))));
+    InOuts outputs = chxvm.Run(inputs, ChxVMOptions());
+    ASSERT_EQ(1, outputs.count("s0"));
+    EXPECT_EQ(2, outputs["s0"]->GetSequence()->size());
+    // `s2` is left empty by SequenceMove.
+    ASSERT_EQ(1, outputs.count("s2"));
+    EXPECT_EQ(0, outputs["s2"]->GetSequence()->size());
+    ASSERT_EQ(1, outputs.count("s3"));
+    EXPECT_EQ(1, outputs["s3"]->GetSequence()->size());
+}
+
+// A body of ParallelLoop which computes `y = iter + x`.
+ChxVMProgramProto MakeAddIterBody() {
+    ChxVMProgramProto body;
+    chxvm::AddInOp(&body, chxvm::ChxVMValue(0), "iter");
+    chxvm::AddInOp(&body, chxvm::ChxVMValue(1), "x");
+    chxvm::AddCastOp(&body, chxvm::ChxVMValue(2), 0, static_cast<int>(chainerx::Dtype::kFloat32));
+    chxvm::AddAddOp(&body, chxvm::ChxVMValue(3), 2, 1);
+    chxvm::AddOutOp(&body, "y", 3);
+    return body;
+}
+
+// Runs `body` for `n` iterations by ParallelLoop and outputs the
+// sequence of `y` as `ys`. `body` takes `inputs` of the program.
+ChxVMProgramProto MakeParallelLoop(const ChxVMProgramProto& body, const std::vector<std::string>& inputs, int num_threads) {
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "n");
+    std::vector<int> input_ids;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        input_ids.push_back(i + 1);
+        chxvm::AddInOp(&program, chxvm::ChxVMValue(i + 1), inputs[i]);
+    }
+    std::string serialized;
+    body.SerializeToString(&serialized);
+    const int ys = inputs.size() + 1;
+    chxvm::AddParallelLoopOp(
+            &program, {chxvm::ChxVMValue(ys)}, 0, -1, input_ids, inputs, "iter", "cond", {"y"}, serialized, num_threads);
+    chxvm::AddOutOp(&program, "ys", ys);
+    return program;
+}
+
+// The same loop as `MakeParallelLoop` with `MakeAddIterBody` by
+// LoopControl.
+ChxVMProgramProto MakeSequentialAddIterLoop(int64_t n) {
+    const int kInt64 = static_cast<int>(chainerx::Dtype::kInt64);
+    const int kBool = static_cast<int>(chainerx::Dtype::kBool);
+    ChxVMProgramProto program;
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(0), "n");
+    chxvm::AddInOp(&program, chxvm::ChxVMValue(1), "x");
+    chxvm::AddIntScalarConstantOp(&program, chxvm::ChxVMValue(2), 0, kInt64, true);
+    chxvm::AddIntScalarConstantOp(&program, chxvm::ChxVMValue(3), n > 0, kBool, true);
+    chxvm::AddSequenceCreateOp(&program, chxvm::ChxVMValue(4), {});
+    const int jmp = program.instructions_size();
+    chxvm::AddJmpFalseOp(&program, 3, -1);
+    const int loop_begin = program.instructions_size();
+    chxvm::AddCastOp(&program, chxvm::ChxVMValue(5), 2, static_cast<int>(chainerx::Dtype::kFloat32));
+    chxvm::AddAddOp(&program, chxvm::ChxVMValue(6), 5, 1);
+    chxvm::AddFreeOp(&program, 5);
+    chxvm::AddIntScalarConstantOp(&program, chxvm::ChxVMValue(7), 1, kBool, true);
+    chxvm::AddLoopControlOp(&program, 2, 3, 7, true, 0, {}, {}, {4}, {6}, loop_begin);
+    // Skips the body for zero trips.
+    program.mutable_instructions(jmp)->mutable_inputs(1)->set_i(program.instructions_size());
+    chxvm::AddOutOp(&program, "ys", 4);
+    return program;
+}
+
+InOuts RunLoop(const ChxVMProgramProto& program, int64_t n, const chainerx::Array& x) {
+    ChxVM chxvm(program);
+    InOuts inputs;
+    inputs.emplace("n", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::testing::BuildArray({}).WithData<int64_t>({n}))));
+    inputs.emplace("x", std::shared_ptr<ChxVMVar>(new ChxVMVar(x)));
+    return chxvm.Run(inputs, ChxVMOptions());
+}
+
+TEST(ChxVMTest, ParallelLoopMatchesLoopControl) {
+    chainerx::testing::ContextSession sess;
+
+    chainerx::Array x = chainerx::testing::BuildArray({2}).WithData<float>({1, 2});
+    const ChxVMProgramProto body = MakeAddIterBody();
+    // Zero trips, fewer, and more iterations than threads.
+    for (int64_t n : {0, 1, 3, 17}) {
+        SCOPED_TRACE(n);
+        InOuts expected = RunLoop(MakeSequentialAddIterLoop(n), n, x);
+        InOuts actual = RunLoop(MakeParallelLoop(body, {"x"}, 4), n, x);
+        ASSERT_EQ(1, expected.count("ys"));
+        ASSERT_EQ(1, actual.count("ys"));
+        const ChxVMSequence& expected_ys = *expected["ys"]->GetSequence();
+        const ChxVMSequence& actual_ys = *actual["ys"]->GetSequence();
+        ASSERT_EQ(n, expected_ys.size());
+        ASSERT_EQ(n, actual_ys.size());
+        for (int64_t i = 0; i < n; ++i) {
+            EXPECT_ARRAY_EQ(expected_ys[i].GetArray(), actual_ys[i].GetArray());
+        }
+    }
+}
+
+TEST(ChxVMTest, ParallelLoopException) {
+    chainerx::testing::ContextSession sess;
+
+    // A body which computes `y = xs[iter] + w`.
+    ChxVMProgramProto body;
+    chxvm::AddInOp(&body, chxvm::ChxVMValue(0), "iter");
+    chxvm::AddInOp(&body, chxvm::ChxVMValue(1), "xs");
+    chxvm::AddInOp(&body, chxvm::ChxVMValue(2), "w");
+    chxvm::AddSequenceLookupOp(&body, chxvm::ChxVMValue(3), 1, 0);
+    chxvm::AddAddOp(&body, chxvm::ChxVMValue(4), 3, 2);
+    chxvm::AddOutOp(&body, "y", 4);
+    ChxVM chxvm(MakeParallelLoop(body, {"xs", "w"}, 4));
+
+    const int64_t n = 9;
+    auto run = [&chxvm, n](int64_t bad_index) {
+        auto xs = std::make_shared<ChxVMSequence>();
+        for (int64_t i = 0; i < n; ++i) {
+            // Only the element at `bad_index` cannot be added to `w`.
+            const int64_t size = i == bad_index ? 3 : 2;
+            xs->emplace_back(chainerx::Zeros({size}, chainerx::Dtype::kFloat32));
+        }
+        InOuts inputs;
+        inputs.emplace("n", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::testing::BuildArray({}).WithData<int64_t>({n}))));
+        inputs.emplace("xs", std::make_shared<ChxVMVar>(xs));
+        inputs.emplace("w", std::shared_ptr<ChxVMVar>(new ChxVMVar(chainerx::testing::BuildArray({2}).WithData<float>({1, 2}))));
+        return chxvm.Run(inputs, ChxVMOptions());
+    };
+
+    EXPECT_THROW(run(5), chainerx::DimensionError);
+    // Workers are still usable after the failure.
+    InOuts outputs = run(-1);
+    ASSERT_EQ(1, outputs.count("ys"));
+    EXPECT_EQ(n, outputs["ys"]->GetSequence()->size());
+}
+
 }  // namespace
 }  // namespace runtime
 }  // namespace chainer_compiler
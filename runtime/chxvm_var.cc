@@ -63,6 +63,12 @@ ChxVMSequence* ChxVMVar::GetSequence() const {
     return absl::get<std::shared_ptr<ChxVMSequence>>(val_).get();
 }
 
+ChxVMSequence* ChxVMVar::GetMutableSequence() {
+    std::shared_ptr<ChxVMSequence>& seq = absl::get<std::shared_ptr<ChxVMSequence>>(val_);
+    if (seq.use_count() > 1) seq = std::make_shared<ChxVMSequence>(*seq);
+    return seq.get();
+}
+
 ChxVMOpaque* ChxVMVar::GetOpaque() const {
     return absl::get<std::shared_ptr<ChxVMOpaque>>(val_).get();
 }
@@ -82,6 +88,10 @@ const chainerx::Shape& ChxVMVar::GetShape() const {
     return absl::get<chainerx::Shape>(val_);
 }
 
+const std::vector<std::string>& ChxVMVar::GetString() const {
+    return absl::get<std::vector<std::string>>(val_);
+}
+
 int64_t ChxVMVar::GetNBytes() const {
     int64_t size = 0;
     switch (kind()) {
@@ -57,12 +57,20 @@ public:
     explicit ChxVMVar(StrictScalar scalar);
     explicit ChxVMVar(const std::vector<std::string>& str);
     explicit ChxVMVar(const ChxVMVar&) = default;
+    ChxVMVar(ChxVMVar&&) = default;
+    ChxVMVar& operator=(const ChxVMVar&) = default;
+    ChxVMVar& operator=(ChxVMVar&&) = default;
 
     const chainerx::Array& GetArray() const;
     ChxVMSequence* GetSequence() const;
+    // Returns the sequence to be updated in place. Sequences are shared
+    // by copies of variables, so the sequence is copied if it is also
+    // referenced by other variables.
+    ChxVMSequence* GetMutableSequence();
     ChxVMOpaque* GetOpaque() const;
     const StrictScalar& GetScalar() const;
     const chainerx::Shape& GetShape() const;
+    const std::vector<std::string>& GetString() const;
 
     Kind kind() const {
         return static_cast<Kind>(val_.index());
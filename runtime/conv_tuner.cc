@@ -0,0 +1,138 @@
+#include "runtime/conv_tuner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+#include <common/log.h>
+#include <common/strutil.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+constexpr int kNumBenchmarkIterations = 3;
+
+std::string GetTuningKey(
+        const chainerx::Shape& x_shape,
+        const chainerx::Shape& w_shape,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group) {
+    return StrCat(
+            "x=",
+            JoinString(x_shape, ","),
+            " w=",
+            JoinString(w_shape, ","),
+            " s=",
+            JoinString(strides, ","),
+            " p=",
+            JoinString(pads, ","),
+            " g=",
+            group);
+}
+
+double BenchmarkNativeConv(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group,
+        NativeConvAlgorithm algorithm) {
+    const chainerx::Array packed_w = PackConvWeight(w, algorithm);
+    // Warm up.
+    NativeConv(x, packed_w, w.shape(), b, strides, pads, group, algorithm);
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < kNumBenchmarkIterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        NativeConv(x, packed_w, w.shape(), b, strides, pads, group, algorithm);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+}  // namespace
+
+ConvAlgorithmTuner* ConvAlgorithmTuner::GetInstance() {
+    static ConvAlgorithmTuner* tuner = new ConvAlgorithmTuner();
+    return tuner;
+}
+
+NativeConvAlgorithm ConvAlgorithmTuner::Select(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group,
+        bool tune,
+        const std::string& cache_path) {
+    std::lock_guard<std::mutex> lock(mu_);
+    LoadIfNeeded(cache_path);
+
+    const std::string key = GetTuningKey(x.shape(), w.shape(), strides, pads, group);
+    auto found = table_.find(key);
+    if (found != table_.end()) {
+        return found->second;
+    }
+    if (!tune) {
+        return ChooseNativeConvAlgorithm(x.shape(), w.shape(), strides, group);
+    }
+
+    NativeConvAlgorithm best_algorithm = NativeConvAlgorithm::kIm2Col;
+    double best_elapsed = std::numeric_limits<double>::max();
+    for (NativeConvAlgorithm algorithm : GetNativeConvAlgorithmCandidates(w.shape(), strides, group)) {
+        double elapsed = BenchmarkNativeConv(x, w, b, strides, pads, group, algorithm);
+        if (elapsed < best_elapsed) {
+            best_elapsed = elapsed;
+            best_algorithm = algorithm;
+        }
+    }
+    table_.emplace(key, best_algorithm);
+    if (!cache_path.empty()) {
+        Save(cache_path);
+    }
+    return best_algorithm;
+}
+
+void ConvAlgorithmTuner::LoadIfNeeded(const std::string& cache_path) {
+    if (cache_path.empty() || cache_path == loaded_path_) {
+        return;
+    }
+    loaded_path_ = cache_path;
+    std::ifstream ifs(cache_path);
+    if (!ifs) {
+        return;
+    }
+    std::string line;
+    while (std::getline(ifs, line)) {
+        std::vector<std::string> toks = SplitString(line, "\t");
+        NativeConvAlgorithm algorithm;
+        if (toks.size() != 2 || !ParseNativeConvAlgorithm(toks[1], &algorithm)) {
+            WARN_ONCE(StrCat("Broken conv tuning cache: ", cache_path));
+            continue;
+        }
+        table_.emplace(toks[0], algorithm);
+    }
+}
+
+void ConvAlgorithmTuner::Save(const std::string& cache_path) const {
+    const std::string tmp_path = cache_path + ".tmp";
+    {
+        std::ofstream ofs(tmp_path);
+        CHECK(ofs) << "Failed to open conv tuning cache: " << tmp_path;
+        for (const auto& p : table_) {
+            ofs << p.first << '\t' << GetNativeConvAlgorithmName(p.second) << '\n';
+        }
+    }
+    CHECK_EQ(0, std::rename(tmp_path.c_str(), cache_path.c_str())) << "Failed to write conv tuning cache: " << cache_path;
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <absl/types/optional.h>
+
+#include <chainerx/array.h>
+
+#include <runtime/chainerx_util.h>
+#include <runtime/native_conv.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// Selects the native convolution algorithm for each convolution
+// configuration, cuDNN's `cudnnFindConvolutionForwardAlgorithm` style.
+// Benchmark results are shared in the process and can be persisted to
+// a file so later processes (or an offline tuning run) skip
+// benchmarking.
+class ConvAlgorithmTuner {
+public:
+    static ConvAlgorithmTuner* GetInstance();
+
+    // Returns the algorithm recorded for the configuration. If nothing
+    // is recorded, all candidates are benchmarked with `x` and `w` and
+    // the fastest one is recorded when `tune` is true. Otherwise, the
+    // result of `ChooseNativeConvAlgorithm` is returned. `cache_path`
+    // can be empty.
+    NativeConvAlgorithm Select(
+            const chainerx::Array& x,
+            const chainerx::Array& w,
+            const absl::optional<chainerx::Array>& b,
+            const Int64StackVector& strides,
+            const Int64StackVector& pads,
+            int group,
+            bool tune,
+            const std::string& cache_path);
+
+private:
+    ConvAlgorithmTuner() = default;
+
+    void LoadIfNeeded(const std::string& cache_path);
+    void Save(const std::string& cache_path) const;
+
+    std::mutex mu_;
+    std::string loaded_path_;
+    std::map<std::string, NativeConvAlgorithm> table_;
+};
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,47 @@
+#include "runtime/gradient_accumulator.h"
+
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/manipulation.h>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <runtime/chxvm_var.h>
+#include <runtime/native_optimizer.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+std::vector<chainerx::Array> SplitBatch(const chainerx::Array& batch, int64_t num_micro_batches) {
+    CHECK_LT(0, batch.ndim());
+    CHECK_EQ(0, batch.shape()[0] % num_micro_batches) << "Batch size " << batch.shape()[0] << " is not divisible by "
+                                                      << num_micro_batches;
+    return chainerx::Split(batch, num_micro_batches, 0);
+}
+
+GradientAccumulator::GradientAccumulator(int64_t num_micro_batches) : num_micro_batches_(num_micro_batches) {
+    CHECK_LT(0, num_micro_batches);
+}
+
+bool GradientAccumulator::Add(const InOuts& outputs) {
+    std::vector<chainerx::Array> grads, accs;
+    for (const auto& p : outputs) {
+        if (!HasPrefix(p.first, "grad_out@")) continue;
+        CHECK(p.second->IsArray()) << "Only an array can be a gradient: " << p.first;
+        const chainerx::Array& grad = p.second->GetArray();
+        auto found = grads_.find(p.first);
+        if (found == grads_.end()) {
+            CHECK_EQ(0, micro_batch_) << "New gradient in the middle of a batch: " << p.first;
+            found = grads_.emplace(p.first, std::make_shared<ChxVMVar>(chainerx::EmptyLike(grad))).first;
+        }
+        grads.push_back(grad);
+        accs.push_back(found->second->GetArray());
+    }
+    CHECK_EQ(grads_.size(), accs.size()) << "Missing gradients";
+
+    const bool is_last = AccumulateGradients(grads, accs, micro_batch_, num_micro_batches_);
+    micro_batch_ = is_last ? 0 : micro_batch_ + 1;
+    return is_last;
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <chainerx/array.h>
+
+#include <runtime/chxvm.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// Splits a batch along the first axis into `num_micro_batches` views.
+std::vector<chainerx::Array> SplitBatch(const chainerx::Array& batch, int64_t num_micro_batches);
+
+// Accumulates gradients of parameters (`grad_out@` outputs of a
+// training graph) of micro-batches into persistent buffers. The
+// buffers are allocated for the first micro-batch and updated in place
+// afterwards, including the micro-batches of later batches.
+class GradientAccumulator {
+public:
+    explicit GradientAccumulator(int64_t num_micro_batches);
+
+    // Accumulates `grad_out@` values in `outputs`. Returns true when the
+    // last micro-batch is added, and `grads()` has the mean gradients.
+    bool Add(const InOuts& outputs);
+
+    // Mean gradients keyed by `grad_out@` names, valid until the next
+    // call of `Add`.
+    const InOuts& grads() const {
+        return grads_;
+    }
+
+    int64_t num_micro_batches() const {
+        return num_micro_batches_;
+    }
+
+private:
+    const int64_t num_micro_batches_;
+    int64_t micro_batch_{0};
+    InOuts grads_;
+};
+
+}  // namespace runtime
+}  // namespace chainer_compiler
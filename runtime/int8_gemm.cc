@@ -0,0 +1,137 @@
+#include "runtime/int8_gemm.h"
+
+#include <cstring>
+#include <type_traits>
+
+#if defined(__AVX2__) || (defined(__AVX512VNNI__) && defined(__AVX512BW__))
+#include <immintrin.h>
+#endif
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+// Loads l[0..3], filling bytes beyond `k` with zeros.
+template <class LT>
+uint32_t LoadQuad(const LT* l, int64_t k) {
+    uint32_t v = 0;
+    std::memcpy(&v, l, k >= 4 ? 4 : k);
+    return v;
+}
+
+template <class LT, class RT>
+void Int8GemmScalar(int64_t m, int64_t n, int64_t j0, int64_t k, const LT* l, int64_t ld_l, const RT* r, int32_t* c, int64_t ld_c) {
+    const int64_t kq = GetInt8PaddedK(k) / 4;
+    for (int64_t i = 0; i < m; ++i) {
+        for (int64_t j = j0; j < n; ++j) {
+            int32_t sum = 0;
+            for (int64_t q = 0; q < kq; ++q) {
+                const RT* rq = r + (q * n + j) * 4;
+                for (int64_t t = 0; t < 4 && q * 4 + t < k; ++t) {
+                    sum += static_cast<int32_t>(l[i * ld_l + q * 4 + t]) * static_cast<int32_t>(rq[t]);
+                }
+            }
+            c[i * ld_c + j] = sum;
+        }
+    }
+}
+
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+
+constexpr int64_t kLanes = 16;
+
+// Computes 16 columns from `j` of a single row.
+template <class LT, class RT>
+void Int8GemmRow(int64_t n, int64_t j, int64_t k, const LT* l, const RT* r, int32_t* c) {
+    const int64_t kq = GetInt8PaddedK(k) / 4;
+    __m512i acc = _mm512_setzero_si512();
+    for (int64_t q = 0; q < kq; ++q) {
+        const __m512i lv = _mm512_set1_epi32(LoadQuad(l + q * 4, k - q * 4));
+        const __m512i rv = _mm512_loadu_si512(r + (q * n + j) * 4);
+        // vpdpbusd multiplies unsigned bytes of the first operand by
+        // signed bytes of the second.
+        if (std::is_same<LT, uint8_t>::value) {
+            acc = _mm512_dpbusd_epi32(acc, lv, rv);
+        } else {
+            acc = _mm512_dpbusd_epi32(acc, rv, lv);
+        }
+    }
+    _mm512_storeu_si512(c + j, acc);
+}
+
+#elif defined(__AVX2__)
+
+constexpr int64_t kLanes = 8;
+
+template <class T>
+__m256i WidenBytes(__m128i v) {
+    return std::is_same<T, uint8_t>::value ? _mm256_cvtepu8_epi16(v) : _mm256_cvtepi8_epi16(v);
+}
+
+// Computes 8 columns from `j` of a single row. Bytes are widened to
+// int16 so products never saturate, unlike vpmaddubsw.
+template <class LT, class RT>
+void Int8GemmRow(int64_t n, int64_t j, int64_t k, const LT* l, const RT* r, int32_t* c) {
+    const int64_t kq = GetInt8PaddedK(k) / 4;
+    // Each int32 of `acc_lo` holds a partial sum of two products for
+    // columns j..j+3, and `acc_hi` for j+4..j+7.
+    __m256i acc_lo = _mm256_setzero_si256();
+    __m256i acc_hi = _mm256_setzero_si256();
+    for (int64_t q = 0; q < kq; ++q) {
+        const __m256i lv = WidenBytes<LT>(_mm_set1_epi32(LoadQuad(l + q * 4, k - q * 4)));
+        const __m256i rv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + (q * n + j) * 4));
+        acc_lo = _mm256_add_epi32(acc_lo, _mm256_madd_epi16(lv, WidenBytes<RT>(_mm256_castsi256_si128(rv))));
+        acc_hi = _mm256_add_epi32(acc_hi, _mm256_madd_epi16(lv, WidenBytes<RT>(_mm256_extracti128_si256(rv, 1))));
+    }
+    // hadd produces columns in the order of (0, 1, 4, 5, 2, 3, 6, 7).
+    const __m256i sum = _mm256_hadd_epi32(acc_lo, acc_hi);
+    const __m256i perm = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + j), _mm256_permutevar8x32_epi32(sum, perm));
+}
+
+#endif
+
+template <class LT, class RT>
+void Int8GemmImpl(int64_t m, int64_t n, int64_t k, const LT* l, int64_t ld_l, const RT* r, int32_t* c, int64_t ld_c) {
+#if defined(__AVX2__) || (defined(__AVX512VNNI__) && defined(__AVX512BW__))
+    const int64_t n_vec = n / kLanes * kLanes;
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int64_t i = 0; i < m; ++i) {
+        for (int64_t j = 0; j < n_vec; j += kLanes) {
+            Int8GemmRow(n, j, k, l + i * ld_l, r, c + i * ld_c);
+        }
+        Int8GemmScalar(1, n, n_vec, k, l + i * ld_l, ld_l, r, c + i * ld_c, ld_c);
+    }
+#else
+    Int8GemmScalar(m, n, 0, k, l, ld_l, r, c, ld_c);
+#endif
+}
+
+}  // namespace
+
+void PackInt8Interleaved(int64_t k, int64_t n, const uint8_t* src, int64_t ld_src, uint8_t xor_mask, uint8_t* dst) {
+    const int64_t kp = GetInt8PaddedK(k);
+    for (int64_t kk = 0; kk < kp; ++kk) {
+        uint8_t* d = dst + (kk / 4) * n * 4 + kk % 4;
+        if (kk >= k) {
+            for (int64_t j = 0; j < n; ++j) d[j * 4] = 0;
+            continue;
+        }
+        const uint8_t* s = src + kk * ld_src;
+        for (int64_t j = 0; j < n; ++j) d[j * 4] = s[j] ^ xor_mask;
+    }
+}
+
+void Int8Gemm(int64_t m, int64_t n, int64_t k, const uint8_t* l, int64_t ld_l, const int8_t* r, int32_t* c, int64_t ld_c) {
+    Int8GemmImpl(m, n, k, l, ld_l, r, c, ld_c);
+}
+
+void Int8Gemm(int64_t m, int64_t n, int64_t k, const int8_t* l, int64_t ld_l, const uint8_t* r, int32_t* c, int64_t ld_c) {
+    Int8GemmImpl(m, n, k, l, ld_l, r, c, ld_c);
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// Integer GEMM kernels for quantized ops. The right-hand side matrix
+// of (k, n) must be packed by `PackInt8Interleaved` into
+// (ceil(k / 4), n, 4), i.e., four consecutive elements along `k` are
+// interleaved for each column. This is the layout AVX-512 VNNI's
+// vpdpbusd consumes, and the AVX2 kernel uses the same layout.
+
+// Returns the number of rows of an interleaved (k, n) matrix, i.e.,
+// `k` rounded up to a multiple of four.
+inline int64_t GetInt8PaddedK(int64_t k) {
+    return (k + 3) / 4 * 4;
+}
+
+// Packs a row-major (k, n) matrix of bytes into the interleaved
+// layout. Each byte is XOR-ed with `xor_mask`, which can be 0x80 to
+// convert int8 into uint8 by adding 128 (and vice versa). Padded rows
+// are filled with zeros.
+void PackInt8Interleaved(int64_t k, int64_t n, const uint8_t* src, int64_t ld_src, uint8_t xor_mask, uint8_t* dst);
+
+// c (m, n) = l (m, k) * r (k, n) where `r` is interleaved. `ld_*` are
+// the distances between rows.
+void Int8Gemm(int64_t m, int64_t n, int64_t k, const uint8_t* l, int64_t ld_l, const int8_t* r, int32_t* c, int64_t ld_c);
+void Int8Gemm(int64_t m, int64_t n, int64_t k, const int8_t* l, int64_t ld_l, const uint8_t* r, int32_t* c, int64_t ld_c);
+
+}  // namespace runtime
+}  // namespace chainer_compiler
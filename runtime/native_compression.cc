@@ -0,0 +1,200 @@
+#include "runtime/native_compression.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include <chainerx/native/native_backend.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/manipulation.h>
+
+#include <common/log.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+chainerx::Device& GetNativeDevice() {
+    return chainerx::GetNativeBackend().GetDevice(0);
+}
+
+// The packing is done on host. Arrays on other devices are copied.
+chainerx::Array ToContiguousNative(const chainerx::Array& a) {
+    return chainerx::AsContiguous(a.ToDevice(GetNativeDevice()));
+}
+
+int64_t GetPoolOutDim(int64_t in, int64_t kernel, int64_t stride, int64_t pad, bool cover_all) {
+    if (cover_all) {
+        return (in + pad * 2 - kernel + stride - 1) / stride + 1;
+    }
+    return (in + pad * 2 - kernel) / stride + 1;
+}
+
+}  // namespace
+
+chainerx::Array PackBits(const chainerx::Array& x) {
+    const chainerx::Array mask = ToContiguousNative(x.AsType(chainerx::Dtype::kBool));
+    const int64_t size = mask.GetTotalSize();
+    chainerx::Array bits = chainerx::Empty({(size + 7) / 8}, chainerx::Dtype::kUInt8, GetNativeDevice());
+    const bool* src = static_cast<const bool*>(RawStartPtr(mask));
+    uint8_t* dst = static_cast<uint8_t*>(RawStartPtr(bits));
+    for (int64_t i = 0; i < size; i += 8) {
+        uint8_t b = 0;
+        for (int64_t j = 0; j < 8 && i + j < size; ++j) {
+            b |= static_cast<uint8_t>(src[i + j]) << j;
+        }
+        dst[i / 8] = b;
+    }
+    return bits.ToDevice(x.device());
+}
+
+chainerx::Array MaskByBits(const chainerx::Array& bits, const chainerx::Array& x) {
+    const int64_t size = x.GetTotalSize();
+    CHECK_EQ(chainerx::Dtype::kUInt8, bits.dtype());
+    CHECK_EQ((size + 7) / 8, bits.GetTotalSize());
+    const chainerx::Array cbits = ToContiguousNative(bits);
+    chainerx::Array mask = chainerx::Empty(x.shape(), chainerx::Dtype::kBool, GetNativeDevice());
+    const uint8_t* src = static_cast<const uint8_t*>(RawStartPtr(cbits));
+    bool* dst = static_cast<bool*>(RawStartPtr(mask));
+    for (int64_t i = 0; i < size; ++i) {
+        dst[i] = (src[i / 8] >> (i % 8)) & 1;
+    }
+    return x * mask.ToDevice(x.device()).AsType(x.dtype());
+}
+
+chainerx::Array FloatToBFloat16(const chainerx::Array& x) {
+    const chainerx::Array cx = ToContiguousNative(x.AsType(chainerx::Dtype::kFloat32));
+    chainerx::Array y = chainerx::Empty(x.shape(), chainerx::Dtype::kInt16, GetNativeDevice());
+    const uint32_t* src = static_cast<const uint32_t*>(RawStartPtr(cx));
+    uint16_t* dst = static_cast<uint16_t*>(RawStartPtr(y));
+    const int64_t size = x.GetTotalSize();
+    for (int64_t i = 0; i < size; ++i) {
+        const uint32_t v = src[i];
+        if ((v & 0x7fffffff) > 0x7f800000) {
+            // Keep NaN as a quiet NaN.
+            dst[i] = static_cast<uint16_t>((v >> 16) | 0x40);
+        } else {
+            const uint32_t rounding = 0x7fff + ((v >> 16) & 1);
+            dst[i] = static_cast<uint16_t>((v + rounding) >> 16);
+        }
+    }
+    return y.ToDevice(x.device());
+}
+
+chainerx::Array BFloat16ToFloat(const chainerx::Array& x) {
+    CHECK_EQ(chainerx::Dtype::kInt16, x.dtype());
+    const chainerx::Array cx = ToContiguousNative(x);
+    chainerx::Array y = chainerx::Empty(x.shape(), chainerx::Dtype::kFloat32, GetNativeDevice());
+    const uint16_t* src = static_cast<const uint16_t*>(RawStartPtr(cx));
+    uint32_t* dst = static_cast<uint32_t*>(RawStartPtr(y));
+    const int64_t size = x.GetTotalSize();
+    for (int64_t i = 0; i < size; ++i) {
+        dst[i] = static_cast<uint32_t>(src[i]) << 16;
+    }
+    return y.ToDevice(x.device());
+}
+
+bool MaxPoolWithIndices(
+        const chainerx::Array& x,
+        const Int64StackVector& kernel_shape,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        bool cover_all,
+        chainerx::Array* y,
+        chainerx::Array* indices) {
+    if (x.ndim() != 4 || x.dtype() != chainerx::Dtype::kFloat32 || !IsNativeDevice(&x.device()) || kernel_shape.size() != 2 ||
+        strides.size() != 2 || pads.size() != 2) {
+        return false;
+    }
+    const int64_t kh = kernel_shape[0], kw = kernel_shape[1];
+    if (kh * kw > std::numeric_limits<int8_t>::max()) {
+        return false;
+    }
+
+    const int64_t nc = x.shape()[0] * x.shape()[1];
+    const int64_t h = x.shape()[2], w = x.shape()[3];
+    const int64_t sy = strides[0], sx = strides[1];
+    const int64_t py = pads[0], px = pads[1];
+    const int64_t oh = GetPoolOutDim(h, kh, sy, py, cover_all);
+    const int64_t ow = GetPoolOutDim(w, kw, sx, px, cover_all);
+
+    const chainerx::Array cx = chainerx::AsContiguous(x);
+    *y = chainerx::Empty({x.shape()[0], x.shape()[1], oh, ow}, chainerx::Dtype::kFloat32, x.device());
+    *indices = chainerx::Empty(y->shape(), chainerx::Dtype::kInt8, x.device());
+    const float* src = static_cast<const float*>(RawStartPtr(cx));
+    float* dst = static_cast<float*>(RawStartPtr(*y));
+    int8_t* idx = static_cast<int8_t*>(RawStartPtr(*indices));
+
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int64_t c = 0; c < nc; ++c) {
+        const float* plane = src + c * h * w;
+        for (int64_t oy = 0; oy < oh; ++oy) {
+            for (int64_t ox = 0; ox < ow; ++ox) {
+                float best = -std::numeric_limits<float>::infinity();
+                int8_t best_index = -1;
+                for (int64_t ky = 0; ky < kh; ++ky) {
+                    const int64_t iy = oy * sy - py + ky;
+                    if (iy < 0 || iy >= h) continue;
+                    for (int64_t kx = 0; kx < kw; ++kx) {
+                        const int64_t ix = ox * sx - px + kx;
+                        if (ix < 0 || ix >= w) continue;
+                        const float v = plane[iy * w + ix];
+                        if (best_index < 0 || v > best) {
+                            best = v;
+                            best_index = static_cast<int8_t>(ky * kw + kx);
+                        }
+                    }
+                }
+                const int64_t o = (c * oh + oy) * ow + ox;
+                dst[o] = best;
+                idx[o] = best_index;
+            }
+        }
+    }
+    return true;
+}
+
+chainerx::Array MaxPoolGradWithIndices(
+        const chainerx::Array& gy,
+        const chainerx::Array& indices,
+        const chainerx::Shape& x_shape,
+        const Int64StackVector& kernel_shape,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads) {
+    CHECK_EQ(4, x_shape.size());
+    CHECK_EQ(gy.shape(), indices.shape());
+    const chainerx::Array cgy = ToContiguousNative(gy.AsType(chainerx::Dtype::kFloat32));
+    const chainerx::Array cidx = ToContiguousNative(indices);
+    chainerx::Array gx = chainerx::Zeros(x_shape, chainerx::Dtype::kFloat32, GetNativeDevice());
+
+    const int64_t nc = x_shape[0] * x_shape[1];
+    const int64_t h = x_shape[2], w = x_shape[3];
+    const int64_t oh = gy.shape()[2], ow = gy.shape()[3];
+    const int64_t kw = kernel_shape[1];
+    const float* src = static_cast<const float*>(RawStartPtr(cgy));
+    const int8_t* idx = static_cast<const int8_t*>(RawStartPtr(cidx));
+    float* dst = static_cast<float*>(RawStartPtr(gx));
+
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int64_t c = 0; c < nc; ++c) {
+        float* plane = dst + c * h * w;
+        for (int64_t oy = 0; oy < oh; ++oy) {
+            for (int64_t ox = 0; ox < ow; ++ox) {
+                const int64_t o = (c * oh + oy) * ow + ox;
+                if (idx[o] < 0) continue;
+                const int64_t iy = oy * strides[0] - pads[0] + idx[o] / kw;
+                const int64_t ix = ox * strides[1] - pads[1] + idx[o] % kw;
+                plane[iy * w + ix] += src[o];
+            }
+        }
+    }
+    return gx.ToDevice(gy.device()).AsType(gy.dtype());
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chainerx/array.h>
+
+#include <runtime/chainerx_util.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// Compressed forms of arrays retained for backward computation.
+
+// Packs whether each element of `x` is non-zero into a 1D uint8 array
+// of bits, the first element in the least significant bit.
+chainerx::Array PackBits(const chainerx::Array& x);
+
+// Returns `x` where bits packed by `PackBits` are set and zero
+// elsewhere. `x` must have the number of elements of the packed array.
+chainerx::Array MaskByBits(const chainerx::Array& bits, const chainerx::Array& x);
+
+// Converts float32 into bfloat16, which is the upper half of float32
+// rounded to nearest even. As ChainerX has no bfloat16, the result is
+// an int16 array.
+chainerx::Array FloatToBFloat16(const chainerx::Array& x);
+
+// Converts bfloat16 stored in an int16 array into float32.
+chainerx::Array BFloat16ToFloat(const chainerx::Array& x);
+
+// Runs 2D max pooling of float32 NCHW `x` and stores the position of
+// the maximum element in each window into `indices` as int8. Returns
+// false if the kernel has more than 127 elements or `x` is not
+// supported.
+bool MaxPoolWithIndices(
+        const chainerx::Array& x,
+        const Int64StackVector& kernel_shape,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        bool cover_all,
+        chainerx::Array* y,
+        chainerx::Array* indices);
+
+// Scatters `gy` into an array of `x_shape` by `indices` from
+// `MaxPoolWithIndices`.
+chainerx::Array MaxPoolGradWithIndices(
+        const chainerx::Array& gy,
+        const chainerx::Array& indices,
+        const chainerx::Shape& x_shape,
+        const Int64StackVector& kernel_shape,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads);
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,81 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <chainerx/array.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/testing/array_check.h>
+#include <chainerx/testing/context_session.h>
+
+#include <runtime/chainerx_util.h>
+#include <runtime/native_compression.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+TEST(NativeCompressionTest, PackBits) {
+    chainerx::testing::ContextSession sess;
+    std::vector<float> data = {0, 1, 0, 2, 3, 0, 0, 0, -1, 0};
+    chainerx::Array x = MakeArray(chainerx::Dtype::kFloat32, {2, 5}, data.data());
+    chainerx::Array bits = PackBits(x);
+    ASSERT_EQ(chainerx::Shape({2}), bits.shape());
+    EXPECT_EQ(chainerx::Dtype::kUInt8, bits.dtype());
+    EXPECT_EQ(0x1a, static_cast<int>(chainerx::AsScalar(bits.At({0}))));
+    EXPECT_EQ(0x01, static_cast<int>(chainerx::AsScalar(bits.At({1}))));
+
+    std::vector<float> gy_data = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    chainerx::Array gy = MakeArray(chainerx::Dtype::kFloat32, {2, 5}, gy_data.data());
+    std::vector<float> expected_data = {0, 2, 0, 4, 5, 0, 0, 0, 9, 0};
+    chainerx::Array expected = MakeArray(chainerx::Dtype::kFloat32, {2, 5}, expected_data.data());
+    EXPECT_ARRAY_EQ(expected, MaskByBits(bits, gy));
+}
+
+TEST(NativeCompressionTest, BFloat16) {
+    chainerx::testing::ContextSession sess;
+    std::vector<float> data = {0.0f, 1.0f, -2.5f, 3.14159f, 1e-20f, 65504.0f, -123.456f};
+    chainerx::Array x = MakeArray(chainerx::Dtype::kFloat32, {static_cast<int64_t>(data.size())}, data.data());
+    chainerx::Array bf16 = FloatToBFloat16(x);
+    EXPECT_EQ(chainerx::Dtype::kInt16, bf16.dtype());
+    chainerx::Array actual = BFloat16ToFloat(bf16);
+    ASSERT_EQ(chainerx::Dtype::kFloat32, actual.dtype());
+    for (size_t i = 0; i < data.size(); ++i) {
+        const float v = static_cast<float>(chainerx::AsScalar(actual.At({static_cast<int64_t>(i)})));
+        EXPECT_GE(std::abs(data[i]) / 256, std::abs(data[i] - v)) << i;
+    }
+}
+
+TEST(NativeCompressionTest, MaxPoolWithIndices) {
+    chainerx::testing::ContextSession sess;
+    std::vector<float> data = {1, 5, 2, 0, 3, 4, 8, 7, 9, 0, 1, 2, 6, 2, 3, 4};
+    chainerx::Array x = MakeArray(chainerx::Dtype::kFloat32, {1, 1, 4, 4}, data.data());
+    chainerx::Array y, indices;
+    ASSERT_TRUE(MaxPoolWithIndices(x, {2, 2}, {2, 2}, {0, 0}, false, &y, &indices));
+
+    std::vector<float> expected_y_data = {5, 8, 9, 4};
+    chainerx::Array expected_y = MakeArray(chainerx::Dtype::kFloat32, {1, 1, 2, 2}, expected_y_data.data());
+    EXPECT_ARRAY_EQ(expected_y, y);
+    std::vector<int8_t> expected_indices_data = {1, 2, 0, 3};
+    chainerx::Array expected_indices = MakeArray(chainerx::Dtype::kInt8, {1, 1, 2, 2}, expected_indices_data.data());
+    EXPECT_ARRAY_EQ(expected_indices, indices);
+
+    std::vector<float> gy_data = {1, 2, 3, 4};
+    chainerx::Array gy = MakeArray(chainerx::Dtype::kFloat32, {1, 1, 2, 2}, gy_data.data());
+    chainerx::Array gx = MaxPoolGradWithIndices(gy, indices, x.shape(), {2, 2}, {2, 2}, {0, 0});
+    std::vector<float> expected_gx_data = {0, 1, 0, 0, 0, 0, 2, 0, 3, 0, 0, 0, 0, 0, 0, 4};
+    chainerx::Array expected_gx = MakeArray(chainerx::Dtype::kFloat32, {1, 1, 4, 4}, expected_gx_data.data());
+    EXPECT_ARRAY_EQ(expected_gx, gx);
+}
+
+TEST(NativeCompressionTest, MaxPoolWithIndicesUnsupported) {
+    chainerx::testing::ContextSession sess;
+    chainerx::Array x = chainerx::Zeros({1, 1, 16, 16}, chainerx::Dtype::kFloat32);
+    chainerx::Array y, indices;
+    EXPECT_FALSE(MaxPoolWithIndices(x, {12, 12}, {1, 1}, {0, 0}, false, &y, &indices));
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
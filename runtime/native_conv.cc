@@ -0,0 +1,804 @@
+#include "runtime/native_conv.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <chainerx/kernels/linalg.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/linalg.h>
+#include <chainerx/routines/manipulation.h>
+
+#include <common/log.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+int64_t GetConvOutDim(int64_t in_dim, int64_t kernel, int64_t stride, int64_t pad) {
+    return (in_dim + pad * 2 - kernel) / stride + 1;
+}
+
+int64_t GetConvTransposeOutDim(int64_t in_dim, int64_t kernel, int64_t stride, int64_t pad) {
+    return stride * (in_dim - 1) + kernel - pad * 2;
+}
+
+// Returns the range of `o` which satisfies 0 <= o * stride + offset < limit.
+std::pair<int64_t, int64_t> GetValidRange(int64_t offset, int64_t stride, int64_t limit, int64_t out_dim) {
+    int64_t lo = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+    int64_t hi = limit - offset <= 0 ? 0 : (limit - offset - 1) / stride + 1;
+    return {std::min(lo, out_dim), std::min(hi, out_dim)};
+}
+
+const float* FloatPtr(const chainerx::Array& a) {
+    return static_cast<const float*>(RawStartPtr(a));
+}
+
+float* MutableFloatPtr(const chainerx::Array& a) {
+    return static_cast<float*>(RawStartPtr(a));
+}
+
+// Fills `col` of (C*KH*KW, OH*OW) from `x` of (C, H, W).
+void Im2Col(
+        const float* x,
+        int64_t channels,
+        int64_t height,
+        int64_t width,
+        int64_t kernel_h,
+        int64_t kernel_w,
+        int64_t stride_h,
+        int64_t stride_w,
+        int64_t pad_h,
+        int64_t pad_w,
+        int64_t out_h,
+        int64_t out_w,
+        float* col) {
+    for (int64_t c = 0; c < channels; ++c) {
+        for (int64_t ky = 0; ky < kernel_h; ++ky) {
+            for (int64_t kx = 0; kx < kernel_w; ++kx) {
+                for (int64_t oy = 0; oy < out_h; ++oy) {
+                    const int64_t iy = oy * stride_h - pad_h + ky;
+                    if (iy < 0 || iy >= height) {
+                        std::fill(col, col + out_w, 0.0f);
+                        col += out_w;
+                        continue;
+                    }
+                    const float* row = x + (c * height + iy) * width;
+                    for (int64_t ox = 0; ox < out_w; ++ox) {
+                        const int64_t ix = ox * stride_w - pad_w + kx;
+                        *col++ = (ix >= 0 && ix < width) ? row[ix] : 0.0f;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Accumulates `col` of (C*KH*KW, H*W) into `y` of (C, OH, OW). This
+// is the adjoint of `Im2Col`.
+void Col2Im(
+        const float* col,
+        int64_t channels,
+        int64_t height,
+        int64_t width,
+        int64_t kernel_h,
+        int64_t kernel_w,
+        int64_t stride_h,
+        int64_t stride_w,
+        int64_t pad_h,
+        int64_t pad_w,
+        int64_t out_h,
+        int64_t out_w,
+        float* y) {
+    for (int64_t c = 0; c < channels; ++c) {
+        for (int64_t ky = 0; ky < kernel_h; ++ky) {
+            for (int64_t kx = 0; kx < kernel_w; ++kx) {
+                for (int64_t iy = 0; iy < height; ++iy) {
+                    const int64_t oy = iy * stride_h - pad_h + ky;
+                    if (oy < 0 || oy >= out_h) {
+                        col += width;
+                        continue;
+                    }
+                    float* row = y + (c * out_h + oy) * out_w;
+                    for (int64_t ix = 0; ix < width; ++ix, ++col) {
+                        const int64_t ox = ix * stride_w - pad_w + kx;
+                        if (ox >= 0 && ox < out_w) row[ox] += *col;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Computes `y` of (M, N) = `a` of (M, K) * `b` of (K, N). Used for
+// the small per-group products of grouped convolutions, which run in
+// parallel over groups instead of calling BLAS one by one.
+void MatMulNN(const float* a, const float* b, int64_t m, int64_t k, int64_t n, float* y) {
+    for (int64_t i = 0; i < m; ++i) {
+        float* yi = y + i * n;
+        std::fill(yi, yi + n, 0.0f);
+        for (int64_t l = 0; l < k; ++l) {
+            const float ail = a[i * k + l];
+            const float* bl = b + l * n;
+            for (int64_t j = 0; j < n; ++j) {
+                yi[j] += ail * bl[j];
+            }
+        }
+    }
+}
+
+// Adds `a` of (M, N) * `b`^T to `y` of (M, K), where `b` is (K, N).
+void AddMatMulNT(const float* a, const float* b, int64_t m, int64_t n, int64_t k, float* y) {
+    for (int64_t i = 0; i < m; ++i) {
+        const float* ai = a + i * n;
+        for (int64_t l = 0; l < k; ++l) {
+            const float* bl = b + l * n;
+            float sum = 0;
+            for (int64_t j = 0; j < n; ++j) {
+                sum += ai[j] * bl[j];
+            }
+            y[i * k + l] += sum;
+        }
+    }
+}
+
+// A direct convolution kernel without im2col buffers. The inner-most
+// loop runs over a contiguous output row so it can be vectorized.
+// This is the fastest algorithm for depthwise convolutions.
+chainerx::Array DirectConv(
+        const chainerx::Array& x,
+        const chainerx::Array& packed_w,
+        const chainerx::Shape& w_shape,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group) {
+    const int64_t batch_size = x.shape()[0];
+    const int64_t channels = x.shape()[1];
+    const int64_t height = x.shape()[2];
+    const int64_t width = x.shape()[3];
+    const int64_t out_channels = w_shape[0];
+    const int64_t group_channels = w_shape[1];
+    const int64_t group_out_channels = out_channels / group;
+    const int64_t kernel_h = w_shape[2];
+    const int64_t kernel_w = w_shape[3];
+    const int64_t stride_h = strides[0];
+    const int64_t stride_w = strides[1];
+    const int64_t pad_h = pads[0];
+    const int64_t pad_w = pads[1];
+    const int64_t out_h = GetConvOutDim(height, kernel_h, stride_h, pad_h);
+    const int64_t out_w = GetConvOutDim(width, kernel_w, stride_w, pad_w);
+    CHECK_LT(0, out_h);
+    CHECK_LT(0, out_w);
+
+    const chainerx::Array cx = chainerx::AsContiguous(x);
+    absl::optional<chainerx::Array> cb;
+    if (b.has_value()) cb = chainerx::AsContiguous(*b);
+    chainerx::Array y = chainerx::Empty({batch_size, out_channels, out_h, out_w}, x.dtype(), x.device());
+    const float* xp = FloatPtr(cx);
+    const float* wp = FloatPtr(packed_w);
+    const float* bp = cb.has_value() ? FloatPtr(*cb) : nullptr;
+    float* yp = MutableFloatPtr(y);
+
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int64_t nc = 0; nc < batch_size * out_channels; ++nc) {
+        const int64_t n = nc / out_channels;
+        const int64_t oc = nc % out_channels;
+        const int64_t g = oc / group_out_channels;
+        float* yc = yp + nc * out_h * out_w;
+        std::fill(yc, yc + out_h * out_w, bp ? bp[oc] : 0.0f);
+
+        for (int64_t ic = 0; ic < group_channels; ++ic) {
+            const float* xc = xp + (n * channels + g * group_channels + ic) * height * width;
+            const float* wc = wp + (oc * group_channels + ic) * kernel_h * kernel_w;
+            for (int64_t oy = 0; oy < out_h; ++oy) {
+                float* yrow = yc + oy * out_w;
+                for (int64_t ky = 0; ky < kernel_h; ++ky) {
+                    const int64_t iy = oy * stride_h - pad_h + ky;
+                    if (iy < 0 || iy >= height) continue;
+                    const float* xrow = xc + iy * width;
+                    for (int64_t kx = 0; kx < kernel_w; ++kx) {
+                        const float wv = wc[ky * kernel_w + kx];
+                        const std::pair<int64_t, int64_t> range = GetValidRange(kx - pad_w, stride_w, width, out_w);
+                        if (stride_w == 1) {
+                            const float* xs = xrow + kx - pad_w;
+                            for (int64_t ox = range.first; ox < range.second; ++ox) {
+                                yrow[ox] += wv * xs[ox];
+                            }
+                        } else {
+                            for (int64_t ox = range.first; ox < range.second; ++ox) {
+                                yrow[ox] += wv * xrow[ox * stride_w + kx - pad_w];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return y;
+}
+
+// Matrices of Winograd's minimal filtering algorithms F(m x m, 3 x 3).
+// See "Fast Algorithms for Convolutional Neural Networks" by Lavin
+// and Gray.
+struct WinogradMatrices {
+    int64_t m;
+    int64_t alpha;
+    // (alpha, alpha)
+    const float* bt;
+    // (alpha, 3)
+    const float* g;
+    // (m, alpha)
+    const float* at;
+};
+
+const WinogradMatrices& GetWinogradMatrices(NativeConvAlgorithm algorithm) {
+    // clang-format off
+    static const float kBt2[] = {
+        1, 0, -1, 0,
+        0, 1, 1, 0,
+        0, -1, 1, 0,
+        0, 1, 0, -1,
+    };
+    static const float kG2[] = {
+        1, 0, 0,
+        0.5, 0.5, 0.5,
+        0.5, -0.5, 0.5,
+        0, 0, 1,
+    };
+    static const float kAt2[] = {
+        1, 1, 1, 0,
+        0, 1, -1, -1,
+    };
+    static const float kBt4[] = {
+        4, 0, -5, 0, 1, 0,
+        0, -4, -4, 1, 1, 0,
+        0, 4, -4, -1, 1, 0,
+        0, -2, -1, 2, 1, 0,
+        0, 2, -1, -2, 1, 0,
+        0, 4, 0, -5, 0, 1,
+    };
+    static const float kG4[] = {
+        1.0 / 4, 0, 0,
+        -1.0 / 6, -1.0 / 6, -1.0 / 6,
+        -1.0 / 6, 1.0 / 6, -1.0 / 6,
+        1.0 / 24, 1.0 / 12, 1.0 / 6,
+        1.0 / 24, -1.0 / 12, 1.0 / 6,
+        0, 0, 1,
+    };
+    static const float kAt4[] = {
+        1, 1, 1, 1, 1, 0,
+        0, 1, -1, 2, -2, 0,
+        0, 1, 1, 4, 4, 0,
+        0, 1, -1, 8, -8, 1,
+    };
+    // clang-format on
+    static const WinogradMatrices kF2x2{2, 4, kBt2, kG2, kAt2};
+    static const WinogradMatrices kF4x4{4, 6, kBt4, kG4, kAt4};
+    switch (algorithm) {
+        case NativeConvAlgorithm::kWinograd2x2:
+            return kF2x2;
+        case NativeConvAlgorithm::kWinograd4x4:
+            return kF4x4;
+        default:
+            CHECK(false) << "Not a Winograd algorithm: " << GetNativeConvAlgorithmName(algorithm);
+    }
+}
+
+// Computes `out` = `mat` * `in` * `mat`^T, where `mat` is (rows, cols),
+// `in` is (cols, cols), and `out` is (rows, rows).
+void Transform2D(const float* mat, int64_t rows, int64_t cols, const float* in, float* out) {
+    float tmp[6 * 6];
+    for (int64_t i = 0; i < rows; ++i) {
+        for (int64_t j = 0; j < cols; ++j) {
+            float s = 0;
+            for (int64_t k = 0; k < cols; ++k) {
+                s += mat[i * cols + k] * in[k * cols + j];
+            }
+            tmp[i * cols + j] = s;
+        }
+    }
+    for (int64_t i = 0; i < rows; ++i) {
+        for (int64_t j = 0; j < rows; ++j) {
+            float s = 0;
+            for (int64_t k = 0; k < cols; ++k) {
+                s += tmp[i * cols + k] * mat[j * cols + k];
+            }
+            out[i * rows + j] = s;
+        }
+    }
+}
+
+// Transforms a weight of (OC, IC, 3, 3) into (alpha * alpha, OC, IC).
+chainerx::Array PackWinogradWeight(const chainerx::Array& w, NativeConvAlgorithm algorithm) {
+    const WinogradMatrices& wm = GetWinogradMatrices(algorithm);
+    const int64_t out_channels = w.shape()[0];
+    const int64_t channels = w.shape()[1];
+    const int64_t alpha2 = wm.alpha * wm.alpha;
+    const chainerx::Array cw = chainerx::AsContiguous(w);
+    chainerx::Array u = chainerx::Empty({alpha2, out_channels, channels}, w.dtype(), w.device());
+    const float* wp = FloatPtr(cw);
+    float* up = MutableFloatPtr(u);
+    float tu[6 * 6];
+    for (int64_t oc = 0; oc < out_channels; ++oc) {
+        for (int64_t ic = 0; ic < channels; ++ic) {
+            Transform2D(wm.g, wm.alpha, 3, wp + (oc * channels + ic) * 9, tu);
+            for (int64_t xi = 0; xi < alpha2; ++xi) {
+                up[(xi * out_channels + oc) * channels + ic] = tu[xi];
+            }
+        }
+    }
+    return u;
+}
+
+// Runs a 3x3 stride-1 convolution by Winograd's minimal filtering
+// algorithm. Tiles of all batches are transformed together so the
+// element-wise products become alpha * alpha large GEMMs.
+chainerx::Array WinogradConv(
+        const chainerx::Array& x,
+        const chainerx::Array& packed_w,
+        const chainerx::Shape& w_shape,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& pads,
+        NativeConvAlgorithm algorithm) {
+    const WinogradMatrices& wm = GetWinogradMatrices(algorithm);
+    const int64_t batch_size = x.shape()[0];
+    const int64_t channels = x.shape()[1];
+    const int64_t height = x.shape()[2];
+    const int64_t width = x.shape()[3];
+    const int64_t out_channels = w_shape[0];
+    const int64_t pad_h = pads[0];
+    const int64_t pad_w = pads[1];
+    const int64_t out_h = GetConvOutDim(height, 3, 1, pad_h);
+    const int64_t out_w = GetConvOutDim(width, 3, 1, pad_w);
+    CHECK_LT(0, out_h);
+    CHECK_LT(0, out_w);
+    const int64_t m = wm.m;
+    const int64_t alpha = wm.alpha;
+    const int64_t alpha2 = alpha * alpha;
+    const int64_t tiles_h = (out_h + m - 1) / m;
+    const int64_t tiles_w = (out_w + m - 1) / m;
+    const int64_t num_tiles = batch_size * tiles_h * tiles_w;
+
+    const chainerx::Array cx = chainerx::AsContiguous(x);
+    absl::optional<chainerx::Array> cb;
+    if (b.has_value()) cb = chainerx::AsContiguous(*b);
+    chainerx::Array v = chainerx::Empty({alpha2, channels, num_tiles}, x.dtype(), x.device());
+    chainerx::Array mv = chainerx::Empty({alpha2, out_channels, num_tiles}, x.dtype(), x.device());
+    chainerx::Array y = chainerx::Empty({batch_size, out_channels, out_h, out_w}, x.dtype(), x.device());
+    const float* xp = FloatPtr(cx);
+    const float* bp = cb.has_value() ? FloatPtr(*cb) : nullptr;
+    float* vp = MutableFloatPtr(v);
+    float* yp = MutableFloatPtr(y);
+
+    // Input transform.
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int64_t nc = 0; nc < batch_size * channels; ++nc) {
+        const int64_t n = nc / channels;
+        const int64_t c = nc % channels;
+        const float* xc = xp + nc * height * width;
+        float d[6 * 6];
+        float td[6 * 6];
+        for (int64_t ty = 0; ty < tiles_h; ++ty) {
+            for (int64_t tx = 0; tx < tiles_w; ++tx) {
+                for (int64_t i = 0; i < alpha; ++i) {
+                    const int64_t iy = ty * m - pad_h + i;
+                    for (int64_t j = 0; j < alpha; ++j) {
+                        const int64_t ix = tx * m - pad_w + j;
+                        d[i * alpha + j] = (iy >= 0 && iy < height && ix >= 0 && ix < width) ? xc[iy * width + ix] : 0.0f;
+                    }
+                }
+                Transform2D(wm.bt, alpha, alpha, d, td);
+                const int64_t tile = (n * tiles_h + ty) * tiles_w + tx;
+                for (int64_t xi = 0; xi < alpha2; ++xi) {
+                    vp[(xi * channels + c) * num_tiles + tile] = td[xi];
+                }
+            }
+        }
+    }
+
+    for (int64_t xi = 0; xi < alpha2; ++xi) {
+        x.device().backend().CallKernel<chainerx::DotKernel>(packed_w.At({xi}), v.At({xi}), mv.At({xi}));
+    }
+
+    // Output transform.
+    const float* mp = FloatPtr(mv);
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int64_t nc = 0; nc < batch_size * out_channels; ++nc) {
+        const int64_t n = nc / out_channels;
+        const int64_t oc = nc % out_channels;
+        const float bias = bp ? bp[oc] : 0.0f;
+        float* yc = yp + nc * out_h * out_w;
+        float tm[6 * 6];
+        float ty_out[4 * 4];
+        for (int64_t ty = 0; ty < tiles_h; ++ty) {
+            for (int64_t tx = 0; tx < tiles_w; ++tx) {
+                const int64_t tile = (n * tiles_h + ty) * tiles_w + tx;
+                for (int64_t xi = 0; xi < alpha2; ++xi) {
+                    tm[xi] = mp[(xi * out_channels + oc) * num_tiles + tile];
+                }
+                Transform2D(wm.at, m, alpha, tm, ty_out);
+                for (int64_t i = 0; i < m && ty * m + i < out_h; ++i) {
+                    for (int64_t j = 0; j < m && tx * m + j < out_w; ++j) {
+                        yc[(ty * m + i) * out_w + tx * m + j] = ty_out[i * m + j] + bias;
+                    }
+                }
+            }
+        }
+    }
+    return y;
+}
+
+// Runs im2col and a matrix multiplication for each batch and group.
+// Results are written into slices of the output directly. Batches and
+// groups of grouped convolutions run in parallel.
+chainerx::Array Im2ColConv(
+        const chainerx::Array& x,
+        const chainerx::Array& packed_w,
+        const chainerx::Shape& w_shape,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group) {
+    const int64_t batch_size = x.shape()[0];
+    const int64_t channels = x.shape()[1];
+    const int64_t height = x.shape()[2];
+    const int64_t width = x.shape()[3];
+    const int64_t out_channels = w_shape[0];
+    const int64_t group_channels = w_shape[1];
+    const int64_t group_out_channels = out_channels / group;
+    const int64_t kernel_h = w_shape[2];
+    const int64_t kernel_w = w_shape[3];
+    const int64_t out_h = GetConvOutDim(height, kernel_h, strides[0], pads[0]);
+    const int64_t out_w = GetConvOutDim(width, kernel_w, strides[1], pads[1]);
+    CHECK_LT(0, out_h);
+    CHECK_LT(0, out_w);
+
+    const chainerx::Array cx = chainerx::AsContiguous(x);
+    const float* xp = FloatPtr(cx);
+    const int64_t col_rows = group_channels * kernel_h * kernel_w;
+    chainerx::Array y = chainerx::Empty({batch_size, out_channels, out_h, out_w}, x.dtype(), x.device());
+
+    if (group == 1) {
+        chainerx::Array col = chainerx::Empty({col_rows, out_h * out_w}, x.dtype(), x.device());
+        for (int64_t n = 0; n < batch_size; ++n) {
+            Im2Col(xp + n * channels * height * width,
+                   channels,
+                   height,
+                   width,
+                   kernel_h,
+                   kernel_w,
+                   strides[0],
+                   strides[1],
+                   pads[0],
+                   pads[1],
+                   out_h,
+                   out_w,
+                   MutableFloatPtr(col));
+            const chainerx::Array y_n = y.At({n}).Reshape({out_channels, out_h * out_w});
+            x.device().backend().CallKernel<chainerx::DotKernel>(packed_w, col, y_n);
+        }
+    } else {
+        const float* wp = FloatPtr(packed_w);
+        float* yp = MutableFloatPtr(y);
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel
+#endif
+        {
+            std::vector<float> col(col_rows * out_h * out_w);
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp for
+#endif
+            for (int64_t ng = 0; ng < batch_size * group; ++ng) {
+                const int64_t n = ng / group;
+                const int64_t g = ng % group;
+                Im2Col(xp + (n * channels + g * group_channels) * height * width,
+                       group_channels,
+                       height,
+                       width,
+                       kernel_h,
+                       kernel_w,
+                       strides[0],
+                       strides[1],
+                       pads[0],
+                       pads[1],
+                       out_h,
+                       out_w,
+                       col.data());
+                MatMulNN(
+                        wp + g * group_out_channels * col_rows,
+                        col.data(),
+                        group_out_channels,
+                        col_rows,
+                        out_h * out_w,
+                        yp + (n * out_channels + g * group_out_channels) * out_h * out_w);
+            }
+        }
+    }
+
+    if (b.has_value()) {
+        y += b->Reshape({1, out_channels, 1, 1}).BroadcastTo(y.shape());
+    }
+    return y;
+}
+
+}  // namespace
+
+bool IsNativeConvSupported(const chainerx::Array& x, const chainerx::Array& w, int group) {
+    return (group >= 1 && x.ndim() == 4 && w.ndim() == 4 && x.dtype() == chainerx::Dtype::kFloat32 &&
+            w.dtype() == chainerx::Dtype::kFloat32 && IsNativeDevice(&x.device()) && IsNativeDevice(&w.device()));
+}
+
+bool IsDepthwiseConv(const chainerx::Shape& x_shape, const chainerx::Shape& w_shape, int group) {
+    return group > 1 && x_shape[1] == group && w_shape[1] == 1;
+}
+
+const char* GetNativeConvAlgorithmName(NativeConvAlgorithm algorithm) {
+    switch (algorithm) {
+        case NativeConvAlgorithm::kIm2Col:
+            return "im2col";
+        case NativeConvAlgorithm::kDirect:
+            return "direct";
+        case NativeConvAlgorithm::kWinograd2x2:
+            return "winograd2x2";
+        case NativeConvAlgorithm::kWinograd4x4:
+            return "winograd4x4";
+    }
+    CHECK(false) << "Unknown algorithm: " << static_cast<int>(algorithm);
+}
+
+bool ParseNativeConvAlgorithm(const std::string& name, NativeConvAlgorithm* algorithm) {
+    for (NativeConvAlgorithm a : {NativeConvAlgorithm::kIm2Col,
+                                  NativeConvAlgorithm::kDirect,
+                                  NativeConvAlgorithm::kWinograd2x2,
+                                  NativeConvAlgorithm::kWinograd4x4}) {
+        if (name == GetNativeConvAlgorithmName(a)) {
+            *algorithm = a;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<NativeConvAlgorithm> GetNativeConvAlgorithmCandidates(
+        const chainerx::Shape& w_shape, const Int64StackVector& strides, int group) {
+    std::vector<NativeConvAlgorithm> candidates = {NativeConvAlgorithm::kIm2Col, NativeConvAlgorithm::kDirect};
+    if (group == 1 && w_shape[2] == 3 && w_shape[3] == 3 && strides[0] == 1 && strides[1] == 1) {
+        candidates.push_back(NativeConvAlgorithm::kWinograd2x2);
+        candidates.push_back(NativeConvAlgorithm::kWinograd4x4);
+    }
+    return candidates;
+}
+
+NativeConvAlgorithm ChooseNativeConvAlgorithm(
+        const chainerx::Shape& x_shape, const chainerx::Shape& w_shape, const Int64StackVector& strides, int group) {
+    if (IsDepthwiseConv(x_shape, w_shape, group)) {
+        return NativeConvAlgorithm::kDirect;
+    }
+    // Winograd is less accurate and is not always faster, so it is used
+    // only when the tuner finds it is the fastest.
+    return NativeConvAlgorithm::kIm2Col;
+}
+
+chainerx::Array PackConvWeight(const chainerx::Array& w) {
+    CHECK_LE(2, w.ndim());
+    return chainerx::AsContiguous(w).Reshape({w.shape()[0], w.GetTotalSize() / w.shape()[0]});
+}
+
+chainerx::Array PackConvWeight(const chainerx::Array& w, NativeConvAlgorithm algorithm) {
+    switch (algorithm) {
+        case NativeConvAlgorithm::kIm2Col:
+        case NativeConvAlgorithm::kDirect:
+            return PackConvWeight(w);
+        case NativeConvAlgorithm::kWinograd2x2:
+        case NativeConvAlgorithm::kWinograd4x4:
+            return PackWinogradWeight(w, algorithm);
+    }
+    CHECK(false) << "Unknown algorithm: " << static_cast<int>(algorithm);
+}
+
+chainerx::Array NativeConv(
+        const chainerx::Array& x,
+        const chainerx::Array& packed_w,
+        const chainerx::Shape& w_shape,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group,
+        NativeConvAlgorithm algorithm) {
+    CHECK_EQ(4, x.ndim());
+    CHECK_EQ(4, w_shape.size());
+    CHECK_EQ(2, strides.size());
+    CHECK_EQ(2, pads.size());
+    CHECK_EQ(x.shape()[1], w_shape[1] * group);
+    CHECK_EQ(0, w_shape[0] % group);
+
+    switch (algorithm) {
+        case NativeConvAlgorithm::kIm2Col:
+            return Im2ColConv(x, packed_w, w_shape, b, strides, pads, group);
+        case NativeConvAlgorithm::kDirect:
+            return DirectConv(x, packed_w, w_shape, b, strides, pads, group);
+        case NativeConvAlgorithm::kWinograd2x2:
+        case NativeConvAlgorithm::kWinograd4x4:
+            CHECK_EQ(1, group);
+            CHECK_EQ(1, strides[0]);
+            CHECK_EQ(1, strides[1]);
+            CHECK_EQ(3, w_shape[2]);
+            CHECK_EQ(3, w_shape[3]);
+            return WinogradConv(x, packed_w, w_shape, b, pads, algorithm);
+    }
+    CHECK(false) << "Unknown algorithm: " << static_cast<int>(algorithm);
+}
+
+chainerx::Array NativeConvTranspose(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        const Int64StackVector& out_size,
+        int group) {
+    CHECK_EQ(4, x.ndim());
+    CHECK_EQ(4, w.ndim());
+    CHECK_EQ(2, strides.size());
+    CHECK_EQ(2, pads.size());
+    const int64_t batch_size = x.shape()[0];
+    const int64_t channels = x.shape()[1];
+    const int64_t height = x.shape()[2];
+    const int64_t width = x.shape()[3];
+    CHECK_EQ(channels, w.shape()[0]);
+    CHECK_EQ(0, channels % group);
+    const int64_t group_channels = channels / group;
+    const int64_t group_out_channels = w.shape()[1];
+    const int64_t out_channels = group_out_channels * group;
+    const int64_t kernel_h = w.shape()[2];
+    const int64_t kernel_w = w.shape()[3];
+    const int64_t out_h = out_size.empty() ? GetConvTransposeOutDim(height, kernel_h, strides[0], pads[0]) : out_size[0];
+    const int64_t out_w = out_size.empty() ? GetConvTransposeOutDim(width, kernel_w, strides[1], pads[1]) : out_size[1];
+    CHECK_LT(0, out_h);
+    CHECK_LT(0, out_w);
+
+    const chainerx::Array cx = chainerx::AsContiguous(x);
+    const chainerx::Array wm = PackConvWeight(w);
+    chainerx::Array y = chainerx::Zeros({batch_size, out_channels, out_h, out_w}, x.dtype(), x.device());
+    float* yp = MutableFloatPtr(y);
+
+    for (int64_t g = 0; g < group; ++g) {
+        const chainerx::Slice ic_slice(g * group_channels, (g + 1) * group_channels);
+        const chainerx::Array w_gt = chainerx::Transpose(group == 1 ? wm : wm.At({ic_slice}));
+        for (int64_t n = 0; n < batch_size; ++n) {
+            const chainerx::Array x_g = cx.At({n, ic_slice}).Reshape({group_channels, height * width});
+            const chainerx::Array col = chainerx::AsContiguous(chainerx::Dot(w_gt, x_g));
+            Col2Im(FloatPtr(col),
+                   group_out_channels,
+                   height,
+                   width,
+                   kernel_h,
+                   kernel_w,
+                   strides[0],
+                   strides[1],
+                   pads[0],
+                   pads[1],
+                   out_h,
+                   out_w,
+                   yp + (n * out_channels + g * group_out_channels) * out_h * out_w);
+        }
+    }
+
+    if (b.has_value()) {
+        y += b->Reshape({1, out_channels, 1, 1}).BroadcastTo(y.shape());
+    }
+    return y;
+}
+
+chainerx::Array NativeConvGradWeight(
+        const chainerx::Shape& w_shape,
+        const chainerx::Array& x,
+        const chainerx::Array& gy,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group) {
+    CHECK_EQ(4, x.ndim());
+    CHECK_EQ(4, gy.ndim());
+    CHECK_EQ(4, w_shape.size());
+    CHECK_EQ(2, strides.size());
+    CHECK_EQ(2, pads.size());
+    const int64_t batch_size = x.shape()[0];
+    const int64_t channels = x.shape()[1];
+    const int64_t height = x.shape()[2];
+    const int64_t width = x.shape()[3];
+    const int64_t out_channels = w_shape[0];
+    const int64_t group_channels = w_shape[1];
+    const int64_t group_out_channels = out_channels / group;
+    const int64_t kernel_h = w_shape[2];
+    const int64_t kernel_w = w_shape[3];
+    const int64_t out_h = gy.shape()[2];
+    const int64_t out_w = gy.shape()[3];
+    CHECK_EQ(channels, group_channels * group);
+    CHECK_EQ(out_channels, gy.shape()[1]);
+
+    const chainerx::Array cx = chainerx::AsContiguous(x);
+    const chainerx::Array cgy = chainerx::AsContiguous(gy);
+    const float* xp = FloatPtr(cx);
+    const int64_t col_rows = group_channels * kernel_h * kernel_w;
+    chainerx::Array gw = chainerx::Zeros({out_channels, col_rows}, x.dtype(), x.device());
+
+    if (group == 1) {
+        chainerx::Array col = chainerx::Empty({col_rows, out_h * out_w}, x.dtype(), x.device());
+        const chainerx::Array col_t = chainerx::Transpose(col);
+        for (int64_t n = 0; n < batch_size; ++n) {
+            Im2Col(xp + n * channels * height * width,
+                   channels,
+                   height,
+                   width,
+                   kernel_h,
+                   kernel_w,
+                   strides[0],
+                   strides[1],
+                   pads[0],
+                   pads[1],
+                   out_h,
+                   out_w,
+                   MutableFloatPtr(col));
+            const chainerx::Array gy_n = cgy.At({n}).Reshape({out_channels, out_h * out_w});
+            gw += chainerx::Dot(gy_n, col_t);
+        }
+        return gw.Reshape(w_shape);
+    }
+
+    // Each thread accumulates batches and groups it runs into its own
+    // copy of `gw`, and the copies are summed at the end.
+    const float* gyp = FloatPtr(cgy);
+    float* gwp = MutableFloatPtr(gw);
+    const int64_t gw_size = out_channels * col_rows;
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel
+#endif
+    {
+        std::vector<float> col(col_rows * out_h * out_w);
+        std::vector<float> local_gw(gw_size);
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp for
+#endif
+        for (int64_t ng = 0; ng < batch_size * group; ++ng) {
+            const int64_t n = ng / group;
+            const int64_t g = ng % group;
+            Im2Col(xp + (n * channels + g * group_channels) * height * width,
+                   group_channels,
+                   height,
+                   width,
+                   kernel_h,
+                   kernel_w,
+                   strides[0],
+                   strides[1],
+                   pads[0],
+                   pads[1],
+                   out_h,
+                   out_w,
+                   col.data());
+            AddMatMulNT(
+                    gyp + (n * out_channels + g * group_out_channels) * out_h * out_w,
+                    col.data(),
+                    group_out_channels,
+                    out_h * out_w,
+                    col_rows,
+                    local_gw.data() + g * group_out_channels * col_rows);
+        }
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp critical
+#endif
+        for (int64_t i = 0; i < gw_size; ++i) {
+            gwp[i] += local_gw[i];
+        }
+    }
+    return gw.Reshape(w_shape);
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <absl/types/optional.h>
+
+#include <chainerx/array.h>
+
+#include <runtime/chainerx_util.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// Native CPU convolution kernels used instead of ChainerX's generic
+// implementation when they are applicable. All kernels in this file
+// handle groups without splitting and concatenating arrays.
+
+// Returns true if a convolution of `x` and `w` can be run by the
+// kernels in this file.
+bool IsNativeConvSupported(const chainerx::Array& x, const chainerx::Array& w, int group);
+
+// Returns true if the convolution is depthwise, i.e., each output
+// channel depends only on a single input channel.
+bool IsDepthwiseConv(const chainerx::Shape& x_shape, const chainerx::Shape& w_shape, int group);
+
+enum class NativeConvAlgorithm {
+    // im2col followed by a matrix multiplication per group.
+    kIm2Col,
+    // Direct loops without temporary buffers. Best for depthwise.
+    kDirect,
+    // Winograd's F(2x2, 3x3) and F(4x4, 3x3). Only for 3x3
+    // convolutions with stride 1 and no groups.
+    kWinograd2x2,
+    kWinograd4x4,
+};
+
+const char* GetNativeConvAlgorithmName(NativeConvAlgorithm algorithm);
+
+bool ParseNativeConvAlgorithm(const std::string& name, NativeConvAlgorithm* algorithm);
+
+// Returns algorithms which can run a convolution of `w_shape`.
+std::vector<NativeConvAlgorithm> GetNativeConvAlgorithmCandidates(const chainerx::Shape& w_shape, const Int64StackVector& strides, int group);
+
+// Chooses an algorithm by a heuristic, without benchmarking. Winograd
+// algorithms are never chosen, see `ConvAlgorithmTuner`.
+NativeConvAlgorithm ChooseNativeConvAlgorithm(
+        const chainerx::Shape& x_shape, const chainerx::Shape& w_shape, const Int64StackVector& strides, int group);
+
+// Converts a weight of (OC, IC/G, KH, KW) into a contiguous
+// (OC, IC/G*KH*KW) matrix, which is the layout of kIm2Col and kDirect.
+chainerx::Array PackConvWeight(const chainerx::Array& w);
+
+// Converts a weight into the layout `algorithm` expects. Winograd
+// algorithms use pre-transformed weights of (alpha*alpha, OC, IC).
+chainerx::Array PackConvWeight(const chainerx::Array& w, NativeConvAlgorithm algorithm);
+
+// Runs a 2D convolution. `packed_w` must be the result of
+// `PackConvWeight` with `algorithm` for a weight of `w_shape`. `pads`
+// must be symmetric.
+chainerx::Array NativeConv(
+        const chainerx::Array& x,
+        const chainerx::Array& packed_w,
+        const chainerx::Shape& w_shape,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group,
+        NativeConvAlgorithm algorithm);
+
+// Runs a 2D transposed convolution of `x` and `w` of (IC, OC/G, KH, KW).
+// `out_size` can be empty.
+chainerx::Array NativeConvTranspose(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const absl::optional<chainerx::Array>& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        const Int64StackVector& out_size,
+        int group);
+
+// Computes the gradient of a 2D convolution with respect to its
+// weight of `w_shape`.
+chainerx::Array NativeConvGradWeight(
+        const chainerx::Shape& w_shape,
+        const chainerx::Array& x,
+        const chainerx::Array& gy,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group);
+
+}  // namespace runtime
+}  // namespace chainer_compiler
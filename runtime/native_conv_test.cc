@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include <chainerx/array.h>
+#include <chainerx/kernels/connection.h>
+#include <chainerx/routines/connection.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/manipulation.h>
+#include <chainerx/testing/array_check.h>
+#include <chainerx/testing/context_session.h>
+
+#include <runtime/chainerx_util.h>
+#include <runtime/native_conv.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+// Computes a grouped convolution by ChainerX's kernels as a reference.
+chainerx::Array ReferenceConv(
+        const chainerx::Array& x,
+        const chainerx::Array& w,
+        const chainerx::Array& b,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group) {
+    std::vector<chainerx::Array> xs = SplitByLengths(x, 1, std::vector<int64_t>(group, x.shape()[1] / group));
+    std::vector<chainerx::Array> ws = SplitByLengths(w, 0, std::vector<int64_t>(group, w.shape()[0] / group));
+    std::vector<chainerx::Array> bs = SplitByLengths(b, 0, std::vector<int64_t>(group, b.shape()[0] / group));
+    std::vector<chainerx::Array> ys;
+    for (int i = 0; i < group; ++i) {
+        ys.push_back(chainerx::Conv(xs[i], ws[i], bs[i], strides, pads));
+    }
+    return chainerx::Concatenate(ys, 1);
+}
+
+TEST(NativeConvTest, Conv) {
+    chainerx::testing::ContextSession sess;
+
+    chainerx::Array x = SlowRandom({2, 3, 7, 6});
+    chainerx::Array w = SlowRandom({4, 3, 3, 2});
+    chainerx::Array b = SlowRandom({4});
+    Int64StackVector strides{2, 1};
+    Int64StackVector pads{1, 1};
+    ASSERT_TRUE(IsNativeConvSupported(x, w, 1));
+
+    chainerx::Array expected = chainerx::Conv(x, w, b, strides, pads);
+    for (NativeConvAlgorithm algorithm : GetNativeConvAlgorithmCandidates(w.shape(), strides, 1)) {
+        SCOPED_TRACE(GetNativeConvAlgorithmName(algorithm));
+        chainerx::Array actual = NativeConv(x, PackConvWeight(w, algorithm), w.shape(), b, strides, pads, 1, algorithm);
+        EXPECT_ARRAY_ALL_CLOSE2(expected, actual, 1e-5, 1e-5);
+    }
+}
+
+TEST(NativeConvTest, Winograd) {
+    chainerx::testing::ContextSession sess;
+
+    chainerx::Array x = SlowRandom({2, 5, 9, 7});
+    chainerx::Array w = SlowRandom({6, 5, 3, 3});
+    chainerx::Array b = SlowRandom({6});
+    Int64StackVector strides{1, 1};
+    std::vector<NativeConvAlgorithm> candidates = GetNativeConvAlgorithmCandidates(w.shape(), strides, 1);
+    ASSERT_EQ(4, candidates.size());
+    // Winograd is opt-in even for wide layers.
+    EXPECT_EQ(NativeConvAlgorithm::kIm2Col, ChooseNativeConvAlgorithm({2, 32, 16, 16}, {32, 32, 3, 3}, strides, 1));
+
+    for (int64_t pad : {0, 1}) {
+        Int64StackVector pads{pad, pad};
+        chainerx::Array expected = chainerx::Conv(x, w, b, strides, pads);
+        for (NativeConvAlgorithm algorithm : candidates) {
+            SCOPED_TRACE(GetNativeConvAlgorithmName(algorithm));
+            chainerx::Array actual = NativeConv(x, PackConvWeight(w, algorithm), w.shape(), b, strides, pads, 1, algorithm);
+            EXPECT_ARRAY_ALL_CLOSE2(expected, actual, 1e-4, 1e-4);
+        }
+    }
+}
+
+TEST(NativeConvTest, GroupedConv) {
+    chainerx::testing::ContextSession sess;
+
+    chainerx::Array x = SlowRandom({2, 6, 7, 6});
+    chainerx::Array w = SlowRandom({4, 3, 3, 3});
+    chainerx::Array b = SlowRandom({4});
+    Int64StackVector strides{1, 2};
+    Int64StackVector pads{1, 0};
+    ASSERT_FALSE(IsDepthwiseConv(x.shape(), w.shape(), 2));
+
+    chainerx::Array expected = ReferenceConv(x, w, b, strides, pads, 2);
+    for (NativeConvAlgorithm algorithm : GetNativeConvAlgorithmCandidates(w.shape(), strides, 2)) {
+        SCOPED_TRACE(GetNativeConvAlgorithmName(algorithm));
+        chainerx::Array actual = NativeConv(x, PackConvWeight(w, algorithm), w.shape(), b, strides, pads, 2, algorithm);
+        EXPECT_ARRAY_ALL_CLOSE2(expected, actual, 1e-5, 1e-5);
+    }
+}
+
+TEST(NativeConvTest, DepthwiseConv) {
+    chainerx::testing::ContextSession sess;
+
+    chainerx::Array x = SlowRandom({2, 4, 9, 8});
+    chainerx::Array w = SlowRandom({8, 1, 3, 3});
+    chainerx::Array b = SlowRandom({8});
+    ASSERT_TRUE(IsDepthwiseConv(x.shape(), w.shape(), 4));
+    EXPECT_EQ(NativeConvAlgorithm::kDirect, ChooseNativeConvAlgorithm(x.shape(), w.shape(), {1, 1}, 4));
+
+    for (int64_t stride : {1, 2}) {
+        Int64StackVector strides{stride, stride};
+        Int64StackVector pads{1, 1};
+        chainerx::Array expected = ReferenceConv(x, w, b, strides, pads, 4);
+        for (NativeConvAlgorithm algorithm : GetNativeConvAlgorithmCandidates(w.shape(), strides, 4)) {
+            SCOPED_TRACE(GetNativeConvAlgorithmName(algorithm));
+            chainerx::Array actual = NativeConv(x, PackConvWeight(w, algorithm), w.shape(), b, strides, pads, 4, algorithm);
+            EXPECT_ARRAY_ALL_CLOSE2(expected, actual, 1e-5, 1e-5);
+        }
+    }
+}
+
+TEST(NativeConvTest, ConvTranspose) {
+    chainerx::testing::ContextSession sess;
+
+    chainerx::Array x = SlowRandom({2, 4, 5, 4});
+    chainerx::Array w = SlowRandom({4, 3, 3, 2});
+    chainerx::Array b = SlowRandom({3});
+    Int64StackVector strides{2, 1};
+    Int64StackVector pads{1, 0};
+
+    chainerx::Array expected = chainerx::ConvTranspose(x, w, b, strides, pads);
+    chainerx::Array actual = NativeConvTranspose(x, w, b, strides, pads, {}, 1);
+    EXPECT_ARRAY_ALL_CLOSE2(expected, actual, 1e-5, 1e-5);
+
+    // Grouped transposed convolution equals per-group ones.
+    chainerx::Array gb = SlowRandom({6});
+    std::vector<chainerx::Array> xs = SplitByLengths(x, 1, {2, 2});
+    std::vector<chainerx::Array> ws = SplitByLengths(w, 0, {2, 2});
+    std::vector<chainerx::Array> bs = SplitByLengths(gb, 0, {3, 3});
+    chainerx::Array grouped_expected = chainerx::Concatenate(
+            {chainerx::ConvTranspose(xs[0], ws[0], bs[0], strides, pads), chainerx::ConvTranspose(xs[1], ws[1], bs[1], strides, pads)}, 1);
+    chainerx::Array grouped_actual = NativeConvTranspose(x, w, gb, strides, pads, {}, 2);
+    EXPECT_ARRAY_ALL_CLOSE2(grouped_expected, grouped_actual, 1e-5, 1e-5);
+}
+
+TEST(NativeConvTest, ConvGradWeight) {
+    chainerx::testing::ContextSession sess;
+
+    chainerx::Array x = SlowRandom({2, 6, 7, 6});
+    chainerx::Array w = SlowRandom({4, 3, 3, 2});
+    Int64StackVector strides{2, 1};
+    Int64StackVector pads{1, 1};
+    chainerx::Array gy = SlowRandom({2, 4, 4, 7});
+
+    chainerx::Shape ws_shape{2, 3, 3, 2};
+    std::vector<chainerx::Array> xs = SplitByLengths(x, 1, {3, 3});
+    std::vector<chainerx::Array> gys = SplitByLengths(gy, 1, {2, 2});
+    std::vector<chainerx::Array> gws;
+    for (int i = 0; i < 2; ++i) {
+        gws.push_back(x.device().backend().CallKernel<chainerx::ConvGradWeightKernel>(
+                w.dtype(), ws_shape, xs[i], gys[i], strides, pads, false /* cover_all */, absl::nullopt));
+    }
+    chainerx::Array expected = chainerx::Concatenate(gws, 0);
+    chainerx::Array actual = NativeConvGradWeight(w.shape(), x, gy, strides, pads, 2);
+    EXPECT_ARRAY_ALL_CLOSE2(expected, actual, 1e-4, 1e-4);
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
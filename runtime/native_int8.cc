@@ -0,0 +1,382 @@
+#include "runtime/native_int8.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/manipulation.h>
+
+#include <common/log.h>
+#include <runtime/int8_gemm.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+bool IsInt8(chainerx::Dtype dtype) {
+    return dtype == chainerx::Dtype::kUInt8 || dtype == chainerx::Dtype::kInt8;
+}
+
+// Activations are computed as uint8 and weights as int8.
+uint8_t ActivationMask(chainerx::Dtype dtype) {
+    return dtype == chainerx::Dtype::kInt8 ? 0x80 : 0;
+}
+
+uint8_t WeightMask(chainerx::Dtype dtype) {
+    return dtype == chainerx::Dtype::kUInt8 ? 0x80 : 0;
+}
+
+int32_t ShiftActivationZeroPoint(int32_t zero_point, chainerx::Dtype dtype) {
+    return dtype == chainerx::Dtype::kInt8 ? zero_point + 128 : zero_point;
+}
+
+int32_t ShiftWeightZeroPoint(int32_t zero_point, chainerx::Dtype dtype) {
+    return dtype == chainerx::Dtype::kUInt8 ? zero_point - 128 : zero_point;
+}
+
+int32_t PerChannel(const std::vector<int32_t>& values, int64_t i) {
+    return values.size() == 1 ? values[0] : values[i];
+}
+
+const uint8_t* BytePtr(const chainerx::Array& a) {
+    return static_cast<const uint8_t*>(RawStartPtr(a));
+}
+
+int64_t GetConvOutDim(int64_t in_dim, int64_t kernel, int64_t stride, int64_t pad) {
+    return (in_dim + pad * 2 - kernel) / stride + 1;
+}
+
+// Fills `col` of interleaved (C*KH*KW, OH*OW) from `x` of (C, H, W).
+// Out-of-bound elements are filled with `pad_value`.
+void Im2ColInterleaved(
+        const uint8_t* x,
+        uint8_t xor_mask,
+        uint8_t pad_value,
+        int64_t channels,
+        int64_t height,
+        int64_t width,
+        int64_t kernel_h,
+        int64_t kernel_w,
+        int64_t stride_h,
+        int64_t stride_w,
+        int64_t pad_h,
+        int64_t pad_w,
+        int64_t out_h,
+        int64_t out_w,
+        uint8_t* col) {
+    const int64_t k = channels * kernel_h * kernel_w;
+    const int64_t n = out_h * out_w;
+    for (int64_t kk = 0; kk < GetInt8PaddedK(k); ++kk) {
+        uint8_t* d = col + (kk / 4) * n * 4 + kk % 4;
+        if (kk >= k) {
+            for (int64_t j = 0; j < n; ++j) d[j * 4] = 0;
+            continue;
+        }
+        const int64_t c = kk / (kernel_h * kernel_w);
+        const int64_t ky = kk / kernel_w % kernel_h;
+        const int64_t kx = kk % kernel_w;
+        for (int64_t oy = 0; oy < out_h; ++oy) {
+            const int64_t iy = oy * stride_h - pad_h + ky;
+            for (int64_t ox = 0; ox < out_w; ++ox, d += 4) {
+                const int64_t ix = ox * stride_w - pad_w + kx;
+                *d = (iy >= 0 && iy < height && ix >= 0 && ix < width) ? x[(c * height + iy) * width + ix] ^ xor_mask : pad_value;
+            }
+        }
+    }
+}
+
+// Returns the sum of each column of an interleaved matrix.
+void InterleavedColumnSums(int64_t k, int64_t n, const uint8_t* r, int32_t* sums) {
+    std::fill(sums, sums + n, 0);
+    for (int64_t q = 0; q < GetInt8PaddedK(k) / 4; ++q) {
+        const uint8_t* rq = r + q * n * 4;
+        for (int64_t j = 0; j < n; ++j) {
+            for (int64_t t = 0; t < 4; ++t) {
+                sums[j] += rq[j * 4 + t];
+            }
+        }
+    }
+}
+
+template <class T>
+T Requantize(float v, int32_t zero_point) {
+    const float lo = std::numeric_limits<T>::lowest();
+    const float hi = std::numeric_limits<T>::max();
+    return static_cast<T>(std::min(hi, std::max(lo, std::nearbyint(v) + zero_point)));
+}
+
+}  // namespace
+
+bool IsNativeInt8ConvSupported(const chainerx::Array& x, const chainerx::Array& w) {
+    return (x.ndim() == 4 && w.ndim() == 4 && IsInt8(x.dtype()) && IsInt8(w.dtype()) && IsNativeDevice(&x.device()) &&
+            IsNativeDevice(&w.device()));
+}
+
+bool IsNativeInt8MatMulSupported(const chainerx::Array& a, const chainerx::Array& b) {
+    return (a.ndim() >= 1 && b.ndim() == 2 && IsInt8(a.dtype()) && IsInt8(b.dtype()) && IsNativeDevice(&a.device()) &&
+            IsNativeDevice(&b.device()));
+}
+
+chainerx::Array PackInt8ConvWeight(const chainerx::Array& w) {
+    const int64_t out_channels = w.shape()[0];
+    const int64_t k = w.GetTotalSize() / out_channels;
+    const int64_t kp = GetInt8PaddedK(k);
+    const chainerx::Array cw = chainerx::AsContiguous(w);
+    const uint8_t mask = WeightMask(w.dtype());
+    chainerx::Array packed = chainerx::Zeros({out_channels, kp}, chainerx::Dtype::kInt8, w.device());
+    const uint8_t* src = BytePtr(cw);
+    uint8_t* dst = static_cast<uint8_t*>(RawStartPtr(packed));
+    for (int64_t oc = 0; oc < out_channels; ++oc) {
+        for (int64_t i = 0; i < k; ++i) {
+            dst[oc * kp + i] = src[oc * k + i] ^ mask;
+        }
+    }
+    return packed;
+}
+
+chainerx::Array ComputeInt8ConvWeightSums(const chainerx::Array& w) {
+    const int64_t out_channels = w.shape()[0];
+    const int64_t k = w.GetTotalSize() / out_channels;
+    const chainerx::Array cw = chainerx::AsContiguous(w);
+    const uint8_t mask = WeightMask(w.dtype());
+    chainerx::Array sums = chainerx::Empty({out_channels}, chainerx::Dtype::kInt32, w.device());
+    const uint8_t* src = BytePtr(cw);
+    int32_t* dst = static_cast<int32_t*>(RawStartPtr(sums));
+    for (int64_t oc = 0; oc < out_channels; ++oc) {
+        int32_t sum = 0;
+        for (int64_t i = 0; i < k; ++i) {
+            sum += static_cast<int8_t>(src[oc * k + i] ^ mask);
+        }
+        dst[oc] = sum;
+    }
+    return sums;
+}
+
+chainerx::Array PackInt8MatMulWeight(const chainerx::Array& b) {
+    CHECK_EQ(2, b.ndim());
+    const int64_t k = b.shape()[0];
+    const int64_t n = b.shape()[1];
+    const chainerx::Array cb = chainerx::AsContiguous(b);
+    chainerx::Array packed = chainerx::Empty({GetInt8PaddedK(k) / 4, n, 4}, chainerx::Dtype::kInt8, b.device());
+    PackInt8Interleaved(k, n, BytePtr(cb), n, WeightMask(b.dtype()), static_cast<uint8_t*>(RawStartPtr(packed)));
+    return packed;
+}
+
+chainerx::Array ComputeInt8MatMulWeightSums(const chainerx::Array& b) {
+    CHECK_EQ(2, b.ndim());
+    const int64_t k = b.shape()[0];
+    const int64_t n = b.shape()[1];
+    const chainerx::Array cb = chainerx::AsContiguous(b);
+    const uint8_t mask = WeightMask(b.dtype());
+    chainerx::Array sums = chainerx::Zeros({n}, chainerx::Dtype::kInt32, b.device());
+    const uint8_t* src = BytePtr(cb);
+    int32_t* dst = static_cast<int32_t*>(RawStartPtr(sums));
+    for (int64_t i = 0; i < k; ++i) {
+        for (int64_t j = 0; j < n; ++j) {
+            dst[j] += static_cast<int8_t>(src[i * n + j] ^ mask);
+        }
+    }
+    return sums;
+}
+
+std::vector<int32_t> GetInt8ZeroPoints(const absl::optional<chainerx::Array>& zero_point) {
+    if (!zero_point.has_value()) {
+        return {0};
+    }
+    CHECK_GE(1, zero_point->ndim());
+    const chainerx::Array z = chainerx::AsContiguous(zero_point->AsType(chainerx::Dtype::kInt32));
+    const int32_t* p = static_cast<const int32_t*>(RawStartPtr(z));
+    return std::vector<int32_t>(p, p + z.GetTotalSize());
+}
+
+std::vector<float> GetQuantizationScales(const chainerx::Array& scale) {
+    CHECK_GE(1, scale.ndim());
+    const chainerx::Array s = chainerx::AsContiguous(scale.AsType(chainerx::Dtype::kFloat32));
+    const float* p = static_cast<const float*>(RawStartPtr(s));
+    return std::vector<float>(p, p + s.GetTotalSize());
+}
+
+chainerx::Array NativeInt8Conv(
+        const chainerx::Array& x,
+        const chainerx::Array& packed_w,
+        const chainerx::Array& w_sums,
+        const chainerx::Shape& w_shape,
+        chainerx::Dtype w_dtype,
+        int32_t x_zero_point,
+        const std::vector<int32_t>& w_zero_points,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group,
+        const Int8Requantization* requant) {
+    CHECK_EQ(4, x.ndim());
+    CHECK_EQ(4, w_shape.size());
+    CHECK_EQ(2, strides.size());
+    CHECK_EQ(2, pads.size());
+    const int64_t batch_size = x.shape()[0];
+    const int64_t channels = x.shape()[1];
+    const int64_t height = x.shape()[2];
+    const int64_t width = x.shape()[3];
+    const int64_t out_channels = w_shape[0];
+    const int64_t group_channels = w_shape[1];
+    const int64_t group_out_channels = out_channels / group;
+    const int64_t kernel_h = w_shape[2];
+    const int64_t kernel_w = w_shape[3];
+    const int64_t k = group_channels * kernel_h * kernel_w;
+    const int64_t kp = GetInt8PaddedK(k);
+    const int64_t out_h = GetConvOutDim(height, kernel_h, strides[0], pads[0]);
+    const int64_t out_w = GetConvOutDim(width, kernel_w, strides[1], pads[1]);
+    const int64_t out_size = out_h * out_w;
+    CHECK_EQ(channels, group_channels * group);
+    CHECK_LT(0, out_h);
+    CHECK_LT(0, out_w);
+    CHECK(w_zero_points.size() == 1 || w_zero_points.size() == out_channels) << w_zero_points.size();
+
+    const int32_t xzp = ShiftActivationZeroPoint(x_zero_point, x.dtype());
+    CHECK_LE(0, xzp);
+    CHECK_GE(255, xzp);
+    std::vector<int32_t> wzps(w_zero_points.size());
+    bool has_wzp = false;
+    for (size_t i = 0; i < wzps.size(); ++i) {
+        wzps[i] = ShiftWeightZeroPoint(w_zero_points[i], w_dtype);
+        has_wzp |= wzps[i] != 0;
+    }
+
+    absl::optional<chainerx::Array> bias;
+    if (requant && requant->b.has_value()) {
+        CHECK_EQ(chainerx::Dtype::kInt32, requant->b->dtype());
+        CHECK_EQ(out_channels, requant->b->GetTotalSize());
+        bias = chainerx::AsContiguous(*requant->b);
+    }
+    const int32_t* bp = bias.has_value() ? static_cast<const int32_t*>(RawStartPtr(*bias)) : nullptr;
+    const chainerx::Dtype y_dtype = requant ? requant->y_dtype : chainerx::Dtype::kInt32;
+    CHECK(y_dtype == chainerx::Dtype::kInt32 || IsInt8(y_dtype)) << y_dtype;
+
+    const chainerx::Array cx = chainerx::AsContiguous(x);
+    const uint8_t* xp = BytePtr(cx);
+    const int8_t* wp = static_cast<const int8_t*>(RawStartPtr(packed_w));
+    const int32_t* wsp = static_cast<const int32_t*>(RawStartPtr(w_sums));
+    chainerx::Array y = chainerx::Empty({batch_size, out_channels, out_h, out_w}, y_dtype, x.device());
+    std::vector<uint8_t> col(kp * out_size);
+    std::vector<int32_t> col_sums(out_size);
+    std::vector<int32_t> acc(group_out_channels * out_size);
+
+    for (int64_t n = 0; n < batch_size; ++n) {
+        for (int64_t g = 0; g < group; ++g) {
+            Im2ColInterleaved(
+                    xp + (n * channels + g * group_channels) * height * width,
+                    ActivationMask(x.dtype()),
+                    xzp,
+                    group_channels,
+                    height,
+                    width,
+                    kernel_h,
+                    kernel_w,
+                    strides[0],
+                    strides[1],
+                    pads[0],
+                    pads[1],
+                    out_h,
+                    out_w,
+                    col.data());
+            if (has_wzp) {
+                InterleavedColumnSums(k, out_size, col.data(), col_sums.data());
+            }
+            Int8Gemm(group_out_channels, out_size, k, wp + g * group_out_channels * kp, kp, col.data(), acc.data(), out_size);
+
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for
+#endif
+            for (int64_t o = 0; o < group_out_channels; ++o) {
+                const int64_t oc = g * group_out_channels + o;
+                const int32_t wzp = PerChannel(wzps, oc);
+                const int32_t offset = k * xzp * wzp - xzp * wsp[oc] + (bp ? bp[oc] : 0);
+                int32_t* a = &acc[o * out_size];
+                for (int64_t p = 0; p < out_size; ++p) {
+                    a[p] += offset - (has_wzp ? wzp * col_sums[p] : 0);
+                }
+
+                void* yc = static_cast<uint8_t*>(RawStartPtr(y)) + (n * out_channels + oc) * out_size * chainerx::GetItemSize(y_dtype);
+                if (!requant) {
+                    std::copy(a, a + out_size, static_cast<int32_t*>(yc));
+                    continue;
+                }
+                const float w_scale = requant->w_scales.size() == 1 ? requant->w_scales[0] : requant->w_scales[oc];
+                const float multiplier = requant->x_scale * w_scale / requant->y_scale;
+                if (y_dtype == chainerx::Dtype::kUInt8) {
+                    uint8_t* yp = static_cast<uint8_t*>(yc);
+                    for (int64_t p = 0; p < out_size; ++p) yp[p] = Requantize<uint8_t>(a[p] * multiplier, requant->y_zero_point);
+                } else {
+                    int8_t* yp = static_cast<int8_t*>(yc);
+                    for (int64_t p = 0; p < out_size; ++p) yp[p] = Requantize<int8_t>(a[p] * multiplier, requant->y_zero_point);
+                }
+            }
+        }
+    }
+    return y;
+}
+
+chainerx::Array NativeInt8MatMul(
+        const chainerx::Array& a,
+        const chainerx::Array& packed_b,
+        const chainerx::Array& b_sums,
+        const chainerx::Shape& b_shape,
+        chainerx::Dtype b_dtype,
+        const std::vector<int32_t>& a_zero_points,
+        const std::vector<int32_t>& b_zero_points) {
+    CHECK_EQ(2, b_shape.size());
+    const int64_t k = b_shape[0];
+    const int64_t n = b_shape[1];
+    CHECK_EQ(k, a.shape().back());
+    const int64_t rows = a.ndim() == 1 ? 1 : a.shape()[a.ndim() - 2];
+    const int64_t m = a.GetTotalSize() / k;
+    CHECK(a_zero_points.size() == 1 || a_zero_points.size() == rows) << a_zero_points.size();
+    CHECK(b_zero_points.size() == 1 || b_zero_points.size() == n) << b_zero_points.size();
+
+    // The left-hand side is read directly by the kernel, so int8
+    // activations need to be converted into uint8.
+    chainerx::Array ca = chainerx::AsContiguous(a);
+    if (a.dtype() == chainerx::Dtype::kInt8) {
+        chainerx::Array shifted = chainerx::Empty(a.shape(), chainerx::Dtype::kUInt8, a.device());
+        const uint8_t* src = BytePtr(ca);
+        uint8_t* dst = static_cast<uint8_t*>(RawStartPtr(shifted));
+        for (int64_t i = 0; i < a.GetTotalSize(); ++i) dst[i] = src[i] ^ 0x80;
+        ca = shifted;
+    }
+    const uint8_t* ap = BytePtr(ca);
+
+    bool has_bzp = false;
+    std::vector<int32_t> bzps(b_zero_points.size());
+    for (size_t i = 0; i < bzps.size(); ++i) {
+        bzps[i] = ShiftWeightZeroPoint(b_zero_points[i], b_dtype);
+        has_bzp |= bzps[i] != 0;
+    }
+
+    chainerx::Shape y_shape = a.shape();
+    y_shape.back() = n;
+    chainerx::Array y = chainerx::Empty(y_shape, chainerx::Dtype::kInt32, a.device());
+    int32_t* yp = static_cast<int32_t*>(RawStartPtr(y));
+    const int32_t* bsp = static_cast<const int32_t*>(RawStartPtr(b_sums));
+    Int8Gemm(m, n, k, ap, k, static_cast<const int8_t*>(RawStartPtr(packed_b)), yp, n);
+
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int64_t i = 0; i < m; ++i) {
+        const int32_t azp = ShiftActivationZeroPoint(PerChannel(a_zero_points, i % rows), a.dtype());
+        int32_t a_sum = 0;
+        if (has_bzp) {
+            for (int64_t kk = 0; kk < k; ++kk) a_sum += ap[i * k + kk];
+        }
+        int32_t* yr = yp + i * n;
+        for (int64_t j = 0; j < n; ++j) {
+            const int32_t bzp = PerChannel(bzps, j);
+            yr[j] += k * azp * bzp - azp * bsp[j] - bzp * a_sum;
+        }
+    }
+    return y;
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <absl/types/optional.h>
+
+#include <chainerx/array.h>
+
+#include <runtime/chainerx_util.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// Quantized convolution and matrix multiplication on native devices.
+// Both uint8 and int8 inputs are accepted. They are shifted by 128
+// where necessary so the kernels in int8_gemm.h always multiply uint8
+// activations by int8 weights, and zero points are shifted together
+// so results do not change. Zero points are applied to the int32
+// accumulators afterwards using row and column sums, so inputs are
+// never widened to int32.
+
+bool IsNativeInt8ConvSupported(const chainerx::Array& x, const chainerx::Array& w);
+
+bool IsNativeInt8MatMulSupported(const chainerx::Array& a, const chainerx::Array& b);
+
+// Converts a weight of (OC, IC/G, KH, KW) into an int8 matrix of
+// (OC, Kp) where Kp is IC/G*KH*KW rounded up to a multiple of four.
+chainerx::Array PackInt8ConvWeight(const chainerx::Array& w);
+
+// Returns int32 sums of each row of the packed weight of `w`.
+chainerx::Array ComputeInt8ConvWeightSums(const chainerx::Array& w);
+
+// Converts a weight of (K, N) into the int8 interleaved layout of
+// `Int8Gemm`.
+chainerx::Array PackInt8MatMulWeight(const chainerx::Array& b);
+
+// Returns int32 sums of each column of the packed weight of `b`.
+chainerx::Array ComputeInt8MatMulWeightSums(const chainerx::Array& b);
+
+// Reads a scalar or 1D array of zero points (or scales) as a vector.
+std::vector<int32_t> GetInt8ZeroPoints(const absl::optional<chainerx::Array>& zero_point);
+std::vector<float> GetQuantizationScales(const chainerx::Array& scale);
+
+// Parameters to requantize int32 accumulators of QLinearConv into
+// `y_dtype` in the same pass.
+struct Int8Requantization {
+    float x_scale;
+    // A single value or one value per output channel.
+    std::vector<float> w_scales;
+    float y_scale;
+    int32_t y_zero_point;
+    chainerx::Dtype y_dtype;
+    // int32 bias of (OC) quantized with x_scale * w_scale.
+    absl::optional<chainerx::Array> b;
+};
+
+// Runs a 2D quantized convolution. `packed_w` and `w_sums` must be
+// the results of `PackInt8ConvWeight` and `ComputeInt8ConvWeightSums`
+// for a weight of `w_shape` and `w_dtype`. `w_zero_points` has a
+// single value or one value per output channel. `pads` must be
+// symmetric. Returns int32 accumulators when `requant` is nullptr.
+chainerx::Array NativeInt8Conv(
+        const chainerx::Array& x,
+        const chainerx::Array& packed_w,
+        const chainerx::Array& w_sums,
+        const chainerx::Shape& w_shape,
+        chainerx::Dtype w_dtype,
+        int32_t x_zero_point,
+        const std::vector<int32_t>& w_zero_points,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group,
+        const Int8Requantization* requant);
+
+// Runs MatMulInteger of `a` of (..., M, K) and a weight of (K, N).
+// `a_zero_points` has a single value or one value per row, and
+// `b_zero_points` has a single value or one value per column.
+chainerx::Array NativeInt8MatMul(
+        const chainerx::Array& a,
+        const chainerx::Array& packed_b,
+        const chainerx::Array& b_sums,
+        const chainerx::Shape& b_shape,
+        chainerx::Dtype b_dtype,
+        const std::vector<int32_t>& a_zero_points,
+        const std::vector<int32_t>& b_zero_points);
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,130 @@
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <chainerx/array.h>
+#include <chainerx/routines/connection.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/manipulation.h>
+#include <chainerx/routines/misc.h>
+#include <chainerx/testing/array_check.h>
+#include <chainerx/testing/context_session.h>
+
+#include <runtime/chainerx_util.h>
+#include <runtime/native_int8.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+template <class T>
+chainerx::Array MakeBytes(const chainerx::Shape& shape, int seed) {
+    std::vector<T> data(shape.GetTotalSize());
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<T>((i * 37 + seed) % 251);
+    }
+    return MakeArray(std::is_same<T, uint8_t>::value ? chainerx::Dtype::kUInt8 : chainerx::Dtype::kInt8, shape, data.data());
+}
+
+chainerx::Array Dequantize(const chainerx::Array& q, float zero_point) {
+    return q.AsType(chainerx::Dtype::kFloat32) - zero_point;
+}
+
+TEST(NativeInt8Test, ConvInteger) {
+    chainerx::testing::ContextSession sess;
+
+    chainerx::Array x = MakeBytes<uint8_t>({2, 3, 7, 6}, 1);
+    chainerx::Array w = MakeBytes<int8_t>({4, 3, 3, 2}, 2);
+    Int64StackVector strides{2, 1};
+    Int64StackVector pads{0, 0};
+    ASSERT_TRUE(IsNativeInt8ConvSupported(x, w));
+
+    chainerx::Array expected = chainerx::Conv(Dequantize(x, 3), Dequantize(w, 0), absl::nullopt, strides, pads);
+    chainerx::Array actual = NativeInt8Conv(
+            x, PackInt8ConvWeight(w), ComputeInt8ConvWeightSums(w), w.shape(), w.dtype(), 3, {0}, strides, pads, 1, nullptr);
+    EXPECT_EQ(chainerx::Dtype::kInt32, actual.dtype());
+    EXPECT_ARRAY_ALL_CLOSE2(expected, actual.AsType(chainerx::Dtype::kFloat32), 0, 0);
+}
+
+TEST(NativeInt8Test, GroupedConvIntegerWithZeroPoints) {
+    chainerx::testing::ContextSession sess;
+
+    // int8 activations and uint8 weights with per-channel zero points.
+    chainerx::Array x = MakeBytes<int8_t>({2, 4, 6, 5}, 3);
+    chainerx::Array w = MakeBytes<uint8_t>({4, 2, 3, 3}, 4);
+    Int64StackVector strides{1, 1};
+    Int64StackVector pads{0, 0};
+    std::vector<int32_t> w_zero_points = {100, 120, 140, 160};
+
+    std::vector<chainerx::Array> xs = SplitByLengths(Dequantize(x, -5), 1, {2, 2});
+    std::vector<chainerx::Array> ws;
+    for (int i = 0; i < 4; ++i) {
+        ws.push_back(Dequantize(w.At({i}), w_zero_points[i]));
+    }
+    chainerx::Array w0 = chainerx::Stack({ws[0], ws[1]});
+    chainerx::Array w1 = chainerx::Stack({ws[2], ws[3]});
+    chainerx::Array expected = chainerx::Concatenate(
+            {chainerx::Conv(xs[0], w0, absl::nullopt, strides, pads), chainerx::Conv(xs[1], w1, absl::nullopt, strides, pads)}, 1);
+    chainerx::Array actual = NativeInt8Conv(
+            x, PackInt8ConvWeight(w), ComputeInt8ConvWeightSums(w), w.shape(), w.dtype(), -5, w_zero_points, strides, pads, 2, nullptr);
+    EXPECT_ARRAY_ALL_CLOSE2(expected, actual.AsType(chainerx::Dtype::kFloat32), 0, 0);
+}
+
+TEST(NativeInt8Test, QLinearConv) {
+    chainerx::testing::ContextSession sess;
+
+    chainerx::Array x = MakeBytes<uint8_t>({1, 3, 5, 5}, 5);
+    chainerx::Array w = MakeBytes<int8_t>({2, 3, 3, 3}, 6);
+    std::vector<int32_t> bias_data = {1000, -2000};
+    chainerx::Array b = MakeArray(chainerx::Dtype::kInt32, {2}, bias_data.data());
+    Int64StackVector strides{1, 1};
+    Int64StackVector pads{1, 1};
+
+    Int8Requantization requant;
+    requant.x_scale = 0.02f;
+    requant.w_scales = {0.01f, 0.03f};
+    requant.y_scale = 0.5f;
+    requant.y_zero_point = 128;
+    requant.y_dtype = chainerx::Dtype::kUInt8;
+    requant.b = b;
+
+    // Padded elements must be the zero point of `x`.
+    const int32_t x_zero_point = 10;
+    Int64StackVector no_pads{0, 0};
+    chainerx::Array px = chainerx::Full({1, 3, 7, 7}, x_zero_point, chainerx::Dtype::kUInt8);
+    BlitArray(x, px.At({chainerx::Slice(), chainerx::Slice(), chainerx::Slice(1, 6), chainerx::Slice(1, 6)}));
+    chainerx::Array acc = NativeInt8Conv(
+            px, PackInt8ConvWeight(w), ComputeInt8ConvWeightSums(w), w.shape(), w.dtype(), x_zero_point, {0}, strides, no_pads, 1, nullptr);
+    chainerx::Array expected = acc.AsType(chainerx::Dtype::kFloat32) + b.AsType(chainerx::Dtype::kFloat32).Reshape({1, 2, 1, 1});
+    std::vector<float> multipliers = {0.02f * 0.01f / 0.5f, 0.02f * 0.03f / 0.5f};
+    expected *= MakeArray(chainerx::Dtype::kFloat32, {1, 2, 1, 1}, multipliers.data());
+    expected = chainerx::Minimum(chainerx::Maximum(expected + 128, 0), 255);
+
+    chainerx::Array actual = NativeInt8Conv(
+            x, PackInt8ConvWeight(w), ComputeInt8ConvWeightSums(w), w.shape(), w.dtype(), x_zero_point, {0}, strides, pads, 1, &requant);
+    EXPECT_EQ(chainerx::Dtype::kUInt8, actual.dtype());
+    EXPECT_ARRAY_ALL_CLOSE2(expected, actual.AsType(chainerx::Dtype::kFloat32), 0, 0.5 + 1e-4);
+}
+
+TEST(NativeInt8Test, MatMulInteger) {
+    chainerx::testing::ContextSession sess;
+
+    chainerx::Array a = MakeBytes<uint8_t>({2, 3, 21}, 7);
+    chainerx::Array b = MakeBytes<int8_t>({21, 19}, 8);
+    std::vector<int32_t> a_zero_points = {1, 2, 3};
+    std::vector<int32_t> b_zero_points(19);
+    for (int i = 0; i < 19; ++i) b_zero_points[i] = i - 9;
+    ASSERT_TRUE(IsNativeInt8MatMulSupported(a, b));
+
+    chainerx::Array fa = a.AsType(chainerx::Dtype::kFloat32) - MakeArray(chainerx::Dtype::kInt32, {3, 1}, a_zero_points.data());
+    chainerx::Array fb = b.AsType(chainerx::Dtype::kFloat32) - MakeArray(chainerx::Dtype::kInt32, {19}, b_zero_points.data());
+    chainerx::Array expected = NumpyMatMul(fa, fb);
+    chainerx::Array actual = NativeInt8MatMul(
+            a, PackInt8MatMulWeight(b), ComputeInt8MatMulWeightSums(b), b.shape(), b.dtype(), a_zero_points, b_zero_points);
+    EXPECT_ARRAY_ALL_CLOSE2(expected, actual.AsType(chainerx::Dtype::kFloat32), 0, 0);
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,236 @@
+#include "runtime/native_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <chainerx/routines/misc.h>
+
+#include <common/log.h>
+#include <runtime/chainerx_util.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+// Parameters are split into chunks of this number of elements so
+// threads are balanced regardless of the sizes of parameters.
+constexpr int64_t kChunkSize = 1 << 16;
+
+// A contiguous range of a float32 parameter and its states.
+struct Chunk {
+    float* param;
+    const float* grad;
+    float* s0;
+    float* s1;
+    int64_t size;
+};
+
+bool IsFusable(const chainerx::Array& a) {
+    return a.dtype() == chainerx::Dtype::kFloat32 && a.IsContiguous() && IsNativeDevice(&a.device());
+}
+
+// Collects chunks of native float32 parameters into `chunks` and
+// returns indices of the other parameters. `holders` keeps contiguous
+// copies of gradients alive.
+std::vector<size_t> CollectChunks(
+        const std::vector<chainerx::Array>& params,
+        const std::vector<chainerx::Array>& grads,
+        const std::vector<chainerx::Array>& s0s,
+        const std::vector<chainerx::Array>& s1s,
+        std::vector<Chunk>* chunks,
+        std::vector<chainerx::Array>* holders) {
+    CHECK_EQ(params.size(), grads.size());
+    CHECK(s0s.empty() || s0s.size() == params.size());
+    CHECK(s1s.empty() || s1s.size() == params.size());
+    std::vector<size_t> rest;
+    for (size_t i = 0; i < params.size(); ++i) {
+        const chainerx::Array& param = params[i];
+        CHECK_EQ(param.shape(), grads[i].shape()) << "Gradient shape mismatch at " << i;
+        if (!IsFusable(param) || !IsNativeDevice(&grads[i].device()) || (!s0s.empty() && !IsFusable(s0s[i])) ||
+            (!s1s.empty() && !IsFusable(s1s[i]))) {
+            rest.push_back(i);
+            continue;
+        }
+        const chainerx::Array grad = chainerx::AsContiguous(grads[i].AsType(chainerx::Dtype::kFloat32, false));
+        holders->push_back(grad);
+        float* p = static_cast<float*>(RawStartPtr(param));
+        const float* g = static_cast<const float*>(RawStartPtr(grad));
+        float* s0 = s0s.empty() ? nullptr : static_cast<float*>(RawStartPtr(s0s[i]));
+        float* s1 = s1s.empty() ? nullptr : static_cast<float*>(RawStartPtr(s1s[i]));
+        const int64_t size = param.GetTotalSize();
+        for (int64_t offset = 0; offset < size; offset += kChunkSize) {
+            const int64_t n = std::min(kChunkSize, size - offset);
+            chunks->push_back(Chunk{p + offset, g + offset, s0 ? s0 + offset : nullptr, s1 ? s1 + offset : nullptr, n});
+        }
+    }
+    return rest;
+}
+
+}  // namespace
+
+void SGDUpdate(
+        const SGDConfig& config,
+        const std::vector<chainerx::Array>& params,
+        const std::vector<chainerx::Array>& grads,
+        const std::vector<chainerx::Array>& moms) {
+    const bool has_momentum = config.momentum != 0.0f;
+    CHECK_EQ(has_momentum ? params.size() : 0, moms.size());
+    std::vector<Chunk> chunks;
+    std::vector<chainerx::Array> holders;
+    const std::vector<size_t> rest = CollectChunks(params, grads, moms, {}, &chunks, &holders);
+
+    const float lr = config.lr;
+    const float momentum = config.momentum;
+    const float weight_decay = config.weight_decay;
+    const bool nesterov = config.nesterov;
+    const int64_t num_chunks = chunks.size();
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t c = 0; c < num_chunks; ++c) {
+        const Chunk& chunk = chunks[c];
+        float* p = chunk.param;
+        const float* g = chunk.grad;
+        float* m = chunk.s0;
+        if (!has_momentum) {
+            for (int64_t i = 0; i < chunk.size; ++i) {
+                p[i] -= lr * (g[i] + weight_decay * p[i]);
+            }
+        } else if (nesterov) {
+            for (int64_t i = 0; i < chunk.size; ++i) {
+                const float gi = g[i] + weight_decay * p[i];
+                m[i] = momentum * m[i] + gi;
+                p[i] -= lr * (gi + momentum * m[i]);
+            }
+        } else {
+            for (int64_t i = 0; i < chunk.size; ++i) {
+                m[i] = momentum * m[i] + g[i] + weight_decay * p[i];
+                p[i] -= lr * m[i];
+            }
+        }
+    }
+
+    for (size_t i : rest) {
+        chainerx::Array param = params[i];
+        chainerx::Array grad = grads[i].AsType(param.dtype(), false);
+        if (weight_decay != 0.0f) {
+            grad = grad + param * weight_decay;
+        }
+        if (!has_momentum) {
+            param -= grad * lr;
+            continue;
+        }
+        chainerx::Array mom = moms[i];
+        mom *= momentum;
+        mom += grad;
+        if (nesterov) {
+            param -= (grad + mom * momentum) * lr;
+        } else {
+            param -= mom * lr;
+        }
+    }
+}
+
+void AdamUpdate(
+        const AdamConfig& config,
+        const std::vector<chainerx::Array>& params,
+        const std::vector<chainerx::Array>& grads,
+        const std::vector<chainerx::Array>& ms,
+        const std::vector<chainerx::Array>& vs) {
+    CHECK_EQ(params.size(), ms.size());
+    CHECK_EQ(params.size(), vs.size());
+    CHECK_LT(0, config.step);
+    std::vector<Chunk> chunks;
+    std::vector<chainerx::Array> holders;
+    const std::vector<size_t> rest = CollectChunks(params, grads, ms, vs, &chunks, &holders);
+
+    const float lr = config.lr;
+    const float beta1 = config.beta1;
+    const float beta2 = config.beta2;
+    const float epsilon = config.epsilon;
+    const float l2 = config.decoupled_weight_decay ? 0.0f : config.weight_decay;
+    const float decay = config.decoupled_weight_decay ? 1.0f - config.lr * config.weight_decay : 1.0f;
+    const float step_size = lr / static_cast<float>(1.0 - std::pow(beta1, config.step));
+    const float inv_sqrt_bc2 = static_cast<float>(1.0 / std::sqrt(1.0 - std::pow(beta2, config.step)));
+    const int64_t num_chunks = chunks.size();
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t c = 0; c < num_chunks; ++c) {
+        const Chunk& chunk = chunks[c];
+        float* p = chunk.param;
+        const float* g = chunk.grad;
+        float* m = chunk.s0;
+        float* v = chunk.s1;
+        for (int64_t i = 0; i < chunk.size; ++i) {
+            const float gi = g[i] + l2 * p[i];
+            m[i] = beta1 * m[i] + (1 - beta1) * gi;
+            v[i] = beta2 * v[i] + (1 - beta2) * gi * gi;
+            p[i] = p[i] * decay - step_size * m[i] / (std::sqrt(v[i]) * inv_sqrt_bc2 + epsilon);
+        }
+    }
+
+    for (size_t i : rest) {
+        chainerx::Array param = params[i];
+        chainerx::Array grad = grads[i].AsType(param.dtype(), false);
+        if (l2 != 0.0f) {
+            grad = grad + param * l2;
+        }
+        chainerx::Array m = ms[i];
+        chainerx::Array v = vs[i];
+        m *= beta1;
+        m += grad * (1 - beta1);
+        v *= beta2;
+        v += grad * grad * (1 - beta2);
+        if (decay != 1.0f) {
+            param *= decay;
+        }
+        param -= m * step_size / (chainerx::Sqrt(v) * inv_sqrt_bc2 + epsilon);
+    }
+}
+
+bool AccumulateGradients(
+        const std::vector<chainerx::Array>& grads,
+        const std::vector<chainerx::Array>& accs,
+        int64_t micro_batch,
+        int64_t num_micro_batches) {
+    CHECK_LE(0, micro_batch);
+    CHECK_LT(micro_batch, num_micro_batches);
+    std::vector<Chunk> chunks;
+    std::vector<chainerx::Array> holders;
+    const std::vector<size_t> rest = CollectChunks(accs, grads, {}, {}, &chunks, &holders);
+
+    const bool is_first = micro_batch == 0;
+    const bool is_last = micro_batch == num_micro_batches - 1;
+    const float scale = is_last ? 1.0f / num_micro_batches : 1.0f;
+    const int64_t num_chunks = chunks.size();
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int64_t c = 0; c < num_chunks; ++c) {
+        const Chunk& chunk = chunks[c];
+        float* acc = chunk.param;
+        const float* g = chunk.grad;
+        // Stale values of the previous batch are overwritten, not added.
+        for (int64_t i = 0; i < chunk.size; ++i) {
+            acc[i] = ((is_first ? 0 : acc[i]) + g[i]) * scale;
+        }
+    }
+
+    for (size_t i : rest) {
+        chainerx::Array acc = accs[i];
+        if (is_first) {
+            acc.Fill(0);
+        }
+        acc += grads[i].AsType(acc.dtype(), false);
+        if (is_last) {
+            acc *= scale;
+        }
+    }
+    return is_last;
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
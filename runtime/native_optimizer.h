@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <chainerx/array.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// Optimizers which update parameters in place at the end of a training
+// step. Native float32 parameters are updated by a single
+// multithreaded loop over all parameters, and the others fall back to
+// in-place ChainerX routines.
+
+struct SGDConfig {
+    float lr = 0.01f;
+    float momentum = 0.0f;
+    float weight_decay = 0.0f;
+    bool nesterov = false;
+};
+
+// Runs momentum SGD. `moms` must be empty if `momentum` is zero.
+//
+//   g = grad + weight_decay * param
+//   mom = momentum * mom + g
+//   param -= lr * (nesterov ? g + momentum * mom : mom)
+void SGDUpdate(
+        const SGDConfig& config,
+        const std::vector<chainerx::Array>& params,
+        const std::vector<chainerx::Array>& grads,
+        const std::vector<chainerx::Array>& moms);
+
+struct AdamConfig {
+    float lr = 0.001f;
+    float beta1 = 0.9f;
+    float beta2 = 0.999f;
+    float epsilon = 1e-8f;
+    float weight_decay = 0.0f;
+    // AdamW if true. Otherwise, the weight decay is added to gradients.
+    bool decoupled_weight_decay = false;
+    // The number of updates including this one, used for the bias
+    // correction.
+    int64_t step = 1;
+};
+
+void AdamUpdate(
+        const AdamConfig& config,
+        const std::vector<chainerx::Array>& params,
+        const std::vector<chainerx::Array>& grads,
+        const std::vector<chainerx::Array>& ms,
+        const std::vector<chainerx::Array>& vs);
+
+// Accumulates gradients of micro-batches into `accs` in place.
+// Returns true for the last micro-batch, where `accs` have the mean of
+// gradients of all micro-batches.
+bool AccumulateGradients(
+        const std::vector<chainerx::Array>& grads,
+        const std::vector<chainerx::Array>& accs,
+        int64_t micro_batch,
+        int64_t num_micro_batches);
+
+}  // namespace runtime
+}  // namespace chainer_compiler
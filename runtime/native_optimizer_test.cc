@@ -0,0 +1,146 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <chainerx/array.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/testing/array_check.h>
+#include <chainerx/testing/context_session.h>
+
+#include <runtime/chainerx_util.h>
+#include <runtime/native_optimizer.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+chainerx::Array MakeFloats(const chainerx::Shape& shape, int seed, chainerx::Dtype dtype = chainerx::Dtype::kFloat32) {
+    std::vector<float> data(shape.GetTotalSize());
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<float>((i * 37 + seed) % 101) / 25 - 2;
+    }
+    return MakeArray(chainerx::Dtype::kFloat32, shape, data.data()).AsType(dtype);
+}
+
+float At(const chainerx::Array& a, int64_t i) {
+    return static_cast<float>(chainerx::AsScalar(a.Reshape({a.GetTotalSize()}).At({i})));
+}
+
+// Runs two steps of `update` for a float32 parameter, which is updated
+// by the fused kernel, and a float64 one, which is not, and checks
+// both against `expected`.
+template <class Update, class Expected>
+void CheckUpdate(int num_states, Update update, Expected expected) {
+    // Larger than a chunk to test parameters split into chunks.
+    const chainerx::Shape shape = {3, 30000};
+    for (chainerx::Dtype dtype : {chainerx::Dtype::kFloat32, chainerx::Dtype::kFloat64}) {
+        chainerx::Array param = MakeFloats(shape, 1, dtype);
+        const chainerx::Array initial = param.Copy();
+        std::vector<chainerx::Array> states;
+        for (int i = 0; i < num_states; ++i) {
+            states.push_back(chainerx::Zeros(shape, dtype));
+        }
+        const chainerx::Array grad0 = MakeFloats(shape, 2, dtype);
+        const chainerx::Array grad1 = MakeFloats(shape, 3, dtype);
+        update({param}, {grad0}, states, 1);
+        update({param}, {grad1}, states, 2);
+        for (int64_t i : {0, 1, 12345, 89999}) {
+            const float want = expected(At(initial, i), At(grad0, i), At(grad1, i));
+            EXPECT_NEAR(want, At(param, i), 1e-5) << dtype << " " << i;
+        }
+    }
+}
+
+TEST(NativeOptimizerTest, SGD) {
+    chainerx::testing::ContextSession sess;
+    SGDConfig config;
+    config.lr = 0.1;
+    config.weight_decay = 0.01;
+    CheckUpdate(
+            0,
+            [&config](const std::vector<chainerx::Array>& params,
+                      const std::vector<chainerx::Array>& grads,
+                      const std::vector<chainerx::Array>& states,
+                      int64_t step) { SGDUpdate(config, params, grads, {}); },
+            [](float p, float g0, float g1) {
+                p -= 0.1 * (g0 + 0.01 * p);
+                p -= 0.1 * (g1 + 0.01 * p);
+                return p;
+            });
+}
+
+TEST(NativeOptimizerTest, Nesterov) {
+    chainerx::testing::ContextSession sess;
+    SGDConfig config;
+    config.lr = 0.1;
+    config.momentum = 0.9;
+    config.nesterov = true;
+    CheckUpdate(
+            1,
+            [&config](const std::vector<chainerx::Array>& params,
+                      const std::vector<chainerx::Array>& grads,
+                      const std::vector<chainerx::Array>& states,
+                      int64_t step) { SGDUpdate(config, params, grads, states); },
+            [](float p, float g0, float g1) {
+                float m = g0;
+                p -= 0.1 * (g0 + 0.9 * m);
+                m = 0.9 * m + g1;
+                p -= 0.1 * (g1 + 0.9 * m);
+                return p;
+            });
+}
+
+TEST(NativeOptimizerTest, AdamW) {
+    chainerx::testing::ContextSession sess;
+    AdamConfig config;
+    config.lr = 0.01;
+    config.weight_decay = 0.1;
+    config.decoupled_weight_decay = true;
+    CheckUpdate(
+            2,
+            [&config](const std::vector<chainerx::Array>& params,
+                      const std::vector<chainerx::Array>& grads,
+                      const std::vector<chainerx::Array>& states,
+                      int64_t step) {
+                config.step = step;
+                AdamUpdate(config, params, grads, {states[0]}, {states[1]});
+            },
+            [](float p, float g0, float g1) {
+                float m = 0, v = 0;
+                int step = 0;
+                for (float g : {g0, g1}) {
+                    ++step;
+                    m = 0.9 * m + 0.1 * g;
+                    v = 0.999 * v + 0.001 * g * g;
+                    const float mhat = m / (1 - std::pow(0.9, step));
+                    const float vhat = v / (1 - std::pow(0.999, step));
+                    p = p * (1 - 0.01 * 0.1) - 0.01 * mhat / (std::sqrt(vhat) + 1e-8);
+                }
+                return p;
+            });
+}
+
+TEST(NativeOptimizerTest, AccumulateGradients) {
+    chainerx::testing::ContextSession sess;
+    const chainerx::Shape shape = {3, 30000};
+    for (chainerx::Dtype dtype : {chainerx::Dtype::kFloat32, chainerx::Dtype::kFloat64}) {
+        // Garbage of a previous batch must be discarded.
+        chainerx::Array acc = MakeFloats(shape, 7, dtype);
+        const chainerx::Array grad0 = MakeFloats(shape, 2, dtype);
+        const chainerx::Array grad1 = MakeFloats(shape, 3, dtype);
+        const chainerx::Array grad2 = MakeFloats(shape, 4, dtype);
+        EXPECT_FALSE(AccumulateGradients({grad0}, {acc}, 0, 3));
+        EXPECT_FALSE(AccumulateGradients({grad1}, {acc}, 1, 3));
+        EXPECT_TRUE(AccumulateGradients({grad2}, {acc}, 2, 3));
+        for (int64_t i : {0, 1, 12345, 89999}) {
+            const float want = (At(grad0, i) + At(grad1, i) + At(grad2, i)) / 3;
+            EXPECT_NEAR(want, At(acc, i), 1e-5) << dtype << " " << i;
+        }
+    }
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,285 @@
+#include "runtime/native_weight_only.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/indexing.h>
+#include <chainerx/routines/linalg.h>
+#include <chainerx/routines/manipulation.h>
+
+#include <common/log.h>
+#include <runtime/chainerx_util.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+// With more rows than this, the GEMM is not memory-bound and it is
+// faster to dequantize the whole weight once.
+constexpr int64_t kMaxRowsForFusedDequantization = 16;
+
+int GetQuantizedMax(int bits) {
+    CHECK(bits == 8 || bits == 4) << "Unsupported bits for weight-only quantization: " << bits;
+    return bits == 8 ? 127 : 7;
+}
+
+int64_t GetNumColumns(const chainerx::Array& qw, int bits) {
+    CHECK_EQ(2, qw.ndim());
+    return bits == 8 ? qw.shape()[1] : qw.shape()[1] * 2;
+}
+
+int8_t LowNibble(uint8_t b) {
+    return static_cast<int8_t>(b << 4) >> 4;
+}
+
+int8_t HighNibble(uint8_t b) {
+    return static_cast<int8_t>(b) >> 4;
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+float HorizontalSum(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+    return _mm_cvtss_f32(s);
+}
+
+#endif
+
+// Returns the dot product of `len` floats and int8 weights.
+float DotInt8(const float* a, const int8_t* w, int64_t len) {
+    int64_t i = 0;
+    float sum = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= len; i += 8) {
+        const __m128i wb = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(w + i));
+        const __m256 wv = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(wb));
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), wv, acc);
+    }
+    sum = HorizontalSum(acc);
+#endif
+    for (; i < len; ++i) {
+        sum += a[i] * w[i];
+    }
+    return sum;
+}
+
+// Returns the dot product of `len` floats and `len` / 2 bytes of
+// packed int4 weights. `len` must be even.
+float DotInt4(const float* a, const uint8_t* w, int64_t len) {
+    int64_t i = 0;
+    float sum = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+    const __m128i low_mask = _mm_set1_epi8(0x0f);
+    const __m128i sign = _mm_set1_epi8(8);
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= len; i += 16) {
+        const __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(w + i / 2));
+        const __m128i lo = _mm_and_si128(b, low_mask);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), low_mask);
+        // Restore the order of elements and sign-extend the nibbles
+        // by (x ^ 8) - 8.
+        __m128i q = _mm_unpacklo_epi8(lo, hi);
+        q = _mm_sub_epi8(_mm_xor_si128(q, sign), sign);
+        const __m256 w0 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(q));
+        const __m256 w1 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(q, 8)));
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), w0, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), w1, acc1);
+    }
+    sum = HorizontalSum(_mm256_add_ps(acc0, acc1));
+#endif
+    for (; i < len; i += 2) {
+        const uint8_t b = w[i / 2];
+        sum += a[i] * LowNibble(b) + a[i + 1] * HighNibble(b);
+    }
+    return sum;
+}
+
+// Dequantizes the `row`-th row of `qw` into `dst`.
+void DequantizeRow(const void* qw, const float* scales, int bits, int64_t k, int64_t groups, int64_t row, float* dst) {
+    const int64_t group_size = k / groups;
+    const float* s = scales + row * groups;
+    if (bits == 8) {
+        const int8_t* w = static_cast<const int8_t*>(qw) + row * k;
+        for (int64_t i = 0; i < k; ++i) {
+            dst[i] = w[i] * s[i / group_size];
+        }
+    } else {
+        const uint8_t* w = static_cast<const uint8_t*>(qw) + row * k / 2;
+        for (int64_t i = 0; i < k; i += 2) {
+            const float scale = s[i / group_size];
+            dst[i] = LowNibble(w[i / 2]) * scale;
+            dst[i + 1] = HighNibble(w[i / 2]) * scale;
+        }
+    }
+}
+
+}  // namespace
+
+int64_t GetWeightOnlyGroupSize(int64_t k, int64_t group_size) {
+    return group_size <= 0 || group_size > k ? k : group_size;
+}
+
+bool QuantizeWeightOnly(const chainerx::Array& w, int bits, int64_t group_size, chainerx::Array* qw, chainerx::Array* scales) {
+    const int qmax = GetQuantizedMax(bits);
+    if (w.ndim() != 2 || w.dtype() != chainerx::Dtype::kFloat32 || !IsNativeDevice(&w.device())) {
+        return false;
+    }
+    const int64_t n = w.shape()[0];
+    const int64_t k = w.shape()[1];
+    const int64_t gs = GetWeightOnlyGroupSize(k, group_size);
+    if (k == 0 || k % gs != 0 || (bits == 4 && gs % 2 != 0)) {
+        return false;
+    }
+    const int64_t groups = k / gs;
+
+    const chainerx::Array cw = chainerx::AsContiguous(w);
+    *scales = chainerx::Empty({n, groups}, chainerx::Dtype::kFloat32, w.device());
+    *qw = bits == 8 ? chainerx::Empty({n, k}, chainerx::Dtype::kInt8, w.device())
+                    : chainerx::Empty({n, k / 2}, chainerx::Dtype::kUInt8, w.device());
+    const float* src = static_cast<const float*>(RawStartPtr(cw));
+    float* sp = static_cast<float*>(RawStartPtr(*scales));
+    int8_t* dst = static_cast<int8_t*>(RawStartPtr(*qw));
+
+    for (int64_t r = 0; r < n; ++r) {
+        for (int64_t g = 0; g < groups; ++g) {
+            const int64_t offset = r * k + g * gs;
+            const float* p = src + offset;
+            float abs_max = 0;
+            for (int64_t i = 0; i < gs; ++i) {
+                abs_max = std::max(abs_max, std::abs(p[i]));
+            }
+            const float scale = abs_max > 0 ? abs_max / qmax : 1.f;
+            sp[r * groups + g] = scale;
+
+            auto quantize = [p, scale, qmax](int64_t i) {
+                return static_cast<int8_t>(std::min<float>(qmax, std::max<float>(-qmax, std::nearbyint(p[i] / scale))));
+            };
+            if (bits == 8) {
+                for (int64_t i = 0; i < gs; ++i) {
+                    dst[offset + i] = quantize(i);
+                }
+            } else {
+                uint8_t* d = reinterpret_cast<uint8_t*>(dst) + offset / 2;
+                for (int64_t i = 0; i < gs; i += 2) {
+                    d[i / 2] = (quantize(i) & 0x0f) | ((quantize(i + 1) & 0x0f) << 4);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+chainerx::Array DequantizeWeightOnly(const chainerx::Array& qw, const chainerx::Array& scales, int bits) {
+    GetQuantizedMax(bits);
+    const int64_t n = qw.shape()[0];
+    const int64_t k = GetNumColumns(qw, bits);
+    const int64_t groups = scales.shape()[1];
+    CHECK_EQ(0, k % groups);
+
+    const chainerx::Array cqw = chainerx::AsContiguous(qw);
+    const chainerx::Array cs = chainerx::AsContiguous(scales.AsType(chainerx::Dtype::kFloat32));
+    chainerx::Array w = chainerx::Empty({n, k}, chainerx::Dtype::kFloat32, qw.device());
+    const void* qp = RawStartPtr(cqw);
+    const float* sp = static_cast<const float*>(RawStartPtr(cs));
+    float* wp = static_cast<float*>(RawStartPtr(w));
+    for (int64_t r = 0; r < n; ++r) {
+        DequantizeRow(qp, sp, bits, k, groups, r, wp + r * k);
+    }
+    return w;
+}
+
+chainerx::Array WeightOnlyMatMul(const chainerx::Array& a, const chainerx::Array& qw, const chainerx::Array& scales, int bits) {
+    GetQuantizedMax(bits);
+    const int64_t n = qw.shape()[0];
+    const int64_t k = GetNumColumns(qw, bits);
+    CHECK_LE(1, a.ndim());
+    CHECK_EQ(k, a.shape().back()) << a.shape() << " vs " << qw.shape();
+    chainerx::Shape y_shape(a.shape().begin(), a.shape().end() - 1);
+    y_shape.push_back(n);
+    const int64_t m = a.GetTotalSize() / k;
+
+    if (m > kMaxRowsForFusedDequantization || a.dtype() != chainerx::Dtype::kFloat32 || !IsNativeDevice(&a.device()) ||
+        !IsNativeDevice(&qw.device())) {
+        const chainerx::Array w = DequantizeWeightOnly(qw, scales, bits).ToDevice(a.device()).AsType(a.dtype());
+        return chainerx::Dot(a.Reshape({m, k}), w.Transpose()).Reshape(y_shape);
+    }
+
+    const int64_t groups = scales.shape()[1];
+    const int64_t gs = k / groups;
+    CHECK_EQ(k, gs * groups);
+    const chainerx::Array ca = chainerx::AsContiguous(a);
+    const chainerx::Array cqw = chainerx::AsContiguous(qw);
+    const chainerx::Array cs = chainerx::AsContiguous(scales.AsType(chainerx::Dtype::kFloat32));
+    chainerx::Array y = chainerx::Empty({m, n}, chainerx::Dtype::kFloat32, a.device());
+    const float* ap = static_cast<const float*>(RawStartPtr(ca));
+    const float* sp = static_cast<const float*>(RawStartPtr(cs));
+    const int8_t* w8 = static_cast<const int8_t*>(RawStartPtr(cqw));
+    const uint8_t* w4 = static_cast<const uint8_t*>(RawStartPtr(cqw));
+    float* yp = static_cast<float*>(RawStartPtr(y));
+
+    // Each weight row is read once and stays in L1 while it is
+    // multiplied by all rows of `a`.
+#if CHAINER_COMPILER_ENABLE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int64_t j = 0; j < n; ++j) {
+        const float* s = sp + j * groups;
+        for (int64_t i = 0; i < m; ++i) {
+            const float* ai = ap + i * k;
+            float sum = 0;
+            for (int64_t g = 0; g < groups; ++g) {
+                if (bits == 8) {
+                    sum += s[g] * DotInt8(ai + g * gs, w8 + j * k + g * gs, gs);
+                } else {
+                    sum += s[g] * DotInt4(ai + g * gs, w4 + (j * k + g * gs) / 2, gs);
+                }
+            }
+            yp[i * n + j] = sum;
+        }
+    }
+    return y.Reshape(y_shape);
+}
+
+chainerx::Array WeightOnlyGather(const chainerx::Array& qw, const chainerx::Array& scales, const chainerx::Array& indices, int bits) {
+    GetQuantizedMax(bits);
+    if (!IsNativeDevice(&qw.device())) {
+        return DequantizeWeightOnly(qw, scales, bits).Take(indices.ToDevice(qw.device()), 0);
+    }
+
+    const int64_t n = qw.shape()[0];
+    const int64_t k = GetNumColumns(qw, bits);
+    const int64_t groups = scales.shape()[1];
+    CHECK_EQ(0, k % groups);
+    chainerx::Shape y_shape = indices.shape();
+    y_shape.push_back(k);
+
+    const chainerx::Array ci = chainerx::AsContiguous(indices.ToDevice(qw.device()).AsType(chainerx::Dtype::kInt64));
+    const chainerx::Array cqw = chainerx::AsContiguous(qw);
+    const chainerx::Array cs = chainerx::AsContiguous(scales.AsType(chainerx::Dtype::kFloat32));
+    chainerx::Array y = chainerx::Empty(y_shape, chainerx::Dtype::kFloat32, qw.device());
+    const int64_t* ip = static_cast<const int64_t*>(RawStartPtr(ci));
+    const void* qp = RawStartPtr(cqw);
+    const float* sp = static_cast<const float*>(RawStartPtr(cs));
+    float* yp = static_cast<float*>(RawStartPtr(y));
+    for (int64_t i = 0; i < ci.GetTotalSize(); ++i) {
+        int64_t index = ip[i];
+        if (index < 0) index += n;
+        CHECK_LE(0, index) << "Gather index out of range: " << ip[i];
+        CHECK_GT(n, index) << "Gather index out of range: " << ip[i];
+        DequantizeRow(qp, sp, bits, k, groups, index, yp + i * k);
+    }
+    return y;
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
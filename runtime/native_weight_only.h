@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include <chainerx/array.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// Weight-only quantization keeps activations in float32 and stores a
+// (N, K) weight matrix as symmetric int8 or int4 with float32 scales.
+// Each row is split into groups of `group_size` elements along K and
+// each group has its own scale, i.e., `group_size` == 0 (or K) is
+// per-channel quantization. The quantized weight is
+//
+// - int8 of (N, K) for 8 bits, and
+// - uint8 of (N, K / 2) for 4 bits, where the low nibble of each byte
+//   is the even element and the high nibble is the odd one.
+//
+// Scales are (N, K / group_size). K and `group_size` must be even for
+// 4 bits.
+
+// Returns the number of weights sharing a scale.
+int64_t GetWeightOnlyGroupSize(int64_t k, int64_t group_size);
+
+// Quantizes a float (N, K) weight. Returns false if `w` cannot be
+// quantized with `bits` and `group_size`.
+bool QuantizeWeightOnly(const chainerx::Array& w, int bits, int64_t group_size, chainerx::Array* qw, chainerx::Array* scales);
+
+// Restores a float (N, K) weight.
+chainerx::Array DequantizeWeightOnly(const chainerx::Array& qw, const chainerx::Array& scales, int bits);
+
+// Computes `a` (..., K) * `w`^T, i.e., a matrix multiplication with
+// the (N, K) weight `qw` quantized by `QuantizeWeightOnly`. For a few
+// rows, which is memory-bound, groups of weights are dequantized in
+// registers inside the inner loop so the weight is read only in its
+// compressed form.
+chainerx::Array WeightOnlyMatMul(const chainerx::Array& a, const chainerx::Array& qw, const chainerx::Array& scales, int bits);
+
+// Gathers rows of a quantized (N, K) table (e.g., an embedding) by
+// `indices` and dequantizes only them.
+chainerx::Array WeightOnlyGather(const chainerx::Array& qw, const chainerx::Array& scales, const chainerx::Array& indices, int bits);
+
+}  // namespace runtime
+}  // namespace chainer_compiler
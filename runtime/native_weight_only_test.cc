@@ -0,0 +1,106 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <chainerx/array.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/indexing.h>
+#include <chainerx/routines/linalg.h>
+#include <chainerx/routines/manipulation.h>
+#include <chainerx/testing/array_check.h>
+#include <chainerx/testing/context_session.h>
+
+#include <runtime/chainerx_util.h>
+#include <runtime/native_weight_only.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+chainerx::Array MakeFloats(const chainerx::Shape& shape, int seed) {
+    std::vector<float> data(shape.GetTotalSize());
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<float>((i * 37 + seed) % 101) / 25 - 2;
+    }
+    return MakeArray(chainerx::Dtype::kFloat32, shape, data.data());
+}
+
+void CheckRoundTrip(int bits, int64_t group_size, const chainerx::Shape& qw_shape, const chainerx::Shape& scales_shape) {
+    chainerx::Array w = MakeFloats({5, 32}, 1);
+    chainerx::Array qw, scales;
+    ASSERT_TRUE(QuantizeWeightOnly(w, bits, group_size, &qw, &scales));
+    EXPECT_EQ(qw_shape, qw.shape());
+    EXPECT_EQ(scales_shape, scales.shape());
+
+    chainerx::Array actual = DequantizeWeightOnly(qw, scales, bits);
+    ASSERT_EQ(w.shape(), actual.shape());
+    const int64_t gs = GetWeightOnlyGroupSize(32, group_size);
+    for (int64_t i = 0; i < 5; ++i) {
+        for (int64_t j = 0; j < 32; ++j) {
+            const float scale = static_cast<float>(chainerx::AsScalar(scales.At({i, j / gs})));
+            const float diff = static_cast<float>(chainerx::AsScalar(w.At({i, j}) - actual.At({i, j})));
+            EXPECT_GE(scale / 2 + 1e-6, std::abs(diff)) << i << "," << j;
+        }
+    }
+}
+
+TEST(NativeWeightOnlyTest, Int8PerChannel) {
+    chainerx::testing::ContextSession sess;
+    CheckRoundTrip(8, 0, {5, 32}, {5, 1});
+}
+
+TEST(NativeWeightOnlyTest, Int4Grouped) {
+    chainerx::testing::ContextSession sess;
+    CheckRoundTrip(4, 8, {5, 16}, {5, 4});
+}
+
+TEST(NativeWeightOnlyTest, Unsupported) {
+    chainerx::testing::ContextSession sess;
+    chainerx::Array qw, scales;
+    EXPECT_FALSE(QuantizeWeightOnly(MakeFloats({4, 7}, 1), 4, 0, &qw, &scales));
+    EXPECT_FALSE(QuantizeWeightOnly(MakeFloats({4, 8}, 1), 8, 3, &qw, &scales));
+    EXPECT_FALSE(QuantizeWeightOnly(MakeFloats({2, 4, 8}, 1), 8, 0, &qw, &scales));
+}
+
+TEST(NativeWeightOnlyTest, MatMul) {
+    chainerx::testing::ContextSession sess;
+
+    for (int bits : {8, 4}) {
+        chainerx::Array qw, scales;
+        ASSERT_TRUE(QuantizeWeightOnly(MakeFloats({7, 48}, 2), bits, 16, &qw, &scales));
+        chainerx::Array w = DequantizeWeightOnly(qw, scales, bits);
+
+        // A single vector, a few rows with fused dequantization, and
+        // many rows with a GEMM.
+        for (const chainerx::Shape& a_shape : {chainerx::Shape{48}, chainerx::Shape{2, 3, 48}, chainerx::Shape{40, 48}}) {
+            chainerx::Array a = MakeFloats(a_shape, 3);
+            chainerx::Shape y_shape(a_shape.begin(), a_shape.end() - 1);
+            y_shape.push_back(7);
+            chainerx::Array expected = chainerx::Dot(a.Reshape({a.GetTotalSize() / 48, 48}), w.Transpose()).Reshape(y_shape);
+            chainerx::Array actual = WeightOnlyMatMul(a, qw, scales, bits);
+            EXPECT_ARRAY_ALL_CLOSE2(expected, actual, 1e-4, 1e-4);
+        }
+    }
+}
+
+TEST(NativeWeightOnlyTest, Gather) {
+    chainerx::testing::ContextSession sess;
+
+    for (int bits : {8, 4}) {
+        chainerx::Array qw, scales;
+        ASSERT_TRUE(QuantizeWeightOnly(MakeFloats({6, 10}, 4), bits, 0, &qw, &scales));
+        std::vector<int64_t> indices_data = {0, 5, -1, 2};
+        chainerx::Array indices = MakeArray(chainerx::Dtype::kInt64, {2, 2}, indices_data.data());
+        std::vector<int64_t> wrapped_data = {0, 5, 5, 2};
+        chainerx::Array wrapped = MakeArray(chainerx::Dtype::kInt64, {2, 2}, wrapped_data.data());
+        chainerx::Array expected = DequantizeWeightOnly(qw, scales, bits).Take(wrapped, 0);
+        chainerx::Array actual = WeightOnlyGather(qw, scales, indices, bits);
+        EXPECT_ARRAY_ALL_CLOSE2(expected, actual, 0, 0);
+    }
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,27 @@
+#include <chainerx/array.h>
+
+#include <runtime/chxvm_state.h>
+#include <runtime/gen_chxvm_ops.h>
+#include <runtime/native_compression.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+chainerx::Array PackBitsOp::RunImpl(ChxVMState* st, const chainerx::Array& x) {
+    return PackBits(x);
+}
+
+chainerx::Array MaskByBitsOp::RunImpl(ChxVMState* st, const chainerx::Array& bits, const chainerx::Array& x) {
+    return MaskByBits(bits, x);
+}
+
+chainerx::Array FloatToBFloat16Op::RunImpl(ChxVMState* st, const chainerx::Array& x) {
+    return FloatToBFloat16(x);
+}
+
+chainerx::Array BFloat16ToFloatOp::RunImpl(ChxVMState* st, const chainerx::Array& x) {
+    return BFloat16ToFloat(x);
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
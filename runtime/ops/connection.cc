@@ -1,17 +1,49 @@
 #include <chainerx/routines/connection.h>
+#include <chainerx/routines/creation.h>
 #include <chainerx/routines/linalg.h>
 #include <chainerx/routines/manipulation.h>
 
 #include <common/log.h>
 #include <runtime/chainerx_util.h>
+#include <runtime/conv_tuner.h>
 #include <runtime/gen_chxvm_ops.h>
+#include <runtime/native_conv.h>
+#include <runtime/packed_weight.h>
 
 namespace chainer_compiler {
 namespace runtime {
 
+class LinearOp::LinearImpl {
+public:
+    PackedWeight w;
+};
+
+void LinearOp::InitImpl() {
+    impl_ = new LinearImpl();
+}
+
+LinearOp::~LinearOp() {
+    delete impl_;
+}
+
 chainerx::Array LinearOp::RunImpl(
         ChxVMState* st, const chainerx::Array& x, const chainerx::Array& w, const absl::optional<chainerx::Array>& b) {
-    return chainerx::Linear(x, w, b, n_batch_axes);
+    if (!prepack || st->is_training() || w.ndim() != 2) {
+        return chainerx::Linear(x, w, b, n_batch_axes);
+    }
+
+    // Same as chainerx::Linear but uses the transposed weight packed
+    // into a contiguous (in, out) matrix.
+    const chainerx::Array& wt =
+            impl_->w.Get(w, [](const chainerx::Array& w) { return chainerx::AsContiguous(chainerx::Transpose(w)); });
+    chainerx::Shape out_shape(x.shape().begin(), x.shape().begin() + n_batch_axes);
+    const int64_t batch_size = out_shape.GetTotalSize();
+    out_shape.push_back(wt.shape()[1]);
+    chainerx::Array y = chainerx::Dot(x.Reshape({batch_size, x.GetTotalSize() / batch_size}), wt);
+    if (b.has_value()) {
+        y += b->BroadcastTo(y.shape());
+    }
+    return y.Reshape(out_shape);
 }
 
 chainerx::Array LinearGradWeightOp::RunImpl(ChxVMState* st, const chainerx::Array& x, const chainerx::Array& gy) {
@@ -21,11 +53,50 @@ chainerx::Array LinearGradWeightOp::RunImpl(ChxVMState* st, const chainerx::Arra
     return chainerx::Dot(chainerx::Transpose(gym), xm);
 }
 
+class ConvOp::ConvImpl {
+public:
+    PackedWeight w;
+    // The shape of the padded input `algorithm` was selected for.
+    absl::optional<chainerx::Shape> x_shape;
+    NativeConvAlgorithm algorithm{NativeConvAlgorithm::kIm2Col};
+};
+
+void ConvOp::InitImpl() {
+    impl_ = new ConvImpl();
+}
+
+ConvOp::~ConvOp() {
+    delete impl_;
+}
+
 chainerx::Array ConvOp::RunImpl(
         ChxVMState* st, const chainerx::Array& x, const chainerx::Array& w, const absl::optional<chainerx::Array>& b) {
     Int64StackVector comp_strides = ComplementStride(strides, x);
     Int64StackVector comp_pads = ComplementPad(pads, x);
 
+    if (IsNativeConvSupported(x, w, group)) {
+        Int64StackVector kernel_shape(w.shape().begin() + 2, w.shape().end());
+        Int64StackVector conv_pads = CalculateAutoPad(auto_pad, x, kernel_shape, comp_strides, comp_pads);
+        chainerx::Array px = ApplyAsymmetricPad(x, &conv_pads);
+        if (!impl_->x_shape.has_value() || *impl_->x_shape != px.shape()) {
+            const ChxVMOptions& options = st->options();
+            NativeConvAlgorithm algorithm = ConvAlgorithmTuner::GetInstance()->Select(
+                    px, w, b, comp_strides, conv_pads, group, options.tune_conv, options.conv_tuning_cache);
+            if (algorithm != impl_->algorithm) {
+                impl_->w.Reset();
+            }
+            impl_->x_shape = px.shape();
+            impl_->algorithm = algorithm;
+        }
+        const NativeConvAlgorithm algorithm = impl_->algorithm;
+        if (prepack && !st->is_training()) {
+            auto pack = [algorithm](const chainerx::Array& raw_w) { return PackConvWeight(raw_w, algorithm); };
+            const chainerx::Array& packed_w = impl_->w.Get(w, pack);
+            return NativeConv(px, packed_w, w.shape(), b, comp_strides, conv_pads, group, algorithm);
+        }
+        return NativeConv(px, PackConvWeight(w, algorithm), w.shape(), b, comp_strides, conv_pads, group, algorithm);
+    }
+
     return GroupedConv(x, w, b, comp_strides, comp_pads, group, auto_pad);
 }
 
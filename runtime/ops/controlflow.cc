@@ -1,4 +1,22 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <chainerx/context.h>
+#include <chainerx/device.h>
+
 #include <common/log.h>
+#include <runtime/chainerx_util.h>
+#include <runtime/chxvm.h>
+#include <runtime/chxvm_state.h>
+#include <runtime/chxvm_var.h>
 #include <runtime/gen_chxvm_ops.h>
 
 namespace chainer_compiler {
@@ -20,5 +38,211 @@ void JmpFalseOp::RunImpl(ChxVMState* st, const StrictScalar& cond) {
     }
 }
 
+void LoopControlOp::RunImpl(ChxVMState* st) {
+    const int64_t next_iter = static_cast<int64_t>(st->GetScalar(iter)) + 1;
+    st->FreeVar(iter);
+    st->SetScalar(iter, StrictScalar(chainerx::Dtype::kInt64, chainerx::Scalar(next_iter), true));
+
+    bool next_cond = true;
+    if (use_body_cond) {
+        next_cond = static_cast<bool>(st->GetScalar(body_cond));
+    }
+    st->FreeVar(body_cond);
+    if (max_trip_count >= 0) {
+        next_cond = next_cond && next_iter < static_cast<int64_t>(st->GetScalar(max_trip_count));
+    }
+    st->FreeVar(cond);
+    st->SetScalar(cond, StrictScalar(chainerx::Dtype::kBool, chainerx::Scalar(next_cond), true));
+
+    // Loop states are renamed instead of copied.
+    CHECK_EQ(states_in.size(), states_out.size());
+    for (size_t i = 0; i < states_in.size(); ++i) {
+        if (states_out[i] < 0) {
+            st->FreeVar(states_in[i]);
+            st->SetVar(states_in[i], ChxVMVar());
+        } else {
+            st->MoveVar(states_out[i], states_in[i]);
+        }
+    }
+
+    CHECK_EQ(scan_seqs.size(), scan_values.size());
+    for (size_t i = 0; i < scan_seqs.size(); ++i) {
+        st->GetSequence(scan_seqs[i])->emplace_back(std::move(*st->GetVar(scan_values[i])));
+        st->FreeVar(scan_values[i]);
+    }
+
+    if (next_cond) {
+        st->set_pc(pc - 1);
+    }
+}
+
+class ParallelLoopOp::ParallelLoopImpl {
+public:
+    // Starts `num_threads - 1` workers. The thread which calls `Run`
+    // works as the first one.
+    ParallelLoopImpl(const ChxVMProgramProto& body, int num_threads) {
+        for (int i = 0; i < num_threads; ++i) {
+            chxvms_.emplace_back(new ChxVM(body));
+        }
+        for (int i = 1; i < num_threads; ++i) {
+            workers_.emplace_back([this, i]() { Work(i); });
+        }
+    }
+
+    ~ParallelLoopImpl() {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stopped_ = true;
+        }
+        start_cond_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    int num_threads() const {
+        return chxvms_.size();
+    }
+
+    // Runs `fn` with the ChxVMs of `num_workers` threads and returns
+    // when all of them finish. The first exception thrown by `fn` is
+    // rethrown.
+    void Run(int num_workers, const std::function<void(ChxVM*)>& fn) {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            fn_ = &fn;
+            context_ = &chainerx::GetDefaultContext();
+            device_ = &chainerx::GetDefaultDevice();
+            num_workers_ = num_workers;
+            num_running_ = std::max(num_workers - 1, 0);
+            error_ = nullptr;
+            ++generation_;
+        }
+        start_cond_.notify_all();
+
+        std::exception_ptr error;
+        try {
+            fn(chxvms_[0].get());
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::unique_lock<std::mutex> lock(mu_);
+        done_cond_.wait(lock, [this]() { return num_running_ == 0; });
+        fn_ = nullptr;
+        if (!error) error = error_;
+        lock.unlock();
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    void Work(int index) {
+        int64_t generation = 0;
+        while (true) {
+            const std::function<void(ChxVM*)>* fn;
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                start_cond_.wait(lock, [this, generation]() { return stopped_ || generation_ != generation; });
+                if (stopped_) return;
+                generation = generation_;
+                if (index >= num_workers_) continue;
+                fn = fn_;
+                chainerx::SetDefaultContext(context_);
+                chainerx::SetDefaultDevice(device_);
+            }
+
+            std::exception_ptr error;
+            try {
+                (*fn)(chxvms_[index].get());
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(mu_);
+            if (error && !error_) error_ = error;
+            if (--num_running_ == 0) done_cond_.notify_all();
+        }
+    }
+
+    // A ChxVM for each thread as ops may keep states across runs.
+    std::vector<std::unique_ptr<ChxVM>> chxvms_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mu_;
+    std::condition_variable start_cond_;
+    std::condition_variable done_cond_;
+    // The task of the current run, which is identified by `generation_`.
+    const std::function<void(ChxVM*)>* fn_{nullptr};
+    chainerx::Context* context_{nullptr};
+    chainerx::Device* device_{nullptr};
+    int num_workers_{0};
+    int num_running_{0};
+    int64_t generation_{0};
+    std::exception_ptr error_;
+    bool stopped_{false};
+};
+
+void ParallelLoopOp::InitImpl() {
+    ChxVMProgramProto body;
+    CHECK(body.ParseFromString(program));
+    impl_ = new ParallelLoopImpl(body, std::max(num_threads, 1));
+}
+
+ParallelLoopOp::~ParallelLoopOp() {
+    delete impl_;
+}
+
+void ParallelLoopOp::RunImpl(ChxVMState* st) {
+    int64_t num_iters = std::max<int64_t>(0, static_cast<int64_t>(st->GetScalar(max_trip_count)));
+    if (cond >= 0 && !static_cast<bool>(st->GetScalar(cond))) {
+        num_iters = 0;
+    }
+
+    // Each iteration writes its scan outputs to its own slots.
+    CHECK_EQ(outputs.size(), scan_names.size());
+    std::vector<ChxVMSequence*> seqs;
+    for (int output : outputs) {
+        seqs.push_back(st->CreateSequence(output));
+        seqs.back()->resize(num_iters);
+    }
+
+    CHECK_EQ(inputs.size(), input_names.size());
+    InOuts body_inputs;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        body_inputs.emplace(input_names[i], std::make_shared<ChxVMVar>(*st->GetVar(inputs[i])));
+    }
+    const bool true_value = true;
+    body_inputs.emplace(cond_name, std::make_shared<ChxVMVar>(MakeHostArray(chainerx::Dtype::kBool, {}, &true_value)));
+
+    ChxVMOptions options = st->options();
+    // They cannot be shared by threads.
+    options.chrome_tracing = nullptr;
+    options.output_callback = nullptr;
+
+    std::atomic<int64_t> next_iter{0};
+    auto run_iterations = [this, num_iters, &seqs, &body_inputs, &options, &next_iter](ChxVM* chxvm) {
+        InOuts iter_inputs(body_inputs);
+        for (int64_t i; (i = next_iter++) < num_iters;) {
+            iter_inputs[iter_name] = std::make_shared<ChxVMVar>(MakeHostArray(chainerx::Dtype::kInt64, {}, &i));
+            InOuts iter_outputs;
+            try {
+                iter_outputs = chxvm->Run(iter_inputs, options);
+            } catch (...) {
+                // Let other threads stop early.
+                next_iter = num_iters;
+                throw;
+            }
+            for (size_t j = 0; j < seqs.size(); ++j) {
+                auto found = iter_outputs.find(scan_names[j]);
+                CHECK(found != iter_outputs.end()) << "Scan output not found: " << scan_names[j];
+                (*seqs[j])[i] = *found->second;
+            }
+        }
+    };
+
+    const int num_workers = std::min<int64_t>(impl_->num_threads(), num_iters);
+    impl_->Run(num_workers, run_iterations);
+}
+
 }  // namespace runtime
 }  // namespace chainer_compiler
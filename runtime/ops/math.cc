@@ -14,6 +14,7 @@
 #include <common/log.h>
 #include <runtime/chainerx_util.h>
 #include <runtime/gen_chxvm_ops.h>
+#include <runtime/packed_weight.h>
 
 #include <numeric>
 
@@ -154,11 +155,54 @@ chainerx::Array ClipOp::RunImpl(
     return y;
 }
 
+class MatMulOp::MatMulImpl {
+public:
+    PackedWeight b;
+};
+
+void MatMulOp::InitImpl() {
+    impl_ = new MatMulImpl();
+}
+
+MatMulOp::~MatMulOp() {
+    delete impl_;
+}
+
 chainerx::Array MatMulOp::RunImpl(ChxVMState* st, const chainerx::Array& a, const chainerx::Array& b) {
+    if (prepack && !st->is_training() && b.ndim() == 2) {
+        const chainerx::Array& pb = impl_->b.Get(b, [](const chainerx::Array& b) { return chainerx::AsContiguous(b); });
+        return chainerx::Dot(a, pb);
+    }
     return NumpyMatMul(a, b);
 }
 
+class GemmOp::GemmImpl {
+public:
+    PackedWeight b;
+};
+
+void GemmOp::InitImpl() {
+    impl_ = new GemmImpl();
+}
+
+GemmOp::~GemmOp() {
+    delete impl_;
+}
+
 chainerx::Array GemmOp::RunImpl(ChxVMState* st, const chainerx::Array& a, const chainerx::Array& b, const chainerx::Array& c) {
+    if (prepack && !st->is_training()) {
+        // Pack `b` into a contiguous (K, N) matrix with `alpha` folded.
+        const chainerx::Array& pb = impl_->b.Get(b, [this](const chainerx::Array& b) {
+            chainerx::Array p = trans_b ? chainerx::Transpose(b) : b;
+            if (alpha != 1.0) p = p * alpha;
+            return chainerx::AsContiguous(p);
+        });
+        chainerx::Array r = chainerx::Dot(trans_a ? chainerx::Transpose(a) : a, pb);
+        if (beta == 0.0) return r;
+        if (beta != 1.0) return r + c * beta;
+        return r + c;
+    }
+
     if (alpha == 1.0 && beta == 1.0 && !trans_a && trans_b && c.ndim() == 1) {
         return Linear(a, b, c);
     }
@@ -0,0 +1,80 @@
+#include <chainerx/array.h>
+
+#include <common/log.h>
+#include <runtime/chxvm_state.h>
+#include <runtime/gen_chxvm_ops.h>
+#include <runtime/native_optimizer.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+// Returns true if parameters should be updated by `*grads`, which are
+// replaced by the mean of accumulated gradients.
+bool PrepareGradients(
+        const absl::optional<chainerx::Array>& micro_batch,
+        int num_micro_batches,
+        const std::vector<chainerx::Array>& accs,
+        std::vector<chainerx::Array>* grads) {
+    if (num_micro_batches <= 1) {
+        return true;
+    }
+    CHECK(micro_batch.has_value());
+    const int64_t index = static_cast<int64_t>(chainerx::AsScalar(*micro_batch));
+    if (!AccumulateGradients(*grads, accs, index, num_micro_batches)) {
+        return false;
+    }
+    *grads = accs;
+    return true;
+}
+
+}  // namespace
+
+void SGDUpdateOp::RunImpl(
+        ChxVMState* st,
+        const chainerx::Array& lr,
+        const absl::optional<chainerx::Array>& micro_batch,
+        const std::vector<chainerx::Array>& params,
+        const std::vector<chainerx::Array>& grads,
+        const std::vector<chainerx::Array>& moms,
+        const std::vector<chainerx::Array>& accs) {
+    std::vector<chainerx::Array> gs = grads;
+    if (!PrepareGradients(micro_batch, num_micro_batches, accs, &gs)) {
+        return;
+    }
+    SGDConfig config;
+    config.lr = static_cast<float>(chainerx::AsScalar(lr));
+    config.momentum = momentum;
+    config.weight_decay = weight_decay;
+    config.nesterov = nesterov;
+    SGDUpdate(config, params, gs, moms);
+}
+
+void AdamUpdateOp::RunImpl(
+        ChxVMState* st,
+        const chainerx::Array& lr,
+        const chainerx::Array& step,
+        const absl::optional<chainerx::Array>& micro_batch,
+        const std::vector<chainerx::Array>& params,
+        const std::vector<chainerx::Array>& grads,
+        const std::vector<chainerx::Array>& ms,
+        const std::vector<chainerx::Array>& vs,
+        const std::vector<chainerx::Array>& accs) {
+    std::vector<chainerx::Array> gs = grads;
+    if (!PrepareGradients(micro_batch, num_micro_batches, accs, &gs)) {
+        return;
+    }
+    AdamConfig config;
+    config.lr = static_cast<float>(chainerx::AsScalar(lr));
+    config.step = static_cast<int64_t>(chainerx::AsScalar(step));
+    config.beta1 = beta1;
+    config.beta2 = beta2;
+    config.epsilon = epsilon;
+    config.weight_decay = weight_decay;
+    config.decoupled_weight_decay = decoupled_weight_decay;
+    AdamUpdate(config, params, gs, ms, vs);
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -10,6 +10,7 @@
 #include <runtime/chainerx_util.h>
 #include <runtime/chxvm_state.h>
 #include <runtime/gen_chxvm_ops.h>
+#include <runtime/native_compression.h>
 
 namespace chainer_compiler {
 namespace runtime {
@@ -42,6 +43,39 @@ private:
     const Int64StackVector pads_;
 };
 
+// Keeps int8 positions of maxima in windows instead of the state of
+// ChainerX, which retains the input and the output.
+class CompressedMaxPoolContext : public ChxVMOpaque {
+public:
+    CompressedMaxPoolContext(
+            const chainerx::Array& indices, const chainerx::Shape& x_shape, const Int64StackVector& strides, const Int64StackVector& pads)
+        : indices_(indices), x_shape_(x_shape), strides_(strides), pads_(pads) {
+    }
+    virtual ~CompressedMaxPoolContext() = default;
+
+    const chainerx::Array& indices() const {
+        return indices_;
+    }
+
+    const chainerx::Shape& x_shape() const {
+        return x_shape_;
+    }
+
+    const Int64StackVector& strides() const {
+        return strides_;
+    }
+
+    const Int64StackVector& pads() const {
+        return pads_;
+    }
+
+private:
+    const chainerx::Array indices_;
+    const chainerx::Shape x_shape_;
+    const Int64StackVector strides_;
+    const Int64StackVector pads_;
+};
+
 }  // namespace
 
 std::tuple<chainerx::Array, ChxVMOpaque*> MaxPoolOp::RunImpl(ChxVMState* st, const chainerx::Array& in_x) {
@@ -51,6 +85,14 @@ std::tuple<chainerx::Array, ChxVMOpaque*> MaxPoolOp::RunImpl(ChxVMState* st, con
     Int64StackVector pads = CalculateAutoPad(auto_pad, in_x, kernel_shape, strides, ComplementPad(this->pads, in_x));
     chainerx::Array x = ApplyAsymmetricPad(in_x, &pads);
     const Int64StackVector& strides = ComplementStride(this->strides, x);
+    chainerx::Array indices;
+    if (compress_indices && MaxPoolWithIndices(x, kernel_shape, strides, pads, cover_all, &out, &indices)) {
+        ChxVMOpaque* ctx = new CompressedMaxPoolContext(indices, x.shape(), strides, pads);
+        if (st->options().dump_memory_usage >= 1) {
+            ctx->SetRetainedArrays({indices});
+        }
+        return std::tie(out, ctx);
+    }
     std::tie(out, state) =
             x.device().backend().CallKernel<chainerx::MaxPoolKernel>(x, kernel_shape, strides, pads, cover_all, true, absl::nullopt);
     ChxVMOpaque* ctx = new BackwardContext<chainerx::MaxPoolGradState>(std::move(state), strides, pads);
@@ -75,6 +117,10 @@ std::tuple<chainerx::Array, ChxVMOpaque*> AveragePoolOp::RunImpl(ChxVMState* st,
 }
 
 chainerx::Array MaxPoolGradOp::RunImpl(ChxVMState* st, const chainerx::Array& gy, const ChxVMOpaque& ctx) {
+    if (auto* compressed = dynamic_cast<const CompressedMaxPoolContext*>(&ctx)) {
+        return MaxPoolGradWithIndices(
+                gy, compressed->indices(), compressed->x_shape(), kernel_shape, compressed->strides(), compressed->pads());
+    }
     auto& context = dynamic_cast<const BackwardContext<chainerx::MaxPoolGradState>&>(ctx);
     return std::get<0>(gy.device().backend().CallKernel<chainerx::MaxPoolGradKernel>(
             gy, kernel_shape, context.strides(), context.pads(), context.state(), true, absl::nullopt));
@@ -7,6 +7,9 @@
 #include <common/log.h>
 #include <runtime/chainerx_util.h>
 #include <runtime/gen_chxvm_ops.h>
+#include <runtime/native_int8.h>
+#include <runtime/native_weight_only.h>
+#include <runtime/packed_weight.h>
 
 namespace chainer_compiler {
 namespace runtime {
@@ -43,6 +46,60 @@ chainerx::Array dequantize_array(const chainerx::Array& x, const chainerx::Scala
     return zero_pointed_x * x_scale;
 }
 
+// Runs a quantized convolution by int8 kernels. Constant weights are
+// packed only once.
+chainerx::Array RunNativeInt8Conv(
+        ChxVMState* st,
+        PackedWeight* packed_w,
+        PackedWeight* w_sums,
+        bool prepack,
+        const chainerx::Array& x,
+        int32_t x_zero_point,
+        const chainerx::Array& w,
+        const std::vector<int32_t>& w_zero_points,
+        const Int64StackVector& strides,
+        const Int64StackVector& pads,
+        int group,
+        const std::string& auto_pad,
+        const Int8Requantization* requant) {
+    Int64StackVector comp_strides = ComplementStride(strides, x);
+    Int64StackVector comp_pads = ComplementPad(pads, x);
+    Int64StackVector kernel_shape(w.shape().begin() + 2, w.shape().end());
+    Int64StackVector conv_pads = CalculateAutoPad(auto_pad, x, kernel_shape, comp_strides, comp_pads);
+    // Padded values must be zero after dequantization.
+    chainerx::Array px = ApplyAsymmetricPad(x, &conv_pads, x_zero_point);
+    if (prepack && !st->is_training()) {
+        return NativeInt8Conv(
+                px,
+                packed_w->Get(w, PackInt8ConvWeight),
+                w_sums->Get(w, ComputeInt8ConvWeightSums),
+                w.shape(),
+                w.dtype(),
+                x_zero_point,
+                w_zero_points,
+                comp_strides,
+                conv_pads,
+                group,
+                requant);
+    }
+    return NativeInt8Conv(
+            px,
+            PackInt8ConvWeight(w),
+            ComputeInt8ConvWeightSums(w),
+            w.shape(),
+            w.dtype(),
+            x_zero_point,
+            w_zero_points,
+            comp_strides,
+            conv_pads,
+            group,
+            requant);
+}
+
+bool IsInt8Dtype(chainerx::Dtype dtype) {
+    return dtype == chainerx::Dtype::kUInt8 || dtype == chainerx::Dtype::kInt8;
+}
+
 }  // namespace
 
 chainerx::Array QuantizeLinearOp::RunImpl(
@@ -59,6 +116,20 @@ chainerx::Array DequantizeLinearOp::RunImpl(
     return dequantize_array(x, chainerx::Scalar(x_scale), chainerx::Scalar(x_zero_point));
 }
 
+class QLinearConvOp::QLinearConvImpl {
+public:
+    PackedWeight w;
+    PackedWeight w_sums;
+};
+
+void QLinearConvOp::InitImpl() {
+    impl_ = new QLinearConvImpl();
+}
+
+QLinearConvOp::~QLinearConvOp() {
+    delete impl_;
+}
+
 chainerx::Array QLinearConvOp::RunImpl(
         ChxVMState* st,
         const chainerx::Array& q_x,
@@ -70,6 +141,31 @@ chainerx::Array QLinearConvOp::RunImpl(
         const StrictScalar& y_scale,
         const StrictScalar& y_zero_point,
         const absl::optional<chainerx::Array>& b) {
+    const bool is_int32_bias = !b.has_value() || b->dtype() == chainerx::Dtype::kInt32;
+    if (IsNativeInt8ConvSupported(q_x, q_w) && IsInt8Dtype(y_zero_point.dtype()) && is_int32_bias) {
+        Int8Requantization requant;
+        requant.x_scale = static_cast<float>(x_scale);
+        requant.w_scales = GetQuantizationScales(w_scale);
+        requant.y_scale = static_cast<float>(y_scale);
+        requant.y_zero_point = static_cast<int32_t>(y_zero_point);
+        requant.y_dtype = y_zero_point.dtype();
+        requant.b = b;
+        return RunNativeInt8Conv(
+                st,
+                &impl_->w,
+                &impl_->w_sums,
+                prepack,
+                q_x,
+                static_cast<int32_t>(x_zero_point),
+                q_w,
+                GetInt8ZeroPoints(w_zero_point),
+                strides,
+                pads,
+                group,
+                auto_pad,
+                &requant);
+    }
+
     // Dequantize q_x and q_w
     const chainerx::Array x = dequantize_array(q_x, chainerx::Scalar(x_scale), chainerx::Scalar(x_zero_point));
     chainerx::Array w = q_w.AsType(chainerx::Dtype::kFloat32);
@@ -93,12 +189,43 @@ chainerx::Array QLinearConvOp::RunImpl(
     return quantize_array(GroupedConv(x, w, b, comp_strides, comp_pads, group, auto_pad), y_scale, y_zero_point);
 }
 
+class MatMulIntegerOp::MatMulIntegerImpl {
+public:
+    PackedWeight b;
+    PackedWeight b_sums;
+};
+
+void MatMulIntegerOp::InitImpl() {
+    impl_ = new MatMulIntegerImpl();
+}
+
+MatMulIntegerOp::~MatMulIntegerOp() {
+    delete impl_;
+}
+
 chainerx::Array MatMulIntegerOp::RunImpl(
         ChxVMState* st,
         const chainerx::Array& q_a,
         const chainerx::Array& q_b,
         const absl::optional<chainerx::Array>& a_zero_point,
         const absl::optional<chainerx::Array>& b_zero_point) {
+    if (IsNativeInt8MatMulSupported(q_a, q_b)) {
+        const std::vector<int32_t> a_zero_points = GetInt8ZeroPoints(a_zero_point);
+        const std::vector<int32_t> b_zero_points = GetInt8ZeroPoints(b_zero_point);
+        if (prepack && !st->is_training()) {
+            return NativeInt8MatMul(
+                    q_a,
+                    impl_->b.Get(q_b, PackInt8MatMulWeight),
+                    impl_->b_sums.Get(q_b, ComputeInt8MatMulWeightSums),
+                    q_b.shape(),
+                    q_b.dtype(),
+                    a_zero_points,
+                    b_zero_points);
+        }
+        return NativeInt8MatMul(
+                q_a, PackInt8MatMulWeight(q_b), ComputeInt8MatMulWeightSums(q_b), q_b.shape(), q_b.dtype(), a_zero_points, b_zero_points);
+    }
+
     chainerx::Array a = q_a.AsType(chainerx::Dtype::kInt32), b = q_b.AsType(chainerx::Dtype::kInt32);
 
     if (a_zero_point.has_value()) {
@@ -113,12 +240,43 @@ chainerx::Array MatMulIntegerOp::RunImpl(
     return NumpyMatMul(a, b).AsType(chainerx::Dtype::kInt32);
 }
 
+class ConvIntegerOp::ConvIntegerImpl {
+public:
+    PackedWeight w;
+    PackedWeight w_sums;
+};
+
+void ConvIntegerOp::InitImpl() {
+    impl_ = new ConvIntegerImpl();
+}
+
+ConvIntegerOp::~ConvIntegerOp() {
+    delete impl_;
+}
+
 chainerx::Array ConvIntegerOp::RunImpl(
         ChxVMState* st,
         const chainerx::Array& q_x,
         const chainerx::Array& q_w,
         const absl::optional<StrictScalar>& x_zero_point,
         const absl::optional<chainerx::Array>& w_zero_point_opt) {
+    if (IsNativeInt8ConvSupported(q_x, q_w)) {
+        return RunNativeInt8Conv(
+                st,
+                &impl_->w,
+                &impl_->w_sums,
+                prepack,
+                q_x,
+                x_zero_point.has_value() ? static_cast<int32_t>(*x_zero_point) : 0,
+                q_w,
+                GetInt8ZeroPoints(w_zero_point_opt),
+                strides,
+                pads,
+                group,
+                auto_pad,
+                nullptr);
+    }
+
     chainerx::Array x = q_x.AsType(chainerx::Dtype::kInt32), w = q_w.AsType(chainerx::Dtype::kInt32);
 
     if (x_zero_point.has_value()) {
@@ -145,6 +303,16 @@ chainerx::Array ConvIntegerOp::RunImpl(
     return GroupedConv(x, w, absl::nullopt, comp_strides, comp_pads, group, auto_pad).AsType(chainerx::Dtype::kInt32);
 }
 
+chainerx::Array WeightOnlyMatMulOp::RunImpl(
+        ChxVMState* st, const chainerx::Array& a, const chainerx::Array& w, const chainerx::Array& scales) {
+    return WeightOnlyMatMul(a, w, scales, bits);
+}
+
+chainerx::Array WeightOnlyGatherOp::RunImpl(
+        ChxVMState* st, const chainerx::Array& data, const chainerx::Array& scales, const chainerx::Array& indices) {
+    return WeightOnlyGather(data, scales, indices, bits);
+}
+
 chainerx::Array RoundOp::RunImpl(ChxVMState* st, const chainerx::Array& x) {
     CHECK(IsFloat(x.dtype()));
     return SlowRound(x);
@@ -1,3 +1,5 @@
+#include <memory>
+
 #include <chainerx/routines/creation.h>
 #include <chainerx/routines/manipulation.h>
 
@@ -22,25 +24,26 @@ int64_t GetOptionalInt(const absl::optional<StrictScalar>& array, int64_t defaul
 }  // namespace
 
 void SequenceClearOp::RunImpl(ChxVMState* st) {
-    st->GetSequence(seq)->clear();
+    st->GetMutableSequence(seq)->clear();
 }
 
 void SequenceAppendOp::RunImpl(ChxVMState* st) {
-    st->GetSequence(seq)->emplace_back(*st->GetVar(value));
+    st->GetMutableSequence(seq)->emplace_back(*st->GetVar(value));
 }
 
-void SequenceInsertOp::RunImpl(
-        ChxVMState* st, const ChxVMSequence& seq, const chainerx::Array& value, const StrictScalar& index, ChxVMSequence* output) {
-    *output = seq;
-    int64_t i = static_cast<int64_t>(index);
-    if (i < 0) i += seq.size();
-    CHECK_LT(i, seq.size());
-    output->insert(output->begin() + i, ChxVMVar(value));
+void SequenceInsertOp::RunImpl(ChxVMState* st) {
+    ChxVMSequence* s = st->GetMutableSequence(seq);
+    int64_t i = static_cast<int64_t>(st->GetScalar(index));
+    if (i < 0) i += s->size();
+    CHECK_LT(i, s->size());
+    s->emplace(s->begin() + i, st->GetArray(value));
 }
 
-void SequenceExtendOp::RunImpl(ChxVMState* st, const ChxVMSequence& a, const ChxVMSequence& b, ChxVMSequence* output) {
-    *output = a;
-    for (const auto& a : b) output->push_back(a);
+void SequenceExtendOp::RunImpl(ChxVMState* st) {
+    CHECK_NE(seq, values);
+    ChxVMSequence* s = st->GetMutableSequence(seq);
+    const ChxVMSequence& v = *st->GetSequence(values);
+    s->insert(s->end(), v.begin(), v.end());
 }
 
 void SequencePopOp::RunImpl(ChxVMState* st) {
@@ -49,18 +52,18 @@ void SequencePopOp::RunImpl(ChxVMState* st) {
         st->SetVar(output, ChxVMVar());
         return;
     }
-    ChxVMSequence* v = st->GetSequence(seq);
+    ChxVMSequence* v = st->GetMutableSequence(seq);
     CHECK(!v->empty());
     st->SetVar(output, v->back());
     v->pop_back();
 }
 
-void SequenceEraseOp::RunImpl(ChxVMState* st, const ChxVMSequence& seq, const StrictScalar& index, ChxVMSequence* output) {
-    *output = seq;
-    int64_t i = static_cast<int64_t>(index);
-    if (i < 0) i += seq.size();
-    CHECK_LT(i, seq.size());
-    output->erase(output->begin() + i);
+void SequenceEraseOp::RunImpl(ChxVMState* st) {
+    ChxVMSequence* s = st->GetMutableSequence(seq);
+    int64_t i = static_cast<int64_t>(st->GetScalar(index));
+    if (i < 0) i += s->size();
+    CHECK_LT(i, s->size());
+    s->erase(s->begin() + i);
 }
 
 chainerx::Array SequenceLookupOp::RunImpl(ChxVMState* st, const ChxVMSequence& seq, const StrictScalar& index) {
@@ -80,13 +83,12 @@ void SequenceLookupGradOp::RunImpl(
     (*gx)[i] = ChxVMVar(gy);
 }
 
-void SequenceUpdateOp::RunImpl(
-        ChxVMState* st, const ChxVMSequence& seq, const StrictScalar& index, const chainerx::Array& value, ChxVMSequence* output) {
-    *output = seq;
-    int64_t i = static_cast<int64_t>(index);
-    if (i < 0) i += seq.size();
-    CHECK_LT(i, seq.size());
-    (*output)[i] = ChxVMVar(value);
+void SequenceUpdateOp::RunImpl(ChxVMState* st) {
+    ChxVMSequence* s = st->GetMutableSequence(seq);
+    int64_t i = static_cast<int64_t>(st->GetScalar(index));
+    if (i < 0) i += s->size();
+    CHECK_LT(i, s->size());
+    (*s)[i] = ChxVMVar(st->GetArray(value));
 }
 
 void SequenceGetSliceOp::RunImpl(
@@ -259,8 +261,8 @@ void SequenceLengthsOp::RunImpl(ChxVMState* st, const ChxVMSequence& seq, ChxVMS
     }
 }
 
-void SequenceCopyOp::RunImpl(ChxVMState* st, const ChxVMSequence& seq, ChxVMSequence* output) {
-    *output = seq;
+void SequenceCopyOp::RunImpl(ChxVMState* st) {
+    st->SetVar(output, *st->GetVar(seq));
 }
 
 void SequenceMoveOp::RunImpl(ChxVMState* st) {
@@ -269,10 +271,12 @@ void SequenceMoveOp::RunImpl(ChxVMState* st) {
         st->SetVar(output, ChxVMVar());
         return;
     }
-    ChxVMSequence* s = st->GetSequence(seq);
-    ChxVMSequence* d = st->CreateSequence(output);
-    CHECK(d->empty());
-    std::swap(*d, *s);
+    // `seq` is not freed here as the emitter frees it after its last
+    // use.
+    ChxVMVar* var = st->GetVar(seq);
+    CHECK_EQ(ChxVMVar::Kind::kSequence, var->kind());
+    st->SetVar(output, *var);
+    *var = ChxVMVar(std::make_shared<ChxVMSequence>());
 }
 
 }  // namespace runtime
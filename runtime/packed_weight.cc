@@ -0,0 +1,29 @@
+#include "runtime/packed_weight.h"
+
+namespace chainer_compiler {
+namespace runtime {
+
+const chainerx::Array& PackedWeight::Get(const chainerx::Array& w, const PackFn& pack) {
+    if (!IsPackedFrom(w)) {
+        packed_ = pack(w);
+        src_ = w;
+    }
+    return packed_;
+}
+
+void PackedWeight::Reset() {
+    src_ = absl::nullopt;
+    packed_ = chainerx::Array();
+}
+
+bool PackedWeight::IsPackedFrom(const chainerx::Array& w) const {
+    if (!src_.has_value()) {
+        return false;
+    }
+    const chainerx::Array& src = *src_;
+    return (src.raw_data() == w.raw_data() && src.offset() == w.offset() && src.dtype() == w.dtype() && src.shape() == w.shape() &&
+            src.strides() == w.strides() && &src.device() == &w.device());
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <functional>
+
+#include <absl/types/optional.h>
+
+#include <chainerx/array.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// Holds a weight which was converted into the layout preferred by a
+// kernel. Ops keep this across runs so constant weights are packed
+// only once. The packed array is rebuilt when the op sees a different
+// source array (e.g., parameters were re-fed by the user).
+//
+// Note in-place updates of the source array cannot be detected. Ops
+// must not use this for weights updated in place (e.g., in training).
+class PackedWeight {
+public:
+    typedef std::function<chainerx::Array(const chainerx::Array&)> PackFn;
+
+    const chainerx::Array& Get(const chainerx::Array& w, const PackFn& pack);
+
+    void Reset();
+
+private:
+    bool IsPackedFrom(const chainerx::Array& w) const;
+
+    absl::optional<chainerx::Array> src_;
+    chainerx::Array packed_;
+};
+
+}  // namespace runtime
+}  // namespace chainer_compiler
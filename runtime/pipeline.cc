@@ -0,0 +1,96 @@
+#include "runtime/pipeline.h"
+
+#include <iterator>
+
+#include <chainerx/backprop_mode.h>
+#include <chainerx/context.h>
+#include <chainerx/device.h>
+
+#include <common/log.h>
+#include <runtime/chxvm.pb.h>
+#include <runtime/chxvm_var.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+Pipeline::Pipeline(
+        const std::vector<ChxVMProgramProto>& programs,
+        const std::vector<std::string>& output_names,
+        const ChxVMOptions& options,
+        size_t capacity)
+    : options_(options), capacity_(capacity) {
+    CHECK(!programs.empty());
+    CHECK(!options.is_training) << "Pipelines are only for inference";
+    CHECK_LT(0, capacity);
+    // ChromeTracingEmitter cannot be shared by threads.
+    options_.chrome_tracing = nullptr;
+    live_names_.resize(programs.size() + 1);
+    live_names_.back().insert(output_names.begin(), output_names.end());
+    for (size_t i = programs.size(); i > 0; --i) {
+        live_names_[i - 1] = live_names_[i];
+        live_names_[i - 1].insert(programs[i - 1].input_names().begin(), programs[i - 1].input_names().end());
+    }
+    for (const ChxVMProgramProto& program : programs) {
+        chxvms_.emplace_back(new ChxVM(program));
+    }
+}
+
+Pipeline::~Pipeline() {
+}
+
+std::vector<InOuts> Pipeline::Run(const std::vector<InOuts>& inputs, const InOuts& params) {
+    const size_t num_stages = chxvms_.size();
+    std::vector<std::unique_ptr<BoundedQueue<InOuts>>> queues;
+    for (size_t i = 0; i <= num_stages; ++i) {
+        queues.emplace_back(new BoundedQueue<InOuts>(capacity_));
+    }
+
+    chainerx::Context* context = &chainerx::GetDefaultContext();
+    chainerx::Device* device = &chainerx::GetDefaultDevice();
+    std::vector<std::thread> threads;
+    threads.emplace_back([&queues, &inputs, &params, this]() {
+        for (const InOuts& input : inputs) {
+            InOuts values(params);
+            for (const auto& p : input) values[p.first] = p.second;
+            for (auto it = values.begin(); it != values.end();) {
+                it = live_names_[0].count(it->first) ? std::next(it) : values.erase(it);
+            }
+            queues[0]->Push(std::move(values));
+        }
+        queues[0]->Close();
+    });
+    for (size_t i = 0; i < num_stages; ++i) {
+        threads.emplace_back([&queues, i, context, device, this]() {
+            chainerx::SetDefaultContext(context);
+            chainerx::SetDefaultDevice(device);
+            chainerx::NoBackpropModeScope no_backprop;
+            InOuts values;
+            while (queues[i]->Pop(&values)) {
+                const InOuts outputs = chxvms_[i]->Run(values, options_);
+                for (const auto& p : outputs) values[p.first] = p.second;
+                // Values no later stage needs are freed here.
+                for (auto it = values.begin(); it != values.end();) {
+                    it = live_names_[i + 1].count(it->first) ? std::next(it) : values.erase(it);
+                }
+                queues[i + 1]->Push(std::move(values));
+                values.clear();
+            }
+            queues[i + 1]->Close();
+        });
+    }
+
+    std::vector<InOuts> outputs;
+    InOuts values;
+    while (queues[num_stages]->Pop(&values)) {
+        outputs.push_back(std::move(values));
+        values.clear();
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK_EQ(inputs.size(), outputs.size());
+    return outputs;
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
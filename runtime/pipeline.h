@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <runtime/chxvm.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// A FIFO queue which blocks producers while it is full and consumers
+// while it is empty.
+template <class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity) {
+    }
+
+    void Push(T value) {
+        std::unique_lock<std::mutex> lock(mu_);
+        not_full_.wait(lock, [this]() { return queue_.size() < capacity_; });
+        queue_.push_back(std::move(value));
+        not_empty_.notify_one();
+    }
+
+    // Returns false when the queue is closed and empty.
+    bool Pop(T* value) {
+        std::unique_lock<std::mutex> lock(mu_);
+        not_empty_.wait(lock, [this]() { return closed_ || !queue_.empty(); });
+        if (queue_.empty()) return false;
+        *value = std::move(queue_.front());
+        queue_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mu_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    std::mutex mu_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<T> queue_;
+    bool closed_{false};
+};
+
+// Runs ChxVM programs of pipeline stages (see `EmitPipeline`) in a
+// thread for each stage. Values of a run flow from a stage to the next
+// by their names through bounded queues, so a run can start before
+// earlier runs finish.
+class Pipeline {
+public:
+    // `output_names` are the outputs of the whole graph. `capacity` is
+    // the number of runs each queue can keep.
+    Pipeline(
+            const std::vector<ChxVMProgramProto>& programs,
+            const std::vector<std::string>& output_names,
+            const ChxVMOptions& options,
+            size_t capacity = 2);
+    ~Pipeline();
+
+    // Streams `inputs` through the stages and returns outputs in the
+    // same order. Parameters in `params` are fed to all stages.
+    std::vector<InOuts> Run(const std::vector<InOuts>& inputs, const InOuts& params = {});
+
+    size_t num_stages() const {
+        return chxvms_.size();
+    }
+
+private:
+    std::vector<std::unique_ptr<ChxVM>> chxvms_;
+    // Names of values needed by each stage, later stages, or the
+    // caller. The last one is for the caller.
+    std::vector<std::set<std::string>> live_names_;
+    ChxVMOptions options_;
+    const size_t capacity_;
+};
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,293 @@
+#include "runtime/shm_allreduce.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include <chainerx/routines/creation.h>
+#include <chainerx/routines/manipulation.h>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <runtime/chainerx_util.h>
+#include <runtime/chxvm_var.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+namespace {
+
+constexpr size_t kHeaderBytes = 64;
+
+// Waiting processes check if others are alive once in this many spins.
+constexpr int64_t kSpinsPerLivenessCheck = 1024;
+
+// Calls `fn(index, offset_in_array, offset_in_bucket, size)` for each
+// part of arrays of `sizes` in the range [begin, end) of their
+// concatenation.
+template <class Fn>
+void ForEachSegment(const std::vector<int64_t>& sizes, int64_t begin, int64_t end, Fn fn) {
+    int64_t base = 0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        const int64_t lo = std::max(begin, base);
+        const int64_t hi = std::min(end, base + sizes[i]);
+        if (lo < hi) {
+            fn(i, lo - base, lo - begin, hi - lo);
+        }
+        base += sizes[i];
+    }
+}
+
+bool IsNativeFloat32(const chainerx::Array& a) {
+    return a.dtype() == chainerx::Dtype::kFloat32 && IsNativeDevice(&a.device());
+}
+
+}  // namespace
+
+// A sense-reversing barrier shared by all processes. `failed` is set
+// by the first process which finds another one exited so the rest stop
+// waiting, too.
+struct LocalProcessGroup::Header {
+    std::atomic<int32_t> num_arrived{0};
+    std::atomic<int32_t> generation{0};
+    std::atomic<bool> failed{false};
+};
+
+LocalProcessGroup::LocalProcessGroup(int world_size, int64_t bucket_bytes)
+    : world_size_(world_size), slot_size_(std::max<int64_t>(1, bucket_bytes / sizeof(float))) {
+    static_assert(sizeof(Header) <= kHeaderBytes, "Header is too large");
+    CHECK_LT(0, world_size);
+    // A slot for each process and one for the result.
+    mapped_bytes_ = kHeaderBytes + sizeof(float) * slot_size_ * (world_size + 1);
+    mapped_ = mmap(nullptr, mapped_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    CHECK(mapped_ != MAP_FAILED) << "Failed to map " << mapped_bytes_ << " bytes: " << strerror(errno);
+    header_ = new (mapped_) Header();
+}
+
+LocalProcessGroup::~LocalProcessGroup() {
+    if (rank_ == 0 && !workers_.empty()) {
+        Join();
+    }
+    header_->~Header();
+    munmap(mapped_, mapped_bytes_);
+}
+
+int LocalProcessGroup::Fork() {
+    CHECK(workers_.empty()) << "Already forked";
+    parent_ = getpid();
+    for (int rank = 1; rank < world_size_; ++rank) {
+        const pid_t pid = fork();
+        CHECK_LE(0, pid) << "fork failed: " << strerror(errno);
+        if (pid == 0) {
+            rank_ = rank;
+            workers_.clear();
+            return rank_;
+        }
+        workers_.push_back(pid);
+    }
+    return rank_;
+}
+
+bool LocalProcessGroup::Join() {
+    if (rank_ != 0) {
+        std::cout << std::flush;
+        std::cerr << std::flush;
+        _exit(0);
+    }
+    bool ok = true;
+    for (pid_t pid : workers_) {
+        int status = 0;
+        CHECK_EQ(pid, waitpid(pid, &status, 0)) << strerror(errno);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "Worker " << pid << " failed with status " << status << std::endl;
+            ok = false;
+        }
+    }
+    workers_.clear();
+    return ok;
+}
+
+void LocalProcessGroup::Barrier() {
+    const int32_t generation = header_->generation.load(std::memory_order_acquire);
+    if (header_->num_arrived.fetch_add(1, std::memory_order_acq_rel) == world_size_ - 1) {
+        header_->num_arrived.store(0, std::memory_order_relaxed);
+        header_->generation.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    for (int64_t spins = 1; header_->generation.load(std::memory_order_acquire) == generation; ++spins) {
+        if (spins % kSpinsPerLivenessCheck == 0) {
+            CheckAlive();
+        }
+        std::this_thread::yield();
+    }
+}
+
+void LocalProcessGroup::CheckAlive() const {
+    bool dead = header_->failed.load(std::memory_order_acquire);
+    if (rank_ == 0) {
+        for (pid_t pid : workers_) {
+            siginfo_t info;
+            info.si_pid = 0;
+            // WNOWAIT leaves the status to `Join`.
+            if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid) {
+                dead = true;
+            }
+        }
+    } else if (getppid() != parent_) {
+        dead = true;
+    }
+    if (!dead) return;
+    header_->failed.store(true, std::memory_order_release);
+    CHECK(false) << "A process of the group exited while rank " << rank_ << " was waiting at a barrier";
+}
+
+float* LocalProcessGroup::slot(int rank) const {
+    return reinterpret_cast<float*>(static_cast<char*>(mapped_) + kHeaderBytes) + slot_size_ * rank;
+}
+
+float* LocalProcessGroup::result() const {
+    return slot(world_size_);
+}
+
+void LocalProcessGroup::AllReduceMean(const std::vector<chainerx::Array>& srcs, const std::vector<chainerx::Array>& dsts) {
+    CHECK_EQ(srcs.size(), dsts.size());
+    std::vector<chainerx::Array> holders;
+    std::vector<const float*> src_ptrs;
+    std::vector<float*> dst_ptrs;
+    std::vector<int64_t> sizes;
+    for (size_t i = 0; i < srcs.size(); ++i) {
+        CHECK_EQ(srcs[i].shape(), dsts[i].shape());
+        CHECK(IsNativeFloat32(dsts[i]) && dsts[i].IsContiguous()) << "Unsupported destination: " << dsts[i].shape();
+        CHECK(IsNativeDevice(&srcs[i].device())) << "Only native arrays can be all-reduced";
+        holders.push_back(chainerx::AsContiguous(srcs[i].AsType(chainerx::Dtype::kFloat32, false)));
+        src_ptrs.push_back(static_cast<const float*>(RawStartPtr(holders.back())));
+        dst_ptrs.push_back(static_cast<float*>(RawStartPtr(dsts[i])));
+        sizes.push_back(srcs[i].GetTotalSize());
+    }
+    AllReduceMean(src_ptrs, dst_ptrs, sizes);
+}
+
+void LocalProcessGroup::AllReduceMean(
+        const std::vector<const float*>& srcs, const std::vector<float*>& dsts, const std::vector<int64_t>& sizes) {
+    CHECK_EQ(srcs.size(), sizes.size());
+    CHECK_EQ(dsts.size(), sizes.size());
+    int64_t total = 0;
+    for (int64_t size : sizes) total += size;
+
+    const float scale = 1.0f / world_size_;
+    for (int64_t begin = 0; begin < total; begin += slot_size_) {
+        const int64_t end = std::min(total, begin + slot_size_);
+        const int64_t n = end - begin;
+
+        float* mine = slot(rank_);
+        ForEachSegment(sizes, begin, end, [&](size_t i, int64_t src_offset, int64_t offset, int64_t size) {
+            std::memcpy(mine + offset, srcs[i] + src_offset, size * sizeof(float));
+        });
+        Barrier();
+
+        // Reduce-scatter: each process sums its own slice of all slots.
+        const int64_t slice = (n + world_size_ - 1) / world_size_;
+        const int64_t lo = std::min(n, slice * rank_);
+        const int64_t hi = std::min(n, lo + slice);
+        float* out = result();
+        for (int64_t j = lo; j < hi; ++j) {
+            float sum = 0;
+            for (int r = 0; r < world_size_; ++r) {
+                sum += slot(r)[j];
+            }
+            out[j] = sum * scale;
+        }
+        Barrier();
+
+        // All-gather. Slots and the result are not overwritten until all
+        // processes reach the first barrier of the next bucket.
+        ForEachSegment(sizes, begin, end, [&](size_t i, int64_t dst_offset, int64_t offset, int64_t size) {
+            std::memcpy(dsts[i] + dst_offset, out + offset, size * sizeof(float));
+        });
+    }
+}
+
+GradientAllReducer::GradientAllReducer(LocalProcessGroup* group, int64_t bucket_bytes)
+    : group_(group), bucket_bytes_(bucket_bytes), thread_([this]() { Loop(); }) {
+}
+
+GradientAllReducer::~GradientAllReducer() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        terminated_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+}
+
+void GradientAllReducer::Add(const std::string& name, const ChxVMVar& var) {
+    if (!HasPrefix(name, "grad_out@")) return;
+    CHECK(var.IsArray()) << "Only an array can be a gradient: " << name;
+    const chainerx::Array& grad = var.GetArray();
+    CHECK(IsNativeDevice(&grad.device())) << "Only native arrays can be all-reduced: " << name;
+    // Buffers are allocated and freed in the main thread.
+    const chainerx::Array src = chainerx::AsContiguous(grad.AsType(chainerx::Dtype::kFloat32, false));
+    const chainerx::Array dst = chainerx::EmptyLike(src);
+    CHECK(results_.emplace(name, std::make_shared<ChxVMVar>(dst)).second) << "Duplicated gradient: " << name;
+    holders_.push_back(src);
+
+    current_.src_ptrs.push_back(static_cast<const float*>(RawStartPtr(src)));
+    current_.dst_ptrs.push_back(static_cast<float*>(RawStartPtr(dst)));
+    current_.sizes.push_back(src.GetTotalSize());
+    current_.bytes += src.GetNBytes();
+    if (current_.bytes >= bucket_bytes_) {
+        Flush();
+    }
+}
+
+void GradientAllReducer::Flush() {
+    if (current_.sizes.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        queue_.push_back(std::move(current_));
+        ++num_pending_;
+    }
+    cond_.notify_all();
+    current_ = Bucket();
+}
+
+InOuts GradientAllReducer::Wait() {
+    Flush();
+    {
+        std::unique_lock<std::mutex> lock(mu_);
+        cond_.wait(lock, [this]() { return num_pending_ == 0; });
+    }
+    holders_.clear();
+    InOuts results;
+    results.swap(results_);
+    return results;
+}
+
+void GradientAllReducer::Loop() {
+    while (true) {
+        Bucket bucket;
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            cond_.wait(lock, [this]() { return terminated_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            bucket = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        group_->AllReduceMean(bucket.src_ptrs, bucket.dst_ptrs, bucket.sizes);
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            --num_pending_;
+        }
+        cond_.notify_all();
+    }
+}
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <chainerx/array.h>
+
+#include <runtime/chxvm.h>
+
+namespace chainer_compiler {
+namespace runtime {
+
+// A group of processes on the same host which average float32 arrays
+// through a shared memory segment. The segment is mapped before worker
+// processes are forked so they share it without any names or external
+// services.
+//
+// An all-reduce is done for each bucket of at most `bucket_bytes`: all
+// processes copy their bucket into their own slots, then each process
+// sums its 1/N slice of the slots (reduce-scatter), and finally all
+// processes read the whole result (all-gather).
+class LocalProcessGroup {
+public:
+    LocalProcessGroup(int world_size, int64_t bucket_bytes);
+    ~LocalProcessGroup();
+
+    // Forks `world_size - 1` workers and returns the rank of the
+    // caller. The calling process gets rank 0. This must be called
+    // before any threads are started.
+    int Fork();
+
+    // In workers, exits the process. In the main process, waits for
+    // workers and returns true if all of them exited successfully.
+    bool Join();
+
+    // Waits for all processes. Fails if any process of the group has
+    // exited as the barrier would never be released.
+    void Barrier();
+
+    // Stores the mean of `srcs` of all processes to `dsts`, which must
+    // be native float32 contiguous arrays. They may be the same arrays.
+    // All processes must call this with the same shapes in the same
+    // order.
+    void AllReduceMean(const std::vector<chainerx::Array>& srcs, const std::vector<chainerx::Array>& dsts);
+
+    // Same as above with raw pointers. This does not call ChainerX so
+    // it is safe to call from threads other than the main thread.
+    void AllReduceMean(const std::vector<const float*>& srcs, const std::vector<float*>& dsts, const std::vector<int64_t>& sizes);
+
+    int rank() const {
+        return rank_;
+    }
+
+    int world_size() const {
+        return world_size_;
+    }
+
+private:
+    struct Header;
+
+    // Fails if another process of the group has exited.
+    void CheckAlive() const;
+
+    float* slot(int rank) const;
+    float* result() const;
+
+    const int world_size_;
+    const int64_t slot_size_;
+    int rank_{0};
+    pid_t parent_{0};
+    std::vector<pid_t> workers_;
+    size_t mapped_bytes_;
+    void* mapped_;
+    Header* header_;
+};
+
+// Averages gradients across a `LocalProcessGroup` in a background
+// thread. `grad_out@` values are packed into buckets as they are
+// output by ChxVM so communication of gradients computed first
+// overlaps with the rest of backprop.
+class GradientAllReducer {
+public:
+    GradientAllReducer(LocalProcessGroup* group, int64_t bucket_bytes);
+    ~GradientAllReducer();
+
+    // Suitable for `ChxVMOptions::output_callback`. Outputs other than
+    // `grad_out@` are ignored.
+    void Add(const std::string& name, const ChxVMVar& var);
+
+    // Sends the last bucket, waits for all buckets, and returns the
+    // averaged gradients of this step keyed by `grad_out@` names.
+    InOuts Wait();
+
+private:
+    struct Bucket {
+        std::vector<const float*> src_ptrs;
+        std::vector<float*> dst_ptrs;
+        std::vector<int64_t> sizes;
+        int64_t bytes{0};
+    };
+
+    void Flush();
+    void Loop();
+
+    LocalProcessGroup* group_;
+    const int64_t bucket_bytes_;
+    Bucket current_;
+    InOuts results_;
+    // Keeps contiguous copies of gradients alive until `Wait`.
+    std::vector<chainerx::Array> holders_;
+
+    std::mutex mu_;
+    std::condition_variable cond_;
+    std::deque<Bucket> queue_;
+    int64_t num_pending_{0};
+    bool terminated_{false};
+    std::thread thread_;
+};
+
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -0,0 +1,98 @@
+#include <unistd.h>
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <chainerx/array.h>
+#include <chainerx/routines/creation.h>
+#include <chainerx/testing/context_session.h>
+
+#include <common/log.h>
+#include <runtime/chainerx_util.h>
+#include <runtime/chxvm_var.h>
+#include <runtime/shm_allreduce.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+chainerx::Array MakeRankArray(int64_t size, int rank) {
+    std::vector<float> data(size);
+    for (int64_t i = 0; i < size; ++i) {
+        data[i] = i + rank * 100;
+    }
+    return MakeArray(chainerx::Dtype::kFloat32, {size}, data.data());
+}
+
+// Checks `a` is the mean of `MakeRankArray` of all ranks.
+bool IsMean(const chainerx::Array& a, int world_size) {
+    const float rank_mean = (world_size - 1) * 100 / 2.0f;
+    for (int64_t i = 0; i < a.GetTotalSize(); ++i) {
+        if (static_cast<float>(chainerx::AsScalar(a.At({i}))) != i + rank_mean) return false;
+    }
+    return true;
+}
+
+TEST(LocalProcessGroupTest, AllReduceMean) {
+    // Buckets smaller than arrays so they are split.
+    LocalProcessGroup group(3, 40);
+    const int rank = group.Fork();
+    bool ok = true;
+    {
+        chainerx::testing::ContextSession sess;
+        std::vector<chainerx::Array> arrays = {MakeRankArray(7, rank), MakeRankArray(25, rank)};
+        group.AllReduceMean(arrays, arrays);
+        for (const chainerx::Array& a : arrays) {
+            ok &= IsMean(a, 3);
+        }
+    }
+    if (!ok) {
+        std::cerr << "Wrong result at rank " << rank << std::endl;
+        _exit(1);
+    }
+    EXPECT_TRUE(group.Join());
+}
+
+TEST(GradientAllReducerTest, Overlapped) {
+    LocalProcessGroup group(2, 40);
+    const int rank = group.Fork();
+    bool ok = true;
+    {
+        chainerx::testing::ContextSession sess;
+        GradientAllReducer reducer(&group, 40);
+        for (int step = 0; step < 2; ++step) {
+            reducer.Add("loss", ChxVMVar(MakeRankArray(1, rank)));
+            reducer.Add("grad_out@a", ChxVMVar(MakeRankArray(5, rank)));
+            reducer.Add("grad_out@b", ChxVMVar(MakeRankArray(30, rank)));
+            reducer.Add("grad_out@c", ChxVMVar(MakeRankArray(3, rank)));
+            const InOuts grads = reducer.Wait();
+            ok &= grads.size() == 3;
+            for (const auto& p : grads) {
+                ok &= IsMean(p.second->GetArray(), 2);
+            }
+        }
+    }
+    if (!ok) {
+        std::cerr << "Wrong result at rank " << rank << std::endl;
+        _exit(1);
+    }
+    EXPECT_TRUE(group.Join());
+}
+
+TEST(LocalProcessGroupDeathTest, WorkerExitedBeforeBarrier) {
+    EXPECT_DEATH(
+            {
+                LocalProcessGroup group(2, 40);
+                // The worker exits without reaching the barrier.
+                if (group.Fork() != 0) group.Join();
+                group.Barrier();
+            },
+            "exited while rank 0 was waiting");
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
@@ -22,6 +22,10 @@ FLAGS = {
         'type': 'bool',
         'doc': 'Fuse consecutive element-wise operations.'
     },
+    'batch_sequence_loops': {
+        'type': 'bool',
+        'doc': 'Rewrite Loops which apply the same ops to each element of a non-empty sequence into batched ops.'
+    },
     'use_nvrtc': {
         'type': 'bool',
         'doc': 'Use NVRTC to execute fused operations.'
@@ -131,6 +135,14 @@ FLAGS = {
         'type': 'bool',
         'doc': 'Dump the subgraph tree of the ONNX graph'
     },
+    'dump_memory_timeline': {
+        'type': 'std::string',
+        'doc': 'Output the simulated memory usage of each step to this JSON file'
+    },
+    'dump_memory_timeline_chrome_trace': {
+        'type': 'std::string',
+        'doc': 'Output the simulated memory usage to this file in the Chrome trace format'
+    },
 
     'quantize': {
         'type': 'bool',
@@ -140,6 +152,74 @@ FLAGS = {
         'type': 'bool',
         'doc': 'Disables per channel quantization'
     },
+    'calibrate_quantization': {
+        'type': 'bool',
+        'doc': 'Output activations to be quantized so their ranges can be calibrated'
+    },
+    'quantization_calibration': {
+        'type': 'std::string',
+        'doc': 'A calibration table for static quantization with QLinear ops'
+    },
+    'weight_only_quantize': {
+        'type': 'int',
+        'doc': 'Quantize weights of MatMul, Gemm, and Gather into the number of bits (8 or 4), keeping activations in float'
+    },
+    'weight_only_quantize_group_size': {
+        'type': 'int',
+        'doc': 'The number of weights sharing a scale in weight-only quantization (0 for one scale per output channel)'
+    },
+
+    'compress_activations': {
+        'type': 'std::string',
+        'doc': 'Keep activations for backward compressed (fp16 or bf16). Masks of Relu and Dropout become bits and MaxPool keeps int8 indices'
+    },
+
+    'scheduler': {
+        'type': 'std::string',
+        'doc': 'The scheduling policy (naive, greedy, or memory). memory minimizes the peak memory usage'
+    },
+
+    'optimizer': {
+        'type': 'std::string',
+        'doc': 'Update parameters in the training graph by this optimizer (sgd, momentum, nesterov, adam, or adamw)'
+    },
+    'optimizer_momentum': {
+        'type': 'float',
+        'default': -1.0,
+        'doc': 'Momentum of momentum and nesterov optimizers (negative for 0.9)'
+    },
+    'optimizer_beta1': {
+        'type': 'float',
+        'default': -1.0,
+        'doc': 'beta1 of adam and adamw optimizers (negative for 0.9)'
+    },
+    'optimizer_beta2': {
+        'type': 'float',
+        'default': -1.0,
+        'doc': 'beta2 of adam and adamw optimizers (negative for 0.999)'
+    },
+    'optimizer_epsilon': {
+        'type': 'float',
+        'default': -1.0,
+        'doc': 'epsilon of adam and adamw optimizers (negative for 1e-8)'
+    },
+    'optimizer_weight_decay': {
+        'type': 'float',
+        'doc': 'Weight decay of optimizers (decoupled for adamw)'
+    },
+    'micro_batches': {
+        'type': 'int',
+        'doc': 'Accumulate gradients of this number of micro-batches before a parameter update'
+    },
+
+    'compiler_threads': {
+        'type': 'int',
+        'doc': 'The number of threads to compile subgraphs and fusion groups (0 or 1 to compile them serially)'
+    },
+    'parallel_loop_threads': {
+        'type': 'int',
+        'doc': 'The number of threads to run iterations of Loops without loop-carried dependencies (0 or 1 to run them serially)'
+    },
 
     'computation_order': {
         'type': 'std::string',
@@ -153,9 +233,36 @@ FLAGS = {
         'type': 'int',
         'doc': 'Memory budget of GT policy (in MB)'
     },
+    'recompute_budget': {
+        'type': 'int',
+        'doc': 'Memory budget of the budget policy, which minimizes recomputation under it (in MB)'
+    },
 }
 
 
+def get_default(info):
+    """Returns the default value of a flag in Python.
+
+    Flags are zero or empty by default. Flags whose zero is a valid
+    value have 'default' instead.
+    """
+    if 'default' in info:
+        return info['default']
+    return {'bool': False, 'int': 0, 'float': 0.0, 'std::string': ''}[info['type']]
+
+
+def get_cxx_default(info):
+    """Returns the default value of a flag as a C++ expression."""
+    default = get_default(info)
+    if info['type'] == 'bool':
+        return 'true' if default else 'false'
+    if info['type'] == 'float':
+        return '{}f'.format(float(default))
+    if info['type'] == 'std::string':
+        return '"{}"'.format(default)
+    return str(default)
+
+
 parser = argparse.ArgumentParser(description='Generate compiler option codes')
 parser.add_argument('--mode')
 parser.add_argument('--output')
@@ -171,14 +278,45 @@ if args.mode == 'flags.h':
 
 namespace chainer_compiler {
 
+// Options of a compilation. Each thread compiles with the context
+// installed by `CompilerContextScope`, so models can be compiled with
+// different options concurrently.
+struct CompilerContext {
 ''')
     for name, v in FLAGS.items():
         f.write('''
-// {}
-extern {} g_{};
-        '''.format(v['doc'], v['type'], name))
+    // {}
+    {} {}{{{}}};
+'''.format(v['doc'], v['type'], name, get_cxx_default(v) if 'default' in v else ''))
     f.write('''
+};
+
+// Returns the context installed in this thread, or the default context
+// of the process if there is none.
+CompilerContext* GetCompilerContext();
 
+// Returns the context used by threads without `CompilerContextScope`.
+CompilerContext* GetDefaultCompilerContext();
+
+// Installs `context` to this thread while this object is alive.
+class CompilerContextScope {
+public:
+    explicit CompilerContextScope(CompilerContext* context);
+    ~CompilerContextScope();
+
+    CompilerContextScope(const CompilerContextScope&) = delete;
+    CompilerContextScope& operator=(const CompilerContextScope&) = delete;
+
+private:
+    CompilerContext* prev_;
+};
+
+// `g_<name>()` refers to the option of the current context.
+''')
+    for name, v in FLAGS.items():
+        f.write('''inline {1}& g_{0}() {{ return GetCompilerContext()->{0}; }}
+'''.format(name, v['type']))
+    f.write('''
 }  // namespace chainer_compiler
 ''')
 
@@ -187,24 +325,29 @@ elif args.mode == 'flags.cc':
 #include "compiler/flags.h"
 
 namespace chainer_compiler {
-''')
-    for name, v in FLAGS.items():
-        f.write('''
 
-// {}
-{} g_{};
-'''.format(v['doc'], v['type'], name))
+namespace {
 
-    f.write('''
-struct Flags {
-''')
-    for name, v in FLAGS.items():
-        f.write('''
-{} {};
-'''.format(v['type'], name))
-    f.write('''
-    void ApplyToGlobal() const;
-};
+thread_local CompilerContext* t_compiler_context = nullptr;
+
+}  // namespace
+
+CompilerContext* GetCompilerContext() {
+    return t_compiler_context ? t_compiler_context : GetDefaultCompilerContext();
+}
+
+CompilerContext* GetDefaultCompilerContext() {
+    static CompilerContext context;
+    return &context;
+}
+
+CompilerContextScope::CompilerContextScope(CompilerContext* context) : prev_(t_compiler_context) {
+    t_compiler_context = context;
+}
+
+CompilerContextScope::~CompilerContextScope() {
+    t_compiler_context = prev_;
+}
 
 }  // namespace chainer_compiler
 ''')
@@ -224,6 +367,8 @@ void AddCompilerFlags(cmdline::parser* args) {
     for name, info in FLAGS.items():
         type_param = '' if info['type'] == 'bool' else '<{}>'.format(info['type'])
         def_arg = '' if info['type'] == 'bool' else ', false'
+        if 'default' in info:
+            def_arg += ', {}'.format(get_cxx_default(info))
         f.write('''
     args->add{}("{}", '\\0', "{}"{});
 '''.format(type_param, name, info['doc'], def_arg))
@@ -236,11 +381,11 @@ void ApplyCompilerFlags(const cmdline::parser& args) {
     for name, info in FLAGS.items():
         func = 'exist' if info['type'] == 'bool' else 'get<{}>'.format(info['type'])
         f.write('''
-    g_{} = args.{}("{}");
+    g_{}() = args.{}("{}");
 '''.format(name, func, name))
     f.write('''
-    if (args.exist("trace")) g_trace_level = 1;
-    if (args.exist("verbose")) g_trace_level = 2;
+    if (args.exist("trace")) g_trace_level() = 1;
+    if (args.exist("verbose")) g_trace_level() = 2;
 }
 
 }  // namespace runtime
@@ -254,41 +399,28 @@ elif args.mode == 'chainer_compiler_core.cxx_args.inc':
 elif args.mode == 'chainer_compiler_core.apply_cxx_args.inc':
     for name, info in sorted(FLAGS.items()):
         f.write('''
-        g_{} = {};
+        g_{}() = {};
 '''.format(name, name))
 elif args.mode == 'chainer_compiler_core.pybind_args.inc':
     res = []
     for name, info in sorted(FLAGS.items()):
-        def_val = 'false' if info['type'] == 'bool' else '""' if info['type'] == 'std::string' else '0'
-        res.append('"{}"_a = {}'.format(name, def_val))
+        res.append('"{}"_a = {}'.format(name, get_cxx_default(info)))
     f.write(', '.join(res))
 elif args.mode == 'menoh_chainer_compiler.json_args.inc':
     res = []
     for name, info in sorted(FLAGS.items()):
-        if info['type'] == 'bool':
-            default = 'false'
-        elif info['type'] == 'int':
-            default = '0'
-        elif info['type'] == 'std::string':
-            default = '""'
-        res.append('chainer_compiler::g_{0} = value_or<{2}>(j, "{0}", {1});'.format(name, default, info['type']))
+        res.append('chainer_compiler::g_{0}() = value_or<{2}>(j, "{0}", {1});'.format(name, get_cxx_default(info), info['type']))
     f.write('\n'.join(res))
 elif args.mode == 'menoh_chainer_compiler.args_json.inc':
     res = []
     for name, info in sorted(FLAGS.items()):
-        res.append('config["{0}"] = chainer_compiler::g_{0};'.format(name))
+        res.append('config["{0}"] = chainer_compiler::g_{0}();'.format(name))
     f.write('\n'.join(res))
 elif args.mode == 'menoh_example_default_config.json':
     import json
     config = {}
     for name, info in sorted(FLAGS.items()):
-        if info['type'] == 'bool':
-            default = False
-        elif info['type'] == 'int':
-            default = 0
-        elif info['type'] == 'std::string':
-            default = ''
-        config[name] = default
+        config[name] = get_default(info)
     f.write(json.dumps(config, indent=2, sort_keys=True))
 else:
     raise('Invalid mode: {}'.format(args.mode))
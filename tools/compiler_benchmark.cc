@@ -0,0 +1,102 @@
+// Measures the compile time of synthetic graphs to track how the
+// compiler scales with the number of nodes.
+//
+// Example:
+//
+// $ ./build/tools/compiler_benchmark --nodes 10000,100000,1000000
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <chainerx/context.h>
+
+#include <common/log.h>
+#include <common/strutil.h>
+#include <compiler/chxvm/emitter.h>
+#include <compiler/graph.h>
+#include <compiler/passes.h>
+#include <compiler/scheduler.h>
+#include <compiler/type.h>
+#include <runtime/chxvm.pb.h>
+#include <tools/cmdline.h>
+#include <tools/compiler_flags.h>
+
+namespace chainer_compiler {
+namespace runtime {
+namespace {
+
+// Builds a graph of about `num_nodes` elementwise nodes. With
+// `residual`, every other node adds a value computed two nodes before,
+// which makes values live longer like skip connections.
+void BuildGraph(Graph* graph, int num_nodes, bool residual) {
+    Value* prev2 = graph->AddInputValue("x", Type(Dtype::kFloat32, {1, 16}));
+    Value* prev = prev2;
+    for (int i = 0; i < num_nodes; ++i) {
+        Value* out = i == num_nodes - 1 ? graph->AddOutputValue("y", prev->type()) : graph->AddValue(StrCat("v", i), prev->type());
+        if (residual && i % 2) {
+            graph->AddNode(Node::kAdd, {prev, prev2}, {out});
+        } else {
+            graph->AddNode(i % 3 ? Node::kRelu : Node::kTanh, {prev}, {out});
+        }
+        prev2 = prev;
+        prev = out;
+    }
+}
+
+void Measure(const std::string& name, int num_nodes, const std::function<void()>& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::setw(24) << std::left << name << std::setw(12) << std::right << std::fixed << std::setprecision(3)
+              << elapsed * 1000 << " msec " << std::setw(12) << std::setprecision(1) << elapsed * 1e9 / num_nodes << " nsec/node"
+              << std::endl;
+}
+
+void RunBenchmark(int num_nodes, bool residual, bool skip_passes) {
+    std::cout << "=== " << num_nodes << " nodes (" << (residual ? "residual" : "chain") << ") ===" << std::endl;
+    Graph graph("benchmark");
+    Measure("Build", num_nodes, [&]() { BuildGraph(&graph, num_nodes, residual); });
+    Measure("SortTopologically", num_nodes, [&]() { graph.GetTopologicallySortedNodes(); });
+    Measure("GetNecessaryValues", num_nodes, [&]() { graph.GetNecessaryValues(); });
+    Measure("GetNecessaryNodes", num_nodes, [&]() { graph.GetNecessaryNodesAndInputCounts(graph.output_values()); });
+    if (skip_passes) {
+        // Emission needs scheduled nodes.
+        Measure("Schedule", num_nodes, [&]() { ScheduleComputation(graph, 0); });
+    } else {
+        Measure("RunDefaultPasses", num_nodes, [&]() { RunDefaultPasses(&graph); });
+    }
+    ChxVMProgramProto program;
+    Measure("Emit", num_nodes, [&]() { chxvm::Emit(graph, &program); });
+    std::cout << program.instructions_size() << " instructions" << std::endl;
+}
+
+void RunMain(int argc, char** argv) {
+    cmdline::parser args;
+    args.add<std::string>("nodes", '\0', "Comma separated numbers of nodes", false, "10000,100000");
+    args.add("chain", '\0', "Build a chain of nodes instead of a residual network");
+    args.add("skip_passes", '\0', "Only schedule the graph instead of running all passes");
+    AddCompilerFlags(&args);
+    args.parse_check(argc, argv);
+    ApplyCompilerFlags(args);
+
+    chainerx::Context ctx;
+    chainerx::ContextScope ctx_scope(ctx);
+
+    for (const std::string& n : SplitString(args.get<std::string>("nodes"), ",")) {
+        const int num_nodes = std::stoi(n);
+        CHECK_LT(0, num_nodes);
+        RunBenchmark(num_nodes, !args.exist("chain"), args.exist("skip_passes"));
+    }
+}
+
+}  // namespace
+}  // namespace runtime
+}  // namespace chainer_compiler
+
+int main(int argc, char** argv) {
+    chainer_compiler::runtime::RunMain(argc, argv);
+}
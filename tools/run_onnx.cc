@@ -18,6 +18,7 @@
 #include <common/log.h>
 #include <common/protoutil.h>
 #include <common/strutil.h>
+#include <compiler/calibration.h>
 #include <compiler/chxvm/emitter.h>
 #include <compiler/computation_order/core.h>
 #include <compiler/custom_onnx_ops.h>
@@ -29,6 +30,7 @@
 #include <compiler/model.h>
 #include <compiler/onnx.h>
 #include <compiler/passes.h>
+#include <compiler/pipeline.h>
 #include <compiler/tensor.h>
 #include <compiler/util.h>
 #include <compiler/value.h>
@@ -38,6 +40,7 @@
 #include <runtime/chxvm.pb.h>
 #include <runtime/chxvm_var.h>
 #include <runtime/meminfo.h>
+#include <runtime/pipeline.h>
 #include <tools/cmdline.h>
 #include <tools/compiler_flags.h>
 #include <tools/log.h>
@@ -93,22 +96,24 @@ class ModelRunner {
 public:
     ModelRunner(const cmdline::parser& args, int64_t initial_used_bytes, std::unique_ptr<Model> model)
         : args_(args), initial_used_bytes_(initial_used_bytes) {
+        std::vector<ChxVMProgramProto> pipeline_programs;
+        std::vector<std::string> pipeline_output_names;
         if (args.exist("backprop_two_phase")) {
             Model backprop_model(*model, model->graph().name() + "_backprop");
             RunDefaultPassesBeforeGradient(model->mutable_graph());
 
             bool skip_scheduling = false;
-            if (g_computation_order.empty()) {
+            if (g_computation_order().empty()) {
                 GenerateGradientNodes(model->mutable_graph(), backprop_model.mutable_graph());
             } else {
-                auto orders = GetComputationOrder(model->graph(), g_computation_order);
+                auto orders = GetComputationOrder(model->graph(), g_computation_order());
                 if (!AddGradientNodesForTrainingWithOrders(model->mutable_graph(), backprop_model.mutable_graph(), orders)) {
                     CHECK(false) << "Computation order is not supported in this graph.";
                 }
                 skip_scheduling = true;
             }
             // TODO(hamaji): Revive shape inference.
-            g_skip_inference = true;
+            g_skip_inference() = true;
 
             LOG() << "Constructing model (forward)..." << std::endl;
             RunDefaultPasses(model->mutable_graph(), false, skip_scheduling);
@@ -119,6 +124,15 @@ public:
             for (Value* value : backprop_model.graph().input_values()) {
                 backprop_ins_.push_back(value->name());
             }
+        } else if (args_.get<int>("pipeline_stages") > 1) {
+            CHECK(!args_.exist("backprop")) << "--pipeline_stages is only for inference";
+            LOG() << "Constructing model..." << std::endl;
+            RunDefaultPasses(model->mutable_graph(), false);
+            LOG() << "Generate code for pipeline stages..." << std::endl;
+            pipeline_programs = EmitPipeline(model->graph(), args_.get<int>("pipeline_stages"));
+            for (const Value* value : model->graph().output_values()) {
+                pipeline_output_names.push_back(value->name());
+            }
         } else {
             LOG() << "Constructing model..." << std::endl;
             RunDefaultPasses(model->mutable_graph(), args_.exist("backprop"));
@@ -139,11 +153,18 @@ public:
         chxvm_opts_.dump_memory_usage = args_.exist("trace") ? 2 : 0;
         chxvm_opts_.base_memory_usage = initial_used_bytes_;
         chxvm_opts_.dump_outputs_dir = args_.get<std::string>("dump_outputs_dir");
+        chxvm_opts_.tune_conv = args_.exist("tune_conv");
+        chxvm_opts_.conv_tuning_cache = args_.get<std::string>("conv_tuning_cache");
         if (!args_.get<std::string>("chrome_tracing").empty()) {
             chxvm_opts_.chrome_tracing = new ChromeTracingEmitter();
         }
 
-        chxvm_->Init();
+        if (!pipeline_programs.empty()) {
+            pipeline_.reset(new Pipeline(pipeline_programs, pipeline_output_names, chxvm_opts_));
+            LOG() << "Pipelined into " << pipeline_->num_stages() << " stages" << std::endl;
+        } else {
+            chxvm_->Init();
+        }
         if (chxvm_bp_) {
             chxvm_bp_->Init();
         }
@@ -205,6 +226,9 @@ public:
     }
 
     InOuts Run(const InOuts& inputs) {
+        if (pipeline_) {
+            return RunPipeline({inputs})[0];
+        }
         if (trace_level()) std::cerr << "Running ChxVM..." << std::endl;
         InOuts outputs = chxvm_->Run(inputs, chxvm_opts_);
         MaybeShowGPUMemory();
@@ -239,6 +263,19 @@ public:
         return outputs;
     }
 
+    // Streams all `inputs` through pipeline stages at once.
+    std::vector<InOuts> RunPipeline(const std::vector<InOuts>& inputs) {
+        CHECK(pipeline_);
+        if (trace_level()) std::cerr << "Running pipeline..." << std::endl;
+        std::vector<InOuts> outputs = pipeline_->Run(inputs);
+        MaybeShowGPUMemory();
+        return outputs;
+    }
+
+    bool is_pipelined() const {
+        return pipeline_.get();
+    }
+
     const InOuts& params() const {
         return params_;
     }
@@ -266,6 +303,8 @@ private:
 
     std::unique_ptr<ChxVM> chxvm_bp_;
     std::vector<std::string> backprop_ins_;
+
+    std::unique_ptr<Pipeline> pipeline_;
 };
 
 void RunMain(const std::vector<std::string>& argv) {
@@ -279,7 +318,14 @@ void RunMain(const std::vector<std::string>& argv) {
     args.add<std::string>("out_chxvm", '\0', "Output ChxVM program", false);
     args.add<std::string>("dump_outputs_dir", '\0', "Dump each output of ChxVM ops to this directory", false);
     args.add<std::string>("report_json", '\0', "Dump report in a JSON", false);
+    args.add<std::string>("conv_tuning_cache", '\0', "A file to keep the results of --tune_conv", false);
+    args.add<std::string>("calibration_table", '\0', "Output a calibration table with --calibrate_quantization", false);
+    args.add<std::string>(
+            "calibration_method", '\0', "The calibration method (minmax, percentile, or entropy)", false, "minmax");
+    args.add<double>("calibration_percentile", '\0', "The percentile for --calibration_method=percentile", false, 99.99);
     args.add<int>("iterations", 'I', "The number of iteartions", false, 1);
+    args.add<int>(
+            "pipeline_stages", '\0', "Split the model into this number of stages run by threads and stream iterations", false, 0);
     args.add<double>("rtol", '\0', "rtol of AllClose", false, 1e-4);
     args.add<double>("atol", '\0', "atol of AllClose", false, 1e-6);
     args.add("equal_nan", '\0', "Treats NaN equal");
@@ -289,6 +335,7 @@ void RunMain(const std::vector<std::string>& argv) {
     args.add("skip_runtime_type_check", '\0', "Skip runtime type check");
     args.add("check_nans", '\0', "Check for NaNs after each operation");
     args.add("check_infs", '\0', "Check for infinities after each operation");
+    args.add("tune_conv", '\0', "Benchmark native convolution algorithms for each shape");
     args.add("compile_only", '\0', "Exit after compilation");
     args.add("dump_onnx", '\0', "Dump ONNX model after optimization");
     args.add("dump_chxvm", '\0', "Dump ChxVM program");
@@ -303,8 +350,8 @@ void RunMain(const std::vector<std::string>& argv) {
     AddCompilerFlags(&args);
     args.parse_check(argv);
     ApplyCompilerFlags(args);
-    g_compiler_log |= args.exist("trace") || args.exist("verbose");
-    g_backend_name = args.get<std::string>("backend");
+    g_compiler_log() |= args.exist("trace") || args.exist("verbose");
+    g_backend_name() = args.get<std::string>("backend");
     g_quiet = args.exist("quiet");
 
     std::string onnx_path = args.get<std::string>("onnx");
@@ -339,7 +386,7 @@ void RunMain(const std::vector<std::string>& argv) {
         chainerx::Device* device = &chainerx::GetDefaultContext().GetDevice(device_spec);
         chainerx::SetDefaultDevice(device);
         if (IsCudaDevice(device)) {
-            g_use_cuda = true;
+            g_use_cuda() = true;
             g_meminfo_enabled = true;
             if (args.exist("trace")) {
                 InitializeMemoryMonitoring(device);
@@ -401,12 +448,46 @@ void RunMain(const std::vector<std::string>& argv) {
         test_cases.swap(new_test_cases);
     }
 
+    CalibrationMethod calibration_method;
+    CHECK(ParseCalibrationMethod(args.get<std::string>("calibration_method"), &calibration_method))
+            << "Unknown calibration method: " << args.get<std::string>("calibration_method");
+    CalibrationCollector calibration_collector;
+
     int num_unknown_ops = 0;
     int64_t flops = CalculateTotalFlops(model->graph(), &num_unknown_ops);
     ModelRunner model_runner(args, initial_used_bytes, std::move(model));
 
     if (args.exist("compile_only")) return;
 
+    if (model_runner.is_pipelined() && iterations > 1) {
+        // Runs overlap in pipeline stages so only the throughput is
+        // measured.
+        std::vector<InOuts> all_inputs;
+        for (const std::unique_ptr<TestCase>& test_case : test_cases) {
+            InOuts inputs(model_runner.params());
+            for (const auto& p : test_case->inputs) {
+                ChxVMVar* v = StageVar(p.second.get());
+                CHECK(inputs.emplace(p.first, std::shared_ptr<ChxVMVar>(v)).second) << "Duplicated input parameter: " << p.first;
+            }
+            all_inputs.push_back(std::move(inputs));
+        }
+        // The first run is for warm up.
+        model_runner.Run(all_inputs.front());
+
+        std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+        model_runner.RunPipeline(all_inputs);
+        chainerx::GetDefaultDevice().Synchronize();
+        std::chrono::system_clock::time_point end = std::chrono::system_clock::now();
+        double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() * 0.001;
+        double average_elapsed = elapsed / iterations;
+        std::cerr << "Average elapsed: " << average_elapsed << " msec per run in a stream of " << iterations << " runs";
+        if (!num_unknown_ops) {
+            std::cerr << " (" << flops / average_elapsed / 1000 / 1000 << " GFLOPs/sec)";
+        }
+        std::cerr << std::endl;
+        return;
+    }
+
     std::vector<double> elapsed_times;
     double total_elapsed = 0;
     double best_elapsed = 0;
@@ -422,6 +503,16 @@ void RunMain(const std::vector<std::string>& argv) {
         std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
         InOuts outputs(model_runner.Run(inputs));
 
+        if (g_calibrate_quantization()) {
+            for (auto it = outputs.begin(); it != outputs.end();) {
+                if (calibration_collector.Add(it->first, it->second->GetArray())) {
+                    it = outputs.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
         if (test_case->outputs.empty()) {
             if (outputs.size() == 1 && outputs.begin()->second->kind() == ChxVMVar::Kind::kSequence) {
                 std::string msg;
@@ -477,6 +568,14 @@ void RunMain(const std::vector<std::string>& argv) {
         }
     }
 
+    if (g_calibrate_quantization()) {
+        const std::string& calibration_table = args.get<std::string>("calibration_table");
+        CHECK(!calibration_table.empty()) << "--calibration_table must be specified with --calibrate_quantization";
+        WriteCalibrationTable(
+                calibration_table,
+                calibration_collector.ComputeQuantizationParams(calibration_method, args.get<double>("calibration_percentile")));
+    }
+
     const std::string& report_json = args.get<std::string>("report_json");
     if (!report_json.empty()) {
         std::ofstream ofs(report_json);
@@ -1,7 +1,11 @@
 #include "tools/train_imagenet.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <memory>
 #include <set>
+#include <thread>
 
 #include <compiler/onnx.h>
 
@@ -19,6 +23,7 @@
 #include <compiler/flags.h>
 #include <compiler/graph.h>
 #include <compiler/model.h>
+#include <compiler/optimizer_update.h>
 #include <compiler/passes.h>
 #include <compiler/tensor.h>
 #include <compiler/util.h>
@@ -28,7 +33,9 @@
 #include <runtime/chrome_tracing.h>
 #include <runtime/chxvm.h>
 #include <runtime/chxvm_var.h>
+#include <runtime/gradient_accumulator.h>
 #include <runtime/meminfo.h>
+#include <runtime/shm_allreduce.h>
 #include <tools/cmdline.h>
 #include <tools/compiler_flags.h>
 #include <tools/util.h>
@@ -58,6 +65,8 @@ void RunMain(const std::vector<std::string>& argv) {
     args.add<std::string>("chrome_tracing", '\0', "Output chrome tracing profile", false);
     args.add<int>("chrome_tracing_frequency", '\0', "Output chrome tracing every this itearation", false, 100);
     args.add<int>("iterations", 'I', "Number of iterations to train", false, 100);
+    args.add<int>("num_workers", '\0', "Number of data-parallel worker processes, each of which runs --batchsize examples", false, 1);
+    args.add<int>("allreduce_bucket_mb", '\0', "Size of gradient buckets all-reduced at once across workers", false, 25);
     args.add("skip_runtime_type_check", '\0', "Skip runtime type check");
     args.add("check_nans", '\0', "Check for NaNs after each operation");
     args.add("check_infs", '\0', "Check for infinities after each operation");
@@ -69,7 +78,7 @@ void RunMain(const std::vector<std::string>& argv) {
     AddCompilerFlags(&args);
     args.parse_check(argv);
     ApplyCompilerFlags(args);
-    g_compiler_log |= args.exist("trace") || args.exist("verbose");
+    g_compiler_log() |= args.exist("trace") || args.exist("verbose");
 
     if (args.rest().size() != 3) {
         std::cerr << args.usage() << std::endl;
@@ -79,6 +88,23 @@ void RunMain(const std::vector<std::string>& argv) {
     g_quiet = args.exist("quiet");
     int batch_size = args.get<int>("batchsize");
 
+    // Workers are forked before ChainerX and threads are initialized.
+    const int num_workers = std::max(1, args.get<int>("num_workers"));
+    const int64_t bucket_bytes = static_cast<int64_t>(args.get<int>("allreduce_bucket_mb")) * 1000 * 1000;
+    std::unique_ptr<LocalProcessGroup> process_group;
+    int rank = 0;
+    if (num_workers > 1) {
+        CHECK(g_optimizer().empty()) << "--optimizer updates parameters before gradients are all-reduced";
+        if (!getenv("OMP_NUM_THREADS")) {
+            const int num_threads = std::max<int>(1, std::thread::hardware_concurrency() / num_workers);
+            setenv("OMP_NUM_THREADS", StrCat(num_threads).c_str(), 0);
+        }
+        process_group.reset(new LocalProcessGroup(num_workers, bucket_bytes));
+        rank = process_group->Fork();
+        // Only the first worker reports progress.
+        g_quiet |= rank != 0;
+    }
+
     LOG() << "Initializing ChainerX..." << std::endl;
     chainerx::Context ctx;
     chainerx::SetGlobalDefaultContext(&ctx);
@@ -88,7 +114,7 @@ void RunMain(const std::vector<std::string>& argv) {
         chainerx::Device* device = &chainerx::GetDefaultContext().GetDevice(device_spec);
         chainerx::SetDefaultDevice(device);
         if (IsCudaDevice(device)) {
-            g_use_cuda = true;
+            g_use_cuda() = true;
             g_meminfo_enabled = true;
         }
     }
@@ -101,14 +127,34 @@ void RunMain(const std::vector<std::string>& argv) {
     const bool expects_onehot = ExpectsOnehot(model);
     CHECK_EQ(1, model.graph().output_values().size());
     const std::string loss_value_name = model.graph().output_values()[0]->name();
+
+    // A batch is split into micro-batches and the model is compiled for
+    // the size of a micro-batch.
+    const int num_micro_batches = std::max(1, g_micro_batches());
+    CHECK_EQ(0, batch_size % num_micro_batches) << "--batchsize must be divisible by --micro_batches";
+    const int micro_batch_size = batch_size / num_micro_batches;
+    if (num_micro_batches > 1) {
+        for (const std::unique_ptr<Value>& value : model.graph().all_values()) {
+            if (!value->IsInput()) {
+                value->set_type(new Type());
+            } else if (!value->initializer() && value->type().ndim() > 0) {
+                std::vector<int64_t> dims = value->type().dims();
+                CHECK_EQ(batch_size, dims[0]) << "The batch size of " << value->name() << " must be --batchsize";
+                dims[0] = micro_batch_size;
+                value->set_type(new Type(value->type().dtype(), dims));
+            }
+        }
+    }
+
     RunDefaultPasses(&model, true /* gen_backprop */);
 
     std::vector<Value*> infeed_values;
     for (Value* value : model.graph().input_values()) {
-        if (value->initializer() == nullptr) {
+        if (value->initializer() == nullptr && !HasPrefix(value->name(), "optimizer@")) {
             infeed_values.push_back(value);
         }
     }
+    const bool has_optimizer = !g_optimizer().empty();
 
     LOG() << "Loading data..." << std::endl;
 
@@ -156,84 +202,133 @@ void RunMain(const std::vector<std::string>& argv) {
         }
     }
     const std::vector<float>& mean = LoadMean(args.rest()[2], height, width);
-    ImageNetIterator train_iter(args.rest()[1], 3, batch_size, mean, height, width);
+    ImageNetIterator train_iter(args.rest()[1], 3, batch_size, mean, height, width, rank, num_workers);
     train_iter.Start();
 
+    GradientAccumulator grad_accumulator(num_micro_batches);
+
+    // Gradients are all-reduced while backprop runs unless they are
+    // accumulated over micro-batches first.
+    std::unique_ptr<GradientAllReducer> all_reducer;
+    if (process_group && num_micro_batches == 1) {
+        all_reducer.reset(new GradientAllReducer(process_group.get(), bucket_bytes));
+        GradientAllReducer* reducer = all_reducer.get();
+        chxvm_opts.output_callback = [reducer](const std::string& name, const ChxVMVar& var) { reducer->Add(name, var); };
+    }
+
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
     LOG() << "Start training!" << std::endl;
     int iter_count = 0;
     int max_iterations = args.get<int>("iterations");
     for (; !max_iterations || iter_count < max_iterations; ++iter_count) {
-        if (!args.get<std::string>("chrome_tracing").empty() && iter_count % args.get<int>("chrome_tracing_frequency") == 1) {
+        if (rank == 0 && !args.get<std::string>("chrome_tracing").empty() &&
+            iter_count % args.get<int>("chrome_tracing_frequency") == 1) {
             chxvm_opts.chrome_tracing = new ChromeTracingEmitter();
         }
 
-        InOuts inputs;
-        {
-            ChromeTracingEmitter::ScopedEvent se(chxvm_opts.chrome_tracing, "Trainer", "Prepare");
-
-            std::vector<chainerx::Array> data = train_iter.GetNext();
-            if (data.empty()) break;
-
-            inputs = params;
-            if (expects_onehot) {
-                CHECK_EQ(2, data.size());
-                CHECK_EQ(3, infeed_values.size());
-                inputs.emplace("Input_0", std::shared_ptr<ChxVMVar>(new ChxVMVar(data[0].ToDevice(chainerx::GetDefaultDevice()))));
-                chainerx::Array labels = data[1].ToDevice(chainerx::GetDefaultDevice()).AsType(chainerx::Dtype::kInt64);
-                chainerx::Array onehot = chainerx::Eye(1000, absl::nullopt, absl::nullopt, chainerx::Dtype::kFloat32).Take(labels, 0);
-                inputs.emplace("Input_1", std::shared_ptr<ChxVMVar>(new ChxVMVar(onehot)));
-                StrictScalar b(chainerx::Dtype::kInt64, chainerx::Scalar(batch_size), true);
-                inputs.emplace("Input_2", std::shared_ptr<ChxVMVar>(new ChxVMVar(b)));
-            } else {
-                CHECK_EQ(2, data.size());
-                CHECK_EQ(2, infeed_values.size());
-                inputs.emplace(
-                        infeed_values[0]->name(), std::shared_ptr<ChxVMVar>(new ChxVMVar(data[0].ToDevice(chainerx::GetDefaultDevice()))));
-                chainerx::Array labels = data[1].ToDevice(chainerx::GetDefaultDevice()).AsType(chainerx::Dtype::kInt64);
-                inputs.emplace(infeed_values[1]->name(), std::shared_ptr<ChxVMVar>(new ChxVMVar(labels)));
+        std::vector<chainerx::Array> data = train_iter.GetNext();
+        if (data.empty()) break;
+        CHECK_EQ(2, data.size());
+        const std::vector<chainerx::Array> xs = SplitBatch(data[0], num_micro_batches);
+        const std::vector<chainerx::Array> ts = SplitBatch(data[1], num_micro_batches);
+
+        double loss = 0;
+        for (int micro_batch = 0; micro_batch < num_micro_batches; ++micro_batch) {
+            InOuts inputs;
+            {
+                ChromeTracingEmitter::ScopedEvent se(chxvm_opts.chrome_tracing, "Trainer", "Prepare");
+
+                inputs = params;
+                if (expects_onehot) {
+                    CHECK_EQ(3, infeed_values.size());
+                    inputs.emplace(
+                            "Input_0", std::shared_ptr<ChxVMVar>(new ChxVMVar(xs[micro_batch].ToDevice(chainerx::GetDefaultDevice()))));
+                    chainerx::Array labels = ts[micro_batch].ToDevice(chainerx::GetDefaultDevice()).AsType(chainerx::Dtype::kInt64);
+                    chainerx::Array onehot = chainerx::Eye(1000, absl::nullopt, absl::nullopt, chainerx::Dtype::kFloat32).Take(labels, 0);
+                    inputs.emplace("Input_1", std::shared_ptr<ChxVMVar>(new ChxVMVar(onehot)));
+                    StrictScalar b(chainerx::Dtype::kInt64, chainerx::Scalar(micro_batch_size), true);
+                    inputs.emplace("Input_2", std::shared_ptr<ChxVMVar>(new ChxVMVar(b)));
+                } else {
+                    CHECK_EQ(2, infeed_values.size());
+                    inputs.emplace(
+                            infeed_values[0]->name(),
+                            std::shared_ptr<ChxVMVar>(new ChxVMVar(xs[micro_batch].ToDevice(chainerx::GetDefaultDevice()))));
+                    chainerx::Array labels = ts[micro_batch].ToDevice(chainerx::GetDefaultDevice()).AsType(chainerx::Dtype::kInt64);
+                    inputs.emplace(infeed_values[1]->name(), std::shared_ptr<ChxVMVar>(new ChxVMVar(labels)));
+                }
+
+                if (has_optimizer) {
+                    const float lr = args.get<float>("learning_rate");
+                    const int64_t step = iter_count + 1;
+                    const int64_t micro_batch_index = micro_batch;
+                    inputs.emplace(
+                            kOptimizerLearningRateName,
+                            std::shared_ptr<ChxVMVar>(new ChxVMVar(MakeHostArray(chainerx::Dtype::kFloat32, {}, &lr))));
+                    inputs.emplace(
+                            kOptimizerStepName,
+                            std::shared_ptr<ChxVMVar>(new ChxVMVar(MakeHostArray(chainerx::Dtype::kInt64, {}, &step))));
+                    inputs.emplace(
+                            kOptimizerMicroBatchName,
+                            std::shared_ptr<ChxVMVar>(new ChxVMVar(MakeHostArray(chainerx::Dtype::kInt64, {}, &micro_batch_index))));
+                }
             }
-        }
 
-        InOuts outputs;
+            InOuts outputs;
 
-        {
-            ChromeTracingEmitter::ScopedEvent se(chxvm_opts.chrome_tracing, "Trainer", "Run");
-            outputs = chxvm.Run(inputs, chxvm_opts);
-        }
+            {
+                ChromeTracingEmitter::ScopedEvent se(chxvm_opts.chrome_tracing, "Trainer", "Run");
+                outputs = chxvm.Run(inputs, chxvm_opts);
+            }
 
-        {
-            ChromeTracingEmitter::ScopedEvent se(chxvm_opts.chrome_tracing, "Trainer", "Update");
-            for (auto&& p : outputs) {
-                if (!HasPrefix(p.first, "grad_out@")) continue;
-                const std::string& param_name = p.first.substr(9);
-                auto found = inputs.find(param_name);
-                CHECK(found != inputs.end());
-                ChxVMVar* param = found->second.get();
-                ChxVMVar* grad = p.second.get();
-                CHECK(param->IsArray()) << "Only an array can be a parameter";
-                CHECK(grad->IsArray()) << "Only an array can be a parameter";
-                param->GetArray() -= grad->GetArray() * args.get<float>("learning_rate");
+            // Parameters are updated in ChxVM with --optimizer.
+            if (!has_optimizer && (num_micro_batches == 1 || grad_accumulator.Add(outputs))) {
+                InOuts grads = num_micro_batches == 1 ? outputs : grad_accumulator.grads();
+                if (process_group) {
+                    ChromeTracingEmitter::ScopedEvent se(chxvm_opts.chrome_tracing, "Trainer", "AllReduce");
+                    if (all_reducer) {
+                        grads = all_reducer->Wait();
+                    } else {
+                        std::vector<chainerx::Array> arrays;
+                        for (auto&& p : grads) {
+                            if (HasPrefix(p.first, "grad_out@")) arrays.push_back(p.second->GetArray());
+                        }
+                        process_group->AllReduceMean(arrays, arrays);
+                    }
+                }
+
+                ChromeTracingEmitter::ScopedEvent se(chxvm_opts.chrome_tracing, "Trainer", "Update");
+                for (auto&& p : grads) {
+                    if (!HasPrefix(p.first, "grad_out@")) continue;
+                    const std::string& param_name = p.first.substr(9);
+                    auto found = params.find(param_name);
+                    CHECK(found != params.end());
+                    ChxVMVar* param = found->second.get();
+                    ChxVMVar* grad = p.second.get();
+                    CHECK(param->IsArray()) << "Only an array can be a parameter";
+                    CHECK(grad->IsArray()) << "Only an array can be a parameter";
+                    param->GetArray() -= grad->GetArray() * args.get<float>("learning_rate");
+                }
             }
-        }
 
-        double loss;
-        {
-            ChromeTracingEmitter::ScopedEvent se(chxvm_opts.chrome_tracing, "Trainer", "Sync");
-            loss = static_cast<double>(chainerx::AsScalar(outputs[loss_value_name]->GetArray()));
+            {
+                ChromeTracingEmitter::ScopedEvent se(chxvm_opts.chrome_tracing, "Trainer", "Sync");
+                loss += static_cast<double>(chainerx::AsScalar(outputs[loss_value_name]->GetArray())) / num_micro_batches;
+            }
         }
 
         std::chrono::system_clock::time_point end = std::chrono::system_clock::now();
         double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() * 0.001;
         start = end;
-        std::cout << train_iter.GetStatus() << " loss=" << loss << " elapsed=" << elapsed << "ms";
-        if (initial_used_bytes >= 0) {
-            size_t used_bytes = GetUsedMemory() - initial_used_bytes;
-            size_t param_mbs = param_bytes / 1000 / 1000;
-            size_t used_mbs = used_bytes / 1000 / 1000;
-            std::cout << " param=" << param_mbs << "MB used=" << used_mbs << "MB";
+        if (rank == 0) {
+            std::cout << train_iter.GetStatus() << " loss=" << loss << " elapsed=" << elapsed << "ms";
+            if (initial_used_bytes >= 0) {
+                size_t used_bytes = GetUsedMemory() - initial_used_bytes;
+                size_t param_mbs = param_bytes / 1000 / 1000;
+                size_t used_mbs = used_bytes / 1000 / 1000;
+                std::cout << " param=" << param_mbs << "MB used=" << used_mbs << "MB";
+            }
+            std::cout << std::endl;
         }
-        std::cout << std::endl;
 
         if (chxvm_opts.chrome_tracing) {
             chxvm_opts.chrome_tracing->Emit(args.get<std::string>("chrome_tracing"));
@@ -243,6 +338,11 @@ void RunMain(const std::vector<std::string>& argv) {
     }
 
     train_iter.Terminate();
+
+    if (process_group) {
+        all_reducer.reset();
+        CHECK(process_group->Join()) << "Some workers failed";
+    }
 }
 
 }  // namespace